@@ -38,6 +38,7 @@
 #endif
 #include "sysemu/cpus.h"
 #include "exec/cpu-all.h"
+#include "exec/cputlb.h"
 #include "sysemu/cpu-timers.h"
 #include "sysemu/replay.h"
 #include "sysemu/tcg.h"
@@ -189,7 +190,7 @@ static inline TranslationBlock *tb_lookup(CPUState *cpu, target_ulong pc,
                tb->cs_base == cs_base &&
                tb->flags == flags &&
                tb->trace_vcpu_dstate == *cpu->trace_dstate &&
-               tb_cflags(tb) == cflags)) {
+               (tb_cflags(tb) & ~CF_HOT) == cflags)) {
         return tb;
     }
     tb = tb_htable_lookup(cpu, pc, cs_base, flags, cflags);
@@ -328,6 +329,10 @@ const void *HELPER(lookup_tb_ptr)(CPUArchState *env)
     if (tb == NULL) {
         return tcg_code_gen_epilogue;
     }
+    if (unlikely(tb_lookup_is_hot(tb))) {
+        /* Let cpu_exec() promote it */
+        return tcg_code_gen_epilogue;
+    }
 
     log_cpu_exec(pc, cpu, tb);
 
@@ -507,7 +512,7 @@ static bool tb_lookup_cmp(const void *p, const void *d)
         tb->cs_base == desc->cs_base &&
         tb->flags == desc->flags &&
         tb->trace_vcpu_dstate == desc->trace_vcpu_dstate &&
-        tb_cflags(tb) == desc->cflags) {
+        (tb_cflags(tb) & ~CF_HOT) == desc->cflags) {
         /* check next page if needed */
         if (tb->page_addr[1] == -1) {
             return true;
@@ -986,6 +991,9 @@ int cpu_exec(CPUState *cpu)
                  * for the fast lookup
                  */
                 qatomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
+            } else if (unlikely(tb_lookup_is_hot(tb))) {
+                tb = tb_promote(cpu, tb);
+                qatomic_set(&cpu->tb_jmp_cache[tb_jmp_cache_hash_func(pc)], tb);
             }
 
 #ifndef CONFIG_USER_ONLY
@@ -1096,6 +1104,20 @@ HumanReadableText *qmp_x_query_opcount(Error **errp)
     return human_readable_text_from_str(buf);
 }
 
+HumanReadableText *qmp_x_query_tlb_stats(Error **errp)
+{
+    g_autoptr(GString) buf = g_string_new("");
+
+    if (!tcg_enabled()) {
+        error_setg(errp, "TLB statistics are only available with accel=tcg");
+        return NULL;
+    }
+
+    tlb_dump_stats(buf);
+
+    return human_readable_text_from_str(buf);
+}
+
 #ifdef CONFIG_PROFILER
 
 int64_t dev_time;
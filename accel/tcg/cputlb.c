@@ -91,11 +91,31 @@ static inline size_t sizeof_tlb(CPUTLBDescFast *fast)
     return fast->mask + (1 << CPU_TLB_ENTRY_BITS);
 }
 
+static inline size_t vtlb_n_entries(CPUTLBDesc *desc)
+{
+    return CPU_VTLB_WAYS << desc->vbits;
+}
+
+/*
+ * Return the first entry of the victim tlb set for @page.  Pages that
+ * conflict in the direct mapped table share the low bits of their page
+ * number, so the set is picked with the bits right above those.
+ */
+static inline size_t vtlb_set(CPUTLBDesc *desc, CPUTLBDescFast *fast,
+                              target_ulong page)
+{
+    target_ulong vpn = page >> TARGET_PAGE_BITS;
+    unsigned tlb_bits = ctz64(tlb_n_entries(fast));
+
+    return ((vpn >> tlb_bits) & ((1 << desc->vbits) - 1)) * CPU_VTLB_WAYS;
+}
+
 static void tlb_window_reset(CPUTLBDesc *desc, int64_t ns,
                              size_t max_entries)
 {
     desc->window_begin_ns = ns;
     desc->window_max_entries = max_entries;
+    desc->window_fill_ns = 0;
 }
 
 static void tb_jmp_cache_clear_page(CPUState *cpu, target_ulong page_addr)
@@ -154,6 +174,12 @@ static void tb_flush_jmp_cache(CPUState *cpu, target_ulong addr)
  * is direct mapped, so we want the use rate to be low (or at least not too
  * high), since otherwise we are likely to have a significant amount of
  * conflict misses.
+ *
+ * 4. Look at the cost of the misses as well, measured as the share of the
+ * window spent in tlb_fill. While it is high, do not shrink the TLB even if
+ * its use rate is low, and grow the victim TLB, which absorbs the conflict
+ * misses of the direct mapped table. Shrink the victim TLB again once the
+ * misses have become cheap over a whole window.
  */
 static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
                                   int64_t now)
@@ -164,15 +190,32 @@ static void tlb_mmu_resize_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast,
     int64_t window_len_ms = 100;
     int64_t window_len_ns = window_len_ms * 1000 * 1000;
     bool window_expired = now > desc->window_begin_ns + window_len_ns;
+    int64_t fill_rate;
+    unsigned vbits = desc->vbits;
 
     if (desc->n_used_entries > desc->window_max_entries) {
         desc->window_max_entries = desc->n_used_entries;
     }
     rate = desc->window_max_entries * 100 / old_size;
+    fill_rate = desc->window_fill_ns * 100 /
+                MAX(now - desc->window_begin_ns, 1);
+
+    if (fill_rate >= 10) {
+        vbits = MIN(vbits + 1, CPU_VTLB_MAX_BITS);
+    } else if (fill_rate < 2 && window_expired) {
+        vbits = MAX(vbits - 1, CPU_VTLB_MIN_BITS);
+    }
+    if (vbits != desc->vbits) {
+        g_free(desc->vtable);
+        g_free(desc->viotlb);
+        desc->vbits = vbits;
+        desc->vtable = g_new(CPUTLBEntry, vtlb_n_entries(desc));
+        desc->viotlb = g_new(CPUIOTLBEntry, vtlb_n_entries(desc));
+    }
 
     if (rate > 70) {
         new_size = MIN(old_size << 1, 1 << CPU_TLB_DYN_MAX_BITS);
-    } else if (rate < 30 && window_expired) {
+    } else if (rate < 30 && window_expired && fill_rate < 10) {
         size_t ceil = pow2ceil(desc->window_max_entries);
         size_t expected_rate = desc->window_max_entries * 100 / ceil;
 
@@ -237,7 +280,7 @@ static void tlb_mmu_flush_locked(CPUTLBDesc *desc, CPUTLBDescFast *fast)
     desc->large_page_mask = -1;
     desc->vindex = 0;
     memset(fast->table, -1, sizeof_tlb(fast));
-    memset(desc->vtable, -1, sizeof(desc->vtable));
+    memset(desc->vtable, -1, vtlb_n_entries(desc) * sizeof(CPUTLBEntry));
 }
 
 static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx,
@@ -248,6 +291,7 @@ static void tlb_flush_one_mmuidx_locked(CPUArchState *env, int mmu_idx,
 
     tlb_mmu_resize_locked(desc, fast, now);
     tlb_mmu_flush_locked(desc, fast);
+    qatomic_set(&desc->flush_count, desc->flush_count + 1);
 }
 
 static void tlb_mmu_init(CPUTLBDesc *desc, CPUTLBDescFast *fast, int64_t now)
@@ -259,6 +303,9 @@ static void tlb_mmu_init(CPUTLBDesc *desc, CPUTLBDescFast *fast, int64_t now)
     fast->mask = (n_entries - 1) << CPU_TLB_ENTRY_BITS;
     fast->table = g_new(CPUTLBEntry, n_entries);
     desc->iotlb = g_new(CPUIOTLBEntry, n_entries);
+    desc->vbits = CPU_VTLB_DEFAULT_BITS;
+    desc->vtable = g_new(CPUTLBEntry, vtlb_n_entries(desc));
+    desc->viotlb = g_new(CPUIOTLBEntry, vtlb_n_entries(desc));
     tlb_mmu_flush_locked(desc, fast);
 }
 
@@ -300,6 +347,8 @@ void tlb_destroy(CPUState *cpu)
 
         g_free(fast->table);
         g_free(desc->iotlb);
+        g_free(desc->vtable);
+        g_free(desc->viotlb);
     }
 }
 
@@ -339,6 +388,40 @@ void tlb_flush_counts(size_t *pfull, size_t *ppart, size_t *pelide)
     *pelide = elide;
 }
 
+void tlb_dump_stats(GString *buf)
+{
+    CPUState *cpu;
+    int i;
+
+    CPU_FOREACH(cpu) {
+        CPUArchState *env = cpu->env_ptr;
+
+        g_string_append_printf(buf, "CPU#%d\n", cpu->cpu_index);
+        g_string_append_printf(buf, "  %-7s %8s %6s %12s %12s %10s %10s\n",
+                               "mmu_idx", "entries", "victim", "victim-hits",
+                               "fills", "fill-ms", "flushes");
+        for (i = 0; i < NB_MMU_MODES; i++) {
+            CPUTLBDesc *desc = &env_tlb(env)->d[i];
+            CPUTLBDescFast *fast = &env_tlb(env)->f[i];
+            size_t hits = qatomic_read(&desc->victim_hit_count);
+            size_t fills = qatomic_read(&desc->fill_count);
+            size_t flushes = qatomic_read(&desc->flush_count);
+            uint64_t fill_ns = qatomic_read_u64(&desc->fill_ns);
+
+            if (!hits && !fills) {
+                continue;
+            }
+            g_string_append_printf(buf,
+                                   "  %-7d %8zu %6u %12zu %12zu %10" PRIu64
+                                   " %10zu\n", i,
+                                   (size_t)(qatomic_read(&fast->mask) >>
+                                            CPU_TLB_ENTRY_BITS) + 1,
+                                   CPU_VTLB_WAYS << qatomic_read(&desc->vbits),
+                                   hits, fills, fill_ns / SCALE_MS, flushes);
+        }
+    }
+}
+
 static void tlb_flush_by_mmuidx_async_work(CPUState *cpu, run_on_cpu_data data)
 {
     CPUArchState *env = cpu->env_ptr;
@@ -453,6 +536,23 @@ static inline bool tlb_entry_is_empty(const CPUTLBEntry *te)
     return te->addr_read == -1 && te->addr_write == -1 && te->addr_code == -1;
 }
 
+/**
+ * tlb_entry_page - return the page mapped by a non-empty entry
+ * @te: pointer to CPUTLBEntry
+ */
+static inline target_ulong tlb_entry_page(const CPUTLBEntry *te)
+{
+    target_ulong addr = te->addr_read;
+
+    if (addr == -1) {
+        addr = te->addr_write;
+    }
+    if (addr == -1) {
+        addr = te->addr_code;
+    }
+    return addr & TARGET_PAGE_MASK;
+}
+
 /* Called with tlb_c.lock held */
 static bool tlb_flush_entry_mask_locked(CPUTLBEntry *tlb_entry,
                                         target_ulong page,
@@ -477,10 +577,15 @@ static void tlb_flush_vtlb_page_mask_locked(CPUArchState *env, int mmu_idx,
                                             target_ulong mask)
 {
     CPUTLBDesc *d = &env_tlb(env)->d[mmu_idx];
-    int k;
+    size_t k, first = 0, n = vtlb_n_entries(d);
 
     assert_cpu_is_self(env_cpu(env));
-    for (k = 0; k < CPU_VTLB_SIZE; k++) {
+    /* A masked page may span several sets.  */
+    if (mask == -1) {
+        first = vtlb_set(d, &env_tlb(env)->f[mmu_idx], page);
+        n = CPU_VTLB_WAYS;
+    }
+    for (k = first; k < first + n; k++) {
         if (tlb_flush_entry_mask_locked(&d->vtable[k], page, mask)) {
             tlb_n_used_entries_dec(env, mmu_idx);
         }
@@ -1030,7 +1135,8 @@ void tlb_reset_dirty(CPUState *cpu, ram_addr_t start1, ram_addr_t length)
                                          start1, length);
         }
 
-        for (i = 0; i < CPU_VTLB_SIZE; i++) {
+        n = vtlb_n_entries(&env_tlb(env)->d[mmu_idx]);
+        for (i = 0; i < n; i++) {
             tlb_reset_dirty_range_locked(&env_tlb(env)->d[mmu_idx].vtable[i],
                                          start1, length);
         }
@@ -1063,9 +1169,12 @@ void tlb_set_dirty(CPUState *cpu, target_ulong vaddr)
     }
 
     for (mmu_idx = 0; mmu_idx < NB_MMU_MODES; mmu_idx++) {
-        int k;
-        for (k = 0; k < CPU_VTLB_SIZE; k++) {
-            tlb_set_dirty1_locked(&env_tlb(env)->d[mmu_idx].vtable[k], vaddr);
+        CPUTLBDesc *desc = &env_tlb(env)->d[mmu_idx];
+        size_t k = vtlb_set(desc, &env_tlb(env)->f[mmu_idx], vaddr);
+        size_t end = k + CPU_VTLB_WAYS;
+
+        for (; k < end; k++) {
+            tlb_set_dirty1_locked(&desc->vtable[k], vaddr);
         }
     }
     qemu_spin_unlock(&env_tlb(env)->c.lock);
@@ -1214,7 +1323,9 @@ void tlb_set_page_with_attrs(CPUState *cpu, target_ulong vaddr,
      * different page; otherwise just overwrite the stale data.
      */
     if (!tlb_hit_page_anyprot(te, vaddr_page) && !tlb_entry_is_empty(te)) {
-        unsigned vidx = desc->vindex++ % CPU_VTLB_SIZE;
+        target_ulong vpage = tlb_entry_page(te);
+        unsigned vidx = vtlb_set(desc, &tlb->f[mmu_idx], vpage) +
+                        desc->vindex++ % CPU_VTLB_WAYS;
         CPUTLBEntry *tv = &desc->vtable[vidx];
 
         /* Evict the old entry into the victim tlb.  */
@@ -1295,6 +1406,29 @@ static inline ram_addr_t qemu_ram_addr_from_host_nofail(void *ptr)
     return ram_addr;
 }
 
+static bool tlb_fill_timed(CPUState *cpu, target_ulong addr, int size,
+                           MMUAccessType access_type, int mmu_idx,
+                           bool probe, uintptr_t retaddr)
+{
+    CPUClass *cc = CPU_GET_CLASS(cpu);
+    CPUTLBDesc *desc = &env_tlb(cpu->env_ptr)->d[mmu_idx];
+    int64_t start = get_clock_realtime();
+    int64_t delta;
+    bool ok;
+
+    /*
+     * Only fills that return are timed; those raising an exception
+     * longjmp out of tcg_ops->tlb_fill and are merely counted.
+     */
+    qatomic_set(&desc->fill_count, desc->fill_count + 1);
+    ok = cc->tcg_ops->tlb_fill(cpu, addr, size,
+                               access_type, mmu_idx, probe, retaddr);
+    delta = get_clock_realtime() - start;
+    desc->window_fill_ns += delta;
+    qatomic_set_u64(&desc->fill_ns, desc->fill_ns + delta);
+    return ok;
+}
+
 /*
  * Note: tlb_fill() can trigger a resize of the TLB. This means that all of the
  * caller's prior references to the TLB table (e.g. CPUTLBEntry pointers) must
@@ -1303,15 +1437,13 @@ static inline ram_addr_t qemu_ram_addr_from_host_nofail(void *ptr)
 static void tlb_fill(CPUState *cpu, target_ulong addr, int size,
                      MMUAccessType access_type, int mmu_idx, uintptr_t retaddr)
 {
-    CPUClass *cc = CPU_GET_CLASS(cpu);
     bool ok;
 
     /*
      * This is not a probe, so only valid return is success; failure
      * should result in exception + longjmp to the cpu loop.
      */
-    ok = cc->tcg_ops->tlb_fill(cpu, addr, size,
-                               access_type, mmu_idx, false, retaddr);
+    ok = tlb_fill_timed(cpu, addr, size, access_type, mmu_idx, false, retaddr);
     assert(ok);
 }
 
@@ -1361,7 +1493,7 @@ static uint64_t io_readx(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
         cpu_io_recompile(cpu, retaddr);
     }
 
-    if (!qemu_mutex_iothread_locked()) {
+    if (mr->global_locking && !qemu_mutex_iothread_locked()) {
         qemu_mutex_lock_iothread();
         locked = true;
     }
@@ -1422,7 +1554,7 @@ static void io_writex(CPUArchState *env, CPUIOTLBEntry *iotlbentry,
      */
     save_iotlb_data(cpu, iotlbentry->addr, section, mr_offset);
 
-    if (!qemu_mutex_iothread_locked()) {
+    if (mr->global_locking && !qemu_mutex_iothread_locked()) {
         qemu_mutex_lock_iothread();
         locked = true;
     }
@@ -1456,11 +1588,14 @@ static inline target_ulong tlb_read_ofs(CPUTLBEntry *entry, size_t ofs)
 static bool victim_tlb_hit(CPUArchState *env, size_t mmu_idx, size_t index,
                            size_t elt_ofs, target_ulong page)
 {
+    CPUTLBDesc *desc = &env_tlb(env)->d[mmu_idx];
+    CPUTLBDescFast *fast = &env_tlb(env)->f[mmu_idx];
+    size_t set = vtlb_set(desc, fast, page);
     size_t vidx;
 
     assert_cpu_is_self(env_cpu(env));
-    for (vidx = 0; vidx < CPU_VTLB_SIZE; ++vidx) {
-        CPUTLBEntry *vtlb = &env_tlb(env)->d[mmu_idx].vtable[vidx];
+    for (vidx = set; vidx < set + CPU_VTLB_WAYS; ++vidx) {
+        CPUTLBEntry *vtlb = &desc->vtable[vidx];
         target_ulong cmp;
 
         /* elt_ofs might correspond to .addr_write, so use qatomic_read */
@@ -1472,17 +1607,33 @@ static bool victim_tlb_hit(CPUArchState *env, size_t mmu_idx, size_t index,
 
         if (cmp == page) {
             /* Found entry in victim tlb, swap tlb and iotlb.  */
-            CPUTLBEntry tmptlb, *tlb = &env_tlb(env)->f[mmu_idx].table[index];
+            CPUTLBEntry tmptlb, *tlb = &fast->table[index];
+            CPUIOTLBEntry tmpio, *io = &desc->iotlb[index];
+            size_t oidx = vidx;
 
             qemu_spin_lock(&env_tlb(env)->c.lock);
             copy_tlb_helper_locked(&tmptlb, tlb);
             copy_tlb_helper_locked(tlb, vtlb);
-            copy_tlb_helper_locked(vtlb, &tmptlb);
+            tmpio = *io;
+            *io = desc->viotlb[vidx];
+
+            /*
+             * The old entry belongs to the set of its own page, which is
+             * usually not the one of @page; page flushes only look there.
+             */
+            if (!tlb_entry_is_empty(&tmptlb)) {
+                size_t oset = vtlb_set(desc, fast, tlb_entry_page(&tmptlb));
+
+                if (oset != set) {
+                    oidx = oset + desc->vindex++ % CPU_VTLB_WAYS;
+                    memset(vtlb, -1, sizeof(*vtlb));
+                }
+            }
+            copy_tlb_helper_locked(&desc->vtable[oidx], &tmptlb);
+            desc->viotlb[oidx] = tmpio;
             qemu_spin_unlock(&env_tlb(env)->c.lock);
 
-            CPUIOTLBEntry tmpio, *io = &env_tlb(env)->d[mmu_idx].iotlb[index];
-            CPUIOTLBEntry *vio = &env_tlb(env)->d[mmu_idx].viotlb[vidx];
-            tmpio = *io; *io = *vio; *vio = tmpio;
+            qatomic_set(&desc->victim_hit_count, desc->victim_hit_count + 1);
             return true;
         }
     }
@@ -1606,10 +1757,9 @@ static int probe_access_internal(CPUArchState *env, target_ulong addr,
     if (!tlb_hit_page(tlb_addr, page_addr)) {
         if (!victim_tlb_hit(env, mmu_idx, index, elt_ofs, page_addr)) {
             CPUState *cs = env_cpu(env);
-            CPUClass *cc = CPU_GET_CLASS(cs);
 
-            if (!cc->tcg_ops->tlb_fill(cs, addr, fault_size, access_type,
-                                       mmu_idx, nonfault, retaddr)) {
+            if (!tlb_fill_timed(cs, addr, fault_size, access_type,
+                                mmu_idx, nonfault, retaddr)) {
                 /* Non-faulting page table read failed.  */
                 *phost = NULL;
                 return TLB_INVALID_MASK;
@@ -18,4 +18,49 @@ G_NORETURN void cpu_io_recompile(CPUState *cpu, uintptr_t retaddr);
 void page_init(void);
 void tb_htable_init(void);
 
+extern uint32_t tb_hot_threshold;
+
+/*
+ * Count a lookup of @tb; returns true once it should be retranslated
+ * with tb_promote(). TBs entered through a direct jump are not counted,
+ * but their chain is counted at its entry.
+ */
+static inline bool tb_lookup_is_hot(TranslationBlock *tb)
+{
+    uint32_t cflags = tb_cflags(tb);
+    uint32_t n;
+
+    if (likely(!tb_hot_threshold) || (cflags & (CF_HOT | CF_COUNT_MASK))) {
+        return false;
+    }
+    /* Racy between vCPUs, but the count only has to be approximate */
+    n = qatomic_read(&tb->lookups) + 1;
+    qatomic_set(&tb->lookups, n);
+    return n >= tb_hot_threshold;
+}
+
+TranslationBlock *tb_promote(CPUState *cpu, TranslationBlock *tb);
+
+#ifdef CONFIG_SOFTMMU
+void tb_persist_init(const char *path);
+TranslationBlock *tb_persist_lookup(CPUArchState *env, target_ulong pc,
+                                    target_ulong cs_base, uint32_t flags,
+                                    uint32_t cflags,
+                                    uint32_t trace_vcpu_dstate,
+                                    tb_page_addr_t phys_pc);
+void tb_persist_exclude(TranslationBlock *tb);
+void tb_persist_flush(void);
+void tb_persist_dump_info(GString *buf);
+#else
+static inline TranslationBlock *
+tb_persist_lookup(CPUArchState *env, target_ulong pc, target_ulong cs_base,
+                  uint32_t flags, uint32_t cflags, uint32_t trace_vcpu_dstate,
+                  tb_page_addr_t phys_pc)
+{
+    return NULL;
+}
+static inline void tb_persist_exclude(TranslationBlock *tb) { }
+static inline void tb_persist_flush(void) { }
+#endif
+
 #endif /* ACCEL_TCG_INTERNAL_H */
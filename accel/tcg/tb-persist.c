@@ -0,0 +1,508 @@
+/*
+ * Persistent translation cache
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/*
+ * Firmware boots run the same guest code over and over, and most of the
+ * time of a short boot goes into translating it. With "-accel tcg,
+ * tb-cache=FILE" the translation blocks alive at exit are written to
+ * FILE, and the next run reuses them instead of translating again.
+ *
+ * Generated code is not relocatable: it calls helpers and jumps to the
+ * epilogue with absolute or PC-relative addresses. Blocks are therefore
+ * reloaded at the address they were generated at, which requires:
+ *
+ * - the same QEMU binary, loaded at the same address (i.e. a non-PIE
+ *   build, or address space randomization disabled with "setarch -R");
+ * - code_gen_buffer mapped at the same address, with the same size and
+ *   split-wx disabled;
+ * - the same machine and CPU type.
+ *
+ * Anything else makes the whole file stale, and it is then ignored and
+ * overwritten at exit. Blocks that embed other host pointers, e.g. the
+ * ARMCPRegInfo of a coprocessor access, are never saved. Neither is
+ * anything while a plugin is installed: instrumented blocks call into the
+ * plugin, and uninstrumented ones would hide code from it, so the cache is
+ * neither loaded nor saved then.
+ *
+ * Reloaded blocks are not published right away. They are kept in an
+ * index keyed like tb_ctx.htable, and tb_gen_code() adopts one in place
+ * of a translation if the guest code it was generated from is unchanged:
+ * the physical pages must match, and so must the guest bytes, which are
+ * saved alongside each block.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/cacheflush.h"
+#include "qemu/error-report.h"
+#include "qemu/notify.h"
+#include "qemu/plugin.h"
+#include "exec/exec-all.h"
+#include "exec/memory.h"
+#include "exec/ram_addr.h"
+#include "hw/boards.h"
+#include "sysemu/runstate.h"
+#include "sysemu/sysemu.h"
+#include "tcg/tcg.h"
+#include "trace.h"
+#include "tb-hash.h"
+#include "internal.h"
+
+#define TB_PERSIST_MAGIC    "QEMUTBC"
+#define TB_PERSIST_VERSION  1
+
+typedef struct TBPersistHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nb_tbs;
+
+    /* identity of the QEMU binary */
+    uint64_t exe_dev;
+    uint64_t exe_ino;
+    uint64_t exe_size;
+    int64_t exe_mtime;
+    uint64_t tb_gen_code;
+
+    /* layout of code_gen_buffer */
+    uint64_t code_gen_start;
+    uint64_t code_gen_capacity;
+    uint64_t code_gen_epilogue;
+
+    char config[128];
+} TBPersistHeader;
+
+/* Followed by @len bytes of TB and host code, then tb->size guest bytes */
+typedef struct TBPersistRecord {
+    uint64_t addr;
+    uint32_t len;
+    uint32_t reserved;
+} TBPersistRecord;
+
+typedef struct TBPersistKey {
+    tb_page_addr_t phys_pc;
+    target_ulong pc;
+    target_ulong cs_base;
+    uint32_t flags;
+    uint32_t cflags;
+    uint32_t trace_vcpu_dstate;
+} TBPersistKey;
+
+typedef struct TBPersistEntry {
+    TBPersistKey key;
+    TranslationBlock *tb;
+    uint8_t *guest;
+} TBPersistEntry;
+
+static struct {
+    char *path;
+    bool enabled;
+
+    /* contents of @path, until machine init done */
+    gchar *data;
+    gsize size;
+
+    QemuMutex lock;
+    GHashTable *entries;    /* TBPersistKey -> TBPersistEntry */
+    GHashTable *excluded;   /* TBs embedding host pointers */
+    unsigned nb_entries;
+    unsigned nb_loaded;
+    unsigned nb_adopted;
+
+    Notifier init_done;
+    Notifier exit;
+} tb_persist;
+
+static guint tb_persist_key_hash(gconstpointer p)
+{
+    const TBPersistKey *k = p;
+
+    return tb_hash_func(k->phys_pc, k->pc, k->flags, k->cflags,
+                        k->trace_vcpu_dstate);
+}
+
+static gboolean tb_persist_key_equal(gconstpointer a, gconstpointer b)
+{
+    const TBPersistKey *ka = a;
+    const TBPersistKey *kb = b;
+
+    return ka->phys_pc == kb->phys_pc &&
+           ka->pc == kb->pc &&
+           ka->cs_base == kb->cs_base &&
+           ka->flags == kb->flags &&
+           ka->cflags == kb->cflags &&
+           ka->trace_vcpu_dstate == kb->trace_vcpu_dstate;
+}
+
+static void tb_persist_key_init(TBPersistKey *k, const TranslationBlock *tb)
+{
+    k->phys_pc = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
+    k->pc = tb->pc;
+    k->cs_base = tb->cs_base;
+    k->flags = tb->flags;
+    /* A hot TB is adopted by the first lookup, which is not CF_HOT */
+    k->cflags = tb->cflags & ~CF_HOT;
+    k->trace_vcpu_dstate = tb->trace_vcpu_dstate;
+}
+
+static bool tb_persist_header_init(TBPersistHeader *h)
+{
+    struct stat st;
+
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, TB_PERSIST_MAGIC, sizeof(TB_PERSIST_MAGIC));
+    h->version = TB_PERSIST_VERSION;
+
+    if (stat("/proc/self/exe", &st) < 0) {
+        return false;
+    }
+    h->exe_dev = st.st_dev;
+    h->exe_ino = st.st_ino;
+    h->exe_size = st.st_size;
+    h->exe_mtime = st.st_mtime;
+    h->tb_gen_code = (uintptr_t)tb_gen_code;
+    return true;
+}
+
+/* The parts of the header that are only known once TCG is set up */
+static void tb_persist_header_init_layout(TBPersistHeader *h)
+{
+    h->code_gen_start = (uintptr_t)tcg_region_start();
+    h->code_gen_capacity = tcg_code_capacity();
+    h->code_gen_epilogue = (uintptr_t)tcg_code_gen_epilogue;
+    snprintf(h->config, sizeof(h->config), "%s %s %u " RAM_ADDR_FMT,
+             MACHINE_GET_CLASS(current_machine)->name,
+             object_get_typename(OBJECT(first_cpu)),
+             current_machine->smp.cpus, current_machine->ram_size);
+}
+
+/* Offset of guest code of @tb in its first page, and length of each part */
+static void tb_persist_guest_layout(const TranslationBlock *tb,
+                                    size_t *offset, size_t *len0,
+                                    size_t *len1)
+{
+    *offset = tb->pc & ~TARGET_PAGE_MASK;
+    *len0 = MIN(tb->size, TARGET_PAGE_SIZE - *offset);
+    *len1 = tb->size - *len0;
+}
+
+static size_t tb_persist_search_size(const TranslationBlock *tb)
+{
+    const uint8_t *start = tb->tc.ptr + tb->tc.size;
+    const uint8_t *p = start;
+    int i, n = tb->icount * (TARGET_INSN_START_WORDS + 1);
+
+    /* See encode_search(): sleb128 deltas */
+    for (i = 0; i < n; i++) {
+        while (*p++ & 0x80) {
+            continue;
+        }
+    }
+    return p - start;
+}
+
+static void tb_persist_entry_free(gpointer p)
+{
+    TBPersistEntry *e = p;
+
+    g_free(e->guest);
+    g_free(e);
+}
+
+TranslationBlock *tb_persist_lookup(CPUArchState *env, target_ulong pc,
+                                    target_ulong cs_base, uint32_t flags,
+                                    uint32_t cflags,
+                                    uint32_t trace_vcpu_dstate,
+                                    tb_page_addr_t phys_pc)
+{
+    TBPersistKey key = {
+        .phys_pc = phys_pc,
+        .pc = pc,
+        .cs_base = cs_base,
+        .flags = flags,
+        .cflags = cflags,
+        .trace_vcpu_dstate = trace_vcpu_dstate,
+    };
+    TBPersistEntry *e;
+    TranslationBlock *tb;
+    size_t offset, len0, len1;
+    bool match;
+
+    if (!qatomic_read(&tb_persist.nb_entries)) {
+        return NULL;
+    }
+
+    /* Each entry is tried once, then it is either adopted or stale */
+    qemu_mutex_lock(&tb_persist.lock);
+    e = g_hash_table_lookup(tb_persist.entries, &key);
+    if (e) {
+        g_hash_table_steal(tb_persist.entries, &key);
+        qatomic_set(&tb_persist.nb_entries, tb_persist.nb_entries - 1);
+    }
+    qemu_mutex_unlock(&tb_persist.lock);
+    if (!e) {
+        return NULL;
+    }
+
+    tb = e->tb;
+    tb_persist_guest_layout(tb, &offset, &len0, &len1);
+    match = !memcmp(qemu_map_ram_ptr(NULL, phys_pc), e->guest, len0);
+    if (match && len1) {
+        /* The translator would have read the second page as well */
+        tb_page_addr_t phys_page2 =
+            get_page_addr_code(env, (pc & TARGET_PAGE_MASK) +
+                                    TARGET_PAGE_SIZE);
+
+        match = phys_page2 != -1 && phys_page2 == tb->page_addr[1] &&
+                !memcmp(qemu_map_ram_ptr(NULL, phys_page2),
+                        e->guest + len0, len1);
+    }
+    tb_persist_entry_free(e);
+    if (!match) {
+        return NULL;
+    }
+
+    qatomic_inc(&tb_persist.nb_adopted);
+    return tb;
+}
+
+void tb_persist_exclude(TranslationBlock *tb)
+{
+    if (!tb_persist.enabled) {
+        return;
+    }
+    qemu_mutex_lock(&tb_persist.lock);
+    g_hash_table_add(tb_persist.excluded, tb);
+    qemu_mutex_unlock(&tb_persist.lock);
+}
+
+/* Called from do_tb_flush(); the reloaded code is about to be overwritten */
+void tb_persist_flush(void)
+{
+    if (!tb_persist.enabled) {
+        return;
+    }
+    qemu_mutex_lock(&tb_persist.lock);
+    g_hash_table_remove_all(tb_persist.entries);
+    g_hash_table_remove_all(tb_persist.excluded);
+    qatomic_set(&tb_persist.nb_entries, 0);
+    qemu_mutex_unlock(&tb_persist.lock);
+}
+
+void tb_persist_dump_info(GString *buf)
+{
+    if (!tb_persist.enabled) {
+        return;
+    }
+    g_string_append_printf(buf, "TB cache adopted    %u/%u\n",
+                           qatomic_read(&tb_persist.nb_adopted),
+                           tb_persist.nb_loaded);
+}
+
+static bool tb_persist_load_record(const TBPersistRecord *r, const void *blob,
+                                   size_t avail, const void **end)
+{
+    TranslationBlock *tb = (TranslationBlock *)(uintptr_t)r->addr;
+    const TranslationBlock *saved = blob;
+    TBPersistEntry *e;
+    size_t offset, len0, len1;
+
+    if (r->len < sizeof(*tb) || r->len > avail ||
+        !in_code_gen_buffer(tb) ||
+        !in_code_gen_buffer((void *)tb + r->len)) {
+        return false;
+    }
+    if (saved->tc.ptr <= (void *)tb ||
+        saved->tc.ptr + saved->tc.size > (void *)tb + r->len ||
+        saved->size == 0 || saved->size > avail - r->len) {
+        return false;
+    }
+
+    memcpy(tb, blob, r->len);
+    *end = MAX(*end, (void *)tb + r->len);
+
+    e = g_new(TBPersistEntry, 1);
+    e->tb = tb;
+    e->guest = g_memdup2(blob + r->len, tb->size);
+    tb_persist_key_init(&e->key, tb);
+    tb_persist_guest_layout(tb, &offset, &len0, &len1);
+    if (len1 && tb->page_addr[1] == -1) {
+        tb_persist_entry_free(e);
+        return true;
+    }
+    g_hash_table_replace(tb_persist.entries, &e->key, e);
+    return true;
+}
+
+static void tb_persist_load(Notifier *notifier, void *data)
+{
+    TBPersistHeader cur, *h = (TBPersistHeader *)tb_persist.data;
+    const void *p, *limit, *start, *end;
+    unsigned i, nb_tbs;
+
+    if (!tb_persist.data) {
+        return;
+    }
+    if (qemu_plugin_installed()) {
+        warn_report("tb-cache: not used while plugins are installed");
+        goto out;
+    }
+
+    tb_persist_header_init(&cur);
+    tb_persist_header_init_layout(&cur);
+    if (h->code_gen_start != cur.code_gen_start ||
+        h->code_gen_capacity != cur.code_gen_capacity ||
+        h->code_gen_epilogue != cur.code_gen_epilogue ||
+        strncmp(h->config, cur.config, sizeof(cur.config))) {
+        warn_report("tb-cache: %s was saved with a different translation "
+                    "buffer or machine, ignoring", tb_persist.path);
+        goto out;
+    }
+
+    start = tcg_region_start();
+    end = start;
+    p = tb_persist.data + sizeof(*h);
+    limit = tb_persist.data + tb_persist.size;
+    for (i = 0, nb_tbs = 0; i < h->nb_tbs; i++) {
+        TBPersistRecord r;
+
+        if (limit - p < sizeof(r)) {
+            break;
+        }
+        memcpy(&r, p, sizeof(r));
+        p += sizeof(r);
+        if (!tb_persist_load_record(&r, p, limit - p, &end)) {
+            break;
+        }
+        p += r.len + ((TranslationBlock *)(uintptr_t)r.addr)->size;
+        nb_tbs++;
+    }
+    if (i < h->nb_tbs) {
+        warn_report("tb-cache: %s is truncated or corrupt", tb_persist.path);
+    }
+
+    if (end == start) {
+        g_hash_table_remove_all(tb_persist.entries);
+        nb_tbs = 0;
+    } else if (!tcg_region_reserve(end)) {
+        warn_report("tb-cache: %s leaves too little room in the translation "
+                    "buffer, ignoring", tb_persist.path);
+        g_hash_table_remove_all(tb_persist.entries);
+        nb_tbs = 0;
+    } else {
+        flush_idcache_range((uintptr_t)start, (uintptr_t)start, end - start);
+    }
+    qatomic_set(&tb_persist.nb_entries, g_hash_table_size(tb_persist.entries));
+    tb_persist.nb_loaded = nb_tbs;
+    trace_tb_persist_load(tb_persist.path, nb_tbs);
+
+out:
+    g_free(tb_persist.data);
+    tb_persist.data = NULL;
+}
+
+static gboolean tb_persist_save_tb(gpointer key, gpointer value, gpointer data)
+{
+    TranslationBlock *tb = value;
+    GByteArray *buf = data;
+    TBPersistRecord r = { .addr = (uintptr_t)tb };
+    size_t offset, len0, len1;
+
+    if ((tb_cflags(tb) & CF_INVALID) || tb->page_addr[0] == -1 ||
+        g_hash_table_contains(tb_persist.excluded, tb)) {
+        return false;
+    }
+    tb_persist_guest_layout(tb, &offset, &len0, &len1);
+    if (len1 && tb->page_addr[1] == -1) {
+        return false;
+    }
+
+    r.len = (void *)tb->tc.ptr + tb->tc.size + tb_persist_search_size(tb) -
+            (void *)tb;
+    g_byte_array_append(buf, (const guint8 *)&r, sizeof(r));
+    g_byte_array_append(buf, (const guint8 *)tb, r.len);
+    g_byte_array_append(buf, qemu_map_ram_ptr(NULL, tb->page_addr[0] + offset),
+                        len0);
+    if (len1) {
+        g_byte_array_append(buf, qemu_map_ram_ptr(NULL, tb->page_addr[1]),
+                            len1);
+    }
+    ((TBPersistHeader *)buf->data)->nb_tbs++;
+    return false;
+}
+
+static void tb_persist_save(Notifier *notifier, void *data)
+{
+    g_autoptr(GByteArray) buf = g_byte_array_new();
+    g_autoptr(GError) err = NULL;
+    TBPersistHeader h;
+
+    /* The vCPUs must not be translating, i.e. after vm_shutdown() */
+    if (runstate_is_running() || !first_cpu || qemu_plugin_installed()) {
+        return;
+    }
+
+    tb_persist_header_init(&h);
+    tb_persist_header_init_layout(&h);
+    g_byte_array_append(buf, (const guint8 *)&h, sizeof(h));
+    tcg_tb_foreach(tb_persist_save_tb, buf);
+
+    if (!g_file_set_contents(tb_persist.path, (const gchar *)buf->data,
+                             buf->len, &err)) {
+        warn_report("tb-cache: %s", err->message);
+        return;
+    }
+    trace_tb_persist_save(tb_persist.path,
+                          ((TBPersistHeader *)buf->data)->nb_tbs);
+}
+
+/* Called before tcg_init(), which maps code_gen_buffer */
+void tb_persist_init(const char *path)
+{
+    g_autoptr(GError) err = NULL;
+    TBPersistHeader cur, *h;
+
+    if (!tb_persist_header_init(&cur)) {
+        warn_report("tb-cache: not supported on this host");
+        return;
+    }
+
+    tb_persist.path = g_strdup(path);
+    tb_persist.enabled = true;
+    qemu_mutex_init(&tb_persist.lock);
+    tb_persist.entries = g_hash_table_new_full(tb_persist_key_hash,
+                                               tb_persist_key_equal,
+                                               NULL, tb_persist_entry_free);
+    tb_persist.excluded = g_hash_table_new(NULL, NULL);
+
+    tb_persist.init_done.notify = tb_persist_load;
+    qemu_add_machine_init_done_notifier(&tb_persist.init_done);
+    tb_persist.exit.notify = tb_persist_save;
+    qemu_add_exit_notifier(&tb_persist.exit);
+
+    if (!g_file_get_contents(path, &tb_persist.data, &tb_persist.size, &err)) {
+        if (!g_error_matches(err, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            warn_report("tb-cache: %s", err->message);
+        }
+        return;
+    }
+
+    h = (TBPersistHeader *)tb_persist.data;
+    if (tb_persist.size < sizeof(*h) ||
+        memcmp(h->magic, cur.magic, sizeof(cur.magic)) ||
+        h->version != cur.version ||
+        h->exe_dev != cur.exe_dev || h->exe_ino != cur.exe_ino ||
+        h->exe_size != cur.exe_size || h->exe_mtime != cur.exe_mtime ||
+        h->tb_gen_code != cur.tb_gen_code) {
+        warn_report("tb-cache: %s was saved by a different QEMU binary or "
+                    "at a different load address, ignoring", path);
+        g_free(tb_persist.data);
+        tb_persist.data = NULL;
+        return;
+    }
+
+    tcg_region_set_hint((void *)(uintptr_t)h->code_gen_start);
+}
@@ -43,6 +43,9 @@ struct TCGState {
     bool mttcg_enabled;
     int splitwx_enabled;
     unsigned long tb_size;
+    char *tb_cache;
+    bool sleep;
+    uint32_t hot_threshold;
 };
 typedef struct TCGState TCGState;
 
@@ -98,6 +101,7 @@ static void tcg_accel_instance_init(Object *obj)
     TCGState *s = TCG_STATE(obj);
 
     s->mttcg_enabled = default_mttcg_enabled();
+    s->sleep = true;
 
     /* If debugging enabled, default "auto on", otherwise off. */
 #if defined(CONFIG_DEBUG_TCG) && !defined(CONFIG_USER_ONLY)
@@ -123,6 +127,24 @@ static int tcg_init_machine(MachineState *ms)
 
     page_init();
     tb_htable_init();
+#if defined(CONFIG_SOFTMMU)
+    if (s->tb_cache) {
+        if (s->splitwx_enabled > 0) {
+            error_report("tb-cache is incompatible with split-wx");
+            return -EINVAL;
+        }
+        s->splitwx_enabled = 0;
+        tb_persist_init(s->tb_cache);
+    }
+    if (!s->sleep) {
+        if (icount_enabled()) {
+            error_report("use -icount sleep=off together with icount");
+            return -EINVAL;
+        }
+        cpu_timers_enable_idle_warp();
+    }
+#endif
+    tb_hot_threshold = s->hot_threshold;
     tcg_init(s->tb_size * MiB, s->splitwx_enabled, max_cpus);
 
 #if defined(CONFIG_SOFTMMU)
@@ -195,6 +217,30 @@ static void tcg_set_tb_size(Object *obj, Visitor *v,
     s->tb_size = value;
 }
 
+static void tcg_get_hot_threshold(Object *obj, Visitor *v,
+                                  const char *name, void *opaque,
+                                  Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value = s->hot_threshold;
+
+    visit_type_uint32(v, name, &value, errp);
+}
+
+static void tcg_set_hot_threshold(Object *obj, Visitor *v,
+                                  const char *name, void *opaque,
+                                  Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    uint32_t value;
+
+    if (!visit_type_uint32(v, name, &value, errp)) {
+        return;
+    }
+
+    s->hot_threshold = value;
+}
+
 static bool tcg_get_splitwx(Object *obj, Error **errp)
 {
     TCGState *s = TCG_STATE(obj);
@@ -207,6 +253,35 @@ static void tcg_set_splitwx(Object *obj, bool value, Error **errp)
     s->splitwx_enabled = value;
 }
 
+#if !defined(CONFIG_USER_ONLY)
+static char *tcg_get_tb_cache(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    return g_strdup(s->tb_cache);
+}
+
+static void tcg_set_tb_cache(Object *obj, const char *value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+
+    g_free(s->tb_cache);
+    s->tb_cache = g_strdup(value);
+}
+
+static bool tcg_get_sleep(Object *obj, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    return s->sleep;
+}
+
+static void tcg_set_sleep(Object *obj, bool value, Error **errp)
+{
+    TCGState *s = TCG_STATE(obj);
+    s->sleep = value;
+}
+#endif
+
 static void tcg_accel_class_init(ObjectClass *oc, void *data)
 {
     AccelClass *ac = ACCEL_CLASS(oc);
@@ -228,6 +303,24 @@ static void tcg_accel_class_init(ObjectClass *oc, void *data)
         tcg_get_splitwx, tcg_set_splitwx);
     object_class_property_set_description(oc, "split-wx",
         "Map jit pages into separate RW and RX regions");
+
+    object_class_property_add(oc, "hot-threshold", "int",
+        tcg_get_hot_threshold, tcg_set_hot_threshold,
+        NULL, NULL);
+    object_class_property_set_description(oc, "hot-threshold",
+        "Lookups after which a TB is retranslated as hot (0 = never)");
+
+#if !defined(CONFIG_USER_ONLY)
+    object_class_property_add_str(oc, "tb-cache",
+        tcg_get_tb_cache, tcg_set_tb_cache);
+    object_class_property_set_description(oc, "tb-cache",
+        "File to reload translated code from, and to save it to at exit");
+
+    object_class_property_add_bool(oc, "sleep",
+        tcg_get_sleep, tcg_set_sleep);
+    object_class_property_set_description(oc, "sleep",
+        "Wait for timers in real time while all vCPUs are idle");
+#endif
 }
 
 static const TypeInfo tcg_accel_type = {
@@ -990,6 +990,7 @@ static void do_tb_flush(CPUState *cpu, run_on_cpu_data tb_flush_count)
 
     qht_reset_size(&tb_ctx.htable, CODE_GEN_HTABLE_SIZE);
     page_flush_tb();
+    tb_persist_flush();
 
     tcg_region_reset_all();
     /* XXX: flush processor icache at this point if cache flush is
@@ -1186,7 +1187,7 @@ static void do_tb_phys_invalidate(TranslationBlock *tb, bool rm_from_page_list)
 
     /* remove the TB from the hash list */
     phys_pc = tb->page_addr[0] + (tb->pc & ~TARGET_PAGE_MASK);
-    h = tb_hash_func(phys_pc, tb->pc, tb->flags, orig_cflags,
+    h = tb_hash_func(phys_pc, tb->pc, tb->flags, orig_cflags & ~CF_HOT,
                      tb->trace_vcpu_dstate);
     if (!qht_remove(&tb_ctx.htable, tb, h)) {
         return;
@@ -1349,7 +1350,7 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     }
 
     /* add in the hash table */
-    h = tb_hash_func(phys_pc, tb->pc, tb->flags, tb->cflags,
+    h = tb_hash_func(phys_pc, tb->pc, tb->flags, tb->cflags & ~CF_HOT,
                      tb->trace_vcpu_dstate);
     qht_insert(&tb_ctx.htable, tb, h, &existing_tb);
 
@@ -1377,6 +1378,8 @@ tb_link_page(TranslationBlock *tb, tb_page_addr_t phys_pc,
     return tb;
 }
 
+uint32_t tb_hot_threshold;
+
 /* Called with mmap_lock held for user mode emulation.  */
 TranslationBlock *tb_gen_code(CPUState *cpu,
                               target_ulong pc, target_ulong cs_base,
@@ -1388,6 +1391,8 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
     target_ulong virt_page2;
     tcg_insn_unit *gen_code_buf;
     int gen_code_size, search_size, max_insns;
+    bool persisted = false;
+    int64_t trans_start = 0;
 #ifdef CONFIG_PROFILER
     TCGProfile *prof = &tcg_ctx->prof;
     int64_t ti;
@@ -1398,6 +1403,16 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
 
     phys_pc = get_page_addr_code(env, pc);
 
+    if (phys_pc != -1) {
+        tb = tb_persist_lookup(env, pc, cs_base, flags, cflags,
+                               *cpu->trace_dstate, phys_pc);
+        if (tb) {
+            persisted = true;
+            goto link;
+        }
+    }
+
+    trans_start = qemu_plugin_tb_gen_start();
     if (phys_pc == -1) {
         /* Generate a one-shot TB with 1 insn in it */
         cflags = (cflags & ~CF_COUNT_MASK) | CF_LAST_IO | 1;
@@ -1603,6 +1618,9 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
         ROUND_UP((uintptr_t)gen_code_buf + gen_code_size + search_size,
                  CODE_GEN_ALIGN));
 
+ link:
+    tb->lookups = 0;
+
     /* init jump list */
     qemu_spin_init(&tb->jmp_lock);
     tb->jmp_list_head = (uintptr_t)NULL;
@@ -1627,6 +1645,7 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
      */
     if (phys_pc == -1) {
         tb->page_addr[0] = tb->page_addr[1] = -1;
+        qemu_plugin_tb_gen_done(trans_start);
         return tb;
     }
 
@@ -1648,18 +1667,45 @@ TranslationBlock *tb_gen_code(CPUState *cpu,
      * TB visible in a consistent state.
      */
     existing_tb = tb_link_page(tb, phys_pc, phys_page2);
+    qemu_plugin_tb_gen_done(trans_start);
     /* if the TB already exists, discard what we just translated */
     if (unlikely(existing_tb != tb)) {
-        uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
+        if (!persisted) {
+            uintptr_t orig_aligned = (uintptr_t)gen_code_buf;
 
-        orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
-        qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
+            orig_aligned -= ROUND_UP(sizeof(*tb), qemu_icache_linesize);
+            qatomic_set(&tcg_ctx->code_gen_ptr, (void *)orig_aligned);
+        }
         tcg_tb_remove(tb);
         return existing_tb;
     }
+    if (!persisted && tcg_ctx->host_ptr_const) {
+        tb_persist_exclude(tb);
+    }
     return tb;
 }
 
+/*
+ * Retranslate @tb, which tb_lookup_is_hot() found to be hot. With CF_HOT
+ * the frontend may spend more effort on the code, e.g. by following
+ * direct branches to form a superblock. Lookups ignore CF_HOT, so once
+ * @tb is invalidated its callers find the new TB, and chain to it again.
+ */
+TranslationBlock *tb_promote(CPUState *cpu, TranslationBlock *tb)
+{
+    TranslationBlock *hot;
+
+    mmap_lock();
+    hot = tb_gen_code(cpu, tb->pc, tb->cs_base, tb->flags,
+                      tb_cflags(tb) | CF_HOT);
+    mmap_unlock();
+
+    if (hot != tb) {
+        tb_phys_invalidate(tb, -1);
+    }
+    return hot;
+}
+
 /*
  * @p must be non-NULL.
  * user-mode: call with mmap_lock held.
@@ -2046,6 +2092,7 @@ struct tb_tree_stats {
     size_t direct_jmp_count;
     size_t direct_jmp2_count;
     size_t cross_page;
+    size_t hot;
 };
 
 static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
@@ -2062,6 +2109,9 @@ static gboolean tb_tree_stats_iter(gpointer key, gpointer value, gpointer data)
     if (tb->page_addr[1] != -1) {
         tst->cross_page++;
     }
+    if (tb_cflags(tb) & CF_HOT) {
+        tst->hot++;
+    }
     if (tb->jmp_reset_offset[0] != TB_JMP_RESET_OFFSET_INVALID) {
         tst->direct_jmp_count++;
         if (tb->jmp_reset_offset[1] != TB_JMP_RESET_OFFSET_INVALID) {
@@ -2100,6 +2150,8 @@ void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "cross page TB count %zu (%zu%%)\n",
                            tst.cross_page,
                            nb_tbs ? (tst.cross_page * 100) / nb_tbs : 0);
+    g_string_append_printf(buf, "hot TB count        %zu (%zu%%)\n",
+                           tst.hot, nb_tbs ? (tst.hot * 100) / nb_tbs : 0);
     g_string_append_printf(buf, "direct jump count   %zu (%zu%%) "
                            "(2 jumps=%zu %zu%%)\n",
                            tst.direct_jmp_count,
@@ -2121,6 +2173,7 @@ void dump_exec_info(GString *buf)
     g_string_append_printf(buf, "TLB full flushes    %zu\n", flush_full);
     g_string_append_printf(buf, "TLB partial flushes %zu\n", flush_part);
     g_string_append_printf(buf, "TLB elided flushes  %zu\n", flush_elide);
+    tb_persist_dump_info(buf);
     tcg_dump_info(buf);
 }
 
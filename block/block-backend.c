@@ -1951,6 +1951,29 @@ bool blk_supports_write_perm(BlockBackend *blk)
     }
 }
 
+/*
+ * Returns the name of the host file whose contents are exactly what the
+ * BlockBackend exposes (a raw image without offset or size limits, on top
+ * of the "file" protocol driver), or NULL for any other configuration.
+ */
+const char *blk_get_raw_filename(BlockBackend *blk)
+{
+    BlockDriverState *bs = bdrv_skip_filters(blk_bs(blk));
+    GLOBAL_STATE_CODE();
+
+    if (bs && bs->drv && !strcmp(bs->drv->format_name, "raw") &&
+        bs->file && (bs->file->role & BDRV_CHILD_FILTERED)) {
+        bs = bdrv_skip_filters(bs->file->bs);
+    }
+
+    if (!bs || !bs->drv || strcmp(bs->drv->format_name, "file") ||
+        bs->backing) {
+        return NULL;
+    }
+
+    return bs->filename;
+}
+
 /*
  * Returns true if the BlockBackend can be written to in its current
  * configuration (i.e. if write permission have been requested)
@@ -0,0 +1,533 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * Boot profiler - break the boot of a firmware image down into stages
+ *
+ * The boot is split into stages at marker addresses or symbols. For each
+ * stage we report the instructions executed, the guest PC ranges they
+ * were executed in, the host time spent running and translating, and
+ * optionally the MMIO accesses per device.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+/*
+ * Binary trace: a BootProfHeader followed by BootProfRecords, in host
+ * byte order. A BP_NAME record is followed by the name and 1 to 8 NULs, up
+ * to a multiple of 8 bytes. The BP_STAGE records are in boot order, each
+ * followed by the BP_RANGE and BP_MMIO records of the stage.
+ */
+#define BOOTPROF_MAGIC      "QBOOTPRF"
+#define BOOTPROF_VERSION    1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t range_bits;
+} BootProfHeader;
+
+enum {
+    BP_NAME,    /* id: name id, v: length */
+    BP_STAGE,   /* id: name id, v: insns, ns, blocks translated, trans ns */
+    BP_RANGE,   /* id: stage, v: range start, insns */
+    BP_MMIO,    /* id: stage, v: device name id, reads, writes */
+};
+
+typedef struct {
+    uint32_t type;
+    uint32_t id;
+    uint64_t v[4];
+} BootProfRecord;
+
+typedef struct {
+    const char *name;
+    /* Symbol the stage starts at, or its address if NULL */
+    const char *sym;
+    uint64_t addr;
+    gint hit;
+} Marker;
+
+/* Marker callbacks get the marker and the insns of the block left to run */
+#define MARKER_UDATA(idx, left) ((void *)(((uintptr_t)(idx) << 16) | (left)))
+#define MARKER_IDX(udata)       ((uintptr_t)(udata) >> 16)
+#define MARKER_LEFT(udata)      ((uintptr_t)(udata) & 0xffff)
+
+/* Keyed on pc and insns: blocks may start at the same pc */
+typedef struct {
+    uint64_t pc;
+    uint64_t insns;
+    uint64_t exec_count;
+    /* exec_count when it was last attributed to a stage */
+    uint64_t stage_count;
+} BlockCount;
+
+typedef struct {
+    uint64_t start;
+    uint64_t insns;
+} RangeCount;
+
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;
+} MMIOCount;
+
+typedef struct {
+    const char *name;
+    uint64_t start_icount;
+    uint64_t insns;
+    int64_t start_ns;
+    int64_t ns;
+    uint64_t start_trans;
+    uint64_t trans;
+    uint64_t start_trans_ns;
+    uint64_t trans_ns;
+    GHashTable *ranges;
+    GHashTable *mmio;
+} Stage;
+
+/* Plugins need to take care of their own locking */
+static GMutex lock;
+static GArray *markers;
+static GHashTable *blocks;
+static GPtrArray *stages;
+static Stage *stage;
+
+/* Incremented inline: exact with one vCPU thread */
+static uint64_t icount;
+
+static const char *out_path;
+static int range_bits = 16;
+static int limit = 5;
+static bool mmio;
+
+static int64_t now_ns(void)
+{
+    return g_get_monotonic_time() * 1000;
+}
+
+static guint block_hash(gconstpointer key)
+{
+    const BlockCount *b = key;
+
+    return g_int64_hash(&b->pc) * 31 + b->insns;
+}
+
+static gboolean block_equal(gconstpointer a, gconstpointer b)
+{
+    const BlockCount *ba = a, *bb = b;
+
+    return ba->pc == bb->pc && ba->insns == bb->insns;
+}
+
+static void stage_open(const char *name, uint64_t at)
+{
+    Stage *s = g_new0(Stage, 1);
+
+    s->name = name;
+    s->start_icount = at;
+    s->start_ns = now_ns();
+    qemu_plugin_translation_stats(&s->start_trans, &s->start_trans_ns);
+    s->ranges = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                      NULL, g_free);
+    s->mmio = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+    g_ptr_array_add(stages, s);
+    stage = s;
+}
+
+static void stage_add_range(Stage *s, uint64_t pc, uint64_t insns)
+{
+    uint64_t start = pc & ~((UINT64_C(1) << range_bits) - 1);
+    RangeCount *rc = g_hash_table_lookup(s->ranges, &start);
+
+    if (!rc) {
+        rc = g_new0(RangeCount, 1);
+        rc->start = start;
+        g_hash_table_insert(s->ranges, &rc->start, rc);
+    }
+    rc->insns += insns;
+}
+
+/* Attribute the blocks executed since the stage started to it */
+static void stage_close(uint64_t at)
+{
+    GHashTableIter iter;
+    gpointer value;
+    uint64_t trans, trans_ns;
+
+    stage->insns = at - stage->start_icount;
+    stage->ns = now_ns() - stage->start_ns;
+    qemu_plugin_translation_stats(&trans, &trans_ns);
+    stage->trans = trans - stage->start_trans;
+    stage->trans_ns = trans_ns - stage->start_trans_ns;
+
+    g_hash_table_iter_init(&iter, blocks);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        BlockCount *b = value;
+        uint64_t execs = b->exec_count - b->stage_count;
+
+        if (execs) {
+            stage_add_range(stage, b->pc, execs * b->insns);
+            b->stage_count += execs;
+        }
+    }
+}
+
+static gint cmp_range_insns(gconstpointer a, gconstpointer b)
+{
+    const RangeCount *ra = a;
+    const RangeCount *rb = b;
+
+    return ra->insns > rb->insns ? -1 : ra->insns < rb->insns;
+}
+
+static gint cmp_mmio_count(gconstpointer a, gconstpointer b, gpointer data)
+{
+    GHashTable *mmio = data;
+    MMIOCount *ca = g_hash_table_lookup(mmio, a);
+    MMIOCount *cb = g_hash_table_lookup(mmio, b);
+    uint64_t na = ca->reads + ca->writes;
+    uint64_t nb = cb->reads + cb->writes;
+
+    return na > nb ? -1 : na < nb;
+}
+
+static void report_stage(GString *report, Stage *s, uint64_t total)
+{
+    GList *ranges, *devs, *it;
+    int i;
+
+    g_string_append_printf(report, "%s, %" PRIu64 ", %.1f%%, %.3f, %"
+                           PRIu64 ", %.3f\n", s->name, s->insns,
+                           total ? 100.0 * s->insns / total : 0.0,
+                           s->ns / 1e6, s->trans, s->trans_ns / 1e6);
+
+    ranges = g_list_sort(g_hash_table_get_values(s->ranges),
+                         cmp_range_insns);
+    for (it = ranges, i = 0; it && i < limit; it = it->next, i++) {
+        RangeCount *rc = it->data;
+
+        g_string_append_printf(report, "  pc:0x%016" PRIx64 ", %" PRIu64
+                               "\n", rc->start, rc->insns);
+    }
+    g_list_free(ranges);
+
+    devs = g_list_sort_with_data(g_hash_table_get_keys(s->mmio),
+                                 cmp_mmio_count, s->mmio);
+    for (it = devs, i = 0; it && i < limit; it = it->next, i++) {
+        MMIOCount *c = g_hash_table_lookup(s->mmio, it->data);
+
+        g_string_append_printf(report, "  mmio:%s, %" PRIu64 ", %" PRIu64
+                               "\n", (const char *)it->data, c->reads,
+                               c->writes);
+    }
+    g_list_free(devs);
+}
+
+static void write_record(FILE *f, uint32_t type, uint32_t id, uint64_t v0,
+                         uint64_t v1, uint64_t v2, uint64_t v3)
+{
+    BootProfRecord r = {
+        .type = type, .id = id, .v = { v0, v1, v2, v3 },
+    };
+
+    fwrite(&r, sizeof(r), 1, f);
+}
+
+static uint32_t write_name(FILE *f, GHashTable *names, const char *name)
+{
+    static const char pad[8];
+    gpointer id;
+    size_t len;
+
+    if (g_hash_table_lookup_extended(names, name, NULL, &id)) {
+        return GPOINTER_TO_UINT(id);
+    }
+    id = GUINT_TO_POINTER(g_hash_table_size(names));
+    g_hash_table_insert(names, (gpointer)name, id);
+
+    len = strlen(name);
+    write_record(f, BP_NAME, GPOINTER_TO_UINT(id), len, 0, 0, 0);
+    fwrite(name, len, 1, f);
+    fwrite(pad, 8 - len % 8, 1, f);
+    return GPOINTER_TO_UINT(id);
+}
+
+static void write_trace(void)
+{
+    g_autoptr(GHashTable) names = g_hash_table_new(g_str_hash, g_str_equal);
+    BootProfHeader hdr = {
+        .version = BOOTPROF_VERSION,
+        .range_bits = range_bits,
+    };
+    GHashTableIter iter;
+    gpointer key, value;
+    uint32_t id;
+    FILE *f;
+    guint i;
+
+    f = fopen(out_path, "wb");
+    if (!f) {
+        fprintf(stderr, "bootprof: can't open %s: %s\n", out_path,
+                strerror(errno));
+        return;
+    }
+    memcpy(hdr.magic, BOOTPROF_MAGIC, sizeof(hdr.magic));
+    fwrite(&hdr, sizeof(hdr), 1, f);
+
+    for (i = 0; i < stages->len; i++) {
+        Stage *s = g_ptr_array_index(stages, i);
+
+        id = write_name(f, names, s->name);
+        write_record(f, BP_STAGE, id, s->insns, s->ns, s->trans,
+                     s->trans_ns);
+
+        g_hash_table_iter_init(&iter, s->ranges);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            RangeCount *rc = value;
+
+            write_record(f, BP_RANGE, i, rc->start, rc->insns, 0, 0);
+        }
+
+        g_hash_table_iter_init(&iter, s->mmio);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            MMIOCount *c = value;
+
+            id = write_name(f, names, key);
+            write_record(f, BP_MMIO, i, id, c->reads, c->writes, 0);
+        }
+    }
+
+    if (fclose(f)) {
+        fprintf(stderr, "bootprof: can't write %s: %s\n", out_path,
+                strerror(errno));
+    }
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new("");
+    uint64_t total;
+    guint i;
+
+    g_mutex_lock(&lock);
+    total = icount;
+    stage_close(total);
+
+    g_string_append_printf(report, "stage, insns, insns%%, host ms, "
+                           "blocks translated, translation ms\n");
+    for (i = 0; i < stages->len; i++) {
+        report_stage(report, g_ptr_array_index(stages, i), total);
+    }
+    if (out_path) {
+        write_trace();
+    }
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_outs(report->str);
+}
+
+static void vcpu_marker(unsigned int cpu_index, void *udata)
+{
+    Marker *m = &g_array_index(markers, Marker, MARKER_IDX(udata));
+    uint64_t at;
+
+    if (g_atomic_int_get(&m->hit)) {
+        return;
+    }
+
+    g_mutex_lock(&lock);
+    if (!m->hit) {
+        g_atomic_int_set(&m->hit, 1);
+        /* The whole block was counted when it started */
+        at = icount - MARKER_LEFT(udata);
+        stage_close(at);
+        stage_open(m->name, at);
+    }
+    g_mutex_unlock(&lock);
+}
+
+static void vcpu_mem(unsigned int cpu_index, qemu_plugin_meminfo_t info,
+                     uint64_t vaddr, void *udata)
+{
+    struct qemu_plugin_hwaddr *hwaddr = qemu_plugin_get_hwaddr(info, vaddr);
+    const char *name;
+    MMIOCount *c;
+
+    if (!hwaddr || !qemu_plugin_hwaddr_is_io(hwaddr)) {
+        return;
+    }
+    name = qemu_plugin_hwaddr_device_name(hwaddr);
+
+    g_mutex_lock(&lock);
+    c = g_hash_table_lookup(stage->mmio, name);
+    if (!c) {
+        c = g_new0(MMIOCount, 1);
+        g_hash_table_insert(stage->mmio, (gpointer)name, c);
+    }
+    if (qemu_plugin_mem_is_store(info)) {
+        c->writes++;
+    } else {
+        c->reads++;
+    }
+    g_mutex_unlock(&lock);
+}
+
+static int find_marker(struct qemu_plugin_insn *insn)
+{
+    uint64_t vaddr = qemu_plugin_insn_vaddr(insn);
+    const char *sym = NULL;
+    guint i;
+
+    for (i = 0; i < markers->len; i++) {
+        Marker *m = &g_array_index(markers, Marker, i);
+
+        if (g_atomic_int_get(&m->hit)) {
+            continue;
+        }
+        if (!m->sym) {
+            if (m->addr == vaddr) {
+                return i;
+            }
+            continue;
+        }
+        if (!sym) {
+            sym = qemu_plugin_insn_symbol(insn);
+        }
+        if (sym && strcmp(sym, m->sym) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Counting is inline, the only callbacks are on the markers and, with
+ * mmio=on, on the memory accesses.
+ */
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    size_t n = qemu_plugin_tb_n_insns(tb);
+    BlockCount key = { .pc = qemu_plugin_tb_vaddr(tb), .insns = n };
+    BlockCount *b;
+    size_t i;
+    int m;
+
+    g_mutex_lock(&lock);
+    b = g_hash_table_lookup(blocks, &key);
+    if (!b) {
+        b = g_new(BlockCount, 1);
+        *b = key;
+        g_hash_table_add(blocks, b);
+    }
+    g_mutex_unlock(&lock);
+
+    qemu_plugin_register_vcpu_tb_exec_inline(tb, QEMU_PLUGIN_INLINE_ADD_U64,
+                                             &b->exec_count, 1);
+    qemu_plugin_register_vcpu_tb_exec_inline(tb, QEMU_PLUGIN_INLINE_ADD_U64,
+                                             &icount, n);
+
+    for (i = 0; i < n; i++) {
+        struct qemu_plugin_insn *insn = qemu_plugin_tb_get_insn(tb, i);
+
+        m = find_marker(insn);
+        if (m >= 0) {
+            qemu_plugin_register_vcpu_insn_exec_cb(insn, vcpu_marker,
+                                                   QEMU_PLUGIN_CB_NO_REGS,
+                                                   MARKER_UDATA(m, n - i));
+        }
+        if (mmio) {
+            qemu_plugin_register_vcpu_mem_cb(insn, vcpu_mem,
+                                             QEMU_PLUGIN_CB_NO_REGS,
+                                             QEMU_PLUGIN_MEM_RW, NULL);
+        }
+    }
+}
+
+/* marker=NAME:ADDR or marker=NAME:SYMBOL */
+static bool parse_marker(const char *arg)
+{
+    g_auto(GStrv) tokens = g_strsplit(arg, ":", 2);
+    Marker m = { 0 };
+    char *end;
+
+    if (!tokens[0] || !*tokens[0] || !tokens[1] || !*tokens[1]) {
+        return false;
+    }
+    m.name = g_intern_string(tokens[0]);
+    if (g_ascii_isdigit(*tokens[1])) {
+        m.addr = g_ascii_strtoull(tokens[1], &end, 0);
+        if (*end) {
+            return false;
+        }
+    } else {
+        m.sym = g_intern_string(tokens[1]);
+    }
+    g_array_append_val(markers, m);
+    return true;
+}
+
+QEMU_PLUGIN_EXPORT
+int qemu_plugin_install(qemu_plugin_id_t id, const qemu_info_t *info,
+                        int argc, char **argv)
+{
+    uint64_t count, ns;
+    int i;
+
+    markers = g_array_new(false, true, sizeof(Marker));
+
+    for (i = 0; i < argc; i++) {
+        char *opt = argv[i];
+        g_auto(GStrv) tokens = g_strsplit(opt, "=", 2);
+
+        if (g_strcmp0(tokens[0], "marker") == 0) {
+            if (!parse_marker(tokens[1])) {
+                fprintf(stderr, "invalid marker: %s\n", opt);
+                return -1;
+            }
+        } else if (g_strcmp0(tokens[0], "out") == 0 && tokens[1]) {
+            out_path = g_strdup(tokens[1]);
+        } else if (g_strcmp0(tokens[0], "range") == 0 && tokens[1]) {
+            range_bits = atoi(tokens[1]);
+            if (range_bits < 2 || range_bits > 63) {
+                fprintf(stderr, "invalid range bits: %s\n", opt);
+                return -1;
+            }
+        } else if (g_strcmp0(tokens[0], "limit") == 0 && tokens[1]) {
+            limit = atoi(tokens[1]);
+        } else if (g_strcmp0(tokens[0], "mmio") == 0) {
+            if (!qemu_plugin_bool_parse(tokens[0], tokens[1], &mmio)) {
+                fprintf(stderr, "boolean argument parsing failed: %s\n", opt);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "option parsing failed: %s\n", opt);
+            return -1;
+        }
+    }
+
+    if (!info->system_emulation) {
+        fprintf(stderr, "bootprof: plugin only useful for system emulation\n");
+        return -1;
+    }
+
+    blocks = g_hash_table_new(block_hash, block_equal);
+    stages = g_ptr_array_new();
+    /* Start the translation counters, and the first stage */
+    qemu_plugin_translation_stats(&count, &ns);
+    stage_open("reset", 0);
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
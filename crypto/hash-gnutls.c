@@ -99,6 +99,91 @@ qcrypto_gnutls_hash_bytesv(QCryptoHashAlgorithm alg,
 }
 
 
+static QCryptoHash *
+qcrypto_gnutls_hash_new(QCryptoHashAlgorithm alg, Error **errp)
+{
+    QCryptoHash *hash;
+    gnutls_hash_hd_t handle;
+    int ret;
+
+    if (!qcrypto_hash_supports(alg)) {
+        error_setg(errp,
+                   "Unknown hash algorithm %d",
+                   alg);
+        return NULL;
+    }
+
+    ret = gnutls_hash_init(&handle, qcrypto_hash_alg_map[alg]);
+    if (ret < 0) {
+        error_setg(errp,
+                   "Unable to initialize hash algorithm: %s",
+                   gnutls_strerror(ret));
+        return NULL;
+    }
+
+    hash = g_new0(QCryptoHash, 1);
+    hash->alg = alg;
+    hash->opaque = handle;
+    return hash;
+}
+
+static int
+qcrypto_gnutls_hash_update(QCryptoHash *hash,
+                           const struct iovec *iov,
+                           size_t niov,
+                           Error **errp)
+{
+    gnutls_hash_hd_t handle = hash->opaque;
+    size_t i;
+    int ret;
+
+    for (i = 0; i < niov; i++) {
+        ret = gnutls_hash(handle, iov[i].iov_base, iov[i].iov_len);
+        if (ret < 0) {
+            error_setg(errp, "Failed to hash data: %s",
+                       gnutls_strerror(ret));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int
+qcrypto_gnutls_hash_finalize(QCryptoHash *hash,
+                             uint8_t **result,
+                             size_t *resultlen,
+                             Error **errp)
+{
+    gnutls_hash_hd_t handle = hash->opaque;
+    int ret;
+
+    ret = gnutls_hash_get_len(qcrypto_hash_alg_map[hash->alg]);
+    if (*resultlen == 0) {
+        *resultlen = ret;
+        *result = g_new0(uint8_t, *resultlen);
+    } else if (*resultlen != ret) {
+        error_setg(errp,
+                   "Result buffer size %zu is smaller than hash %d",
+                   *resultlen, ret);
+        return -1;
+    }
+
+    gnutls_hash_output(handle, *result);
+    return 0;
+}
+
+static void
+qcrypto_gnutls_hash_free(QCryptoHash *hash)
+{
+    gnutls_hash_deinit(hash->opaque, NULL);
+    g_free(hash);
+}
+
+
 QCryptoHashDriver qcrypto_hash_lib_driver = {
     .hash_bytesv = qcrypto_gnutls_hash_bytesv,
+    .hash_new = qcrypto_gnutls_hash_new,
+    .hash_update = qcrypto_gnutls_hash_update,
+    .hash_finalize = qcrypto_gnutls_hash_finalize,
+    .hash_free = qcrypto_gnutls_hash_free,
 };
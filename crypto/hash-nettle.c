@@ -156,6 +156,85 @@ qcrypto_nettle_hash_bytesv(QCryptoHashAlgorithm alg,
 }
 
 
+static QCryptoHash *
+qcrypto_nettle_hash_new(QCryptoHashAlgorithm alg, Error **errp)
+{
+    QCryptoHash *hash;
+    union qcrypto_hash_ctx *ctx;
+
+    if (!qcrypto_hash_supports(alg)) {
+        error_setg(errp,
+                   "Unknown hash algorithm %d",
+                   alg);
+        return NULL;
+    }
+
+    ctx = g_new(union qcrypto_hash_ctx, 1);
+    qcrypto_hash_alg_map[alg].init(ctx);
+
+    hash = g_new0(QCryptoHash, 1);
+    hash->alg = alg;
+    hash->opaque = ctx;
+    return hash;
+}
+
+static int
+qcrypto_nettle_hash_update(QCryptoHash *hash,
+                           const struct iovec *iov,
+                           size_t niov,
+                           Error **errp)
+{
+    union qcrypto_hash_ctx *ctx = hash->opaque;
+    size_t i;
+
+    for (i = 0; i < niov; i++) {
+        /* See qcrypto_nettle_hash_bytesv() */
+        size_t len = iov[i].iov_len;
+        uint8_t *base = iov[i].iov_base;
+        while (len) {
+            size_t shortlen = MIN(len, UINT_MAX);
+            qcrypto_hash_alg_map[hash->alg].write(ctx, shortlen, base);
+            len -= shortlen;
+            base += shortlen;
+        }
+    }
+    return 0;
+}
+
+static int
+qcrypto_nettle_hash_finalize(QCryptoHash *hash,
+                             uint8_t **result,
+                             size_t *resultlen,
+                             Error **errp)
+{
+    union qcrypto_hash_ctx *ctx = hash->opaque;
+
+    if (*resultlen == 0) {
+        *resultlen = qcrypto_hash_alg_map[hash->alg].len;
+        *result = g_new0(uint8_t, *resultlen);
+    } else if (*resultlen != qcrypto_hash_alg_map[hash->alg].len) {
+        error_setg(errp,
+                   "Result buffer size %zu is smaller than hash %zu",
+                   *resultlen, qcrypto_hash_alg_map[hash->alg].len);
+        return -1;
+    }
+
+    qcrypto_hash_alg_map[hash->alg].result(ctx, *resultlen, *result);
+    return 0;
+}
+
+static void
+qcrypto_nettle_hash_free(QCryptoHash *hash)
+{
+    g_free(hash->opaque);
+    g_free(hash);
+}
+
+
 QCryptoHashDriver qcrypto_hash_lib_driver = {
     .hash_bytesv = qcrypto_nettle_hash_bytesv,
+    .hash_new = qcrypto_nettle_hash_new,
+    .hash_update = qcrypto_nettle_hash_update,
+    .hash_finalize = qcrypto_nettle_hash_finalize,
+    .hash_free = qcrypto_nettle_hash_free,
 };
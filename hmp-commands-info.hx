@@ -253,6 +253,21 @@ SRST
     Show memory tree.
 ERST
 
+    {
+        .name       = "mtree-profile",
+        .args_type  = "max:i?",
+        .params     = "[max]",
+        .help       = "show the memory regions taking the most time in "
+                      "MMIO accesses (default: 10)",
+        .cmd        = hmp_info_mtree_profile,
+    },
+
+SRST
+  ``info mtree-profile`` [*max*]
+    Show the *max* memory regions (default: 10) taking the most host time in
+    MMIO accesses, as counted since ``mtree-profile on``.
+ERST
+
 #if defined(CONFIG_TCG)
     {
         .name       = "jit",
@@ -281,6 +296,21 @@ SRST
     Show dynamic compiler opcode counters
 ERST
 
+#if defined(CONFIG_TCG)
+    {
+        .name       = "tlb-stats",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show software TLB statistics per MMU index",
+    },
+#endif
+
+SRST
+  ``info tlb-stats``
+    Show the victim TLB hits, the TLB fills with the time spent in them,
+    and the flushes of the software TLB, per CPU and MMU index.
+ERST
+
     {
         .name       = "sync-profile",
         .args_type  = "mean:-m,no_coalesce:-n,max:i?",
@@ -626,6 +626,22 @@ SRST
   whether profiling is on or off.
 ERST
 
+    {
+        .name       = "mtree-profile",
+        .args_type  = "enable:b,bucket_size:i?",
+        .params     = "on|off [bucket_size]",
+        .help       = "enable or disable MMIO access profiling, counting the "
+                      "accesses per range of bucket_size bytes (default: 4)",
+        .cmd        = hmp_mtree_profile,
+    },
+
+SRST
+``mtree-profile on|off`` [*bucket_size*]
+  Enable or disable the profiling of the MMIO accesses, per memory region
+  and per range of *bucket_size* bytes in the region (default: 4). Enabling
+  it clears the previous results, which are shown by ``info mtree-profile``.
+ERST
+
     {
         .name       = "system_reset",
         .args_type  = "",
@@ -1029,7 +1029,7 @@ static void fby35_i2c_init(AspeedMachineState *bmc)
     /*
      * TODO: There is a multi-master i2c connection to an AST1030 MiniBMC on
      * buses 0, 1, 2, 3, and 9. Source address 0x10, target address 0x20 on
-     * each.
+     * each. The fby35 machine wires buses 0 to 3 to its BICs.
      */
 }
 
@@ -1506,6 +1506,148 @@ static void aspeed_minibmc_machine_ast1030_evb_class_init(ObjectClass *oc,
     amc->macs_mask = 0;
 }
 
+/*
+ * fby35 sled: the fby35-bmc AST2600 plus one AST1030 BIC per server slot.
+ * Each BIC runs in its own address space, and its IPMB bus is wired to the
+ * BMC bus of its slot, so IPMB transfers are calls from one I2C controller
+ * model into the other.
+ */
+#define TYPE_FBY35_MACHINE MACHINE_TYPE_NAME("fby35")
+OBJECT_DECLARE_SIMPLE_TYPE(Fby35State, FBY35_MACHINE)
+
+#define FBY35_MAX_SLOTS 4
+/* BIC bus connected to BMC bus <slot>, BIC at 0x20, BMC at 0x10 */
+#define FBY35_BIC_IPMB_BUS 6
+/* MTD units of the BIC flashes, after the ones of the BMC */
+#define FBY35_BIC_MTD_UNIT(slot) (4 + (slot) * 6)
+
+struct Fby35State {
+    AspeedMachineState parent_obj;
+
+    uint32_t slots;
+    char *bic_kernel;
+    Clock *bic_sysclk;
+    MemoryRegion bic_memory[FBY35_MAX_SLOTS];
+    AspeedSoCState bic[FBY35_MAX_SLOTS];
+};
+
+static void fby35_bic_i2c_init(AspeedSoCState *soc)
+{
+    I2CBus *i2c[16];
+
+    for (int i = 0; i < 16; i++) {
+        i2c[i] = aspeed_i2c_get_bus(&soc->i2c, i);
+    }
+
+    /* Same placeholders as oby35-cl, the BMC is the real peer of bus 6 */
+    create_unimplemented_i2c_device(i2c[1], 0x71);
+    create_unimplemented_i2c_device(i2c[2], 0x16);
+    create_unimplemented_i2c_device(i2c[2], 0x10);
+    create_unimplemented_i2c_device(i2c[7], 0x20);
+    create_unimplemented_i2c_device(i2c[8], 0x20);
+}
+
+static void fby35_bic_init(Fby35State *s, int slot)
+{
+    AspeedMachineState *bmc = ASPEED_MACHINE(s);
+    AspeedSoCState *bic = &s->bic[slot];
+    g_autofree char *name = g_strdup_printf("bic[%d]", slot);
+    g_autofree char *mem_name = g_strdup_printf("bic%d-memory", slot);
+    AspeedI2CBus *bmc_bus = &bmc->soc.i2c.busses[slot];
+    AspeedI2CBus *bic_bus = &bic->i2c.busses[FBY35_BIC_IPMB_BUS];
+    AspeedSoCClass *sc;
+
+    memory_region_init(&s->bic_memory[slot], OBJECT(s), mem_name, 4 * GiB);
+
+    object_initialize_child(OBJECT(s), name, bic, "ast1030-a1");
+    sc = ASPEED_SOC_GET_CLASS(bic);
+    qdev_connect_clock_in(DEVICE(bic), "sysclk", s->bic_sysclk);
+    object_property_set_link(OBJECT(bic), "memory",
+                             OBJECT(&s->bic_memory[slot]), &error_abort);
+    qdev_prop_set_uint32(DEVICE(bic), "uart-default", ASPEED_DEV_UART5);
+    /* The BIC consoles follow the BMC ones in the -serial list */
+    qdev_prop_set_uint32(DEVICE(bic), "serial-base",
+                         ASPEED_SOC_GET_CLASS(&bmc->soc)->uarts_num +
+                         slot * sc->uarts_num);
+    qdev_realize(DEVICE(bic), NULL, &error_abort);
+
+    aspeed_board_init_flashes(&bic->fmc, "sst25vf032b", 2,
+                              FBY35_BIC_MTD_UNIT(slot));
+    aspeed_board_init_flashes(&bic->spi[0], "sst25vf032b", 2,
+                              FBY35_BIC_MTD_UNIT(slot) + 2);
+    aspeed_board_init_flashes(&bic->spi[1], "sst25vf032b", 2,
+                              FBY35_BIC_MTD_UNIT(slot) + 4);
+
+    fby35_bic_i2c_init(bic);
+    aspeed_i2c_bus_connect(bic_bus, bmc_bus->bus);
+    aspeed_i2c_bus_connect(bmc_bus, bic_bus->bus);
+
+    armv7m_load_kernel(bic->armv7m.cpu, s->bic_kernel,
+                       AST1030_INTERNAL_FLASH_SIZE);
+}
+
+static void fby35_machine_init(MachineState *machine)
+{
+    Fby35State *s = FBY35_MACHINE(machine);
+
+    if (s->slots < 1 || s->slots > FBY35_MAX_SLOTS) {
+        error_report("fby35: 'slots' must be between 1 and %d",
+                     FBY35_MAX_SLOTS);
+        exit(1);
+    }
+
+    /*
+     * The BMC goes first: arm_load_kernel() hooks the reset of all the
+     * CPUs existing at that point, which must not include the BICs.
+     */
+    aspeed_machine_init(machine);
+
+    s->bic_sysclk = clock_new(OBJECT(machine), "bic-sysclk");
+    clock_set_hz(s->bic_sysclk, SYSCLK_FRQ);
+
+    for (int i = 0; i < s->slots; i++) {
+        fby35_bic_init(s, i);
+    }
+}
+
+static char *fby35_get_bic_kernel(Object *obj, Error **errp)
+{
+    return g_strdup(FBY35_MACHINE(obj)->bic_kernel);
+}
+
+static void fby35_set_bic_kernel(Object *obj, const char *value, Error **errp)
+{
+    Fby35State *s = FBY35_MACHINE(obj);
+
+    g_free(s->bic_kernel);
+    s->bic_kernel = g_strdup(value);
+}
+
+static void fby35_machine_instance_init(Object *obj)
+{
+    Fby35State *s = FBY35_MACHINE(obj);
+
+    s->slots = FBY35_MAX_SLOTS;
+    object_property_add_uint32_ptr(obj, "slots", &s->slots,
+                                   OBJ_PROP_FLAG_READWRITE);
+    object_property_set_description(obj, "slots",
+                                    "Number of server slots, with one BIC "
+                                    "each");
+}
+
+static void fby35_machine_class_init(ObjectClass *oc, void *data)
+{
+    MachineClass *mc = MACHINE_CLASS(oc);
+
+    mc->desc = "Facebook fby35 sled, BMC (Cortex-A7) and BICs (Cortex-M4)";
+    mc->init = fby35_machine_init;
+
+    object_class_property_add_str(oc, "bic-kernel", fby35_get_bic_kernel,
+                                  fby35_set_bic_kernel);
+    object_class_property_set_description(oc, "bic-kernel",
+                                          "Firmware image of the BICs");
+}
+
 static const TypeInfo aspeed_machine_types[] = {
     {
         .name          = MACHINE_TYPE_NAME("palmetto-bmc"),
@@ -1567,6 +1709,12 @@ static const TypeInfo aspeed_machine_types[] = {
         .name          = MACHINE_TYPE_NAME("fby35-bmc"),
         .parent        = MACHINE_TYPE_NAME("ast2600-evb"),
         .class_init    = aspeed_machine_fby35_class_init,
+    }, {
+        .name          = TYPE_FBY35_MACHINE,
+        .parent        = MACHINE_TYPE_NAME("fby35-bmc"),
+        .instance_size = sizeof(Fby35State),
+        .instance_init = fby35_machine_instance_init,
+        .class_init    = fby35_machine_class_init,
     }, {
         .name           = MACHINE_TYPE_NAME("ast1030-evb"),
         .parent         = TYPE_ASPEED_MACHINE,
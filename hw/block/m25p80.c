@@ -24,12 +24,15 @@
 #include "qemu/osdep.h"
 #include "qemu/units.h"
 #include "sysemu/block-backend.h"
+#include "hw/block/flash.h"
 #include "hw/qdev-properties.h"
 #include "hw/qdev-properties-system.h"
 #include "hw/ssi/ssi.h"
 #include "hw/irq.h"
+#include "migration/checkpoint.h"
 #include "migration/vmstate.h"
 #include "qemu/bitops.h"
+#include "qemu/bitmap.h"
 #include "qemu/log.h"
 #include "qemu/module.h"
 #include "qemu/error-report.h"
@@ -37,6 +40,7 @@
 #include "qapi/visitor.h"
 #include "trace.h"
 #include "qom/object.h"
+#include "sysemu/sysemu.h"
 
 /* 16 MiB max in 3 byte address mode */
 #define MAX_3BYTES_SIZE 0x1000000
@@ -452,6 +456,9 @@ struct Flash {
     uint8_t *storage;
     uint32_t size;
     int page_size;
+    bool use_mmap;
+    bool storage_mapped;
+    Notifier exit_notifier;
 
     uint8_t state;
     uint8_t data[M25P80_INTERNAL_DATA_BUFFER_SZ];
@@ -488,7 +495,12 @@ struct Flash {
     bool status_register_write_disabled;
     uint8_t ear;
 
-    int64_t dirty_page;
+    /* Pages written since the last sync, when storage is a working copy */
+    unsigned long *dirty_bitmap;
+
+    /* Copy of storage when the checkpoint was taken, and pages written since */
+    uint8_t *checkpoint;
+    unsigned long *checkpoint_dirty;
 
     const FlashPartInfo *pi;
 
@@ -534,35 +546,33 @@ static void blk_sync_complete(void *opaque, int ret)
      */
 }
 
-static void flash_sync_page(Flash *s, int page)
+/*
+ * When the storage is a shared mapping of the image file, guest writes land
+ * directly in the file and nothing needs to be written back.
+ */
+static bool flash_needs_sync(Flash *s)
 {
-    QEMUIOVector *iov;
+    return s->blk && blk_is_writable(s->blk) && !s->storage_mapped;
+}
 
-    if (!s->blk || !blk_is_writable(s->blk)) {
-        return;
-    }
+static void flash_sync_range(Flash *s, int64_t off, int64_t len)
+{
+    QEMUIOVector *iov;
 
     iov = g_new(QEMUIOVector, 1);
     qemu_iovec_init(iov, 1);
-    qemu_iovec_add(iov, s->storage + page * s->pi->page_size,
-                   s->pi->page_size);
-    blk_aio_pwritev(s->blk, page * s->pi->page_size, iov, 0,
-                    blk_sync_complete, iov);
+    qemu_iovec_add(iov, s->storage + off, len);
+    blk_aio_pwritev(s->blk, off, iov, 0, blk_sync_complete, iov);
 }
 
 static inline void flash_sync_area(Flash *s, int64_t off, int64_t len)
 {
-    QEMUIOVector *iov;
-
-    if (!s->blk || !blk_is_writable(s->blk)) {
+    if (!flash_needs_sync(s)) {
         return;
     }
 
     assert(!(len % BDRV_SECTOR_SIZE));
-    iov = g_new(QEMUIOVector, 1);
-    qemu_iovec_init(iov, 1);
-    qemu_iovec_add(iov, s->storage + off, len);
-    blk_aio_pwritev(s->blk, off, iov, 0, blk_sync_complete, iov);
+    flash_sync_range(s, off, len);
 }
 
 static void flash_erase(Flash *s, int offset, FlashCMD cmd)
@@ -614,14 +624,33 @@ static void flash_erase(Flash *s, int offset, FlashCMD cmd)
         return;
     }
     memset(s->storage + offset, 0xff, len);
+    if (s->checkpoint_dirty) {
+        bitmap_set(s->checkpoint_dirty, offset / s->pi->page_size,
+                   DIV_ROUND_UP(len, s->pi->page_size));
+    }
     flash_sync_area(s, offset, len);
 }
 
-static inline void flash_sync_dirty(Flash *s, int64_t newpage)
+/*
+ * Write back the pages programmed since the last sync, one request per run
+ * of contiguous dirty pages.
+ */
+static void flash_sync_dirty(Flash *s)
 {
-    if (s->dirty_page >= 0 && s->dirty_page != newpage) {
-        flash_sync_page(s, s->dirty_page);
-        s->dirty_page = newpage;
+    unsigned long nr_pages = s->size / s->pi->page_size;
+    unsigned long first, last;
+
+    if (!s->dirty_bitmap) {
+        return;
+    }
+
+    first = find_first_bit(s->dirty_bitmap, nr_pages);
+    while (first < nr_pages) {
+        last = find_next_zero_bit(s->dirty_bitmap, nr_pages, first);
+        bitmap_clear(s->dirty_bitmap, first, last - first);
+        flash_sync_range(s, (int64_t)first * s->pi->page_size,
+                         (int64_t)(last - first) * s->pi->page_size);
+        first = find_next_bit(s->dirty_bitmap, nr_pages, last);
     }
 }
 
@@ -671,8 +700,12 @@ void flash_write8(Flash *s, uint32_t addr, uint8_t data)
         s->storage[s->cur_addr] &= data;
     }
 
-    flash_sync_dirty(s, page);
-    s->dirty_page = page;
+    if (s->dirty_bitmap) {
+        set_bit(page, s->dirty_bitmap);
+    }
+    if (s->checkpoint_dirty) {
+        set_bit(page, s->checkpoint_dirty);
+    }
 }
 
 static inline int get_addr_length(Flash *s)
@@ -1457,7 +1490,7 @@ static int m25p80_cs(SSIPeripheral *ss, bool select)
         s->len = 0;
         s->pos = 0;
         s->state = STATE_IDLE;
-        flash_sync_dirty(s, -1);
+        flash_sync_dirty(s);
         s->data_read_loop = false;
     }
 
@@ -1571,6 +1604,26 @@ static uint32_t m25p80_transfer8_ex(SSIPeripheral *ss, uint32_t tx)
     return r;
 }
 
+/*
+ * When the device is selected and streaming out data of a read command,
+ * returns its storage along with the size of the flash and the address of
+ * the next byte to be read. Returns NULL otherwise.
+ */
+uint8_t *m25p80_get_read_window(DeviceState *dev, uint32_t *size,
+                                uint32_t *addr)
+{
+    Flash *s = (Flash *)object_dynamic_cast(OBJECT(dev), TYPE_M25P80);
+
+    /* CS is active low */
+    if (!s || SSI_PERIPHERAL(s)->cs || s->state != STATE_READ) {
+        return NULL;
+    }
+
+    *size = s->size;
+    *addr = s->cur_addr;
+    return s->storage;
+}
+
 static void m25p80_write_protect_pin_irq_handler(void *opaque, int n, int level)
 {
     Flash *s = M25P80(opaque);
@@ -1579,6 +1632,149 @@ static void m25p80_write_protect_pin_irq_handler(void *opaque, int n, int level)
     s->wp_level = !!level;
 }
 
+/*
+ * Map a raw image file in place of a working copy. Pages are only read in
+ * from the file when the guest first touches them. A writable drive gets a
+ * shared mapping so that programming goes straight to the file, otherwise
+ * writes stay private to this instance.
+ */
+static bool m25p80_map_storage(Flash *s)
+{
+#ifdef CONFIG_POSIX
+    const char *filename = blk_get_raw_filename(s->blk);
+    bool shared = blk_is_writable(s->blk);
+    Error *local_err = NULL;
+    void *storage;
+    int fd;
+
+    if (!filename) {
+        warn_report("m25p80: drive is not a raw image file, not mapping it");
+        return false;
+    }
+
+    if (blk_getlength(s->blk) < s->size) {
+        return false;
+    }
+
+    fd = qemu_open(filename, shared ? O_RDWR : O_RDONLY, &local_err);
+    if (fd < 0) {
+        warn_report_err(local_err);
+        return false;
+    }
+
+    storage = mmap(NULL, s->size, PROT_READ | PROT_WRITE,
+                   shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (storage == MAP_FAILED) {
+        warn_report("m25p80: failed to map '%s': %s", filename,
+                    strerror(errno));
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    trace_m25p80_binding_mmap(s, filename, shared);
+    s->storage = storage;
+    s->storage_mapped = true;
+    qemu_add_exit_notifier(&s->exit_notifier);
+    return true;
+#else
+    warn_report("m25p80: mapping the drive is not supported on this host");
+    return false;
+#endif
+}
+
+/* Write the pages programmed through a shared mapping back to the file */
+static void m25p80_sync_storage(Flash *s)
+{
+#ifdef CONFIG_POSIX
+    if (s->storage_mapped && blk_is_writable(s->blk) &&
+        msync(s->storage, s->size, MS_SYNC)) {
+        warn_report("m25p80: failed to sync the flash contents: %s",
+                    strerror(errno));
+    }
+#endif
+}
+
+static void m25p80_unmap_storage(Flash *s)
+{
+#ifdef CONFIG_POSIX
+    if (!s->storage_mapped) {
+        return;
+    }
+
+    qemu_remove_exit_notifier(&s->exit_notifier);
+    m25p80_sync_storage(s);
+    munmap(s->storage, s->size);
+    s->storage = NULL;
+    s->storage_mapped = false;
+#endif
+}
+
+/*
+ * The mapping goes away with the process, but the pages are only known to
+ * be on disk once synced.
+ */
+static void m25p80_exit_notify(Notifier *n, void *data)
+{
+    Flash *s = container_of(n, Flash, exit_notifier);
+
+    m25p80_sync_storage(s);
+}
+
+static void m25p80_checkpoint_create(void *opaque)
+{
+    Flash *s = opaque;
+
+    s->checkpoint = g_memdup2(s->storage, s->size);
+    s->checkpoint_dirty = bitmap_new(s->size / s->pi->page_size);
+}
+
+/*
+ * Copy back the pages written since the checkpoint. They are written back
+ * to the drive like the guest writes are, mapped storage is the file.
+ */
+static void m25p80_checkpoint_restore(void *opaque)
+{
+    Flash *s = opaque;
+    unsigned long nr_pages = s->size / s->pi->page_size;
+    unsigned long first, last, count = 0;
+
+    if (!s->checkpoint) {
+        return;
+    }
+
+    first = find_first_bit(s->checkpoint_dirty, nr_pages);
+    while (first < nr_pages) {
+        last = find_next_zero_bit(s->checkpoint_dirty, nr_pages, first);
+        memcpy(s->storage + first * s->pi->page_size,
+               s->checkpoint + first * s->pi->page_size,
+               (last - first) * s->pi->page_size);
+        if (s->dirty_bitmap) {
+            bitmap_set(s->dirty_bitmap, first, last - first);
+        }
+        count += last - first;
+        first = find_next_bit(s->checkpoint_dirty, nr_pages, last);
+    }
+    bitmap_zero(s->checkpoint_dirty, nr_pages);
+    flash_sync_dirty(s);
+
+    trace_m25p80_checkpoint_restore(s, count);
+}
+
+static void m25p80_checkpoint_delete(void *opaque)
+{
+    Flash *s = opaque;
+
+    g_clear_pointer(&s->checkpoint, g_free);
+    g_clear_pointer(&s->checkpoint_dirty, g_free);
+}
+
+static const CheckpointOps m25p80_checkpoint_ops = {
+    .create = m25p80_checkpoint_create,
+    .restore = m25p80_checkpoint_restore,
+    .delete = m25p80_checkpoint_delete,
+};
+
 static void m25p80_realize(SSIPeripheral *ss, Error **errp)
 {
     Flash *s = M25P80(ss);
@@ -1588,7 +1784,7 @@ static void m25p80_realize(SSIPeripheral *ss, Error **errp)
     s->pi = mc->pi;
 
     s->size = s->pi->sector_size * s->pi->n_sectors;
-    s->dirty_page = -1;
+    s->exit_notifier.notify = m25p80_exit_notify;
 
     if (s->blk) {
         uint64_t perm = BLK_PERM_CONSISTENT_READ |
@@ -1598,12 +1794,18 @@ static void m25p80_realize(SSIPeripheral *ss, Error **errp)
             return;
         }
 
-        trace_m25p80_binding(s);
-        s->storage = blk_blockalign(s->blk, s->size);
+        if (!s->use_mmap || !m25p80_map_storage(s)) {
+            trace_m25p80_binding(s);
+            s->storage = blk_blockalign(s->blk, s->size);
 
-        if (blk_pread(s->blk, 0, s->storage, s->size) != s->size) {
-            error_setg(errp, "failed to read the initial flash content");
-            return;
+            if (blk_pread(s->blk, 0, s->storage, s->size) != s->size) {
+                error_setg(errp, "failed to read the initial flash content");
+                return;
+            }
+
+            if (blk_is_writable(s->blk)) {
+                s->dirty_bitmap = bitmap_new(s->size / s->pi->page_size);
+            }
         }
     } else {
         trace_m25p80_binding_no_bdrv(s);
@@ -1613,6 +1815,15 @@ static void m25p80_realize(SSIPeripheral *ss, Error **errp)
 
     qdev_init_gpio_in_named(DEVICE(s),
                             m25p80_write_protect_pin_irq_handler, "WP#", 1);
+    checkpoint_register(&m25p80_checkpoint_ops, s);
+}
+
+static void m25p80_unrealize(DeviceState *dev)
+{
+    Flash *s = M25P80(dev);
+
+    checkpoint_unregister(s);
+    m25p80_unmap_storage(s);
 }
 
 static void m25p80_reset(DeviceState *d)
@@ -1632,7 +1843,7 @@ static void m25p80_reset(DeviceState *d)
 
 static int m25p80_pre_save(void *opaque)
 {
-    flash_sync_dirty((Flash *)opaque, -1);
+    flash_sync_dirty((Flash *)opaque);
 
     return 0;
 }
@@ -1646,6 +1857,7 @@ static Property m25p80_properties[] = {
     DEFINE_PROP_UINT8("spansion-cr3nv", Flash, spansion_cr3nv, 0x2),
     DEFINE_PROP_UINT8("spansion-cr4nv", Flash, spansion_cr4nv, 0x10),
     DEFINE_PROP_DRIVE("drive", Flash, blk),
+    DEFINE_PROP_BOOL("mmap", Flash, use_mmap, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -1785,6 +1997,7 @@ static void m25p80_class_init(ObjectClass *klass, void *data)
     k->transfer = m25p80_transfer8_ex;
     k->set_cs = m25p80_cs;
     k->cs_polarity = SSI_CS_LOW;
+    dc->unrealize = m25p80_unrealize;
     dc->vmsd = &vmstate_m25p80;
     device_class_set_props(dc, m25p80_properties);
     dc->reset = m25p80_reset;
@@ -30,6 +30,7 @@
 #include "migration/vmstate.h"
 #include "chardev/char-serial.h"
 #include "qapi/error.h"
+#include "qemu/main-loop.h"
 #include "qemu/timer.h"
 #include "sysemu/reset.h"
 #include "sysemu/runstate.h"
@@ -102,6 +103,10 @@
 
 #define MAX_XMIT_RETRY      4
 
+/* Coalesced transmission buffer, flushed at the end of each line */
+#define SERIAL_TX_BUF_LEN   4096
+#define SERIAL_TX_FLUSH_NS  (1 * SCALE_MS)
+
 static void serial_receive1(void *opaque, const uint8_t *buf, int size);
 static void serial_xmit(SerialState *s);
 
@@ -229,6 +234,82 @@ static gboolean serial_watch_cb(void *do_not_use, GIOCondition cond,
     return FALSE;
 }
 
+/*
+ * Waits for the chardev to accept more data, with the tsr kept busy.
+ * Returns false to give up and drop the data.
+ */
+static bool serial_xmit_wait(SerialState *s)
+{
+    if (s->tsr_retry >= MAX_XMIT_RETRY) {
+        return false;
+    }
+
+    assert(s->watch_tag == 0);
+    s->watch_tag = qemu_chr_fe_add_watch(&s->chr, G_IO_OUT | G_IO_HUP,
+                                         serial_watch_cb, s);
+    if (s->watch_tag > 0) {
+        s->tsr_retry++;
+        return true;
+    }
+    return false;
+}
+
+/* Writes as much of the coalesced transmission as the chardev takes */
+static void serial_tx_flush(SerialState *s)
+{
+    int rc;
+
+    if (!s->tx_len) {
+        return;
+    }
+
+    rc = qemu_chr_fe_write(&s->chr, s->tx_buf, s->tx_len);
+    if (rc > 0) {
+        s->tx_len -= rc;
+        memmove(s->tx_buf, s->tx_buf + rc, s->tx_len);
+    } else if (rc < 0 && errno != EAGAIN) {
+        /* Dropped, as single bytes are on errors */
+        s->tx_len = 0;
+    }
+    trace_serial_tx_flush(rc, s->tx_len);
+
+    /* Retry later, the tsr only waits once the buffer is full */
+    if (s->tx_len) {
+        timer_mod(s->tx_flush_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + SERIAL_TX_FLUSH_NS);
+    }
+}
+
+static void serial_tx_flush_timer_cb(void *opaque)
+{
+    serial_tx_flush(opaque);
+}
+
+/*
+ * In coalesce mode, the transmitted bytes are written to the chardev by
+ * lines, or after a short delay for a partial line, instead of one by one.
+ * The guest sees the same transmitter timings. Returns false if the buffer
+ * is full and the chardev does not accept more data yet.
+ */
+static bool serial_tx_queue(SerialState *s, uint8_t chr)
+{
+    if (s->tx_len == SERIAL_TX_BUF_LEN) {
+        serial_tx_flush(s);
+        if (s->tx_len == SERIAL_TX_BUF_LEN) {
+            return false;
+        }
+    }
+
+    s->tx_buf[s->tx_len++] = chr;
+    if (chr == '\n' || s->tx_len == SERIAL_TX_BUF_LEN) {
+        serial_tx_flush(s);
+    } else if (!timer_pending(s->tx_flush_timer)) {
+        timer_mod(s->tx_flush_timer,
+                  qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + SERIAL_TX_FLUSH_NS);
+    }
+    return true;
+}
+
 static void serial_xmit(SerialState *s)
 {
     do {
@@ -255,20 +336,22 @@ static void serial_xmit(SerialState *s)
         if (s->mcr & UART_MCR_LOOP) {
             /* in loopback mode, say that we just received a char */
             serial_receive1(s, &s->tsr, 1);
+        } else if (s->tx_buf) {
+            if (!serial_tx_queue(s, s->tsr)) {
+                if (serial_xmit_wait(s)) {
+                    return;
+                }
+                /* Give up on the stuck data, as for a single byte */
+                s->tx_len = 0;
+                serial_tx_queue(s, s->tsr);
+            }
         } else {
             int rc = qemu_chr_fe_write(&s->chr, &s->tsr, 1);
 
             if ((rc == 0 ||
                  (rc == -1 && errno == EAGAIN)) &&
-                s->tsr_retry < MAX_XMIT_RETRY) {
-                assert(s->watch_tag == 0);
-                s->watch_tag =
-                    qemu_chr_fe_add_watch(&s->chr, G_IO_OUT | G_IO_HUP,
-                                          serial_watch_cb, s);
-                if (s->watch_tag > 0) {
-                    s->tsr_retry++;
-                    return;
-                }
+                serial_xmit_wait(s)) {
+                return;
             }
         }
         s->tsr_retry = 0;
@@ -555,6 +638,10 @@ static uint64_t serial_ioport_read(void *opaque, hwaddr addr, unsigned size)
 static int serial_can_receive(SerialState *s)
 {
     if(s->fcr & UART_FCR_FE) {
+        if (s->coalesce) {
+            /* Fill the whole FIFO from one chardev read */
+            return fifo8_num_free(&s->recv_fifo);
+        }
         if (s->recv_fifo.num < UART_FIFO_LENGTH) {
             /*
              * Advertise (fifo.itl - fifo.count) bytes when count < ITL, and 1
@@ -605,9 +692,12 @@ static void serial_receive1(void *opaque, const uint8_t *buf, int size)
         qemu_system_wakeup_request(QEMU_WAKEUP_REASON_OTHER, NULL);
     }
     if(s->fcr & UART_FCR_FE) {
-        int i;
-        for (i = 0; i < size; i++) {
-            recv_fifo_put(s, buf[i]);
+        /* Receive overruns do not overwrite FIFO contents. */
+        int n = MIN(size, fifo8_num_free(&s->recv_fifo));
+
+        fifo8_push_all(&s->recv_fifo, buf, n);
+        if (n < size) {
+            s->lsr |= UART_LSR_OE;
         }
         s->lsr |= UART_LSR_DR;
         /* call the timeout receive callback in 4 char transmit time */
@@ -633,6 +723,11 @@ static int serial_pre_save(void *opaque)
     SerialState *s = opaque;
     s->fcr_vmstate = s->fcr;
 
+    /* The coalesced transmission is not migrated, write what can be */
+    if (s->tx_buf) {
+        serial_tx_flush(s);
+    }
+
     return 0;
 }
 
@@ -860,6 +955,12 @@ static void serial_reset(void *opaque)
         s->watch_tag = 0;
     }
 
+    if (s->tx_buf) {
+        serial_tx_flush(s);
+        timer_del(s->tx_flush_timer);
+        s->tx_len = 0;
+    }
+
     s->rbr = 0;
     s->ier = 0;
     s->iir = UART_IIR_NO_INT;
@@ -932,6 +1033,13 @@ static void serial_realize(DeviceState *dev, Error **errp)
                              serial_event, serial_be_change, s, NULL, true);
     fifo8_create(&s->recv_fifo, UART_FIFO_LENGTH);
     fifo8_create(&s->xmit_fifo, UART_FIFO_LENGTH);
+
+    /* Without a backend, the bytes are dropped right away */
+    if (s->coalesce && qemu_chr_fe_backend_connected(&s->chr)) {
+        s->tx_buf = g_malloc(SERIAL_TX_BUF_LEN);
+        s->tx_flush_timer = timer_new_ns(QEMU_CLOCK_REALTIME,
+                                         serial_tx_flush_timer_cb, s);
+    }
     serial_reset(s);
 }
 
@@ -939,12 +1047,21 @@ static void serial_unrealize(DeviceState *dev)
 {
     SerialState *s = SERIAL(dev);
 
+    if (s->tx_buf) {
+        serial_tx_flush(s);
+    }
     qemu_chr_fe_deinit(&s->chr, false);
 
     timer_free(s->modem_status_poll);
 
     timer_free(s->fifo_timeout_timer);
 
+    if (s->tx_buf) {
+        timer_free(s->tx_flush_timer);
+        g_free(s->tx_buf);
+        s->tx_buf = NULL;
+    }
+
     fifo8_destroy(&s->recv_fifo);
     fifo8_destroy(&s->xmit_fifo);
 
@@ -972,6 +1089,7 @@ static Property serial_properties[] = {
     DEFINE_PROP_CHR("chardev", SerialState, chr),
     DEFINE_PROP_UINT32("baudbase", SerialState, baudbase, 115200),
     DEFINE_PROP_BOOL("wakeup", SerialState, wakeup, false),
+    DEFINE_PROP_BOOL("coalesce", SerialState, coalesce, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -993,18 +1111,45 @@ static const TypeInfo serial_info = {
     .class_init = serial_class_init,
 };
 
-/* Memory mapped interface */
+/*
+ * Memory mapped interface
+ *
+ * With the "lockless" property, the accesses are dispatched without the
+ * BQL and take it themselves, so that the guests polling the Line Status
+ * Register do not contend on it. Unless there is a break or an overrun to
+ * clear, reading LSR has no side effect, and the register is a single
+ * byte: it is read without any lock.
+ */
+static uint64_t serial_mm_read_locked(SerialMM *s, hwaddr reg)
+{
+    QEMU_IOTHREAD_LOCK_GUARD();
+
+    return serial_ioport_read(&s->serial, reg, 1);
+}
+
 static uint64_t serial_mm_read(void *opaque, hwaddr addr,
                                unsigned size)
 {
     SerialMM *s = SERIAL_MM(opaque);
-    return serial_ioport_read(&s->serial, addr >> s->regshift, 1);
+    hwaddr reg = addr >> s->regshift;
+
+    if (reg == 5) {
+        uint8_t lsr = qatomic_read(&s->serial.lsr);
+
+        if (!(lsr & (UART_LSR_BI | UART_LSR_OE))) {
+            trace_serial_read(reg, lsr);
+            return lsr;
+        }
+    }
+    return serial_mm_read_locked(s, reg);
 }
 
 static void serial_mm_write(void *opaque, hwaddr addr,
                             uint64_t value, unsigned size)
 {
     SerialMM *s = SERIAL_MM(opaque);
+    QEMU_IOTHREAD_LOCK_GUARD();
+
     value &= 255;
     serial_ioport_write(&s->serial, addr >> s->regshift, value, 1);
 }
@@ -1045,6 +1190,9 @@ static void serial_mm_realize(DeviceState *dev, Error **errp)
     memory_region_init_io(&s->io, OBJECT(dev),
                           &serial_mm_ops[smm->endianness], smm, "serial",
                           8 << smm->regshift);
+    if (smm->lockless) {
+        memory_region_clear_global_locking(&s->io);
+    }
     sysbus_init_mmio(SYS_BUS_DEVICE(smm), &s->io);
     sysbus_init_irq(SYS_BUS_DEVICE(smm), &smm->serial.irq);
 }
@@ -1098,6 +1246,7 @@ static Property serial_mm_properties[] = {
      */
     DEFINE_PROP_UINT8("regshift", SerialMM, regshift, 0),
     DEFINE_PROP_UINT8("endianness", SerialMM, endianness, DEVICE_NATIVE_ENDIAN),
+    DEFINE_PROP_BOOL("lockless", SerialMM, lockless, false),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -0,0 +1,148 @@
+/*
+ * RAM-backed register files
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bitmap.h"
+#include "qapi/error.h"
+#include "exec/cpu-common.h"
+#include "hw/core/cpu.h"
+#include "hw/register-ram.h"
+#include "trace.h"
+
+/* Writes are watched with a 32-bit register granularity */
+#define WATCH_SHIFT 2
+
+static bool register_ram_watched(RegisterRAM *r, hwaddr addr, unsigned size)
+{
+    unsigned long first = addr >> WATCH_SHIFT;
+    unsigned long last = (addr + size - 1) >> WATCH_SHIFT;
+
+    return find_next_bit(r->watch, last + 1, first) <= last;
+}
+
+static uint64_t register_ram_mmio_read(void *opaque, hwaddr addr,
+                                       unsigned size)
+{
+    RegisterRAM *r = opaque;
+
+    if (r->ops->read) {
+        return r->ops->read(r->opaque, addr, size);
+    }
+    return register_ram_read(r, addr, size);
+}
+
+static void register_ram_mmio_write(void *opaque, hwaddr addr, uint64_t data,
+                                    unsigned size)
+{
+    RegisterRAM *r = opaque;
+
+    if (r->ops->write && register_ram_watched(r, addr, size)) {
+        trace_register_ram_write_watched(memory_region_name(&r->mr), addr,
+                                         data, size);
+        r->ops->write(r->opaque, addr, data, size);
+        return;
+    }
+    register_ram_write(r, addr, data, size);
+}
+
+static const MemoryRegionOps register_ram_mmio_ops = {
+    .read = register_ram_mmio_read,
+    .write = register_ram_mmio_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid = {
+        .min_access_size = 1,
+        .max_access_size = 8,
+    },
+};
+
+bool register_ram_init(RegisterRAM *r, Object *owner,
+                       const RegisterRAMOps *ops, void *opaque,
+                       const char *name, uint64_t size, Error **errp)
+{
+    ERRP_GUARD();
+    g_autofree char *path = NULL;
+    g_autofree char *idstr = NULL;
+
+    r->ops = ops;
+    r->opaque = opaque;
+    r->size = size;
+
+    if (ops) {
+        memory_region_init_rom_device_nomigrate(&r->mr, owner,
+                                                &register_ram_mmio_ops, r,
+                                                name, size, errp);
+    } else {
+        memory_region_init_ram_nomigrate(&r->mr, owner, name, size, errp);
+    }
+    if (*errp) {
+        return false;
+    }
+
+    /*
+     * The owner is usually on the system bus, which gives no device path
+     * to tell several instances apart. Use its QOM path in the RAMBlock id.
+     */
+    path = object_get_canonical_path(owner);
+    idstr = g_strdup_printf("%s/%s", path, name);
+    qemu_ram_set_idstr(r->mr.ram_block, idstr, NULL);
+    qemu_ram_set_migratable(r->mr.ram_block);
+
+    r->ptr = memory_region_get_ram_ptr(&r->mr);
+    r->watch = bitmap_new(DIV_ROUND_UP(size, 1 << WATCH_SHIFT));
+    return true;
+}
+
+void register_ram_watch(RegisterRAM *r, hwaddr addr, uint64_t size)
+{
+    unsigned long first = addr >> WATCH_SHIFT;
+    unsigned long last = (addr + size - 1) >> WATCH_SHIFT;
+
+    assert(r->ops && r->ops->write);
+    assert(addr + size <= r->size);
+    bitmap_set(r->watch, first, last - first + 1);
+}
+
+static void register_ram_sync_cpu(CPUState *cpu, run_on_cpu_data data)
+{
+}
+
+void register_ram_set_direct_read(RegisterRAM *r, bool enable)
+{
+    CPUState *cpu;
+
+    assert(r->ops && r->ops->read);
+    if (r->mr.romd_mode == enable) {
+        return;
+    }
+    memory_region_rom_device_set_romd(&r->mr, enable);
+
+    /*
+     * The vCPUs drop their direct mappings of the bank when they process
+     * the TLB flush queued by the memory map change. Wait for it, so that
+     * the device sees all the reads from now on. This cannot be done from
+     * a vCPU thread, which would deadlock with another one doing the same.
+     */
+    if (!enable && !current_cpu) {
+        CPU_FOREACH(cpu) {
+            if (cpu->created) {
+                run_on_cpu(cpu, register_ram_sync_cpu, RUN_ON_CPU_NULL);
+            }
+        }
+    }
+}
+
+void register_ram_set_dirty(RegisterRAM *r, hwaddr addr, uint64_t size)
+{
+    memory_region_set_dirty(&r->mr, addr, size);
+}
+
+void register_ram_reset(RegisterRAM *r)
+{
+    memset(r->ptr, 0, r->size);
+    register_ram_set_dirty(r, 0, r->size);
+}
@@ -8,11 +8,15 @@
 
 #include "qemu/osdep.h"
 #include "qemu/host-utils.h"
+#include "qemu/lockable.h"
 #include "qemu/log.h"
+#include "qemu/main-loop.h"
 #include "hw/gpio/aspeed_gpio.h"
 #include "hw/misc/aspeed_scu.h"
 #include "qapi/error.h"
 #include "qapi/visitor.h"
+#include "qapi/qapi-builtin-visit.h"
+#include "qapi/qapi-events-misc.h"
 #include "hw/irq.h"
 #include "migration/vmstate.h"
 
@@ -280,6 +284,10 @@ static void aspeed_gpio_update(AspeedGPIOState *s, GPIOSets *regs,
                 /* ...trigger the line-state IRQ */
                 ptrdiff_t set = aspeed_gpio_set_idx(s, regs);
                 qemu_set_irq(s->gpios[set][gpio], !!(new & mask));
+                if (s->change_events) {
+                    s->changed[set] |= mask;
+                    qemu_bh_schedule(s->change_bh);
+                }
             } else {
                 /* ...otherwise if we meet the line's current IRQ policy... */
                 if (aspeed_evaluate_irq(regs, old & mask, gpio)) {
@@ -524,6 +532,8 @@ static uint64_t aspeed_gpio_read(void *opaque, hwaddr offset, uint32_t size)
     const AspeedGPIOReg *reg;
     GPIOSets *set;
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     idx = offset >> 2;
     if (idx >= GPIO_DEBOUNCE_TIME_1 && idx <= GPIO_DEBOUNCE_TIME_3) {
         idx -= GPIO_DEBOUNCE_TIME_1;
@@ -585,6 +595,10 @@ static void aspeed_gpio_write(void *opaque, hwaddr offset, uint64_t data,
     GPIOSets *set;
     uint32_t cleared;
 
+    /* Writes update the interrupt and output lines, which needs the BQL */
+    QEMU_IOTHREAD_LOCK_GUARD();
+    QEMU_LOCK_GUARD(&s->lock);
+
     idx = offset >> 2;
     if (idx >= GPIO_DEBOUNCE_TIME_1 && idx <= GPIO_DEBOUNCE_TIME_3) {
         idx -= GPIO_DEBOUNCE_TIME_1;
@@ -726,7 +740,9 @@ static void aspeed_gpio_get_pin(Object *obj, Visitor *v, const char *name,
         return;
     }
     pin =  pin + group_idx * GPIOS_PER_GROUP;
-    level = aspeed_gpio_get_pin_level(s, set_idx, pin);
+    WITH_QEMU_LOCK_GUARD(&s->lock) {
+        level = aspeed_gpio_get_pin_level(s, set_idx, pin);
+    }
     visit_type_bool(v, name, &level, errp);
 }
 
@@ -755,7 +771,101 @@ static void aspeed_gpio_set_pin(Object *obj, Visitor *v, const char *name,
         return;
     }
     pin =  pin + group_idx * GPIOS_PER_GROUP;
-    aspeed_gpio_set_pin_level(s, set_idx, pin, level);
+    WITH_QEMU_LOCK_GUARD(&s->lock) {
+        aspeed_gpio_set_pin_level(s, set_idx, pin, level);
+    }
+}
+
+/*
+ * Output changes are reported once per main loop iteration, so that a guest
+ * updating several pins of a set, one at a time, raises a single event.
+ */
+static void aspeed_gpio_change_bh(void *opaque)
+{
+    AspeedGPIOState *s = opaque;
+    g_autofree char *qom_path = object_get_canonical_path(OBJECT(s));
+    int i;
+
+    QEMU_LOCK_GUARD(&s->lock);
+
+    for (i = 0; i < ASPEED_GPIO_MAX_NR_SETS; i++) {
+        if (s->changed[i]) {
+            qapi_event_send_gpio_change(qom_path, i, s->sets[i].data_value,
+                                        s->changed[i]);
+            s->changed[i] = 0;
+        }
+    }
+}
+
+static bool aspeed_gpio_get_change_events(Object *obj, Error **errp)
+{
+    return ASPEED_GPIO(obj)->change_events;
+}
+
+static void aspeed_gpio_set_change_events(Object *obj, bool value,
+                                          Error **errp)
+{
+    AspeedGPIOState *s = ASPEED_GPIO(obj);
+
+    QEMU_LOCK_GUARD(&s->lock);
+
+    s->change_events = value;
+    if (!value) {
+        memset(s->changed, 0, sizeof(s->changed));
+    }
+}
+
+/*
+ * The pin levels of all the sets of the controller, one uint32 per set, as
+ * the "gpio<group><pin>" properties would read or write them one by one.
+ */
+static void aspeed_gpio_get_sets(Object *obj, Visitor *v, const char *name,
+                                 void *opaque, Error **errp)
+{
+    AspeedGPIOState *s = ASPEED_GPIO(obj);
+    AspeedGPIOClass *agc = ASPEED_GPIO_GET_CLASS(s);
+    uint32List *list = NULL, **tail = &list;
+    int i;
+
+    WITH_QEMU_LOCK_GUARD(&s->lock) {
+        for (i = 0; i < agc->nr_gpio_sets; i++) {
+            QAPI_LIST_APPEND(tail, s->sets[i].data_value);
+        }
+    }
+
+    visit_type_uint32List(v, name, &list, errp);
+    qapi_free_uint32List(list);
+}
+
+static void aspeed_gpio_set_sets(Object *obj, Visitor *v, const char *name,
+                                 void *opaque, Error **errp)
+{
+    AspeedGPIOState *s = ASPEED_GPIO(obj);
+    AspeedGPIOClass *agc = ASPEED_GPIO_GET_CLASS(s);
+    uint32List *list = NULL, *l;
+    int i;
+
+    if (!visit_type_uint32List(v, name, &list, errp)) {
+        return;
+    }
+
+    for (i = 0, l = list; l; i++, l = l->next) {
+        if (i == agc->nr_gpio_sets) {
+            error_setg(errp, "%s: too many sets, the controller has %d",
+                       __func__, agc->nr_gpio_sets);
+            goto out;
+        }
+    }
+
+    /* Sets missing from the end of the list are left untouched */
+    WITH_QEMU_LOCK_GUARD(&s->lock) {
+        for (i = 0, l = list; l; i++, l = l->next) {
+            aspeed_gpio_update(s, &s->sets[i], l->value);
+        }
+    }
+
+out:
+    qapi_free_uint32List(list);
 }
 
 /****************** Setup functions ******************/
@@ -807,8 +917,11 @@ static void aspeed_gpio_reset(DeviceState *dev)
 {
     AspeedGPIOState *s = ASPEED_GPIO(dev);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     /* TODO: respect the reset tolerance registers */
     memset(s->sets, 0, sizeof(s->sets));
+    memset(s->changed, 0, sizeof(s->changed));
 }
 
 static void aspeed_gpio_realize(DeviceState *dev, Error **errp)
@@ -832,8 +945,12 @@ static void aspeed_gpio_realize(DeviceState *dev, Error **errp)
         }
     }
 
+    qemu_rec_mutex_init(&s->lock);
     memory_region_init_io(&s->iomem, OBJECT(s), &aspeed_gpio_ops, s,
             TYPE_ASPEED_GPIO, 0x800);
+    memory_region_clear_global_locking(&s->iomem);
+
+    s->change_bh = qemu_bh_new(aspeed_gpio_change_bh, s);
 
     sysbus_init_mmio(sbd, &s->iomem);
 }
@@ -905,6 +1022,13 @@ static void aspeed_gpio_class_init(ObjectClass *klass, void *data)
     dc->reset = aspeed_gpio_reset;
     dc->desc = "Aspeed GPIO Controller";
     dc->vmsd = &vmstate_aspeed_gpio;
+
+    object_class_property_add(klass, "sets", "uint32List",
+                              aspeed_gpio_get_sets, aspeed_gpio_set_sets,
+                              NULL, NULL);
+    object_class_property_add_bool(klass, "change-events",
+                                   aspeed_gpio_get_change_events,
+                                   aspeed_gpio_set_change_events);
 }
 
 static void aspeed_gpio_ast2400_class_init(ObjectClass *klass, void *data)
@@ -257,10 +257,23 @@ static inline bool aspeed_i2c_bus_is_enabled(AspeedI2CBus *bus)
     return bus->ctrl & (I2CD_MASTER_EN | I2CD_SLAVE_EN);
 }
 
+static void aspeed_i2c_bus_set_slave_address(AspeedI2CBus *bus)
+{
+    i2c_slave_set_address(&bus->slave->i2c, bus->dev_addr);
+    if (bus->peer_slave) {
+        i2c_slave_set_address(&bus->peer_slave->i2c, bus->dev_addr);
+    }
+}
+
 static inline void aspeed_i2c_bus_raise_interrupt_new(AspeedI2CBus *bus)
 {
     AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(bus->controller);
 
+    /* Raised when the command stalled on the I2C target completes */
+    if (bus->async_op != I2C_ASYNC_NONE) {
+        return;
+    }
+
     trace_aspeed_i2c_bus_raise_interrupt_new(bus->intr_status,
           bus->intr_status & I2CM_TX_NAK ? "nak|" : "",
           bus->intr_status & I2CM_TX_ACK ? "ack|" : "",
@@ -279,6 +292,11 @@ static inline void aspeed_i2c_bus_raise_interrupt(AspeedI2CBus *bus)
 {
     AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(bus->controller);
 
+    /* Raised when the command stalled on the I2C target completes */
+    if (bus->async_op != I2C_ASYNC_NONE) {
+        return;
+    }
+
     trace_aspeed_i2c_bus_raise_interrupt(bus->intr_status,
           bus->intr_status & I2CD_INTR_TX_NAK ? "nak|" : "",
           bus->intr_status & I2CD_INTR_TX_ACK ? "ack|" : "",
@@ -511,103 +529,332 @@ static int aspeed_i2c_dma_write(AspeedI2CBus *bus, uint8_t *data)
     return 0;
 }
 
-static int aspeed_i2c_bus_send(AspeedI2CBus *bus, uint8_t pool_start)
+/*
+ * Sends the TX DMA buffer to the I2C target in large chunks, mapping the
+ * guest memory once per chunk instead of reading it byte by byte. *ret is
+ * set as by i2c_send(). Returns false, with the rest of the buffer left to
+ * send byte by byte, if the guest memory cannot be mapped.
+ */
+static bool aspeed_i2c_dma_send_buf(AspeedI2CBus *bus, int *ret)
+{
+    AspeedI2CState *s = bus->controller;
+
+    *ret = 0;
+    while (bus->dma_len && !*ret) {
+        hwaddr len = bus->dma_len;
+        size_t count;
+        uint8_t *buf;
+
+        buf = address_space_map(&s->dram_as, bus->dma_addr, &len, false,
+                                MEMTXATTRS_UNSPECIFIED);
+        if (!buf) {
+            return false;
+        }
+
+        count = i2c_send_buf(bus->bus, buf, len);
+        if (count < len) {
+            /* The NAKed byte was sent too */
+            count++;
+            *ret = -1;
+        }
+        address_space_unmap(&s->dram_as, buf, len, false, count);
+        trace_aspeed_i2c_bus_send_buf("DMA", count, *ret);
+
+        bus->dma_addr += count;
+        bus->dma_len -= count;
+        bus->dma_len_tx += count;
+    }
+
+    return true;
+}
+
+/* Same as aspeed_i2c_dma_send_buf(), for the RX DMA buffer */
+static bool aspeed_i2c_dma_recv_buf(AspeedI2CBus *bus)
+{
+    AspeedI2CState *s = bus->controller;
+
+    while (bus->dma_len) {
+        hwaddr len = bus->dma_len;
+        uint8_t *buf;
+
+        buf = address_space_map(&s->dram_as, bus->dma_addr, &len, true,
+                                MEMTXATTRS_UNSPECIFIED);
+        if (!buf) {
+            return false;
+        }
+
+        i2c_recv_buf(bus->bus, buf, len);
+        address_space_unmap(&s->dram_as, buf, len, true, len);
+        trace_aspeed_i2c_bus_recv_buf("DMA", len);
+
+        bus->dma_addr += len;
+        bus->dma_len -= len;
+        bus->dma_len_rx += len;
+    }
+
+    return true;
+}
+
+static void aspeed_i2c_bus_async_done(void *opaque, int ret, uint8_t data);
+
+/*
+ * Records the operation a command is waiting for when the I2C target
+ * defers its answer. The command resumes from aspeed_i2c_bus_async_done().
+ */
+static bool aspeed_i2c_bus_stall(AspeedI2CBus *bus, int ret, I2CAsyncOp op)
+{
+    if (ret != I2C_ASYNC_PENDING) {
+        return false;
+    }
+
+    bus->async_op = op;
+    return true;
+}
+
+static bool aspeed_i2c_bus_tx_remaining(AspeedI2CBus *bus)
+{
+    if (bus->cmd & I2CD_TX_BUFF_ENABLE) {
+        return bus->pool_pos < I2CD_POOL_TX_COUNT(bus->pool_ctrl);
+    } else if (bus->cmd & I2CD_TX_DMA_ENABLE) {
+        return bus->dma_len;
+    } else {
+        return !bus->pool_pos;
+    }
+}
+
+/* Sends the rest of the TX pool buffer at once */
+static int aspeed_i2c_bus_send_pool(AspeedI2CBus *bus)
 {
     AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(bus->controller);
+    uint8_t *pool_base = aic->bus_pool_base(bus);
+    uint32_t count = I2CD_POOL_TX_COUNT(bus->pool_ctrl) - bus->pool_pos;
+    size_t acked;
+    int ret = 0;
+
+    acked = i2c_send_buf(bus->bus, pool_base + bus->pool_pos, count);
+    if (acked < count) {
+        /* The NAKed byte was sent too */
+        count = acked + 1;
+        ret = -1;
+    }
+    bus->pool_pos += count;
+    trace_aspeed_i2c_bus_send_buf("BUF", count, ret);
+
+    return ret;
+}
+
+/*
+ * Sends the bytes of the TX command, starting at bus->pool_pos. Returns
+ * I2C_ASYNC_PENDING if the target has deferred its answer.
+ *
+ * The pool and DMA buffers are handed to the target at once, unless it
+ * may defer its answers, which needs a byte by byte transfer.
+ */
+static int aspeed_i2c_bus_send(AspeedI2CBus *bus)
+{
+    AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(bus->controller);
+    uint8_t data;
     int ret = -1;
-    int i;
 
-    if (bus->cmd & I2CD_TX_BUFF_ENABLE) {
-        for (i = pool_start; i < I2CD_POOL_TX_COUNT(bus->pool_ctrl); i++) {
+    if (aspeed_i2c_bus_tx_remaining(bus) &&
+        !i2c_bus_target_may_defer(bus->bus)) {
+        if (bus->cmd & I2CD_TX_BUFF_ENABLE) {
+            return aspeed_i2c_bus_send_pool(bus);
+        } else if (bus->cmd & I2CD_TX_DMA_ENABLE &&
+                   aspeed_i2c_dma_send_buf(bus, &ret)) {
+            return ret;
+        }
+    }
+
+    while (aspeed_i2c_bus_tx_remaining(bus)) {
+        if (bus->cmd & I2CD_TX_BUFF_ENABLE) {
             uint8_t *pool_base = aic->bus_pool_base(bus);
 
-            trace_aspeed_i2c_bus_send("BUF", i + 1,
+            data = pool_base[bus->pool_pos++];
+            trace_aspeed_i2c_bus_send("BUF", bus->pool_pos,
                                       I2CD_POOL_TX_COUNT(bus->pool_ctrl),
-                                      pool_base[i]);
-            ret = i2c_send(bus->bus, pool_base[i]);
-            if (ret) {
-                break;
-            }
-        }
-        bus->cmd &= ~I2CD_TX_BUFF_ENABLE;
-    } else if (bus->cmd & I2CD_TX_DMA_ENABLE) {
-        while (bus->dma_len) {
-            uint8_t data;
+                                      data);
+        } else if (bus->cmd & I2CD_TX_DMA_ENABLE) {
             aspeed_i2c_dma_read(bus, &data);
             trace_aspeed_i2c_bus_send("DMA", bus->dma_len, bus->dma_len, data);
-            ret = i2c_send(bus->bus, data);
-            if (ret) {
-                break;
-            }
+        } else {
+            data = bus->buf;
+            bus->pool_pos++;
+            trace_aspeed_i2c_bus_send("BYTE", 1, 1, data);
+        }
+
+        ret = i2c_async_send(bus->bus, data, aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_SEND)) {
+            return I2C_ASYNC_PENDING;
+        }
+        if (ret) {
+            break;
         }
-        bus->cmd &= ~I2CD_TX_DMA_ENABLE;
-    } else {
-        trace_aspeed_i2c_bus_send("BYTE", pool_start, 1, bus->buf);
-        ret = i2c_send(bus->bus, bus->buf);
     }
 
     return ret;
 }
 
-static void aspeed_i2c_bus_recv(AspeedI2CBus *bus)
+static void aspeed_i2c_bus_tx_done(AspeedI2CBus *bus, int ret)
+{
+    if (ret) {
+        bus->intr_status |= (I2CD_INTR_TX_NAK);
+        i2c_end_transfer(bus->bus);
+    } else {
+        bus->intr_status |= I2CD_INTR_TX_ACK;
+    }
+    bus->cmd &= ~(I2CD_M_TX_CMD | I2CD_TX_BUFF_ENABLE | I2CD_TX_DMA_ENABLE);
+    aspeed_i2c_set_state(bus, I2CD_MACTIVE);
+}
+
+static bool aspeed_i2c_bus_rx_remaining(AspeedI2CBus *bus)
+{
+    if (bus->cmd & I2CD_RX_BUFF_ENABLE) {
+        return bus->pool_pos < I2CD_POOL_RX_SIZE(bus->pool_ctrl);
+    } else if (bus->cmd & I2CD_RX_DMA_ENABLE) {
+        return bus->dma_len;
+    } else {
+        return !bus->pool_pos;
+    }
+}
+
+/* Marks @len bytes of the pool buffer of @bus, from @pos, as written */
+static void aspeed_i2c_bus_pool_set_dirty(AspeedI2CBus *bus, uint32_t pos,
+                                          uint32_t len)
+{
+    AspeedI2CState *s = bus->controller;
+    AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(s);
+    uint8_t *pool = register_ram_ptr(&s->pool, 0);
+
+    register_ram_set_dirty(&s->pool, aic->bus_pool_base(bus) + pos - pool,
+                           len);
+}
+
+/* Returns false if the byte could not be stored */
+static bool aspeed_i2c_bus_rx_store(AspeedI2CBus *bus, uint8_t data)
 {
     AspeedI2CState *s = bus->controller;
     AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(s);
-    uint8_t data;
-    int i;
 
     if (bus->cmd & I2CD_RX_BUFF_ENABLE) {
         uint8_t *pool_base = aic->bus_pool_base(bus);
 
-        for (i = 0; i < I2CD_POOL_RX_SIZE(bus->pool_ctrl); i++) {
-            pool_base[i] = i2c_recv(bus->bus);
-            trace_aspeed_i2c_bus_recv("BUF", i + 1,
-                                      I2CD_POOL_RX_SIZE(bus->pool_ctrl),
-                                      pool_base[i]);
-        }
-
-        /* Update RX count */
-        bus->pool_ctrl &= ~(0xff << 24);
-        bus->pool_ctrl |= (i & 0xff) << 24;
-        bus->cmd &= ~I2CD_RX_BUFF_ENABLE;
+        pool_base[bus->pool_pos] = data;
+        aspeed_i2c_bus_pool_set_dirty(bus, bus->pool_pos++, 1);
+        trace_aspeed_i2c_bus_recv("BUF", bus->pool_pos,
+                                  I2CD_POOL_RX_SIZE(bus->pool_ctrl), data);
     } else if (bus->cmd & I2CD_RX_DMA_ENABLE) {
-        uint8_t data;
-
-        while (bus->dma_len) {
-            MemTxResult result;
-
-            data = i2c_recv(bus->bus);
-            trace_aspeed_i2c_bus_recv("DMA", bus->dma_len, bus->dma_len, data);
-            result = address_space_write(&s->dram_as, bus->dma_addr,
-                                         MEMTXATTRS_UNSPECIFIED, &data, 1);
-            if (result != MEMTX_OK) {
-                qemu_log_mask(LOG_GUEST_ERROR, "%s: DRAM write failed @%08x\n",
-                              __func__, bus->dma_addr);
-                return;
-            }
-            bus->dma_addr++;
-            bus->dma_len--;
+        MemTxResult result;
+
+        trace_aspeed_i2c_bus_recv("DMA", bus->dma_len, bus->dma_len, data);
+        result = address_space_write(&s->dram_as, bus->dma_addr,
+                                     MEMTXATTRS_UNSPECIFIED, &data, 1);
+        if (result != MEMTX_OK) {
+            qemu_log_mask(LOG_GUEST_ERROR, "%s: DRAM write failed @%08x\n",
+                          __func__, bus->dma_addr);
+            return false;
         }
-        bus->cmd &= ~I2CD_RX_DMA_ENABLE;
+        bus->dma_addr++;
+        bus->dma_len--;
     } else {
-        data = i2c_recv(bus->bus);
-        trace_aspeed_i2c_bus_recv("BYTE", 1, 1, bus->buf);
+        bus->pool_pos++;
+        trace_aspeed_i2c_bus_recv("BYTE", 1, 1, data);
         bus->buf = (data & I2CD_BYTE_BUF_RX_MASK) << I2CD_BYTE_BUF_RX_SHIFT;
     }
+
+    return true;
 }
 
-static void aspeed_i2c_handle_rx_cmd(AspeedI2CBus *bus)
+/* Fills the rest of the RX pool buffer at once */
+static void aspeed_i2c_bus_recv_pool(AspeedI2CBus *bus)
 {
-    aspeed_i2c_set_state(bus, I2CD_MRXD);
-    aspeed_i2c_bus_recv(bus);
-    bus->intr_status |= I2CD_INTR_RX_DONE;
-    if (bus->cmd & I2CD_M_S_RX_CMD_LAST) {
-        i2c_nack(bus->bus);
+    AspeedI2CState *s = bus->controller;
+    AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(s);
+    uint8_t *pool_base = aic->bus_pool_base(bus);
+    uint32_t count = I2CD_POOL_RX_SIZE(bus->pool_ctrl) - bus->pool_pos;
+
+    i2c_recv_buf(bus->bus, pool_base + bus->pool_pos, count);
+    aspeed_i2c_bus_pool_set_dirty(bus, bus->pool_pos, count);
+    bus->pool_pos += count;
+    trace_aspeed_i2c_bus_recv_buf("BUF", count);
+}
+
+/*
+ * Receives the bytes of the RX command, starting at bus->pool_pos. Returns
+ * I2C_ASYNC_PENDING if the target has deferred a byte. The buffers are
+ * filled at once as in aspeed_i2c_bus_send().
+ */
+static int aspeed_i2c_bus_recv(AspeedI2CBus *bus)
+{
+    uint8_t data;
+    int ret;
+
+    if (aspeed_i2c_bus_rx_remaining(bus) &&
+        !i2c_bus_target_may_defer(bus->bus)) {
+        if (bus->cmd & I2CD_RX_BUFF_ENABLE) {
+            aspeed_i2c_bus_recv_pool(bus);
+            return 0;
+        } else if (bus->cmd & I2CD_RX_DMA_ENABLE &&
+                   aspeed_i2c_dma_recv_buf(bus)) {
+            return 0;
+        }
     }
+
+    while (aspeed_i2c_bus_rx_remaining(bus)) {
+        ret = i2c_async_recv(bus->bus, &data, aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_RECV)) {
+            return I2C_ASYNC_PENDING;
+        }
+        if (!aspeed_i2c_bus_rx_store(bus, data)) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+static void aspeed_i2c_bus_rx_done(AspeedI2CBus *bus)
+{
     bus->cmd &= ~(I2CD_M_RX_CMD | I2CD_M_S_RX_CMD_LAST);
     aspeed_i2c_set_state(bus, I2CD_MACTIVE);
 }
 
+static void aspeed_i2c_bus_rx_finish(AspeedI2CBus *bus)
+{
+    int ret;
+
+    if (bus->cmd & I2CD_RX_BUFF_ENABLE) {
+        /* Update RX count, the 8 bits of a full 256 byte pool read 0 */
+        bus->pool_ctrl &= ~(0xff << 24);
+        bus->pool_ctrl |= (bus->pool_pos & 0xff) << 24;
+    }
+    bus->cmd &= ~(I2CD_RX_BUFF_ENABLE | I2CD_RX_DMA_ENABLE);
+
+    bus->intr_status |= I2CD_INTR_RX_DONE;
+    if (bus->cmd & I2CD_M_S_RX_CMD_LAST) {
+        ret = i2c_async_nack(bus->bus, aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_NACK)) {
+            return;
+        }
+    }
+    aspeed_i2c_bus_rx_done(bus);
+}
+
+static void aspeed_i2c_bus_rx_continue(AspeedI2CBus *bus)
+{
+    if (aspeed_i2c_bus_recv(bus) == I2C_ASYNC_PENDING) {
+        return;
+    }
+    aspeed_i2c_bus_rx_finish(bus);
+}
+
+static void aspeed_i2c_handle_rx_cmd(AspeedI2CBus *bus)
+{
+    aspeed_i2c_set_state(bus, I2CD_MRXD);
+    bus->pool_pos = 0;
+    aspeed_i2c_bus_rx_continue(bus);
+}
+
 static uint8_t aspeed_i2c_get_addr(AspeedI2CBus *bus)
 {
     AspeedI2CClass *aic = ASPEED_I2C_GET_CLASS(bus->controller);
@@ -688,125 +935,229 @@ static void aspeed_i2c_bus_cmd_dump(AspeedI2CBus *bus)
     trace_aspeed_i2c_bus_cmd(bus->cmd, cmd_flags, count, bus->intr_status);
 }
 
-/*
- * This cmd handler only process new register set with packet mode
- */
-static void aspeed_i2c_bus_handle_cmd_new(AspeedI2CBus *bus, uint64_t value)
+static void aspeed_i2c_bus_start_done_new(AspeedI2CBus *bus, int ret)
 {
-    uint32_t cmd_done = 0;
+    uint8_t addr = aspeed_i2c_get_addr(bus);
 
-    if (bus->cmd & I2CM_CMD_PKT_MODE) {
-        bus->intr_status |= I2CM_PKT_DONE;
-        bus->dma_len_tx = 0;
-        bus->dma_len_rx = 0;
+    /* A failed repeated start is not reported */
+    if (ret && aspeed_i2c_get_state(bus) == I2CM_PKT_OP_SM_IDLE) {
+        bus->intr_status |= I2CM_TX_NAK | I2CM_PKT_ERROR;
+    }
+
+    if (addr & 0x01) {
+        aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_STARTR);
+    } else {
+        aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_STARTW);
+    }
+    bus->cmd &= ~I2CM_START_CMD;
+}
+
+static void aspeed_i2c_bus_tx_done_new(AspeedI2CBus *bus)
+{
+    if (bus->cmd & I2CM_TX_DMA_EN) {
+        bus->intr_status |= I2CM_TX_ACK;
     }
+    aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_TXD);
+    bus->cmd &= ~(I2CM_TX_CMD | I2CM_TX_DMA_EN);
+}
 
-    if (bus->cmd & I2CM_START_CMD) {
+static void aspeed_i2c_bus_rx_done_new(AspeedI2CBus *bus)
+{
+    aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_RXD);
+    bus->cmd &= ~(I2CM_RX_CMD | I2CM_RX_DMA_EN);
+}
+
+static void aspeed_i2c_bus_rx_last_done_new(AspeedI2CBus *bus)
+{
+    bus->intr_status |= I2CM_RX_DONE;
+    bus->cmd &= ~I2CM_RX_CMD_LAST;
+}
+
+static void aspeed_i2c_bus_stop_done_new(AspeedI2CBus *bus)
+{
+    aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_IDLE);
+    bus->intr_status |= I2CM_NORMAL_STOP;
+    bus->cmd &= ~I2CM_STOP_CMD;
+}
+
+/*
+ * Runs the remaining steps of a packet mode command. Each step clears its
+ * command bits when done, so that a command stalled on the I2C target can
+ * be resumed from where it stopped.
+ */
+static void aspeed_i2c_bus_run_cmd_new(AspeedI2CBus *bus)
+{
+    uint8_t data;
+    int ret;
+
+    if (bus->cmd & I2CM_START_CMD &&
+        aspeed_i2c_get_state(bus) == I2CM_PKT_OP_SM_IDLE) {
         /* Send I2C_START event */
         uint8_t addr = aspeed_i2c_get_addr(bus);
-        if (aspeed_i2c_get_state(bus) == I2CM_PKT_OP_SM_IDLE) {
-            if (i2c_start_transfer(bus->bus, extract32(addr, 1, 7),
-                                   extract32(addr, 0, 1))) {
-                bus->intr_status |= I2CM_TX_NAK | I2CM_PKT_ERROR;
-            }
 
-            if (addr & 0x01) {
-                aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_STARTR);
-            } else {
-                aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_STARTW);
-            }
+        ret = i2c_async_start(bus->bus, extract32(addr, 1, 7),
+                              extract32(addr, 0, 1),
+                              aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_START)) {
+            return;
         }
-        cmd_done |= I2CM_START_CMD;
+        aspeed_i2c_bus_start_done_new(bus, ret);
     }
 
     if (bus->cmd & I2CM_TX_CMD) {
         /* Send through DMA */
         if (bus->cmd & I2CM_TX_DMA_EN) {
-            while (bus->dma_len) {
-                uint8_t data;
-                int ret;
+            bool sent = !i2c_bus_target_may_defer(bus->bus) &&
+                        aspeed_i2c_dma_send_buf(bus, &ret);
+
+            while (!sent && bus->dma_len) {
                 aspeed_i2c_dma_read(bus, &data);
                 trace_aspeed_i2c_bus_send("DMA", bus->dma_len, bus->dma_len, data);
-                ret = i2c_send(bus->bus, data);
+                ret = i2c_async_send(bus->bus, data,
+                                     aspeed_i2c_bus_async_done, bus);
+                if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_SEND)) {
+                    return;
+                }
                 if (ret) {
                     break;
                 }
             }
-            bus->intr_status |= I2CM_TX_ACK;
-            cmd_done |= I2CM_TX_DMA_EN;
         } else {
             /* TODO: Support Byte/Buffer mode */
             qemu_log_mask(LOG_GUEST_ERROR, "%s: Only support DMA\n",  __func__);
         }
-        aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_TXD);
-        cmd_done |= I2CM_TX_CMD;
+        aspeed_i2c_bus_tx_done_new(bus);
     }
 
     if (bus->cmd & I2CM_RX_CMD) {
-        uint8_t addr = aspeed_i2c_get_addr(bus);
         if (bus->cmd & I2CM_START_CMD &&
             aspeed_i2c_get_state(bus) != I2CM_PKT_OP_SM_STARTR) {
             /* Repeated Start */
-            i2c_start_transfer(bus->bus, extract32(addr, 1, 7), extract32(addr, 0, 1));
-            aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_STARTR);
+            uint8_t addr = aspeed_i2c_get_addr(bus);
+
+            ret = i2c_async_start(bus->bus, extract32(addr, 1, 7),
+                                  extract32(addr, 0, 1),
+                                  aspeed_i2c_bus_async_done, bus);
+            if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_START)) {
+                return;
+            }
+            aspeed_i2c_bus_start_done_new(bus, ret);
         }
         if (bus->cmd & I2CM_RX_DMA_EN) {
             /* Write to DMA */
-            while (bus->dma_len) {
-                uint8_t data;
-                data = i2c_recv(bus->bus);
+            bool received = !i2c_bus_target_may_defer(bus->bus) &&
+                            aspeed_i2c_dma_recv_buf(bus);
+
+            while (!received && bus->dma_len) {
+                ret = i2c_async_recv(bus->bus, &data,
+                                     aspeed_i2c_bus_async_done, bus);
+                if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_RECV)) {
+                    return;
+                }
                 if (aspeed_i2c_dma_write(bus, &data)) {
                     break;
                 }
             }
-            cmd_done |= I2CM_RX_DMA_EN;
         }
-        aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_RXD);
-        cmd_done |= I2CM_RX_CMD;
+        aspeed_i2c_bus_rx_done_new(bus);
     }
 
     if (bus->cmd & I2CM_RX_CMD_LAST) {
-        i2c_nack(bus->bus);
-        bus->intr_status |= I2CM_RX_DONE;
-        cmd_done |= I2CM_RX_CMD_LAST;
+        ret = i2c_async_nack(bus->bus, aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_NACK)) {
+            return;
+        }
+        aspeed_i2c_bus_rx_last_done_new(bus);
     }
 
     if (bus->cmd & I2CM_STOP_CMD) {
         aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_STOP);
         /* Send I2C_END Event */
-        i2c_end_transfer(bus->bus);
-        aspeed_i2c_set_state(bus, I2CM_PKT_OP_SM_IDLE);
-        bus->intr_status |= I2CM_NORMAL_STOP;
-        cmd_done |= I2CM_STOP_CMD;
+        ret = i2c_async_end(bus->bus, aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_END)) {
+            return;
+        }
+        aspeed_i2c_bus_stop_done_new(bus);
     }
 
+    bus->cmd &= ~I2CM_START_CMD;
     if (bus->cmd & I2CM_CMD_PKT_MODE) {
         bus->intr_status |= I2CM_PKT_DONE;
-        cmd_done |= 0x7F000000 | I2CM_CMD_PKT_MODE;
+        bus->cmd &= ~(0x7F000000 | I2CM_CMD_PKT_MODE);
     }
-
-    bus->cmd &= ~cmd_done;
 }
 
 /*
- * The state machine needs some refinement. It is only used to track
- * invalid STOP commands for the moment.
+ * This cmd handler only process new register set with packet mode
  */
-static void aspeed_i2c_bus_handle_cmd(AspeedI2CBus *bus, uint64_t value)
+static void aspeed_i2c_bus_handle_cmd_new(AspeedI2CBus *bus, uint64_t value)
 {
-    uint8_t pool_start = 0;
+    if (bus->cmd & I2CM_CMD_PKT_MODE) {
+        bus->intr_status |= I2CM_PKT_DONE;
+        bus->dma_len_tx = 0;
+        bus->dma_len_rx = 0;
+    }
 
-    bus->cmd &= ~0xFFFF;
-    bus->cmd |= value & 0xFFFF;
+    aspeed_i2c_bus_run_cmd_new(bus);
+}
 
-    if (!aspeed_i2c_check_sram(bus)) {
-        return;
+/* Returns false if no target answered the START */
+static bool aspeed_i2c_bus_start_done(AspeedI2CBus *bus, int ret)
+{
+    if (ret) {
+        bus->intr_status |= I2CD_INTR_TX_NAK;
+    } else {
+        bus->intr_status |= I2CD_INTR_TX_ACK;
     }
 
-    if (trace_event_get_state_backends(TRACE_ASPEED_I2C_BUS_CMD)) {
-        aspeed_i2c_bus_cmd_dump(bus);
+    bus->cmd &= ~I2CD_M_START_CMD;
+
+    /*
+     * The START command is also a TX command, as the slave
+     * address is sent on the bus. Drop the TX flag if nothing
+     * else needs to be sent in this sequence.
+     */
+    if (bus->cmd & I2CD_TX_BUFF_ENABLE) {
+        if (I2CD_POOL_TX_COUNT(bus->pool_ctrl) == 1) {
+            bus->cmd &= ~I2CD_M_TX_CMD;
+        } else {
+            /*
+             * Increase the start index in the TX pool buffer to
+             * skip the address byte.
+             */
+            bus->pool_pos++;
+        }
+    } else if (bus->cmd & I2CD_TX_DMA_ENABLE) {
+        if (bus->dma_len == 0) {
+            bus->cmd &= ~I2CD_M_TX_CMD;
+        }
+    } else {
+        bus->cmd &= ~I2CD_M_TX_CMD;
     }
 
+    /* No slave found */
+    if (!i2c_bus_busy(bus->bus)) {
+        return false;
+    }
+    aspeed_i2c_set_state(bus, I2CD_MACTIVE);
+    return true;
+}
+
+static void aspeed_i2c_bus_stop_done(AspeedI2CBus *bus)
+{
+    bus->intr_status |= I2CD_INTR_NORMAL_STOP;
+    bus->cmd &= ~I2CD_M_STOP_CMD;
+    aspeed_i2c_set_state(bus, I2CD_IDLE);
+}
+
+/*
+ * Runs the remaining steps of a command. As in packet mode, the command
+ * bits are cleared as the steps complete.
+ */
+static void aspeed_i2c_bus_run_cmd(AspeedI2CBus *bus)
+{
+    int ret;
+
     if (bus->cmd & I2CD_M_START_CMD) {
         uint8_t state = aspeed_i2c_get_state(bus) & I2CD_MACTIVE ?
             I2CD_MSTARTR : I2CD_MSTART;
@@ -816,76 +1167,147 @@ static void aspeed_i2c_bus_handle_cmd(AspeedI2CBus *bus, uint64_t value)
 
         addr = aspeed_i2c_get_addr(bus);
 
-        if (i2c_start_transfer(bus->bus, extract32(addr, 1, 7),
-                               extract32(addr, 0, 1))) {
-            bus->intr_status |= I2CD_INTR_TX_NAK;
-        } else {
-            bus->intr_status |= I2CD_INTR_TX_ACK;
-        }
-
-        bus->cmd &= ~I2CD_M_START_CMD;
-
-        /*
-         * The START command is also a TX command, as the slave
-         * address is sent on the bus. Drop the TX flag if nothing
-         * else needs to be sent in this sequence.
-         */
-        if (bus->cmd & I2CD_TX_BUFF_ENABLE) {
-            if (I2CD_POOL_TX_COUNT(bus->pool_ctrl) == 1) {
-                bus->cmd &= ~I2CD_M_TX_CMD;
-            } else {
-                /*
-                 * Increase the start index in the TX pool buffer to
-                 * skip the address byte.
-                 */
-                pool_start++;
-            }
-        } else if (bus->cmd & I2CD_TX_DMA_ENABLE) {
-            if (bus->dma_len == 0) {
-                bus->cmd &= ~I2CD_M_TX_CMD;
-            }
-        } else {
-            bus->cmd &= ~I2CD_M_TX_CMD;
+        ret = i2c_async_start(bus->bus, extract32(addr, 1, 7),
+                              extract32(addr, 0, 1),
+                              aspeed_i2c_bus_async_done, bus);
+        if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_START)) {
+            return;
         }
-
-        /* No slave found */
-        if (!i2c_bus_busy(bus->bus)) {
+        if (!aspeed_i2c_bus_start_done(bus, ret)) {
             return;
         }
-        aspeed_i2c_set_state(bus, I2CD_MACTIVE);
     }
 
     if (bus->cmd & I2CD_M_TX_CMD) {
         aspeed_i2c_set_state(bus, I2CD_MTXD);
-        if (aspeed_i2c_bus_send(bus, pool_start)) {
-            bus->intr_status |= (I2CD_INTR_TX_NAK);
-            i2c_end_transfer(bus->bus);
-        } else {
-            bus->intr_status |= I2CD_INTR_TX_ACK;
+        ret = aspeed_i2c_bus_send(bus);
+        if (ret == I2C_ASYNC_PENDING) {
+            return;
         }
-        bus->cmd &= ~I2CD_M_TX_CMD;
-        aspeed_i2c_set_state(bus, I2CD_MACTIVE);
+        aspeed_i2c_bus_tx_done(bus, ret);
     }
 
     if ((bus->cmd & (I2CD_M_RX_CMD | I2CD_M_S_RX_CMD_LAST)) &&
         !(bus->intr_status & I2CD_INTR_RX_DONE)) {
         aspeed_i2c_handle_rx_cmd(bus);
+        if (bus->async_op != I2C_ASYNC_NONE) {
+            return;
+        }
     }
 
     if (bus->cmd & I2CD_M_STOP_CMD) {
         if (!(aspeed_i2c_get_state(bus) & I2CD_MACTIVE)) {
             qemu_log_mask(LOG_GUEST_ERROR, "%s: abnormal stop\n", __func__);
             bus->intr_status |= I2CD_INTR_ABNORMAL;
+            bus->cmd &= ~I2CD_M_STOP_CMD;
+            aspeed_i2c_set_state(bus, I2CD_IDLE);
         } else {
             aspeed_i2c_set_state(bus, I2CD_MSTOP);
-            i2c_end_transfer(bus->bus);
-            bus->intr_status |= I2CD_INTR_NORMAL_STOP;
+            ret = i2c_async_end(bus->bus, aspeed_i2c_bus_async_done, bus);
+            if (aspeed_i2c_bus_stall(bus, ret, I2C_ASYNC_END)) {
+                return;
+            }
+            aspeed_i2c_bus_stop_done(bus);
         }
-        bus->cmd &= ~I2CD_M_STOP_CMD;
-        aspeed_i2c_set_state(bus, I2CD_IDLE);
     }
 }
 
+/*
+ * The state machine needs some refinement. It is only used to track
+ * invalid STOP commands for the moment.
+ */
+static void aspeed_i2c_bus_handle_cmd(AspeedI2CBus *bus, uint64_t value)
+{
+    bus->cmd &= ~0xFFFF;
+    bus->cmd |= value & 0xFFFF;
+
+    if (!aspeed_i2c_check_sram(bus)) {
+        return;
+    }
+
+    if (trace_event_get_state_backends(TRACE_ASPEED_I2C_BUS_CMD)) {
+        aspeed_i2c_bus_cmd_dump(bus);
+    }
+
+    bus->pool_pos = 0;
+    aspeed_i2c_bus_run_cmd(bus);
+}
+
+/*
+ * Completion of an operation deferred by the I2C target: finish the step
+ * the command was stalled on and run the rest of it.
+ */
+static void aspeed_i2c_bus_async_done(void *opaque, int ret, uint8_t data)
+{
+    AspeedI2CBus *bus = opaque;
+    I2CAsyncOp op = bus->async_op;
+    bool resume = true;
+
+    bus->async_op = I2C_ASYNC_NONE;
+
+    if (aspeed_i2c_bus_is_new_mode(bus)) {
+        switch (op) {
+        case I2C_ASYNC_START:
+            aspeed_i2c_bus_start_done_new(bus, ret);
+            break;
+        case I2C_ASYNC_SEND:
+            if (ret || !bus->dma_len) {
+                aspeed_i2c_bus_tx_done_new(bus);
+            }
+            break;
+        case I2C_ASYNC_RECV:
+            if (aspeed_i2c_dma_write(bus, &data) || !bus->dma_len) {
+                aspeed_i2c_bus_rx_done_new(bus);
+            }
+            break;
+        case I2C_ASYNC_NACK:
+            aspeed_i2c_bus_rx_last_done_new(bus);
+            break;
+        case I2C_ASYNC_END:
+            aspeed_i2c_bus_stop_done_new(bus);
+            break;
+        default:
+            g_assert_not_reached();
+        }
+
+        aspeed_i2c_bus_run_cmd_new(bus);
+        aspeed_i2c_bus_raise_interrupt_new(bus);
+        return;
+    }
+
+    switch (op) {
+    case I2C_ASYNC_START:
+        resume = aspeed_i2c_bus_start_done(bus, ret);
+        break;
+    case I2C_ASYNC_SEND:
+        if (ret || !aspeed_i2c_bus_tx_remaining(bus)) {
+            aspeed_i2c_bus_tx_done(bus, ret);
+        }
+        break;
+    case I2C_ASYNC_RECV:
+        if (aspeed_i2c_bus_rx_store(bus, data)) {
+            aspeed_i2c_bus_rx_continue(bus);
+        } else {
+            aspeed_i2c_bus_rx_finish(bus);
+        }
+        resume = bus->async_op == I2C_ASYNC_NONE;
+        break;
+    case I2C_ASYNC_NACK:
+        aspeed_i2c_bus_rx_done(bus);
+        break;
+    case I2C_ASYNC_END:
+        aspeed_i2c_bus_stop_done(bus);
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+    if (resume) {
+        aspeed_i2c_bus_run_cmd(bus);
+    }
+    aspeed_i2c_bus_raise_interrupt(bus);
+}
+
 static void aspeed_i2c_bus_write_new(void *opaque, hwaddr offset,
                                  uint64_t value, unsigned size)
 {
@@ -896,7 +1318,7 @@ static void aspeed_i2c_bus_write_new(void *opaque, hwaddr offset,
     switch (offset) {
     case I2CC_M_S_FUNC_CTRL_REG:
         if (value & I2CD_SLAVE_EN) {
-            i2c_slave_set_address(&bus->slave->i2c, bus->dev_addr);
+            aspeed_i2c_bus_set_slave_address(bus);
         }
         bus->ctrl = value & 0x007FFFFF;
         break;
@@ -930,6 +1352,11 @@ static void aspeed_i2c_bus_write_new(void *opaque, hwaddr offset,
                             __func__);
             break;
         }
+        if (bus->async_op != I2C_ASYNC_NONE) {
+            qemu_log_mask(LOG_GUEST_ERROR, "%s: command in progress\n",
+                          __func__);
+            break;
+        }
         bus->cmd = value;
         aspeed_i2c_bus_handle_cmd_new(bus, value);
         aspeed_i2c_bus_raise_interrupt_new(bus);
@@ -1013,7 +1440,7 @@ static void aspeed_i2c_bus_write_old(void *opaque, hwaddr offset,
     switch (offset) {
     case I2CD_FUN_CTRL_REG:
         if (value & I2CD_SLAVE_EN) {
-            i2c_slave_set_address(&bus->slave->i2c, bus->dev_addr);
+            aspeed_i2c_bus_set_slave_address(bus);
         }
 
         bus->ctrl = value & 0x0071C3FF;
@@ -1036,12 +1463,12 @@ static void aspeed_i2c_bus_write_old(void *opaque, hwaddr offset,
             qemu_irq_lower(aic->bus_get_irq(bus));
         }
 
-        if (handle_rx) {
+        if (handle_rx && bus->async_op == I2C_ASYNC_NONE) {
             if (bus->cmd & (I2CD_M_RX_CMD | I2CD_M_S_RX_CMD_LAST)) {
                 aspeed_i2c_handle_rx_cmd(bus);
                 aspeed_i2c_bus_raise_interrupt(bus);
             } else if (aspeed_i2c_get_state(bus) == I2CD_STXD) {
-                i2c_ack(bus->bus);
+                i2c_ack(bus->slave_bus);
             }
         }
 
@@ -1074,6 +1501,12 @@ static void aspeed_i2c_bus_write_old(void *opaque, hwaddr offset,
             break;
         }
 
+        if (bus->async_op != I2C_ASYNC_NONE) {
+            qemu_log_mask(LOG_GUEST_ERROR, "%s: command in progress\n",
+                          __func__);
+            break;
+        }
+
         aspeed_i2c_bus_handle_cmd(bus, value);
         aspeed_i2c_bus_raise_interrupt(bus);
         break;
@@ -1168,44 +1601,9 @@ static const MemoryRegionOps aspeed_i2c_ctrl_ops = {
     .endianness = DEVICE_LITTLE_ENDIAN,
 };
 
-static uint64_t aspeed_i2c_pool_read(void *opaque, hwaddr offset,
-                                     unsigned size)
-{
-    AspeedI2CState *s = opaque;
-    uint64_t ret = 0;
-    int i;
-
-    for (i = 0; i < size; i++) {
-        ret |= (uint64_t) s->pool[offset + i] << (8 * i);
-    }
-
-    return ret;
-}
-
-static void aspeed_i2c_pool_write(void *opaque, hwaddr offset,
-                                  uint64_t value, unsigned size)
-{
-    AspeedI2CState *s = opaque;
-    int i;
-
-    for (i = 0; i < size; i++) {
-        s->pool[offset + i] = (value >> (8 * i)) & 0xFF;
-    }
-}
-
-static const MemoryRegionOps aspeed_i2c_pool_ops = {
-    .read = aspeed_i2c_pool_read,
-    .write = aspeed_i2c_pool_write,
-    .endianness = DEVICE_LITTLE_ENDIAN,
-    .valid = {
-        .min_access_size = 1,
-        .max_access_size = 4,
-    },
-};
-
 static const VMStateDescription aspeed_i2c_bus_vmstate = {
     .name = TYPE_ASPEED_I2C,
-    .version_id = 3,
+    .version_id = 4,
     .minimum_version_id = 3,
     .fields = (VMStateField[]) {
         VMSTATE_UINT8(id, AspeedI2CBus),
@@ -1218,20 +1616,21 @@ static const VMStateDescription aspeed_i2c_bus_vmstate = {
         VMSTATE_UINT32(pool_ctrl, AspeedI2CBus),
         VMSTATE_UINT32(dma_addr, AspeedI2CBus),
         VMSTATE_UINT32(dma_len, AspeedI2CBus),
+        VMSTATE_UINT16_V(pool_pos, AspeedI2CBus, 4),
         VMSTATE_END_OF_LIST()
     }
 };
 
+/* The buffer pool is migrated with the RAM */
 static const VMStateDescription aspeed_i2c_vmstate = {
     .name = TYPE_ASPEED_I2C,
-    .version_id = 2,
-    .minimum_version_id = 2,
+    .version_id = 3,
+    .minimum_version_id = 3,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32(intr_status, AspeedI2CState),
         VMSTATE_STRUCT_ARRAY(busses, AspeedI2CState,
                              ASPEED_I2C_NR_BUSSES, 1, aspeed_i2c_bus_vmstate,
                              AspeedI2CBus),
-        VMSTATE_UINT8_ARRAY(pool, AspeedI2CState, ASPEED_I2C_MAX_POOL_SIZE),
         VMSTATE_END_OF_LIST()
     }
 };
@@ -1308,9 +1707,12 @@ static void aspeed_i2c_realize(DeviceState *dev, Error **errp)
                                     &s->busses[i].mr);
     }
 
-    memory_region_init_io(&s->pool_iomem, OBJECT(s), &aspeed_i2c_pool_ops, s,
-                          "aspeed.i2c-pool", aic->pool_size);
-    memory_region_add_subregion(&s->iomem, aic->pool_base, &s->pool_iomem);
+    /* The pool is plain storage, the guest accesses it directly */
+    if (!register_ram_init(&s->pool, OBJECT(s), NULL, NULL, "aspeed.i2c-pool",
+                           aic->pool_size, errp)) {
+        return;
+    }
+    memory_region_add_subregion(&s->iomem, aic->pool_base, &s->pool.mr);
 
     if (aic->has_dma) {
         if (!s->dram_mr) {
@@ -1360,7 +1762,7 @@ static int aspeed_i2c_slave_event_new(AspeedI2CBus *bus, enum i2c_event event)
         assert(bus->slave_dma_len_tx == 0);
         assert(bus->slave_dma_len);
         assert(bus->slave_dma_addr);
-        i2c_ack(bus->bus);
+        i2c_ack(bus->slave_bus);
         break;
     case I2C_FINISH:
         bus->slave_intr_status |= I2CS_PKT_DONE;
@@ -1382,6 +1784,11 @@ static int aspeed_i2c_slave_event(I2CSlave *slave, enum i2c_event event)
     AspeedI2CSlave *s = ASPEED_I2C_SLAVE(slave);
     AspeedI2CBus *bus = s->bus;
 
+    /* The transfer may come from a peer bus, see aspeed_i2c_bus_connect() */
+    if (event == I2C_START_SEND) {
+        bus->slave_bus = I2C_BUS(qdev_get_parent_bus(DEVICE(slave)));
+    }
+
     if (aspeed_i2c_bus_is_new_mode(bus)) {
         return aspeed_i2c_slave_event_new(bus, event);
     }
@@ -1424,7 +1831,7 @@ static void aspeed_i2c_slave_send_async_new(AspeedI2CBus *bus, uint8_t data)
     bus->slave_dma_len--;
     bus->slave_dma_len_rx++;
 
-    i2c_ack(bus->bus);
+    i2c_ack(bus->slave_bus);
 }
 
 static void aspeed_i2c_slave_send_async(I2CSlave *slave, uint8_t data)
@@ -1479,7 +1886,12 @@ static void aspeed_i2c_bus_reset(DeviceState *dev)
     s->slave_dma_len_rx = 0;
     s->slave_intr_ctrl = 0;
     s->slave_intr_status = 0;
+    s->slave_bus = s->bus;
 
+    if (s->async_op != I2C_ASYNC_NONE) {
+        i2c_async_cancel(s->bus);
+        s->async_op = I2C_ASYNC_NONE;
+    }
     i2c_end_transfer(s->bus);
 }
 
@@ -1501,12 +1913,22 @@ static void aspeed_i2c_bus_realize(DeviceState *dev, Error **errp)
     s->bus = i2c_init_bus(dev, name);
     s->slave = ASPEED_I2C_SLAVE(i2c_slave_create_simple(s->bus, TYPE_ASPEED_I2C_SLAVE, 0xff));
     s->slave->bus = s;
+    s->slave_bus = s->bus;
 
     memory_region_init_io(&s->mr, OBJECT(s), &aspeed_i2c_bus_ops,
                           s, name, aic->reg_size);
     sysbus_init_mmio(SYS_BUS_DEVICE(dev), &s->mr);
 }
 
+void aspeed_i2c_bus_connect(AspeedI2CBus *bus, I2CBus *peer)
+{
+    assert(!bus->peer_slave);
+
+    bus->peer_slave = ASPEED_I2C_SLAVE(
+        i2c_slave_create_simple(peer, TYPE_ASPEED_I2C_SLAVE, 0xff));
+    bus->peer_slave->bus = bus;
+}
+
 static Property aspeed_i2c_bus_properties[] = {
     DEFINE_PROP_UINT8("bus-id", AspeedI2CBus, id, 0),
     DEFINE_PROP_LINK("controller", AspeedI2CBus, controller, TYPE_ASPEED_I2C,
@@ -1539,7 +1961,8 @@ static qemu_irq aspeed_2400_i2c_bus_get_irq(AspeedI2CBus *bus)
 static uint8_t *aspeed_2400_i2c_bus_pool_base(AspeedI2CBus *bus)
 {
     uint8_t *pool_page =
-        &bus->controller->pool[I2CD_POOL_PAGE_SEL(bus->ctrl) * 0x100];
+        register_ram_ptr(&bus->controller->pool,
+                         I2CD_POOL_PAGE_SEL(bus->ctrl) * 0x100);
 
     return &pool_page[I2CD_POOL_OFFSET(bus->pool_ctrl)];
 }
@@ -1573,7 +1996,7 @@ static qemu_irq aspeed_2500_i2c_bus_get_irq(AspeedI2CBus *bus)
 
 static uint8_t *aspeed_2500_i2c_bus_pool_base(AspeedI2CBus *bus)
 {
-    return &bus->controller->pool[bus->id * 0x10];
+    return register_ram_ptr(&bus->controller->pool, bus->id * 0x10);
 }
 
 static void aspeed_2500_i2c_class_init(ObjectClass *klass, void *data)
@@ -1607,7 +2030,7 @@ static qemu_irq aspeed_2600_i2c_bus_get_irq(AspeedI2CBus *bus)
 
 static uint8_t *aspeed_2600_i2c_bus_pool_base(AspeedI2CBus *bus)
 {
-   return &bus->controller->pool[bus->id * 0x20];
+   return register_ram_ptr(&bus->controller->pool, bus->id * 0x20);
 }
 
 static void aspeed_2600_i2c_class_init(ObjectClass *klass, void *data)
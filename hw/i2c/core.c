@@ -23,16 +23,41 @@ static Property i2c_props[] = {
     DEFINE_PROP_END_OF_LIST(),
 };
 
+static bool i2c_slave_match(I2CSlave *candidate, uint8_t address,
+                            bool broadcast, I2CNodeList *current_devs);
+static bool i2c_slave_route(I2CSlave *candidate, I2CSlave **routes);
+
+/* The device plugged into the bus may answer some addresses */
+static bool i2c_bus_check_address(BusState *qbus, DeviceState *dev,
+                                  Error **errp)
+{
+    i2c_bus_invalidate_routes(I2C_BUS(qbus));
+    return true;
+}
+
+static void i2c_bus_class_init(ObjectClass *klass, void *data)
+{
+    BusClass *k = BUS_CLASS(klass);
+
+    k->check_address = i2c_bus_check_address;
+}
+
 static const TypeInfo i2c_bus_info = {
     .name = TYPE_I2C_BUS,
     .parent = TYPE_BUS,
     .instance_size = sizeof(I2CBus),
+    .class_init = i2c_bus_class_init,
 };
 
 static int i2c_bus_pre_save(void *opaque)
 {
     I2CBus *bus = opaque;
 
+    /* The completion callback of the master cannot be migrated */
+    if (bus->async.op != I2C_ASYNC_NONE) {
+        return -EBUSY;
+    }
+
     bus->saved_address = -1;
     if (!QLIST_EMPTY(&bus->current_devs)) {
         if (!bus->broadcast) {
@@ -70,7 +95,12 @@ I2CBus *i2c_init_bus(DeviceState *parent, const char *name)
 
 void i2c_slave_set_address(I2CSlave *dev, uint8_t address)
 {
+    BusState *bus = qdev_get_parent_bus(DEVICE(dev));
+
     dev->address = address;
+    if (bus) {
+        i2c_bus_invalidate_routes(I2C_BUS(bus));
+    }
 }
 
 /* Return nonzero if bus is busy.  */
@@ -103,6 +133,123 @@ bool i2c_scan_bus(I2CBus *bus, uint8_t address, bool broadcast,
     return broadcast;
 }
 
+/*
+ * Fills the routing table of the bus with the devices i2c_scan_bus() would
+ * match: the first child matching an address answers it.
+ */
+static void i2c_bus_update_routes(I2CBus *bus)
+{
+    BusChild *kid;
+
+    memset(bus->routes, 0, sizeof(bus->routes));
+    bus->routes_scan = false;
+
+    QTAILQ_FOREACH(kid, &bus->qbus.children, sibling) {
+        I2CSlave *candidate = I2C_SLAVE(kid->child);
+        I2CSlaveClass *sc = I2C_SLAVE_GET_CLASS(candidate);
+
+        /* A custom match_and_add needs its own route handler */
+        if (!sc->route ||
+            (sc->match_and_add != i2c_slave_match &&
+             sc->route == i2c_slave_route) ||
+            !sc->route(candidate, bus->routes)) {
+            bus->routes_scan = true;
+            break;
+        }
+    }
+
+    bus->routes_valid = true;
+    trace_i2c_bus_routes(bus->qbus.name, bus->routes_scan);
+}
+
+bool i2c_bus_merge_routes(I2CBus *bus, I2CSlave **routes)
+{
+    int i;
+
+    if (!bus->routes_valid) {
+        i2c_bus_update_routes(bus);
+    }
+    if (bus->routes_scan) {
+        return false;
+    }
+
+    for (i = 0; i < I2C_ROUTES; i++) {
+        if (!routes[i]) {
+            routes[i] = bus->routes[i];
+        }
+    }
+    return true;
+}
+
+void i2c_bus_invalidate_routes(I2CBus *bus)
+{
+    DeviceState *parent;
+
+    for (;;) {
+        bus->routes_valid = false;
+
+        /* Go up through the muxes */
+        parent = bus->qbus.parent;
+        if (!parent || !parent->parent_bus ||
+            !object_dynamic_cast(OBJECT(parent), TYPE_I2C_SLAVE)) {
+            break;
+        }
+        bus = I2C_BUS(parent->parent_bus);
+    }
+}
+
+/*
+ * Adds the target of a start to current_devs with the routing table of the
+ * bus, without allocating. Returns false if the bus must be scanned instead.
+ */
+static bool i2c_bus_route(I2CBus *bus, uint8_t address)
+{
+    I2CSlave *s;
+
+    if (bus->broadcast || address >= I2C_ROUTES) {
+        return false;
+    }
+
+    if (!bus->routes_valid) {
+        i2c_bus_update_routes(bus);
+    }
+    if (bus->routes_scan) {
+        return false;
+    }
+
+    s = bus->routes[address];
+    if (s) {
+        bus->route_node.elt = s;
+        QLIST_INSERT_HEAD(&bus->current_devs, &bus->route_node, next);
+    }
+    return true;
+}
+
+static I2CSlave *i2c_async_target(I2CBus *bus)
+{
+    I2CNode *node = QLIST_FIRST(&bus->current_devs);
+
+    if (!node || bus->broadcast || QLIST_NEXT(node, next)) {
+        return NULL;
+    }
+
+    return node->elt;
+}
+
+static void i2c_async_begin(I2CBus *bus, I2CAsyncOp op,
+                            I2CAsyncCompletionFunc cb, void *opaque)
+{
+    assert(bus->async.op == I2C_ASYNC_NONE && cb);
+
+    bus->async.op = op;
+    bus->async.cb = cb;
+    bus->async.opaque = opaque;
+    bus->async.in_handler = true;
+    bus->async.done = false;
+}
+
+static int i2c_async_wait(I2CBus *bus, uint8_t *data);
+
 /* TODO: Make this handle multiple masters.  */
 /*
  * Start or continue an i2c transaction.  When this is called for the
@@ -117,10 +264,13 @@ bool i2c_scan_bus(I2CBus *bus, uint8_t address, bool broadcast,
  * without releasing the bus.  If that fails, the bus is still
  * in a transaction.
  *
- * @event must be I2C_START_RECV or I2C_START_SEND.
+ * @event must be I2C_START_RECV or I2C_START_SEND. When @cb is set, a
+ * target with an event_async handler may defer its answer, see
+ * i2c_async_start().
  */
 static int i2c_do_start_transfer(I2CBus *bus, uint8_t address,
-                                 enum i2c_event event)
+                                 enum i2c_event event,
+                                 I2CAsyncCompletionFunc cb, void *opaque)
 {
     I2CSlaveClass *sc;
     I2CNode *node;
@@ -143,8 +293,11 @@ static int i2c_do_start_transfer(I2CBus *bus, uint8_t address,
      * terminating the previous transaction.
      */
     if (QLIST_EMPTY(&bus->current_devs)) {
-        /* Disregard whether devices were found. */
-        (void)i2c_scan_bus(bus, address, bus->broadcast, &bus->current_devs);
+        if (!i2c_bus_route(bus, address)) {
+            /* Disregard whether devices were found. */
+            (void)i2c_scan_bus(bus, address, bus->broadcast,
+                               &bus->current_devs);
+        }
         bus_scanned = true;
     }
 
@@ -152,6 +305,18 @@ static int i2c_do_start_transfer(I2CBus *bus, uint8_t address,
         return 1;
     }
 
+    if (cb) {
+        I2CSlave *s = i2c_async_target(bus);
+
+        if (s && I2C_SLAVE_GET_CLASS(s)->event_async) {
+            trace_i2c_event("start", s->address);
+            i2c_async_begin(bus, I2C_ASYNC_START, cb, opaque);
+            bus->async.scanned = bus_scanned;
+            I2C_SLAVE_GET_CLASS(s)->event_async(s, event);
+            return i2c_async_wait(bus, NULL);
+        }
+    }
+
     QLIST_FOREACH(node, &bus->current_devs, next) {
         I2CSlave *s = node->elt;
         int rv;
@@ -179,7 +344,7 @@ int i2c_start_transfer(I2CBus *bus, uint8_t address, bool is_recv)
 {
     return i2c_do_start_transfer(bus, address, is_recv
                                                ? I2C_START_RECV
-                                               : I2C_START_SEND);
+                                               : I2C_START_SEND, NULL, NULL);
 }
 
 void i2c_bus_master(I2CBus *bus, QEMUBH *bh)
@@ -204,28 +369,23 @@ void i2c_bus_release(I2CBus *bus)
 
 int i2c_start_recv(I2CBus *bus, uint8_t address)
 {
-    return i2c_do_start_transfer(bus, address, I2C_START_RECV);
+    return i2c_do_start_transfer(bus, address, I2C_START_RECV, NULL, NULL);
 }
 
 int i2c_start_send(I2CBus *bus, uint8_t address)
 {
-    return i2c_do_start_transfer(bus, address, I2C_START_SEND);
+    return i2c_do_start_transfer(bus, address, I2C_START_SEND, NULL, NULL);
 }
 
-void i2c_end_transfer(I2CBus *bus)
+static void i2c_release_devs(I2CBus *bus)
 {
-    I2CSlaveClass *sc;
     I2CNode *node, *next;
 
     QLIST_FOREACH_SAFE(node, &bus->current_devs, next, next) {
-        I2CSlave *s = node->elt;
-        sc = I2C_SLAVE_GET_CLASS(s);
-        if (sc->event) {
-            trace_i2c_event("finish", s->address);
-            sc->event(s, I2C_FINISH);
-        }
         QLIST_REMOVE(node, next);
-        g_free(node);
+        if (node != &bus->route_node) {
+            g_free(node);
+        }
     }
     bus->broadcast = false;
 
@@ -240,6 +400,23 @@ void i2c_end_transfer(I2CBus *bus)
     }
 }
 
+void i2c_end_transfer(I2CBus *bus)
+{
+    I2CSlaveClass *sc;
+    I2CNode *node;
+
+    QLIST_FOREACH(node, &bus->current_devs, next) {
+        I2CSlave *s = node->elt;
+        sc = I2C_SLAVE_GET_CLASS(s);
+        if (sc->event) {
+            trace_i2c_event("finish", s->address);
+            sc->event(s, I2C_FINISH);
+        }
+    }
+
+    i2c_release_devs(bus);
+}
+
 int i2c_send(I2CBus *bus, uint8_t data)
 {
     I2CSlaveClass *sc;
@@ -293,6 +470,50 @@ uint8_t i2c_recv(I2CBus *bus)
     return data;
 }
 
+size_t i2c_send_buf(I2CBus *bus, const uint8_t *buf, size_t len)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+    size_t i;
+
+    if (sc && sc->send_buf) {
+        trace_i2c_send_buf(s->address, len);
+        return sc->send_buf(s, buf, len);
+    }
+
+    for (i = 0; i < len; i++) {
+        if (i2c_send(bus, buf[i])) {
+            break;
+        }
+    }
+    return i;
+}
+
+void i2c_recv_buf(I2CBus *bus, uint8_t *buf, size_t len)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+    size_t i;
+
+    if (sc && sc->recv_buf) {
+        trace_i2c_recv_buf(s->address, len);
+        sc->recv_buf(s, buf, len);
+        return;
+    }
+
+    for (i = 0; i < len; i++) {
+        buf[i] = i2c_recv(bus);
+    }
+}
+
+bool i2c_bus_target_may_defer(I2CBus *bus)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+
+    return sc && (sc->send_async || sc->recv_async);
+}
+
 void i2c_nack(I2CBus *bus)
 {
     I2CSlaveClass *sc;
@@ -313,6 +534,11 @@ void i2c_nack(I2CBus *bus)
 
 void i2c_ack(I2CBus *bus)
 {
+    if (bus->async.op != I2C_ASYNC_NONE) {
+        i2c_async_complete(bus, 0, 0xff);
+        return;
+    }
+
     if (!bus->bh) {
         return;
     }
@@ -320,6 +546,161 @@ void i2c_ack(I2CBus *bus)
     qemu_bh_schedule(bus->bh);
 }
 
+/*
+ * Bus side effects of a completed operation, before the master is told
+ * about it.
+ */
+static void i2c_async_finish(I2CBus *bus)
+{
+    switch (bus->async.op) {
+    case I2C_ASYNC_START:
+        /* A NAK on the first start terminates the transfer */
+        if (bus->async.ret && bus->async.scanned) {
+            i2c_release_devs(bus);
+        }
+        break;
+    case I2C_ASYNC_END:
+        i2c_release_devs(bus);
+        break;
+    default:
+        break;
+    }
+
+    bus->async.op = I2C_ASYNC_NONE;
+}
+
+/*
+ * Called once the target handler has returned. The target may have
+ * completed the operation from within the handler, in which case the
+ * result is returned directly and the callback is not used.
+ */
+static int i2c_async_wait(I2CBus *bus, uint8_t *data)
+{
+    bus->async.in_handler = false;
+    if (!bus->async.done) {
+        return I2C_ASYNC_PENDING;
+    }
+
+    i2c_async_finish(bus);
+    if (data) {
+        *data = bus->async.data;
+    }
+    return bus->async.ret ? -1 : 0;
+}
+
+void i2c_async_complete(I2CBus *bus, int ret, uint8_t data)
+{
+    I2CAsyncCompletionFunc cb = bus->async.cb;
+    void *opaque = bus->async.opaque;
+
+    if (bus->async.op == I2C_ASYNC_NONE || bus->async.done) {
+        return;
+    }
+
+    bus->async.ret = ret;
+    bus->async.data = data;
+    if (bus->async.in_handler) {
+        bus->async.done = true;
+        return;
+    }
+
+    if (bus->async.op == I2C_ASYNC_RECV) {
+        trace_i2c_recv(QLIST_FIRST(&bus->current_devs)->elt->address, data);
+    }
+    i2c_async_finish(bus);
+    cb(opaque, ret, data);
+}
+
+void i2c_async_cancel(I2CBus *bus)
+{
+    bus->async.op = I2C_ASYNC_NONE;
+}
+
+int i2c_async_start(I2CBus *bus, uint8_t address, bool is_recv,
+                    I2CAsyncCompletionFunc cb, void *opaque)
+{
+    int ret = i2c_do_start_transfer(bus, address, is_recv
+                                                  ? I2C_START_RECV
+                                                  : I2C_START_SEND,
+                                    cb, opaque);
+
+    if (bus->async.op != I2C_ASYNC_NONE) {
+        return I2C_ASYNC_PENDING;
+    }
+    return ret ? -1 : 0;
+}
+
+int i2c_async_send(I2CBus *bus, uint8_t data,
+                   I2CAsyncCompletionFunc cb, void *opaque)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+
+    if (!sc || !sc->send_async) {
+        return i2c_send(bus, data);
+    }
+
+    trace_i2c_send(s->address, data);
+    i2c_async_begin(bus, I2C_ASYNC_SEND, cb, opaque);
+    sc->send_async(s, data);
+    return i2c_async_wait(bus, NULL);
+}
+
+int i2c_async_recv(I2CBus *bus, uint8_t *data,
+                   I2CAsyncCompletionFunc cb, void *opaque)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+    int ret;
+
+    if (!sc || !sc->recv_async) {
+        *data = i2c_recv(bus);
+        return 0;
+    }
+
+    i2c_async_begin(bus, I2C_ASYNC_RECV, cb, opaque);
+    sc->recv_async(s);
+    ret = i2c_async_wait(bus, data);
+    if (ret != I2C_ASYNC_PENDING) {
+        trace_i2c_recv(s->address, *data);
+    }
+    return ret == I2C_ASYNC_PENDING ? ret : 0;
+}
+
+int i2c_async_nack(I2CBus *bus, I2CAsyncCompletionFunc cb, void *opaque)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+
+    if (!sc || !sc->event_async) {
+        i2c_nack(bus);
+        return 0;
+    }
+
+    trace_i2c_event("nack", s->address);
+    i2c_async_begin(bus, I2C_ASYNC_NACK, cb, opaque);
+    sc->event_async(s, I2C_NACK);
+    return i2c_async_wait(bus, NULL) == I2C_ASYNC_PENDING ?
+           I2C_ASYNC_PENDING : 0;
+}
+
+int i2c_async_end(I2CBus *bus, I2CAsyncCompletionFunc cb, void *opaque)
+{
+    I2CSlave *s = i2c_async_target(bus);
+    I2CSlaveClass *sc = s ? I2C_SLAVE_GET_CLASS(s) : NULL;
+
+    if (!sc || !sc->event_async) {
+        i2c_end_transfer(bus);
+        return 0;
+    }
+
+    trace_i2c_event("finish", s->address);
+    i2c_async_begin(bus, I2C_ASYNC_END, cb, opaque);
+    sc->event_async(s, I2C_FINISH);
+    return i2c_async_wait(bus, NULL) == I2C_ASYNC_PENDING ?
+           I2C_ASYNC_PENDING : 0;
+}
+
 static int i2c_slave_post_load(void *opaque, int version_id)
 {
     I2CSlave *dev = opaque;
@@ -327,6 +708,8 @@ static int i2c_slave_post_load(void *opaque, int version_id)
     I2CNode *node;
 
     bus = I2C_BUS(qdev_get_parent_bus(DEVICE(dev)));
+    /* The address may differ from the one routed, as in a loadvm */
+    i2c_bus_invalidate_routes(bus);
     if ((bus->saved_address == dev->address) ||
         (bus->saved_address == I2C_BROADCAST)) {
         node = g_new(struct I2CNode, 1);
@@ -384,6 +767,14 @@ static bool i2c_slave_match(I2CSlave *candidate, uint8_t address,
     return false;
 }
 
+static bool i2c_slave_route(I2CSlave *candidate, I2CSlave **routes)
+{
+    if (candidate->address < I2C_ROUTES && !routes[candidate->address]) {
+        routes[candidate->address] = candidate;
+    }
+    return true;
+}
+
 static void i2c_slave_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *k = DEVICE_CLASS(klass);
@@ -392,6 +783,7 @@ static void i2c_slave_class_init(ObjectClass *klass, void *data)
     k->bus_type = TYPE_I2C_BUS;
     device_class_set_props(k, i2c_props);
     sc->match_and_add = i2c_slave_match;
+    sc->route = i2c_slave_route;
 }
 
 static const TypeInfo i2c_slave_type_info = {
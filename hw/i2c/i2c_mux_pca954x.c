@@ -96,9 +96,30 @@ static bool pca954x_match(I2CSlave *candidate, uint8_t address,
     return broadcast;
 }
 
+/* Same as pca954x_match(), for the routing table of the upstream bus */
+static bool pca954x_route(I2CSlave *candidate, I2CSlave **routes)
+{
+    Pca954xState *mux = PCA954X(candidate);
+    Pca954xClass *mc = PCA954X_GET_CLASS(mux);
+    int i;
+
+    if (candidate->address < I2C_ROUTES && !routes[candidate->address]) {
+        routes[candidate->address] = candidate;
+    }
+
+    for (i = 0; i < mc->nchans; i++) {
+        if (mux->enabled[i] && !i2c_bus_merge_routes(mux->bus[i], routes)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static void pca954x_enable_channel(Pca954xState *s, uint8_t enable_mask)
 {
     Pca954xClass *mc = PCA954X_GET_CLASS(s);
+    BusState *bus = qdev_get_parent_bus(DEVICE(s));
     int i;
 
     /*
@@ -112,6 +133,11 @@ static void pca954x_enable_channel(Pca954xState *s, uint8_t enable_mask)
             s->enabled[i] = false;
         }
     }
+
+    /* The devices behind the mux are routed by the upstream bus */
+    if (bus) {
+        i2c_bus_invalidate_routes(I2C_BUS(bus));
+    }
 }
 
 static void pca954x_write(Pca954xState *s, uint8_t data)
@@ -205,6 +231,7 @@ static void pca954x_class_init(ObjectClass *klass, void *data)
     SMBusDeviceClass *k = SMBUS_DEVICE_CLASS(klass);
 
     sc->match_and_add = pca954x_match;
+    sc->route = pca954x_route;
 
     rc->phases.enter = pca954x_enter_reset;
 
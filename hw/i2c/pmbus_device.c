@@ -282,6 +282,8 @@ static uint8_t pmbus_receive_byte(SMBusDevice *smd)
         return ret;
     }
 
+    sensor_feed_client_sample(OBJECT(pmdev), &pmdev->feed);
+
     /*
      * Reading from all pages will return the value from page 0,
      * this is unspecified behaviour in general.
@@ -1062,6 +1064,26 @@ static void pmbus_operation(PMBusDevice *pmdev)
     pmbus_check_limits(pmdev);
 }
 
+/*
+ * The response of a read command is built by the first receive_byte call,
+ * the rest of it is then popped from the output buffer in one go.
+ */
+static void pmbus_receive_buf(SMBusDevice *smd, uint8_t *buf, size_t len)
+{
+    PMBusDevice *pmdev = PMBUS_DEVICE(smd);
+    size_t i = 0;
+
+    while (i < len) {
+        if (pmdev->out_buf_len == 0) {
+            buf[i++] = pmbus_receive_byte(smd);
+            continue;
+        }
+        while (i < len && pmdev->out_buf_len != 0) {
+            buf[i++] = pmdev->out_buf[--pmdev->out_buf_len];
+        }
+    }
+}
+
 static int pmbus_write_data(SMBusDevice *smd, uint8_t *buf, uint8_t len)
 {
     PMBusDevice *pmdev = PMBUS_DEVICE(smd);
@@ -1665,10 +1687,18 @@ const VMStateDescription vmstate_pmbus_device = {
     }
 };
 
+static void pmbus_device_init(Object *obj)
+{
+    PMBusDevice *pmdev = PMBUS_DEVICE(obj);
+
+    sensor_feed_client_init(obj, &pmdev->feed);
+}
+
 static void pmbus_device_finalize(Object *obj)
 {
     PMBusDevice *pmdev = PMBUS_DEVICE(obj);
     g_free(pmdev->pages);
+    sensor_feed_client_finalize(&pmdev->feed);
 }
 
 static void pmbus_device_class_init(ObjectClass *klass, void *data)
@@ -1678,12 +1708,14 @@ static void pmbus_device_class_init(ObjectClass *klass, void *data)
     k->quick_cmd = pmbus_quick_cmd;
     k->write_data = pmbus_write_data;
     k->receive_byte = pmbus_receive_byte;
+    k->receive_buf = pmbus_receive_buf;
 }
 
 static const TypeInfo pmbus_device_type_info = {
     .name = TYPE_PMBUS_DEVICE,
     .parent = TYPE_SMBUS_DEVICE,
     .instance_size = sizeof(PMBusDevice),
+    .instance_init = pmbus_device_init,
     .instance_finalize = pmbus_device_finalize,
     .abstract = true,
     .class_size = sizeof(PMBusDeviceClass),
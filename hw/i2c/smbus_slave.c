@@ -193,6 +193,45 @@ static int smbus_i2c_send(I2CSlave *s, uint8_t data)
     return 0;
 }
 
+static void smbus_i2c_recv_buf(I2CSlave *s, uint8_t *buf, size_t len)
+{
+    SMBusDevice *dev = SMBUS_DEVICE(s);
+    SMBusDeviceClass *sc = SMBUS_DEVICE_GET_CLASS(dev);
+    size_t i;
+
+    if (dev->mode != SMBUS_READ_DATA || !sc->receive_buf) {
+        for (i = 0; i < len; i++) {
+            buf[i] = smbus_i2c_recv(s);
+        }
+        return;
+    }
+
+    sc->receive_buf(dev, buf, len);
+    DPRINTF("Read %zu bytes of data\n", len);
+}
+
+static size_t smbus_i2c_send_buf(I2CSlave *s, const uint8_t *buf,
+                                 size_t len)
+{
+    SMBusDevice *dev = SMBUS_DEVICE(s);
+    size_t n;
+
+    if (dev->mode != SMBUS_WRITE_DATA) {
+        BADF("Unexpected write in state %d\n", dev->mode);
+        return len;
+    }
+
+    DPRINTF("Write %zu bytes of data\n", len);
+    n = MIN(len, sizeof(dev->data_buf) - dev->data_len);
+    if (n < len) {
+        BADF("Too many bytes sent\n");
+    }
+    memcpy(dev->data_buf + dev->data_len, buf, n);
+    dev->data_len += n;
+
+    return len;
+}
+
 static void smbus_device_class_init(ObjectClass *klass, void *data)
 {
     I2CSlaveClass *sc = I2C_SLAVE_CLASS(klass);
@@ -200,6 +239,8 @@ static void smbus_device_class_init(ObjectClass *klass, void *data)
     sc->event = smbus_i2c_event;
     sc->recv = smbus_i2c_recv;
     sc->send = smbus_i2c_send;
+    sc->recv_buf = smbus_i2c_recv_buf;
+    sc->send_buf = smbus_i2c_send_buf;
 }
 
 bool smbus_vmstate_needed(SMBusDevice *dev)
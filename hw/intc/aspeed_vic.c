@@ -32,7 +32,9 @@
 #include "hw/irq.h"
 #include "migration/vmstate.h"
 #include "qemu/bitops.h"
+#include "qemu/lockable.h"
 #include "qemu/log.h"
+#include "qemu/main-loop.h"
 #include "qemu/module.h"
 #include "trace.h"
 
@@ -70,6 +72,8 @@ static void aspeed_vic_set_irq(void *opaque, int irq, int level)
 
     trace_aspeed_vic_set_irq(irq, level);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     irq_mask = BIT(irq);
     if (s->sense & irq_mask) {
         /* level-triggered */
@@ -111,6 +115,8 @@ static uint64_t aspeed_vic_read(void *opaque, hwaddr offset, unsigned size)
     uint64_t val;
     bool high;
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (offset < AVIC_NEW_BASE_OFFSET) {
         high = false;
         n_offset = offset;
@@ -197,6 +203,10 @@ static void aspeed_vic_write(void *opaque, hwaddr offset, uint64_t data,
     hwaddr n_offset;
     bool high;
 
+    /* Writes update the interrupt outputs, which needs the BQL */
+    QEMU_IOTHREAD_LOCK_GUARD();
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (offset < AVIC_NEW_BASE_OFFSET) {
         high = false;
         n_offset = offset;
@@ -308,6 +318,8 @@ static void aspeed_vic_reset(DeviceState *dev)
 {
     AspeedVICState *s = ASPEED_VIC(dev);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     s->level = 0;
     s->raw = 0;
     s->select = 0;
@@ -327,8 +339,10 @@ static void aspeed_vic_realize(DeviceState *dev, Error **errp)
     SysBusDevice *sbd = SYS_BUS_DEVICE(dev);
     AspeedVICState *s = ASPEED_VIC(dev);
 
+    qemu_mutex_init(&s->lock);
     memory_region_init_io(&s->iomem, OBJECT(s), &aspeed_vic_ops, s,
                           TYPE_ASPEED_VIC, AVIC_IO_REGION_SIZE);
+    memory_region_clear_global_locking(&s->iomem);
 
     sysbus_init_mmio(sbd, &s->iomem);
 
@@ -13,6 +13,7 @@
 #include "qemu/error-report.h"
 #include "hw/misc/aspeed_hace.h"
 #include "qapi/error.h"
+#include "migration/blocker.h"
 #include "migration/vmstate.h"
 #include "crypto/hash.h"
 #include "hw/qdev-properties.h"
@@ -107,6 +108,10 @@ static bool has_padding(AspeedHACEState *s, struct iovec *iov,
                         hwaddr req_len, uint32_t *total_msg_len,
                         uint32_t *pad_offset)
 {
+    if (req_len < 8) {
+        return false;
+    }
+
     *total_msg_len = (uint32_t)(ldq_be_p(iov->iov_base + req_len - 8) / 8);
     /*
      * SG_LIST_LEN_LAST asserted in the request length doesn't mean it is the
@@ -123,6 +128,11 @@ static bool has_padding(AspeedHACEState *s, struct iovec *iov,
     if (*total_msg_len <= s->total_req_len) {
         uint32_t padding_size = s->total_req_len - *total_msg_len;
         uint8_t *padding = iov->iov_base;
+
+        if (padding_size > req_len) {
+            return false;
+        }
+
         *pad_offset = req_len - padding_size;
         if (padding[*pad_offset] == 0x80) {
             return true;
@@ -132,74 +142,158 @@ static bool has_padding(AspeedHACEState *s, struct iovec *iov,
     return false;
 }
 
-static int reconstruct_iov(AspeedHACEState *s, struct iovec *iov, int id,
-                           uint32_t *pad_offset)
-{
-    int i, iov_count;
-    if (*pad_offset != 0) {
-        s->iov_cache[s->iov_count].iov_base = iov[id].iov_base;
-        s->iov_cache[s->iov_count].iov_len = *pad_offset;
-        ++s->iov_count;
-    }
-    for (i = 0; i < s->iov_count; i++) {
-        iov[i].iov_base = s->iov_cache[i].iov_base;
-        iov[i].iov_len = s->iov_cache[i].iov_len;
-    }
-    iov_count = s->iov_count;
-    s->iov_count = 0;
-    s->total_req_len = 0;
-    return iov_count;
-}
-
 /**
- * Generate iov for accumulative mode.
+ * Feed one chunk of the message to the hash context.
+ *
+ * In accumulative mode, the chunks of a message are hashed as they
+ * arrive, in a context which is kept until the chunk holding the
+ * padding message is received. The padding itself is not hashed.
  *
  * @param s             aspeed hace state object
- * @param iov           iov of the current request
- * @param id            index of the current iov
- * @param req_len       length of the current request
+ * @param hash          hash context
+ * @param addr          DRAM address of the chunk
+ * @param len           length of the chunk
+ * @param acc_mode      accumulative mode
  *
- * @return count of iov
+ * @return true when the chunk completes the message
  */
-static int gen_acc_mode_iov(AspeedHACEState *s, struct iovec *iov, int id,
-                            hwaddr *req_len)
+static bool hash_update(AspeedHACEState *s, QCryptoHash *hash, hwaddr addr,
+                        hwaddr len, bool acc_mode)
 {
-    uint32_t pad_offset;
+    struct iovec iov;
+    hwaddr plen = len;
     uint32_t total_msg_len;
-    s->total_req_len += *req_len;
+    uint32_t pad_offset;
+    bool done = false;
+
+    iov.iov_base = address_space_map(&s->dram_as, addr, &plen, false,
+                                     MEMTXATTRS_UNSPECIFIED);
+    if (!iov.iov_base) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "aspeed_hace: failed to map dram @0x%" HWADDR_PRIx "\n",
+                      addr);
+        return false;
+    }
+    iov.iov_len = plen;
 
-    if (has_padding(s, &iov[id], *req_len, &total_msg_len, &pad_offset)) {
-        if (s->iov_count) {
-            return reconstruct_iov(s, iov, id, &pad_offset);
+    if (acc_mode) {
+        s->total_req_len += plen;
+
+        if (has_padding(s, &iov, plen, &total_msg_len, &pad_offset)) {
+            iov.iov_len = pad_offset;
+            s->total_req_len = 0;
+            done = true;
         }
+    }
 
-        *req_len -= s->total_req_len - total_msg_len;
-        s->total_req_len = 0;
-        iov[id].iov_len = *req_len;
-    } else {
-        s->iov_cache[s->iov_count].iov_base = iov->iov_base;
-        s->iov_cache[s->iov_count].iov_len = *req_len;
-        ++s->iov_count;
+    if (qcrypto_hash_updatev(hash, &iov, 1, NULL) < 0) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: qcrypto failed\n", __func__);
     }
 
-    return id + 1;
+    address_space_unmap(&s->dram_as, iov.iov_base, plen, false, plen);
+    return done;
+}
+
+static void hash_write_digest(AspeedHACEState *s, QCryptoHash *hash)
+{
+    g_autofree uint8_t *digest_buf = NULL;
+    size_t digest_len = 0;
+
+    if (qcrypto_hash_finalize_bytes(hash, &digest_buf, &digest_len,
+                                    NULL) < 0) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: qcrypto failed\n", __func__);
+        return;
+    }
+
+    if (address_space_write(&s->dram_as, s->regs[R_HASH_DEST],
+                            MEMTXATTRS_UNSPECIFIED,
+                            digest_buf, digest_len)) {
+        qemu_log_mask(LOG_GUEST_ERROR,
+                      "aspeed_hace: address space write failed\n");
+    }
+}
+
+/*
+ * The hash context of an accumulative operation cannot be migrated, block
+ * migration until the operation completes. If a migration is already
+ * running, pre_save fails it instead.
+ */
+static void hash_acc_block_migration(AspeedHACEState *s)
+{
+    Error *local_err = NULL;
+
+    if (s->migration_blocker) {
+        return;
+    }
+
+    error_setg(&s->migration_blocker,
+               TYPE_ASPEED_HACE ": accumulative hash operation in progress");
+    if (migrate_add_blocker(s->migration_blocker, &local_err) < 0) {
+        error_free(local_err);
+        error_free(s->migration_blocker);
+        s->migration_blocker = NULL;
+    }
+}
+
+static void hash_acc_reset(AspeedHACEState *s)
+{
+    qcrypto_hash_free(s->hash_ctx);
+    s->hash_ctx = NULL;
+    s->total_req_len = 0;
+
+    if (s->migration_blocker) {
+        migrate_del_blocker(s->migration_blocker);
+        error_free(s->migration_blocker);
+        s->migration_blocker = NULL;
+    }
 }
 
 static void do_hash_operation(AspeedHACEState *s, int algo, bool sg_mode,
                               bool acc_mode)
 {
-    struct iovec iov[ASPEED_HACE_MAX_SG];
-    g_autofree uint8_t *digest_buf;
-    size_t digest_len = 0;
-    int niov = 0;
+    g_autoptr(QCryptoHash) local_hash = NULL;
+    QCryptoHash *hash;
+    bool done = false;
     int i;
 
+    /*
+     * In aspeed sdk kernel driver, sg_mode is disabled in hash_final().
+     * Thus if we received a request with sg_mode disabled while an
+     * accumulative session is open, it belongs to the session.
+     */
+    if (!sg_mode && s->hash_ctx) {
+        acc_mode = true;
+    }
+
+    if (acc_mode) {
+        if (s->hash_ctx && s->hash_ctx->alg != algo) {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                          "aspeed_hace: hash algorithm changed during "
+                          "accumulative operation\n");
+            hash_acc_reset(s);
+        }
+        if (!s->hash_ctx) {
+            s->hash_ctx = qcrypto_hash_new(algo, NULL);
+            if (s->hash_ctx) {
+                hash_acc_block_migration(s);
+            }
+        }
+        hash = s->hash_ctx;
+    } else {
+        local_hash = qcrypto_hash_new(algo, NULL);
+        hash = local_hash;
+    }
+
+    if (!hash) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: qcrypto failed\n", __func__);
+        return;
+    }
+
     if (sg_mode) {
         uint32_t len = 0;
 
         for (i = 0; !(len & SG_LIST_LEN_LAST); i++) {
             uint32_t addr, src;
-            hwaddr plen;
 
             if (i == ASPEED_HACE_MAX_SG) {
                 qemu_log_mask(LOG_GUEST_ERROR,
@@ -216,62 +310,23 @@ static void do_hash_operation(AspeedHACEState *s, int algo, bool sg_mode,
                                         MEMTXATTRS_UNSPECIFIED, NULL);
             addr &= SG_LIST_ADDR_MASK;
 
-            plen = len & SG_LIST_LEN_MASK;
-            iov[i].iov_base = address_space_map(&s->dram_as, addr, &plen, false,
-                                                MEMTXATTRS_UNSPECIFIED);
-
-            if (acc_mode) {
-                niov = gen_acc_mode_iov(s, iov, i, &plen);
-
-            } else {
-                iov[i].iov_len = plen;
+            done = hash_update(s, hash, addr, len & SG_LIST_LEN_MASK,
+                               acc_mode);
+            if (done) {
+                break;
             }
         }
     } else {
-        hwaddr len = s->regs[R_HASH_SRC_LEN];
-
-        iov[0].iov_len = len;
-        iov[0].iov_base = address_space_map(&s->dram_as, s->regs[R_HASH_SRC],
-                                            &len, false,
-                                            MEMTXATTRS_UNSPECIFIED);
-        i = 1;
-
-        if (s->iov_count) {
-            /*
-             * In aspeed sdk kernel driver, sg_mode is disabled in hash_final().
-             * Thus if we received a request with sg_mode disabled, it is
-             * required to check whether cache is empty. If no, we should
-             * combine cached iov and the current iov.
-             */
-            uint32_t total_msg_len;
-            uint32_t pad_offset;
-            s->total_req_len += len;
-            if (has_padding(s, iov, len, &total_msg_len, &pad_offset)) {
-                niov = reconstruct_iov(s, iov, 0, &pad_offset);
-            }
-        }
-    }
-
-    if (niov) {
-        i = niov;
-    }
-
-    if (qcrypto_hash_bytesv(algo, iov, i, &digest_buf, &digest_len, NULL) < 0) {
-        qemu_log_mask(LOG_GUEST_ERROR, "%s: qcrypto failed\n", __func__);
-        return;
+        done = hash_update(s, hash, s->regs[R_HASH_SRC],
+                           s->regs[R_HASH_SRC_LEN], acc_mode);
     }
 
-    if (address_space_write(&s->dram_as, s->regs[R_HASH_DEST],
-                            MEMTXATTRS_UNSPECIFIED,
-                            digest_buf, digest_len)) {
-        qemu_log_mask(LOG_GUEST_ERROR,
-                      "aspeed_hace: address space write failed\n");
+    if (!acc_mode || done) {
+        hash_write_digest(s, hash);
     }
 
-    for (; i > 0; i--) {
-        address_space_unmap(&s->dram_as, iov[i - 1].iov_base,
-                            iov[i - 1].iov_len, false,
-                            iov[i - 1].iov_len);
+    if (acc_mode && done) {
+        hash_acc_reset(s);
     }
 
     /*
@@ -389,8 +444,7 @@ static void aspeed_hace_reset(DeviceState *dev)
     struct AspeedHACEState *s = ASPEED_HACE(dev);
 
     memset(s->regs, 0, sizeof(s->regs));
-    s->iov_count = 0;
-    s->total_req_len = 0;
+    hash_acc_reset(s);
 }
 
 static void aspeed_hace_realize(DeviceState *dev, Error **errp)
@@ -419,15 +473,27 @@ static Property aspeed_hace_properties[] = {
     DEFINE_PROP_END_OF_LIST(),
 };
 
+static int aspeed_hace_pre_save(void *opaque)
+{
+    AspeedHACEState *s = opaque;
+
+    if (s->hash_ctx) {
+        error_report(TYPE_ASPEED_HACE ": cannot migrate an accumulative "
+                     "hash operation in progress");
+        return -EBUSY;
+    }
+    return 0;
+}
 
 static const VMStateDescription vmstate_aspeed_hace = {
     .name = TYPE_ASPEED_HACE,
     .version_id = 1,
     .minimum_version_id = 1,
+    .pre_save = aspeed_hace_pre_save,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32_ARRAY(regs, AspeedHACEState, ASPEED_HACE_NR_REGS),
         VMSTATE_UINT32(total_req_len, AspeedHACEState),
-        VMSTATE_UINT32(iov_count, AspeedHACEState),
+        VMSTATE_UNUSED(4), /* was iov_count */
         VMSTATE_END_OF_LIST(),
     }
 };
@@ -176,6 +176,31 @@ static const struct aspeed_kcs_register_data aspeed_kcs_registers[] = {
     { },
 };
 
+static uint32_t aspeed_lpc_get_reg(AspeedLPCState *s, int reg)
+{
+    return register_ram_get(&s->regs, reg << 2);
+}
+
+static void aspeed_lpc_set_reg(AspeedLPCState *s, int reg, uint32_t value)
+{
+    register_ram_set(&s->regs, reg << 2, value);
+}
+
+/*
+ * The guest reads the registers directly from RAM, unless an input data
+ * register holds a byte: reading it clears IBF then.
+ */
+static void aspeed_lpc_update_direct_read(AspeedLPCState *s)
+{
+    bool ibf = false;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(aspeed_kcs_channel_map); i++) {
+        ibf |= aspeed_lpc_get_reg(s, aspeed_kcs_channel_map[i].str) & STR_IBF;
+    }
+    register_ram_set_direct_read(&s->regs, !ibf);
+}
+
 static const struct aspeed_kcs_register_data *
 aspeed_kcs_get_register_data_by_name(const char *name)
 {
@@ -221,11 +246,18 @@ static void aspeed_kcs_get_register_property(Object *obj,
         return;
     }
 
+    /* The registers live in RAM allocated at realize time */
+    if (!DEVICE(obj)->realized) {
+        error_setg(errp, "%s: the LPC controller is not realized", name);
+        return;
+    }
+
     if (!strncmp("odr", name, 3)) {
-        s->regs[data->chan->str] &= ~STR_OBF;
+        aspeed_lpc_set_reg(s, data->chan->str,
+                           aspeed_lpc_get_reg(s, data->chan->str) & ~STR_OBF);
     }
 
-    val = s->regs[data->reg];
+    val = aspeed_lpc_get_reg(s, data->reg);
 
     visit_type_uint32(v, name, &val, errp);
 }
@@ -234,12 +266,12 @@ static bool aspeed_kcs_channel_enabled(AspeedLPCState *s,
                                        const struct aspeed_kcs_channel *channel)
 {
     switch (channel->id) {
-    case kcs_channel_1: return s->regs[HICR0] & HICR0_LPC1E;
-    case kcs_channel_2: return s->regs[HICR0] & HICR0_LPC2E;
+    case kcs_channel_1: return aspeed_lpc_get_reg(s, HICR0) & HICR0_LPC1E;
+    case kcs_channel_2: return aspeed_lpc_get_reg(s, HICR0) & HICR0_LPC2E;
     case kcs_channel_3:
-        return (s->regs[HICR0] & HICR0_LPC3E) &&
-                    (s->regs[HICR4] & HICR4_KCSENBL);
-    case kcs_channel_4: return s->regs[HICRB] & HICRB_LPC4E;
+        return (aspeed_lpc_get_reg(s, HICR0) & HICR0_LPC3E) &&
+                    (aspeed_lpc_get_reg(s, HICR4) & HICR4_KCSENBL);
+    case kcs_channel_4: return aspeed_lpc_get_reg(s, HICRB) & HICRB_LPC4E;
     default: return false;
     }
 }
@@ -253,10 +285,10 @@ aspeed_kcs_channel_ibf_irq_enabled(AspeedLPCState *s,
     }
 
     switch (channel->id) {
-    case kcs_channel_1: return s->regs[HICR2] & HICR2_IBFIE1;
-    case kcs_channel_2: return s->regs[HICR2] & HICR2_IBFIE2;
-    case kcs_channel_3: return s->regs[HICR2] & HICR2_IBFIE3;
-    case kcs_channel_4: return s->regs[HICRB] & HICRB_IBFIE4;
+    case kcs_channel_1: return aspeed_lpc_get_reg(s, HICR2) & HICR2_IBFIE1;
+    case kcs_channel_2: return aspeed_lpc_get_reg(s, HICR2) & HICR2_IBFIE2;
+    case kcs_channel_3: return aspeed_lpc_get_reg(s, HICR2) & HICR2_IBFIE3;
+    case kcs_channel_4: return aspeed_lpc_get_reg(s, HICRB) & HICRB_IBFIE4;
     default: return false;
     }
 }
@@ -276,16 +308,25 @@ static void aspeed_kcs_set_register_property(Object *obj,
         return;
     }
 
+    /* The registers live in RAM allocated at realize time */
+    if (!DEVICE(obj)->realized) {
+        error_setg(errp, "%s: the LPC controller is not realized", name);
+        return;
+    }
+
     if (!visit_type_uint32(v, name, &val, errp)) {
         return;
     }
 
     if (strncmp("str", name, 3)) {
-        s->regs[data->reg] = val;
+        aspeed_lpc_set_reg(s, data->reg, val);
     }
 
     if (!strncmp("idr", name, 3)) {
-        s->regs[data->chan->str] |= STR_IBF;
+        /* Reading IDR clears IBF, trap it before setting IBF */
+        register_ram_set_direct_read(&s->regs, false);
+        aspeed_lpc_set_reg(s, data->chan->str,
+                           aspeed_lpc_get_reg(s, data->chan->str) | STR_IBF);
         if (aspeed_kcs_channel_ibf_irq_enabled(s, data->chan)) {
             enum aspeed_lpc_subdevice subdev;
 
@@ -313,7 +354,7 @@ static uint64_t aspeed_lpc_read(void *opaque, hwaddr offset, unsigned size)
     AspeedLPCState *s = ASPEED_LPC(opaque);
     int reg = TO_REG(offset);
 
-    if (reg >= ARRAY_SIZE(s->regs)) {
+    if (reg >= ASPEED_LPC_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds read at offset 0x%" HWADDR_PRIx "\n",
                       __func__, offset);
@@ -329,21 +370,23 @@ static uint64_t aspeed_lpc_read(void *opaque, hwaddr offset, unsigned size)
         const struct aspeed_kcs_channel *channel;
 
         channel = aspeed_kcs_get_channel_by_register(reg);
-        if (s->regs[channel->str] & STR_IBF) {
+        if (aspeed_lpc_get_reg(s, channel->str) & STR_IBF) {
             enum aspeed_lpc_subdevice subdev;
 
             subdev = aspeed_kcs_subdevice_map[channel->id];
             qemu_irq_lower(s->subdevice_irqs[subdev]);
         }
 
-        s->regs[channel->str] &= ~STR_IBF;
+        aspeed_lpc_set_reg(s, channel->str,
+                           aspeed_lpc_get_reg(s, channel->str) & ~STR_IBF);
+        aspeed_lpc_update_direct_read(s);
         break;
     }
     default:
         break;
     }
 
-    return s->regs[reg];
+    return register_ram_read(&s->regs, offset, size);
 }
 
 static void aspeed_lpc_write(void *opaque, hwaddr offset, uint64_t data,
@@ -352,7 +395,7 @@ static void aspeed_lpc_write(void *opaque, hwaddr offset, uint64_t data,
     AspeedLPCState *s = ASPEED_LPC(opaque);
     int reg = TO_REG(offset);
 
-    if (reg >= ARRAY_SIZE(s->regs)) {
+    if (reg >= ASPEED_LPC_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds write at offset 0x%" HWADDR_PRIx "\n",
                       __func__, offset);
@@ -365,23 +408,26 @@ static void aspeed_lpc_write(void *opaque, hwaddr offset, uint64_t data,
     case ODR2:
     case ODR3:
     case ODR4:
-        s->regs[aspeed_kcs_get_channel_by_register(reg)->str] |= STR_OBF;
+    {
+        int str = aspeed_kcs_get_channel_by_register(reg)->str;
+
+        aspeed_lpc_set_reg(s, str, aspeed_lpc_get_reg(s, str) | STR_OBF);
         break;
+    }
     default:
         break;
     }
 
-    s->regs[reg] = data;
+    register_ram_write(&s->regs, offset, data, size);
 }
 
-static const MemoryRegionOps aspeed_lpc_ops = {
+/*
+ * Only the output data registers have write side effects, the others are
+ * written directly.
+ */
+static const RegisterRAMOps aspeed_lpc_ops = {
     .read = aspeed_lpc_read,
     .write = aspeed_lpc_write,
-    .endianness = DEVICE_LITTLE_ENDIAN,
-    .valid = {
-        .min_access_size = 1,
-        .max_access_size = 4,
-    },
 };
 
 static void aspeed_lpc_reset(DeviceState *dev)
@@ -390,9 +436,10 @@ static void aspeed_lpc_reset(DeviceState *dev)
 
     s->subdevice_irqs_pending = 0;
 
-    memset(s->regs, 0, sizeof(s->regs));
+    register_ram_reset(&s->regs);
 
-    s->regs[HICR7] = s->hicr7;
+    aspeed_lpc_set_reg(s, HICR7, s->hicr7);
+    aspeed_lpc_update_direct_read(s);
 }
 
 static void aspeed_lpc_realize(DeviceState *dev, Error **errp)
@@ -407,10 +454,18 @@ static void aspeed_lpc_realize(DeviceState *dev, Error **errp)
     sysbus_init_irq(sbd, &s->subdevice_irqs[aspeed_lpc_kcs_4]);
     sysbus_init_irq(sbd, &s->subdevice_irqs[aspeed_lpc_ibt]);
 
-    memory_region_init_io(&s->iomem, OBJECT(s), &aspeed_lpc_ops, s,
-            TYPE_ASPEED_LPC, 0x1000);
+    if (!register_ram_init(&s->regs, OBJECT(s), &aspeed_lpc_ops, s,
+                           TYPE_ASPEED_LPC, ASPEED_LPC_SIZE, errp)) {
+        return;
+    }
+    register_ram_watch(&s->regs, ODR1 << 2, 4);
+    register_ram_watch(&s->regs, ODR2 << 2, 4);
+    register_ram_watch(&s->regs, ODR3 << 2, 4);
+    register_ram_watch(&s->regs, ODR4 << 2, 4);
+    register_ram_watch(&s->regs, ASPEED_LPC_NR_REGS << 2,
+                       ASPEED_LPC_SIZE - (ASPEED_LPC_NR_REGS << 2));
 
-    sysbus_init_mmio(sbd, &s->iomem);
+    sysbus_init_mmio(sbd, &s->regs.mr);
 
     qdev_init_gpio_in(dev, aspeed_lpc_set_irq, ASPEED_LPC_NR_SUBDEVS);
 }
@@ -443,12 +498,19 @@ static void aspeed_lpc_init(Object *obj)
                         aspeed_kcs_set_register_property, NULL, NULL);
 }
 
+static int aspeed_lpc_post_load(void *opaque, int version_id)
+{
+    aspeed_lpc_update_direct_read(opaque);
+    return 0;
+}
+
+/* The registers are migrated with the RAM */
 static const VMStateDescription vmstate_aspeed_lpc = {
     .name = TYPE_ASPEED_LPC,
-    .version_id = 2,
-    .minimum_version_id = 2,
+    .version_id = 3,
+    .minimum_version_id = 3,
+    .post_load = aspeed_lpc_post_load,
     .fields = (VMStateField[]) {
-        VMSTATE_UINT32_ARRAY(regs, AspeedLPCState, ASPEED_LPC_NR_REGS),
         VMSTATE_UINT32(subdevice_irqs_pending, AspeedLPCState),
         VMSTATE_END_OF_LIST(),
     }
@@ -19,27 +19,13 @@
 #define R_STATUS        (0x014 / 4)
 #define R_QSR           (0x040 / 4)
 
-static uint64_t aspeed_sbc_read(void *opaque, hwaddr addr, unsigned int size)
-{
-    AspeedSBCState *s = ASPEED_SBC(opaque);
-
-    addr >>= 2;
-
-    if (addr >= ASPEED_SBC_NR_REGS) {
-        qemu_log_mask(LOG_GUEST_ERROR,
-                      "%s: Out-of-bounds read at offset 0x%" HWADDR_PRIx "\n",
-                      __func__, addr << 2);
-        return 0;
-    }
-
-    return s->regs[addr];
-}
-
+/*
+ * Only the writes to the read only registers and out of bounds are
+ * handled here, the registers are otherwise plain storage.
+ */
 static void aspeed_sbc_write(void *opaque, hwaddr addr, uint64_t data,
                               unsigned int size)
 {
-    AspeedSBCState *s = ASPEED_SBC(opaque);
-
     addr >>= 2;
 
     if (addr >= ASPEED_SBC_NR_REGS) {
@@ -49,39 +35,24 @@ static void aspeed_sbc_write(void *opaque, hwaddr addr, uint64_t data,
         return;
     }
 
-    switch (addr) {
-    case R_STATUS:
-    case R_QSR:
-        qemu_log_mask(LOG_GUEST_ERROR,
-                      "%s: write to read only register 0x%" HWADDR_PRIx "\n",
-                      __func__, addr << 2);
-        return;
-    default:
-        break;
-    }
-
-    s->regs[addr] = data;
+    qemu_log_mask(LOG_GUEST_ERROR,
+                  "%s: write to read only register 0x%" HWADDR_PRIx "\n",
+                  __func__, addr << 2);
 }
 
-static const MemoryRegionOps aspeed_sbc_ops = {
-    .read = aspeed_sbc_read,
+static const RegisterRAMOps aspeed_sbc_ops = {
     .write = aspeed_sbc_write,
-    .endianness = DEVICE_LITTLE_ENDIAN,
-    .valid = {
-        .min_access_size = 1,
-        .max_access_size = 4,
-    },
 };
 
 static void aspeed_sbc_reset(DeviceState *dev)
 {
     struct AspeedSBCState *s = ASPEED_SBC(dev);
 
-    memset(s->regs, 0, sizeof(s->regs));
+    register_ram_reset(&s->regs);
 
     /* Set secure boot enabled with RSA4096_SHA256 and enable eMMC ABR */
-    s->regs[R_STATUS] = 0x000044C6;
-    s->regs[R_QSR] = 0x07C07C89;
+    register_ram_set(&s->regs, R_STATUS << 2, 0x000044C6);
+    register_ram_set(&s->regs, R_QSR << 2, 0x07C07C89);
 }
 
 static void aspeed_sbc_realize(DeviceState *dev, Error **errp)
@@ -89,18 +60,24 @@ static void aspeed_sbc_realize(DeviceState *dev, Error **errp)
     AspeedSBCState *s = ASPEED_SBC(dev);
     SysBusDevice *sbd = SYS_BUS_DEVICE(dev);
 
-    memory_region_init_io(&s->iomem, OBJECT(s), &aspeed_sbc_ops, s,
-            TYPE_ASPEED_SBC, 0x1000);
+    if (!register_ram_init(&s->regs, OBJECT(s), &aspeed_sbc_ops, s,
+                           TYPE_ASPEED_SBC, ASPEED_SBC_SIZE, errp)) {
+        return;
+    }
+    register_ram_watch(&s->regs, R_STATUS << 2, 4);
+    register_ram_watch(&s->regs, R_QSR << 2, 4);
+    register_ram_watch(&s->regs, ASPEED_SBC_NR_REGS << 2,
+                       ASPEED_SBC_SIZE - (ASPEED_SBC_NR_REGS << 2));
 
-    sysbus_init_mmio(sbd, &s->iomem);
+    sysbus_init_mmio(sbd, &s->regs.mr);
 }
 
+/* The registers are migrated with the RAM */
 static const VMStateDescription vmstate_aspeed_sbc = {
     .name = TYPE_ASPEED_SBC,
-    .version_id = 1,
-    .minimum_version_id = 1,
+    .version_id = 2,
+    .minimum_version_id = 2,
     .fields = (VMStateField[]) {
-        VMSTATE_UINT32_ARRAY(regs, AspeedSBCState, ASPEED_SBC_NR_REGS),
         VMSTATE_END_OF_LIST(),
     }
 };
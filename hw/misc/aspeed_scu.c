@@ -16,6 +16,7 @@
 #include "qapi/error.h"
 #include "qapi/visitor.h"
 #include "qemu/bitops.h"
+#include "qemu/lockable.h"
 #include "qemu/log.h"
 #include "qemu/guest-random.h"
 #include "qemu/module.h"
@@ -214,6 +215,8 @@ static uint32_t aspeed_scu_get_random(void)
 
 uint32_t aspeed_scu_get_apb_freq(AspeedSCUState *s)
 {
+    QEMU_LOCK_GUARD(&s->lock);
+
     return ASPEED_SCU_GET_CLASS(s)->get_apb(s);
 }
 
@@ -249,6 +252,8 @@ static uint64_t aspeed_scu_read(void *opaque, hwaddr offset, unsigned size)
     AspeedSCUState *s = ASPEED_SCU(opaque);
     int reg = TO_REG(offset);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (reg >= ASPEED_SCU_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds read at offset 0x%" HWADDR_PRIx "\n",
@@ -279,6 +284,8 @@ static void aspeed_ast2400_scu_write(void *opaque, hwaddr offset,
     AspeedSCUState *s = ASPEED_SCU(opaque);
     int reg = TO_REG(offset);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (reg >= ASPEED_SCU_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds write at offset 0x%" HWADDR_PRIx "\n",
@@ -318,6 +325,8 @@ static void aspeed_ast2500_scu_write(void *opaque, hwaddr offset,
     AspeedSCUState *s = ASPEED_SCU(opaque);
     int reg = TO_REG(offset);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (reg >= ASPEED_SCU_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds write at offset 0x%" HWADDR_PRIx "\n",
@@ -475,6 +484,8 @@ static void aspeed_scu_reset(DeviceState *dev)
     AspeedSCUState *s = ASPEED_SCU(dev);
     AspeedSCUClass *asc = ASPEED_SCU_GET_CLASS(dev);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     memcpy(s->regs, asc->resets, asc->nr_regs * 4);
     s->regs[SILICON_REV] = s->silicon_rev;
     s->regs[HW_STRAP1] = s->hw_strap1;
@@ -520,8 +531,10 @@ static void aspeed_scu_realize(DeviceState *dev, Error **errp)
         return;
     }
 
+    qemu_mutex_init(&s->lock);
     memory_region_init_io(&s->iomem, OBJECT(s), asc->ops, s,
                           TYPE_ASPEED_SCU, SCU_IO_REGION_SIZE);
+    memory_region_clear_global_locking(&s->iomem);
 
     sysbus_init_mmio(sbd, &s->iomem);
 }
@@ -613,6 +626,8 @@ static uint64_t aspeed_ast2600_scu_read(void *opaque, hwaddr offset,
     AspeedSCUState *s = ASPEED_SCU(opaque);
     int reg = TO_REG(offset);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (reg >= ASPEED_AST2600_SCU_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds read at offset 0x%" HWADDR_PRIx "\n",
@@ -648,6 +663,8 @@ static void aspeed_ast2600_scu_write(void *opaque, hwaddr offset,
     /* Truncate here so bitwise operations below behave as expected */
     uint32_t data = data64;
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     if (reg >= ASPEED_AST2600_SCU_NR_REGS) {
         qemu_log_mask(LOG_GUEST_ERROR,
                       "%s: Out-of-bounds write at offset 0x%" HWADDR_PRIx "\n",
@@ -744,6 +761,8 @@ static void aspeed_ast2600_scu_reset(DeviceState *dev)
     AspeedSCUState *s = ASPEED_SCU(dev);
     AspeedSCUClass *asc = ASPEED_SCU_GET_CLASS(dev);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     memcpy(s->regs, asc->resets, asc->nr_regs * 4);
 
     /*
@@ -800,6 +819,8 @@ static void aspeed_ast1030_scu_reset(DeviceState *dev)
     AspeedSCUState *s = ASPEED_SCU(dev);
     AspeedSCUClass *asc = ASPEED_SCU_GET_CLASS(dev);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     memcpy(s->regs, asc->resets, asc->nr_regs * 4);
 
     s->regs[AST2600_SILICON_REV] = AST1030_A1_SILICON_REV;
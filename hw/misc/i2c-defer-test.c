@@ -0,0 +1,174 @@
+/*
+ * I2C target deferring its answers, to test masters using the
+ * asynchronous I2C API
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * The device is a 256 byte memory. The first byte written after a start
+ * sets the offset, the next ones are stored from there and reads return
+ * the bytes from the offset on.
+ *
+ * Masters issuing i2c_async_*() transfers get each answer, for a start, a
+ * byte sent or received, a NACK or a stop, "delay" ns of virtual time
+ * after asking for it. The "deferred" property counts these operations.
+ * Other masters are answered at once.
+ *
+ *   -device i2c-defer-test,bus=aspeed.i2c.bus.0,address=0x40,delay=1000
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/module.h"
+#include "qemu/timer.h"
+#include "hw/i2c/i2c.h"
+#include "hw/qdev-properties.h"
+
+#define TYPE_I2C_DEFER_TEST "i2c-defer-test"
+OBJECT_DECLARE_SIMPLE_TYPE(I2CDeferTest, I2C_DEFER_TEST)
+
+struct I2CDeferTest {
+    I2CSlave parent;
+
+    I2CBus *bus;
+    QEMUTimer timer;
+    uint64_t delay;
+    uint32_t deferred;
+
+    uint8_t mem[256];
+    uint8_t offset;
+    bool has_offset;
+
+    /* Answer to the pending operation */
+    int ret;
+    uint8_t data;
+};
+
+static int i2c_defer_test_event(I2CSlave *i2c, enum i2c_event event)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(i2c);
+
+    if (event == I2C_START_SEND) {
+        s->has_offset = false;
+    }
+
+    return 0;
+}
+
+static int i2c_defer_test_send(I2CSlave *i2c, uint8_t data)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(i2c);
+
+    if (!s->has_offset) {
+        s->offset = data;
+        s->has_offset = true;
+    } else {
+        s->mem[s->offset++] = data;
+    }
+
+    return 0;
+}
+
+static uint8_t i2c_defer_test_recv(I2CSlave *i2c)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(i2c);
+
+    return s->mem[s->offset++];
+}
+
+static void i2c_defer_test_answer(I2CDeferTest *s, int ret, uint8_t data)
+{
+    s->ret = ret;
+    s->data = data;
+    s->deferred++;
+    timer_mod(&s->timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + s->delay);
+}
+
+static void i2c_defer_test_timer(void *opaque)
+{
+    I2CDeferTest *s = opaque;
+
+    i2c_async_complete(s->bus, s->ret, s->data);
+}
+
+static void i2c_defer_test_event_async(I2CSlave *i2c, enum i2c_event event)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(i2c);
+
+    i2c_defer_test_answer(s, i2c_defer_test_event(i2c, event), 0xff);
+}
+
+static void i2c_defer_test_send_async(I2CSlave *i2c, uint8_t data)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(i2c);
+
+    i2c_defer_test_answer(s, i2c_defer_test_send(i2c, data), 0xff);
+}
+
+static void i2c_defer_test_recv_async(I2CSlave *i2c)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(i2c);
+
+    i2c_defer_test_answer(s, 0, i2c_defer_test_recv(i2c));
+}
+
+static void i2c_defer_test_realize(DeviceState *dev, Error **errp)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(dev);
+
+    s->bus = I2C_BUS(qdev_get_parent_bus(dev));
+    timer_init_ns(&s->timer, QEMU_CLOCK_VIRTUAL, i2c_defer_test_timer, s);
+}
+
+static void i2c_defer_test_unrealize(DeviceState *dev)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(dev);
+
+    timer_del(&s->timer);
+}
+
+static void i2c_defer_test_init(Object *obj)
+{
+    I2CDeferTest *s = I2C_DEFER_TEST(obj);
+
+    object_property_add_uint32_ptr(obj, "deferred", &s->deferred,
+                                   OBJ_PROP_FLAG_READ);
+}
+
+static Property i2c_defer_test_props[] = {
+    DEFINE_PROP_UINT64("delay", I2CDeferTest, delay, 1000),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void i2c_defer_test_class_init(ObjectClass *oc, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(oc);
+    I2CSlaveClass *sc = I2C_SLAVE_CLASS(oc);
+
+    dc->realize = i2c_defer_test_realize;
+    dc->unrealize = i2c_defer_test_unrealize;
+    dc->desc = "I2C target deferring its answers, for tests";
+    device_class_set_props(dc, i2c_defer_test_props);
+
+    sc->event = i2c_defer_test_event;
+    sc->event_async = i2c_defer_test_event_async;
+    sc->send = i2c_defer_test_send;
+    sc->send_async = i2c_defer_test_send_async;
+    sc->recv = i2c_defer_test_recv;
+    sc->recv_async = i2c_defer_test_recv_async;
+}
+
+static const TypeInfo i2c_defer_test_info = {
+    .name = TYPE_I2C_DEFER_TEST,
+    .parent = TYPE_I2C_SLAVE,
+    .instance_size = sizeof(I2CDeferTest),
+    .instance_init = i2c_defer_test_init,
+    .class_init = i2c_defer_test_class_init,
+};
+
+static void i2c_defer_test_register_types(void)
+{
+    type_register_static(&i2c_defer_test_info);
+}
+
+type_init(i2c_defer_test_register_types)
@@ -1,5 +1,7 @@
 #include "qemu/osdep.h"
 #include "qemu/main-loop.h"
+#include "qemu/log.h"
+#include "qemu/bswap.h"
 #include "qapi/error.h"
 #include "hw/i2c/i2c.h"
 #include "hw/qdev-properties.h"
@@ -7,12 +9,60 @@
 #include "net/eth.h"
 #include "block/aio.h"
 
+/*
+ * Protocol version 1: one packet per I2C event, keyed on packet length, and
+ * an ACK packet round-trip for every byte.
+ */
 #define DATA_LEN 1
 #define ACK_LEN 2
 #define START_LEN 3
 #define STOP_LEN 4
 #define DEBUG 0
 
+/*
+ * Protocol version 2: a whole START..STOP transaction is carried in a single
+ * frame, and the peer answers with a single RESP frame once the transaction
+ * has completed on its bus. Frames are always longer than STOP_LEN, so they
+ * can never be mistaken for version 1 packets.
+ */
+#define I2C_NETDEV2_VERSION_BYTE  1
+#define I2C_NETDEV2_VERSION_FRAME 2
+
+#define I2C_NETDEV2_FRAME_WRITE 0x01 /* addr, data[len] */
+#define I2C_NETDEV2_FRAME_READ  0x02 /* addr, len bytes requested */
+#define I2C_NETDEV2_FRAME_RESP  0x80 /* status, data[len] (reads only) */
+
+#define I2C_NETDEV2_STATUS_ACK  0x00
+#define I2C_NETDEV2_STATUS_NACK 0x01 /* len is the number of bytes acked */
+
+/*
+ * READ frame flag, in the status field: the read goes on after these bytes,
+ * so the peer neither NACKs the last one nor stops. It keeps the transfer
+ * open until a READ frame without the flag, which may request no bytes.
+ * This lets the guest read byte by byte without knowing the length.
+ */
+#define I2C_NETDEV2_READ_CONT   0x01
+
+#define I2C_NETDEV2_MAX_XFER 4096
+
+typedef struct QEMU_PACKED I2CNetdev2FrameHdr {
+    uint8_t version;
+    uint8_t type;
+    uint8_t addr;       /* 7-bit address << 1 | R/W */
+    uint8_t status;
+    uint16_t len;       /* little endian */
+} I2CNetdev2FrameHdr;
+
+#define I2C_NETDEV2_FRAME_SIZE \
+    (sizeof(I2CNetdev2FrameHdr) + I2C_NETDEV2_MAX_XFER)
+
+typedef enum I2CNetdev2XferState {
+    I2C_NETDEV2_XFER_IDLE,
+    I2C_NETDEV2_XFER_WAIT_MASTER,
+    I2C_NETDEV2_XFER_DATA,
+    I2C_NETDEV2_XFER_READ_HOLD,     /* read left open by the peer */
+} I2CNetdev2XferState;
+
 #if !DEBUG
 #define printf(...)
 #endif
@@ -29,9 +79,27 @@ struct I2CNetdev2 {
     NICState *nic;
     QEMUBH *bh;
 
+    uint8_t version;
+
     uint8_t rx_buf[10];
     int rx_len;
     bool rx_ack_pending;
+
+    /* Version 2: transaction initiated by the guest, sent on I2C_FINISH */
+    uint8_t tx_frame[I2C_NETDEV2_FRAME_SIZE];
+    uint16_t tx_len;
+    bool tx_active;
+
+    /* Version 2: read initiated by the guest, left open on the peer */
+    bool read_open;
+    bool read_waiting;      /* for the RESP completing a deferred op */
+    unsigned resp_skip;     /* RESP frames of ended reads, not waited for */
+
+    /* Version 2: transaction initiated by the peer, replayed on our bus */
+    uint8_t rx_frame[I2C_NETDEV2_FRAME_SIZE];
+    uint16_t rx_frame_len;
+    uint16_t rx_frame_pos;
+    I2CNetdev2XferState xfer_state;
 };
 
 static void print_bytes(const uint8_t *buf, size_t len)
@@ -50,6 +118,19 @@ static void print_bytes(const uint8_t *buf, size_t len)
 
 static ssize_t i2c_netdev2_nic_receive(NetClientState *nc, const uint8_t *buf, size_t len);
 
+static bool i2c_netdev2_nic_can_receive(NetClientState *nc)
+{
+    I2CNetdev2 *s = I2C_NETDEV2(qemu_get_nic_opaque(nc));
+
+    /*
+     * Peer-initiated transactions are replayed one at a time; later frames
+     * stay queued in the net layer until the current one has completed,
+     * or until it waits for the peer to continue a read.
+     */
+    return s->xfer_state == I2C_NETDEV2_XFER_IDLE ||
+           s->xfer_state == I2C_NETDEV2_XFER_READ_HOLD;
+}
+
 static void i2c_netdev2_nic_cleanup(NetClientState *nc)
 {
     I2CNetdev2 *s = I2C_NETDEV2(qemu_get_nic_opaque(nc));
@@ -60,10 +141,247 @@ static void i2c_netdev2_nic_cleanup(NetClientState *nc)
 static NetClientInfo net_client_info = {
     .type = NET_CLIENT_DRIVER_NIC,
     .size = sizeof(NetClientState),
+    .can_receive = i2c_netdev2_nic_can_receive,
     .receive = i2c_netdev2_nic_receive,
     .cleanup = i2c_netdev2_nic_cleanup,
 };
 
+/*
+ * Fills in the header of @frame and sends it along with @payload_len bytes of
+ * data. For READ and write RESP frames, @len is a byte count and there is no
+ * payload.
+ */
+static void i2c_netdev2_send_frame(I2CNetdev2 *s, uint8_t *frame, uint8_t type,
+                                   uint8_t addr, uint8_t status, uint16_t len,
+                                   uint16_t payload_len)
+{
+    I2CNetdev2FrameHdr *hdr = (I2CNetdev2FrameHdr *)frame;
+
+    hdr->version = I2C_NETDEV2_VERSION_FRAME;
+    hdr->type = type;
+    hdr->addr = addr;
+    hdr->status = status;
+    hdr->len = cpu_to_le16(len);
+
+    qemu_send_packet(qemu_get_queue(s->nic), frame,
+                     sizeof(*hdr) + payload_len);
+}
+
+static void i2c_netdev2_xfer_done(I2CNetdev2 *s, uint8_t status, uint16_t len)
+{
+    I2CNetdev2FrameHdr *hdr = (I2CNetdev2FrameHdr *)s->rx_frame;
+    bool is_read = hdr->addr & 1;
+
+    /*
+     * A failed start may already have ended the transfer and handed the bus
+     * over to the next pending master.
+     */
+    if (s->bus->bh == s->bh) {
+        i2c_bus_release(s->bus);
+        i2c_end_transfer(s->bus);
+    }
+
+    /* The RESP frame is built in place, read data is already there */
+    i2c_netdev2_send_frame(s, s->rx_frame, I2C_NETDEV2_FRAME_RESP, hdr->addr,
+                           status, len, is_read ? len : 0);
+
+    s->xfer_state = I2C_NETDEV2_XFER_IDLE;
+    qemu_flush_queued_packets(qemu_get_queue(s->nic));
+}
+
+static bool i2c_netdev2_target_is_async(I2CNetdev2 *s)
+{
+    I2CNode *node = QLIST_FIRST(&s->bus->current_devs);
+
+    return node && I2C_SLAVE_GET_CLASS(node->elt)->send_async;
+}
+
+static void i2c_netdev2_frame_read(I2CNetdev2 *s, uint8_t addr, uint16_t len)
+{
+    I2CNetdev2FrameHdr *hdr = (I2CNetdev2FrameHdr *)s->rx_frame;
+    uint8_t *data = s->rx_frame + sizeof(*hdr);
+    bool cont = hdr->status & I2C_NETDEV2_READ_CONT;
+    uint16_t i;
+
+    if (s->xfer_state != I2C_NETDEV2_XFER_READ_HOLD &&
+        i2c_start_recv(s->bus, addr)) {
+        i2c_netdev2_xfer_done(s, I2C_NETDEV2_STATUS_NACK, 0);
+        return;
+    }
+
+    for (i = 0; i < len; i++) {
+        data[i] = i2c_recv(s->bus);
+    }
+
+    if (cont) {
+        /* Keep the bus until the peer ends the read */
+        s->xfer_state = I2C_NETDEV2_XFER_READ_HOLD;
+        i2c_netdev2_send_frame(s, s->rx_frame, I2C_NETDEV2_FRAME_RESP,
+                               hdr->addr, I2C_NETDEV2_STATUS_ACK, len, len);
+        qemu_flush_queued_packets(qemu_get_queue(s->nic));
+        return;
+    }
+    i2c_nack(s->bus);
+
+    i2c_netdev2_xfer_done(s, I2C_NETDEV2_STATUS_ACK, len);
+}
+
+/* Ends a read the peer left open without ending it */
+static void i2c_netdev2_end_hold(I2CNetdev2 *s)
+{
+    qemu_log_mask(LOG_GUEST_ERROR, "%s: peer did not end its read\n",
+                  TYPE_I2C_NETDEV2);
+    i2c_nack(s->bus);
+    i2c_bus_release(s->bus);
+    i2c_end_transfer(s->bus);
+    s->xfer_state = I2C_NETDEV2_XFER_IDLE;
+}
+
+/*
+ * Replays a peer-initiated transaction on our bus. Slaves with a send_async
+ * handler ack each byte with i2c_ack(), which reschedules this bh; other
+ * slaves are driven synchronously.
+ */
+static void i2c_netdev2_frame_bh(I2CNetdev2 *s)
+{
+    I2CNetdev2FrameHdr *hdr = (I2CNetdev2FrameHdr *)s->rx_frame;
+    uint8_t *data = s->rx_frame + sizeof(*hdr);
+    uint8_t addr = hdr->addr >> 1;
+    uint8_t b;
+
+    switch (s->xfer_state) {
+    case I2C_NETDEV2_XFER_IDLE:
+    case I2C_NETDEV2_XFER_READ_HOLD:
+        return;
+    case I2C_NETDEV2_XFER_WAIT_MASTER:
+        if (hdr->type == I2C_NETDEV2_FRAME_READ) {
+            i2c_netdev2_frame_read(s, addr, s->rx_frame_len);
+            return;
+        }
+
+        if (i2c_start_send(s->bus, addr)) {
+            i2c_netdev2_xfer_done(s, I2C_NETDEV2_STATUS_NACK, 0);
+            return;
+        }
+
+        s->rx_frame_pos = 0;
+        s->xfer_state = I2C_NETDEV2_XFER_DATA;
+        if (i2c_netdev2_target_is_async(s)) {
+            /* Wait for the slave to ack the address byte */
+            return;
+        }
+        /* fallthrough */
+    case I2C_NETDEV2_XFER_DATA:
+        while (s->rx_frame_pos < s->rx_frame_len) {
+            b = data[s->rx_frame_pos++];
+            if (i2c_send_async(s->bus, b) == 0) {
+                return;
+            }
+            if (i2c_send(s->bus, b)) {
+                i2c_netdev2_xfer_done(s, I2C_NETDEV2_STATUS_NACK,
+                                      s->rx_frame_pos - 1);
+                return;
+            }
+        }
+        i2c_netdev2_xfer_done(s, I2C_NETDEV2_STATUS_ACK, s->rx_frame_len);
+        break;
+    }
+}
+
+/*
+ * Completes the deferred start or recv of a guest read with the RESP frame
+ * of the peer.
+ */
+static void i2c_netdev2_read_resp(I2CNetdev2 *s, const I2CNetdev2FrameHdr *hdr,
+                                  const uint8_t *data)
+{
+    uint16_t len = le16_to_cpu(hdr->len);
+
+    if (s->resp_skip) {
+        s->resp_skip--;
+        return;
+    }
+    if (!s->read_waiting) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: unexpected read response\n",
+                      TYPE_I2C_NETDEV2);
+        return;
+    }
+    s->read_waiting = false;
+
+    if (hdr->status != I2C_NETDEV2_STATUS_ACK) {
+        /* The peer has ended the transfer */
+        s->read_open = false;
+        i2c_async_complete(s->bus, -1, 0xff);
+        return;
+    }
+    s->read_open = true;
+    i2c_async_complete(s->bus, 0, len ? data[0] : 0xff);
+}
+
+static ssize_t i2c_netdev2_frame_receive(I2CNetdev2 *s, const uint8_t *buf,
+                                         size_t len)
+{
+    const I2CNetdev2FrameHdr *hdr = (const I2CNetdev2FrameHdr *)buf;
+    uint16_t data_len;
+
+    if (len < sizeof(*hdr) || hdr->version != I2C_NETDEV2_VERSION_FRAME) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: dropping invalid frame, len=%zu\n",
+                      TYPE_I2C_NETDEV2, len);
+        return len;
+    }
+
+    data_len = le16_to_cpu(hdr->len);
+    if (data_len > I2C_NETDEV2_MAX_XFER ||
+        ((hdr->type == I2C_NETDEV2_FRAME_WRITE ||
+          (hdr->type == I2C_NETDEV2_FRAME_RESP && (hdr->addr & 1))) &&
+         len < sizeof(*hdr) + data_len)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: truncated frame, len=%zu\n",
+                      TYPE_I2C_NETDEV2, len);
+        return len;
+    }
+
+    switch (hdr->type) {
+    case I2C_NETDEV2_FRAME_WRITE:
+    case I2C_NETDEV2_FRAME_READ:
+        if (s->xfer_state == I2C_NETDEV2_XFER_READ_HOLD &&
+            hdr->type != I2C_NETDEV2_FRAME_READ) {
+            i2c_netdev2_end_hold(s);
+        }
+        memcpy(s->rx_frame, buf, MIN(len, sizeof(s->rx_frame)));
+        /* Keep the R/W bit consistent with the frame type */
+        s->rx_frame[offsetof(I2CNetdev2FrameHdr, addr)] &= ~1;
+        if (hdr->type == I2C_NETDEV2_FRAME_READ) {
+            s->rx_frame[offsetof(I2CNetdev2FrameHdr, addr)] |= 1;
+        }
+        s->rx_frame_len = data_len;
+        if (s->xfer_state == I2C_NETDEV2_XFER_READ_HOLD) {
+            /* The bus is still ours */
+            i2c_netdev2_frame_read(s, hdr->addr >> 1, data_len);
+            break;
+        }
+        s->xfer_state = I2C_NETDEV2_XFER_WAIT_MASTER;
+        i2c_bus_master(s->bus, s->bh);
+        break;
+    case I2C_NETDEV2_FRAME_RESP:
+        if (hdr->addr & 1) {
+            i2c_netdev2_read_resp(s, hdr, buf + sizeof(*hdr));
+            break;
+        }
+        if (hdr->status != I2C_NETDEV2_STATUS_ACK) {
+            qemu_log_mask(LOG_GUEST_ERROR,
+                          "%s: peer NACKed transfer to 0x%02x after %u bytes\n",
+                          TYPE_I2C_NETDEV2, hdr->addr >> 1, data_len);
+        }
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: unknown frame type 0x%02x\n",
+                      TYPE_I2C_NETDEV2, hdr->type);
+        break;
+    }
+
+    return len;
+}
+
 static ssize_t i2c_netdev2_nic_receive(NetClientState *nc, const uint8_t *buf, size_t len)
 {
     printf("%s: rx ", __FILE__);
@@ -72,6 +390,10 @@ static ssize_t i2c_netdev2_nic_receive(NetClientState *nc, const uint8_t *buf, s
 
     I2CNetdev2 *s = I2C_NETDEV2(qemu_get_nic_opaque(nc));
 
+    if (s->version == I2C_NETDEV2_VERSION_FRAME) {
+        return i2c_netdev2_frame_receive(s, buf, len);
+    }
+
     if (len == ACK_LEN) {
         return len;
     }
@@ -113,6 +435,11 @@ static void i2c_netdev2_slave_mode_rx(void *opaque)
     uint8_t rx_addr;
     uint8_t ack[2] = {1, 0};
 
+    if (s->version == I2C_NETDEV2_VERSION_FRAME) {
+        i2c_netdev2_frame_bh(s);
+        return;
+    }
+
     printf("%s: rx_len=%d\n", __func__, s->rx_len);
 
     if (s->rx_ack_pending) {
@@ -156,10 +483,91 @@ static void i2c_netdev2_realize(DeviceState *dev, Error **errp)
 {
     I2CNetdev2 *s = I2C_NETDEV2(dev);
 
+    if (s->version != I2C_NETDEV2_VERSION_BYTE &&
+        s->version != I2C_NETDEV2_VERSION_FRAME) {
+        error_setg(errp, "%s: unsupported protocol version %u",
+                   TYPE_I2C_NETDEV2, s->version);
+        return;
+    }
+
     s->bus = I2C_BUS(qdev_get_parent_bus(dev));
     s->nic = qemu_new_nic(&net_client_info, &s->nic_conf, TYPE_I2C_NETDEV2, dev->id, s);
     s->bh = qemu_bh_new(i2c_netdev2_slave_mode_rx, s);
     s->rx_len = 0;
+    s->tx_len = 0;
+    s->tx_active = false;
+    s->read_open = false;
+    s->read_waiting = false;
+    s->resp_skip = 0;
+    s->xfer_state = I2C_NETDEV2_XFER_IDLE;
+}
+
+static void i2c_netdev2_flush_tx(I2CNetdev2 *s)
+{
+    if (!s->tx_active) {
+        return;
+    }
+
+    i2c_netdev2_send_frame(s, s->tx_frame, I2C_NETDEV2_FRAME_WRITE,
+                           s->parent.address << 1, 0, s->tx_len, s->tx_len);
+    s->tx_active = false;
+    s->tx_len = 0;
+}
+
+static void i2c_netdev2_send_read(I2CNetdev2 *s, uint16_t len, bool cont)
+{
+    uint8_t frame[sizeof(I2CNetdev2FrameHdr)];
+
+    i2c_netdev2_send_frame(s, frame, I2C_NETDEV2_FRAME_READ,
+                           s->parent.address << 1 | 1,
+                           cont ? I2C_NETDEV2_READ_CONT : 0, len, 0);
+}
+
+/* Ends the guest read left open on the peer, if any */
+static void i2c_netdev2_end_read(I2CNetdev2 *s)
+{
+    if (!s->read_open) {
+        return;
+    }
+
+    i2c_netdev2_send_read(s, 0, false);
+    s->read_open = false;
+    s->resp_skip++;
+}
+
+static int i2c_netdev2_frame_event(I2CNetdev2 *s, enum i2c_event event)
+{
+    switch (event) {
+    case I2C_START_SEND:
+        /* A repeated start ends the previous write segment or read */
+        i2c_netdev2_flush_tx(s);
+        i2c_netdev2_end_read(s);
+        s->tx_active = true;
+        s->tx_len = 0;
+        break;
+    case I2C_FINISH:
+        i2c_netdev2_flush_tx(s);
+        i2c_netdev2_end_read(s);
+        break;
+    case I2C_START_RECV:
+        /*
+         * The peer's answer cannot be waited for from a synchronous
+         * handler, so reads are NACKed unless the master lets us defer
+         * them, see i2c_netdev2_event_async(). Reads issued by the peer
+         * are served from our bus with READ frames.
+         */
+        i2c_netdev2_flush_tx(s);
+        i2c_netdev2_end_read(s);
+        qemu_log_mask(LOG_UNIMP, "%s: synchronous guest read from 0x%02x "
+                      "not supported\n", TYPE_I2C_NETDEV2, s->parent.address);
+        return -1;
+    case I2C_NACK:
+        /* The master reads no more */
+        i2c_netdev2_end_read(s);
+        break;
+    }
+
+    return 0;
 }
 
 static int i2c_netdev2_handle_event(I2CSlave *i2c, enum i2c_event event)
@@ -170,6 +578,10 @@ static int i2c_netdev2_handle_event(I2CSlave *i2c, enum i2c_event event)
     uint8_t start_msg[START_LEN];
     uint8_t stop_msg[STOP_LEN];
 
+    if (s->version == I2C_NETDEV2_VERSION_FRAME) {
+        return i2c_netdev2_frame_event(s, event);
+    }
+
     // printf("%s: %d\n", __func__, event);
 
     switch (event) {
@@ -204,16 +616,66 @@ static int i2c_netdev2_handle_event(I2CSlave *i2c, enum i2c_event event)
 
 static uint8_t i2c_netdev2_handle_recv(I2CSlave *i2c)
 {
+    I2CNetdev2 *s = I2C_NETDEV2(i2c);
+
+    if (s->version == I2C_NETDEV2_VERSION_FRAME) {
+        /* Only reached after a NACKed start */
+        return 0xff;
+    }
+
     printf("%s: unimplemented\n", __func__);
     abort();
 }
 
+/*
+ * Guest reads are forwarded to the peer one step at a time: the start,
+ * then each byte, are READ frames that leave the transfer open on the
+ * peer, and are completed by its RESP frames.
+ */
+static void i2c_netdev2_event_async(I2CSlave *i2c, enum i2c_event event)
+{
+    I2CNetdev2 *s = I2C_NETDEV2(i2c);
+
+    if (s->version != I2C_NETDEV2_VERSION_FRAME ||
+        event != I2C_START_RECV) {
+        i2c_async_complete(s->bus, i2c_netdev2_handle_event(i2c, event),
+                           0xff);
+        return;
+    }
+
+    i2c_netdev2_flush_tx(s);
+    i2c_netdev2_end_read(s);
+    i2c_netdev2_send_read(s, 0, true);
+    s->read_waiting = true;
+}
+
+static void i2c_netdev2_recv_async(I2CSlave *i2c)
+{
+    I2CNetdev2 *s = I2C_NETDEV2(i2c);
+
+    if (s->version != I2C_NETDEV2_VERSION_FRAME || !s->read_open) {
+        i2c_async_complete(s->bus, 0, i2c_netdev2_handle_recv(i2c));
+        return;
+    }
+
+    i2c_netdev2_send_read(s, 1, true);
+    s->read_waiting = true;
+}
+
 static int i2c_netdev2_handle_send(I2CSlave *i2c, uint8_t byte)
 {
     I2CNetdev2 *s = I2C_NETDEV2(i2c);
     NetClientState *netdev = qemu_get_queue(s->nic);
     uint8_t data_msg[DATA_LEN] = {byte};
 
+    if (s->version == I2C_NETDEV2_VERSION_FRAME) {
+        if (!s->tx_active || s->tx_len >= I2C_NETDEV2_MAX_XFER) {
+            return -1;
+        }
+        s->tx_frame[sizeof(I2CNetdev2FrameHdr) + s->tx_len++] = byte;
+        return 0;
+    }
+
     qemu_send_packet(netdev, data_msg, sizeof(data_msg));
     printf("%s: tx ", __FILE__);
     print_bytes(data_msg, sizeof(data_msg));
@@ -225,6 +687,8 @@ static int i2c_netdev2_handle_send(I2CSlave *i2c, uint8_t byte)
 
 static Property i2c_netdev2_props[] = {
     DEFINE_NIC_PROPERTIES(I2CNetdev2, nic_conf),
+    DEFINE_PROP_UINT8("protocol-version", I2CNetdev2, version,
+                      I2C_NETDEV2_VERSION_BYTE),
     DEFINE_PROP_END_OF_LIST(),
 };
 
@@ -239,6 +703,8 @@ static void i2c_netdev2_class_init(ObjectClass *cls, void *data)
     sc->event = i2c_netdev2_handle_event;
     sc->recv = i2c_netdev2_handle_recv;
     sc->send = i2c_netdev2_handle_send;
+    sc->event_async = i2c_netdev2_event_async;
+    sc->recv_async = i2c_netdev2_recv_async;
 }
 
 static const TypeInfo i2c_netdev2 = {
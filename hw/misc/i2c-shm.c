@@ -0,0 +1,871 @@
+/*
+ * I2C bus bridge between two local QEMU processes over shared memory
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * This code is licensed under the GPL version 2 or later.  See the
+ * COPYING file in the top-level directory.
+ *
+ * The device sits on an I2C bus at the address of a device of the peer.
+ * Transfers the guest addresses to it are forwarded to the peer, which
+ * replays them on its own bus. Transfers the peer forwards to us are
+ * replayed on our bus the same way.
+ *
+ * Each side allocates an inbox, a shared memory region holding two rings
+ * of messages written by the peer: one for the transfers to replay and one
+ * for the answers to our own reads. Each side also has an event notifier
+ * the peer rings when it adds messages to an empty ring. The inbox and
+ * notifier file descriptors are exchanged over a UNIX socket chardev when
+ * the two sides connect, after which the socket is not used anymore.
+ *
+ *   -chardev socket,id=i2c0,path=/tmp/i2c0.sock,server=on,wait=off
+ *   -device i2c-shm,bus=aspeed.i2c.bus.0,address=0x20,chardev=i2c0
+ *
+ * Writes are posted: a whole write segment is sent as one message when the
+ * transfer stops or restarts, and the guest does not wait for the peer.
+ * Reads wait for the peer and need a master that uses the asynchronous
+ * I2C API; other masters get a NAK.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/error-report.h"
+#include "qemu/event_notifier.h"
+#include "qemu/log.h"
+#include "qemu/main-loop.h"
+#include "qemu/memfd.h"
+#include "qemu/module.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+#include "chardev/char-fe.h"
+#include "hw/i2c/i2c.h"
+#include "hw/misc/i2c-shm.h"
+#include "hw/qdev-properties.h"
+#include "hw/qdev-properties-system.h"
+#include "trace.h"
+
+typedef enum I2CShmReplayState {
+    I2C_SHM_REPLAY_IDLE,
+    I2C_SHM_REPLAY_WAIT_MASTER,
+    I2C_SHM_REPLAY_MASTER,
+    I2C_SHM_REPLAY_BUSY,        /* waiting for the target */
+} I2CShmReplayState;
+
+#define TYPE_I2C_SHM "i2c-shm"
+OBJECT_DECLARE_SIMPLE_TYPE(I2CShm, I2C_SHM)
+
+struct I2CShm {
+    I2CSlave parent;
+
+    I2CBus *bus;
+    CharBackend chr;
+    uint32_t timeout_ms;
+
+    I2CShmInbox *inbox;
+    int inbox_fd;
+    EventNotifier notifier;
+
+    I2CShmInbox *peer;
+    EventNotifier peer_notifier;
+    bool connected;
+
+    I2CShmHello hello;
+    int hello_len;
+
+    /* Transfer initiated by the guest, forwarded to the peer */
+    I2CShmMsg tx_msg;
+    bool tx_active;
+    bool tx_cont;
+    bool tx_blocked;            /* FINISH waits for room in the peer ring */
+    bool rx_waiting;            /* waiting for a RESP */
+    uint16_t seq;
+    QEMUTimer timeout;
+
+    /* Transfer initiated by the peer, replayed on our bus */
+    QEMUBH *bh;
+    I2CShmReplayState replay_state;
+    /* Copy of the request being replayed, the peer owns the slot */
+    I2CShmMsg replay_msg;
+    bool replay_loaded;
+    bool replay_issued;         /* the current message was replayed */
+    bool replay_stopped;
+    uint16_t replay_pos;
+    int replay_ret;
+    uint8_t replay_data;
+};
+
+static I2CShmMsg *i2c_shm_ring_peek(I2CShmRing *r)
+{
+    if (r->tail == qatomic_load_acquire(&r->head)) {
+        return NULL;
+    }
+
+    return &r->slots[r->tail % I2C_SHM_RING_SLOTS];
+}
+
+/* Returns true if the producer waits for room */
+static bool i2c_shm_ring_pop(I2CShmRing *r)
+{
+    qatomic_store_release(&r->tail, r->tail + 1);
+    /* Pairs with the barrier in i2c_shm_ring_push() */
+    smp_mb();
+
+    return qatomic_xchg(&r->blocked, 0);
+}
+
+static I2CShmMsg *i2c_shm_ring_reserve(I2CShmRing *r)
+{
+    if (r->head - qatomic_load_acquire(&r->tail) >= I2C_SHM_RING_SLOTS) {
+        qatomic_set(&r->blocked, 1);
+        smp_mb();
+        if (r->head - qatomic_read(&r->tail) >= I2C_SHM_RING_SLOTS) {
+            return NULL;
+        }
+        qatomic_set(&r->blocked, 0);
+    }
+
+    return &r->slots[r->head % I2C_SHM_RING_SLOTS];
+}
+
+/*
+ * Publishes the reserved slot. Returns true if the ring was empty, in which
+ * case the consumer may be idle and needs a doorbell. Otherwise it has yet
+ * to update the tail, and will find the new message when it rereads the
+ * head.
+ */
+static bool i2c_shm_ring_push(I2CShmRing *r)
+{
+    uint32_t head = r->head;
+
+    qatomic_store_release(&r->head, head + 1);
+    /* Pairs with the barrier in i2c_shm_ring_pop() */
+    smp_mb();
+
+    return qatomic_read(&r->tail) == head;
+}
+
+/* Copies @msg to a ring of the peer. Returns false if it is full. */
+static bool i2c_shm_send(I2CShm *s, I2CShmRing *r, const I2CShmMsg *msg)
+{
+    I2CShmMsg *slot;
+
+    if (!s->connected) {
+        return false;
+    }
+
+    slot = i2c_shm_ring_reserve(r);
+    if (!slot) {
+        return false;
+    }
+
+    memcpy(slot, msg, offsetof(I2CShmMsg, data) + msg->len);
+    trace_i2c_shm_send(s->parent.address, msg->type, msg->addr, msg->len);
+    if (i2c_shm_ring_push(r)) {
+        event_notifier_set(&s->peer_notifier);
+    }
+
+    return true;
+}
+
+static bool i2c_shm_post(I2CShm *s, uint8_t type, uint8_t addr)
+{
+    I2CShmMsg msg = {
+        .type = type,
+        .addr = addr,
+        .seq = ++s->seq,
+    };
+
+    return i2c_shm_send(s, &s->peer->req, &msg);
+}
+
+/*
+ * Guest side
+ */
+
+static void i2c_shm_wait_resp(I2CShm *s)
+{
+    s->rx_waiting = true;
+    if (s->timeout_ms) {
+        timer_mod(&s->timeout, qemu_clock_get_ms(QEMU_CLOCK_REALTIME) +
+                  s->timeout_ms);
+    }
+}
+
+static void i2c_shm_complete(I2CShm *s, int ret, uint8_t data)
+{
+    s->rx_waiting = false;
+    s->tx_blocked = false;
+    timer_del(&s->timeout);
+    i2c_async_complete(s->bus, ret, data);
+}
+
+static void i2c_shm_timeout(void *opaque)
+{
+    I2CShm *s = opaque;
+
+    qemu_log_mask(LOG_GUEST_ERROR, "%s: 0x%02x: peer did not answer\n",
+                  TYPE_I2C_SHM, s->parent.address);
+    s->tx_active = false;
+    i2c_shm_complete(s, -1, 0xff);
+}
+
+/*
+ * Sends the pending write segment. Returns false if the peer ring is full,
+ * the segment is then kept for a later attempt.
+ */
+static bool i2c_shm_flush_tx(I2CShm *s, bool stop)
+{
+    if (!s->tx_active) {
+        return true;
+    }
+
+    s->tx_msg.type = I2C_SHM_MSG_WRITE;
+    s->tx_msg.addr = s->parent.address << 1;
+    s->tx_msg.flags = (s->tx_cont ? I2C_SHM_F_CONT : 0) |
+                      (stop ? I2C_SHM_F_STOP : 0);
+    s->tx_msg.seq = ++s->seq;
+    if (!i2c_shm_send(s, &s->peer->req, &s->tx_msg)) {
+        return false;
+    }
+
+    s->tx_active = false;
+    return true;
+}
+
+static void i2c_shm_start_send(I2CShm *s)
+{
+    s->tx_msg.len = 0;
+    s->tx_active = true;
+    s->tx_cont = false;
+}
+
+static int i2c_shm_event(I2CSlave *i2c, enum i2c_event event)
+{
+    I2CShm *s = I2C_SHM(i2c);
+
+    if (!s->connected) {
+        return event == I2C_START_SEND || event == I2C_START_RECV ? -1 : 0;
+    }
+
+    switch (event) {
+    case I2C_START_SEND:
+        /* A repeated start ends the previous write segment */
+        if (!i2c_shm_flush_tx(s, false)) {
+            return -1;
+        }
+        i2c_shm_start_send(s);
+        break;
+    case I2C_START_RECV:
+        /* The answer of the peer cannot be waited for */
+        qemu_log_mask(LOG_UNIMP, "%s: 0x%02x: synchronous read not supported\n",
+                      TYPE_I2C_SHM, s->parent.address);
+        i2c_shm_flush_tx(s, false);
+        return -1;
+    case I2C_NACK:
+        i2c_shm_post(s, I2C_SHM_MSG_NACK, s->parent.address << 1 | 1);
+        break;
+    case I2C_FINISH:
+        if (s->tx_active) {
+            if (!i2c_shm_flush_tx(s, true)) {
+                qemu_log_mask(LOG_GUEST_ERROR, "%s: 0x%02x: peer ring full, "
+                              "dropping write\n", TYPE_I2C_SHM,
+                              s->parent.address);
+                s->tx_active = false;
+            }
+        } else {
+            i2c_shm_post(s, I2C_SHM_MSG_STOP, s->parent.address << 1);
+        }
+        break;
+    }
+
+    return 0;
+}
+
+static void i2c_shm_event_async(I2CSlave *i2c, enum i2c_event event)
+{
+    I2CShm *s = I2C_SHM(i2c);
+    I2CShmMsg msg = {
+        .type = I2C_SHM_MSG_START,
+        .addr = s->parent.address << 1 | 1,
+    };
+
+    if (!s->connected) {
+        i2c_async_complete(s->bus, i2c_shm_event(i2c, event), 0xff);
+        return;
+    }
+
+    switch (event) {
+    case I2C_START_RECV:
+        /*
+         * The segment is sent ahead of the start, so the peer always has
+         * room for it once the start has been queued.
+         */
+        if (!i2c_shm_flush_tx(s, false)) {
+            i2c_async_complete(s->bus, -1, 0xff);
+            return;
+        }
+        msg.seq = ++s->seq;
+        if (!i2c_shm_send(s, &s->peer->req, &msg)) {
+            i2c_async_complete(s->bus, -1, 0xff);
+            return;
+        }
+        i2c_shm_wait_resp(s);
+        return;
+    case I2C_FINISH:
+        if (!s->tx_active) {
+            i2c_shm_post(s, I2C_SHM_MSG_STOP, s->parent.address << 1);
+        } else if (!i2c_shm_flush_tx(s, true)) {
+            /* Retried when the peer makes room */
+            s->tx_blocked = true;
+            i2c_shm_wait_resp(s);
+            return;
+        }
+        i2c_ack(s->bus);
+        return;
+    default:
+        i2c_async_complete(s->bus, i2c_shm_event(i2c, event), 0xff);
+        return;
+    }
+}
+
+static int i2c_shm_send_byte(I2CSlave *i2c, uint8_t data)
+{
+    I2CShm *s = I2C_SHM(i2c);
+
+    if (!s->tx_active) {
+        return -1;
+    }
+
+    if (s->tx_msg.len == I2C_SHM_MAX_DATA) {
+        if (!i2c_shm_flush_tx(s, false)) {
+            qemu_log_mask(LOG_GUEST_ERROR, "%s: 0x%02x: peer ring full\n",
+                          TYPE_I2C_SHM, s->parent.address);
+            return -1;
+        }
+        i2c_shm_start_send(s);
+        s->tx_cont = true;
+    }
+
+    s->tx_msg.data[s->tx_msg.len++] = data;
+    return 0;
+}
+
+static uint8_t i2c_shm_recv(I2CSlave *i2c)
+{
+    I2CShm *s = I2C_SHM(i2c);
+
+    qemu_log_mask(LOG_UNIMP, "%s: 0x%02x: synchronous read not supported\n",
+                  TYPE_I2C_SHM, s->parent.address);
+    return 0xff;
+}
+
+static void i2c_shm_recv_async(I2CSlave *i2c)
+{
+    I2CShm *s = I2C_SHM(i2c);
+
+    if (!i2c_shm_post(s, I2C_SHM_MSG_READ, s->parent.address << 1 | 1)) {
+        i2c_async_complete(s->bus, 0, 0xff);
+        return;
+    }
+    i2c_shm_wait_resp(s);
+}
+
+static void i2c_shm_handle_resp(I2CShm *s)
+{
+    I2CShmMsg *slot;
+    I2CShmMsg msg;
+
+    while ((slot = i2c_shm_ring_peek(&s->inbox->resp))) {
+        /* The header and the only data byte we use, read once */
+        memcpy(&msg, slot, offsetof(I2CShmMsg, data) + 1);
+        if (s->rx_waiting && !s->tx_blocked && msg.seq == s->seq) {
+            i2c_shm_complete(s, msg.status, msg.len ? msg.data[0] : 0xff);
+        }
+        i2c_shm_ring_pop(&s->inbox->resp);
+    }
+
+    if (s->tx_blocked && i2c_shm_flush_tx(s, true)) {
+        i2c_shm_complete(s, 0, 0xff);
+    }
+}
+
+/*
+ * Peer side
+ */
+
+static void i2c_shm_replay_done(void *opaque, int ret, uint8_t data)
+{
+    I2CShm *s = opaque;
+
+    s->replay_ret = ret;
+    s->replay_data = data;
+    s->replay_state = I2C_SHM_REPLAY_MASTER;
+    qemu_bh_schedule(s->bh);
+}
+
+static bool i2c_shm_replay_wait(I2CShm *s, int ret)
+{
+    if (ret != I2C_ASYNC_PENDING) {
+        s->replay_ret = ret;
+        return false;
+    }
+
+    s->replay_state = I2C_SHM_REPLAY_BUSY;
+    return true;
+}
+
+/*
+ * Ends the replayed transfer. The bus is handed over before the end, which
+ * passes it to the next pending master. If a NAKed start already did that,
+ * the transfer is over and the bus belongs to someone else.
+ */
+static bool i2c_shm_replay_stop(I2CShm *s)
+{
+    int ret;
+
+    s->replay_stopped = true;
+    if (s->bus->bh != s->bh) {
+        return true;
+    }
+
+    i2c_bus_release(s->bus);
+    ret = i2c_async_end(s->bus, i2c_shm_replay_done, s);
+    return !i2c_shm_replay_wait(s, ret);
+}
+
+static void i2c_shm_replay_resp(I2CShm *s, const I2CShmMsg *req,
+                                int status, bool has_data)
+{
+    I2CShmMsg msg = {
+        .type = I2C_SHM_MSG_RESP,
+        .addr = req->addr,
+        .status = status ? 1 : 0,
+        .seq = req->seq,
+        .len = has_data ? 1 : 0,
+        .data = { s->replay_data },
+    };
+
+    /* The peer waits for this answer, there is always room for it */
+    i2c_shm_send(s, &s->peer->resp, &msg);
+}
+
+/*
+ * Copies the request in @slot to replay_msg, so that the peer cannot change
+ * it while it is replayed. Returns false if the request is invalid.
+ */
+static bool i2c_shm_replay_load(I2CShm *s, const I2CShmMsg *slot)
+{
+    I2CShmMsg *msg = &s->replay_msg;
+    int rw = -1;
+
+    memcpy(msg, slot, offsetof(I2CShmMsg, data));
+    switch (msg->type) {
+    case I2C_SHM_MSG_WRITE:
+        rw = 0;
+        break;
+    case I2C_SHM_MSG_START:
+        rw = 1;
+        break;
+    case I2C_SHM_MSG_READ:
+    case I2C_SHM_MSG_NACK:
+    case I2C_SHM_MSG_STOP:
+        break;
+    default:
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: 0x%02x: unknown message type "
+                      "0x%02x\n", TYPE_I2C_SHM, s->parent.address, msg->type);
+        return false;
+    }
+
+    /* Only the messages that address a target carry a valid address */
+    if (rw >= 0 && ((msg->addr & 1) != rw || (msg->addr >> 1) >= 0x78)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: 0x%02x: invalid address 0x%02x "
+                      "for message type 0x%02x\n", TYPE_I2C_SHM,
+                      s->parent.address, msg->addr, msg->type);
+        return false;
+    }
+
+    if (msg->len > I2C_SHM_MAX_DATA ||
+        (msg->type != I2C_SHM_MSG_WRITE && msg->len)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: 0x%02x: invalid length %u for "
+                      "message type 0x%02x\n", TYPE_I2C_SHM,
+                      s->parent.address, msg->len, msg->type);
+        return false;
+    }
+    memcpy(msg->data, slot->data, msg->len);
+
+    return true;
+}
+
+/*
+ * Replays @msg on our bus. Returns false if it has to wait for the target,
+ * the bh runs again with the result in replay_ret when it answers.
+ */
+static bool i2c_shm_replay_msg(I2CShm *s, const I2CShmMsg *msg)
+{
+    bool issued = s->replay_issued;
+    int ret;
+
+    if (s->replay_stopped) {
+        goto done;
+    }
+
+    s->replay_issued = true;
+    switch (msg->type) {
+    case I2C_SHM_MSG_WRITE:
+        if (!issued && !(msg->flags & I2C_SHM_F_CONT)) {
+            ret = i2c_async_start(s->bus, msg->addr >> 1, false,
+                                  i2c_shm_replay_done, s);
+            if (i2c_shm_replay_wait(s, ret)) {
+                return false;
+            }
+        }
+        while (!s->replay_ret && s->replay_pos < msg->len) {
+            ret = i2c_async_send(s->bus, msg->data[s->replay_pos++],
+                                 i2c_shm_replay_done, s);
+            if (i2c_shm_replay_wait(s, ret)) {
+                return false;
+            }
+        }
+        if (s->replay_ret) {
+            /* The rest of the segment is dropped */
+            trace_i2c_shm_replay_nak(s->parent.address, msg->addr >> 1,
+                                     s->replay_pos);
+        }
+        if ((msg->flags & I2C_SHM_F_STOP) && !i2c_shm_replay_stop(s)) {
+            return false;
+        }
+        break;
+    case I2C_SHM_MSG_START:
+        if (!issued) {
+            ret = i2c_async_start(s->bus, msg->addr >> 1, true,
+                                  i2c_shm_replay_done, s);
+            if (i2c_shm_replay_wait(s, ret)) {
+                return false;
+            }
+        }
+        i2c_shm_replay_resp(s, msg, s->replay_ret, false);
+        break;
+    case I2C_SHM_MSG_READ:
+        if (!issued) {
+            ret = i2c_async_recv(s->bus, &s->replay_data,
+                                 i2c_shm_replay_done, s);
+            if (i2c_shm_replay_wait(s, ret)) {
+                return false;
+            }
+        }
+        i2c_shm_replay_resp(s, msg, 0, true);
+        break;
+    case I2C_SHM_MSG_NACK:
+        if (!issued) {
+            ret = i2c_async_nack(s->bus, i2c_shm_replay_done, s);
+            if (i2c_shm_replay_wait(s, ret)) {
+                return false;
+            }
+        }
+        break;
+    case I2C_SHM_MSG_STOP:
+        if (!i2c_shm_replay_stop(s)) {
+            return false;
+        }
+        break;
+    default:
+        g_assert_not_reached();
+    }
+
+done:
+    if (s->replay_stopped) {
+        s->replay_state = I2C_SHM_REPLAY_IDLE;
+        s->replay_stopped = false;
+    }
+    s->replay_issued = false;
+    s->replay_pos = 0;
+    s->replay_ret = 0;
+    return true;
+}
+
+static void i2c_shm_replay_bh(void *opaque)
+{
+    I2CShm *s = opaque;
+    I2CShmMsg *msg;
+
+    if (!s->connected) {
+        /* The peer left while we were waiting for the bus */
+        if (s->bus->bh == s->bh) {
+            i2c_bus_release(s->bus);
+            i2c_end_transfer(s->bus);
+        }
+        return;
+    }
+
+    while ((msg = i2c_shm_ring_peek(&s->inbox->req))) {
+        if (!s->replay_loaded) {
+            if (!i2c_shm_replay_load(s, msg)) {
+                if (i2c_shm_ring_pop(&s->inbox->req)) {
+                    event_notifier_set(&s->peer_notifier);
+                }
+                continue;
+            }
+            s->replay_loaded = true;
+        }
+
+        switch (s->replay_state) {
+        case I2C_SHM_REPLAY_BUSY:
+            return;
+        case I2C_SHM_REPLAY_IDLE:
+            s->replay_state = I2C_SHM_REPLAY_WAIT_MASTER;
+            i2c_bus_master(s->bus, s->bh);
+            return;
+        case I2C_SHM_REPLAY_WAIT_MASTER:
+            /* Slave events of other devices schedule the bh as well */
+            if (s->bus->bh != s->bh) {
+                return;
+            }
+            s->replay_state = I2C_SHM_REPLAY_MASTER;
+            break;
+        case I2C_SHM_REPLAY_MASTER:
+            break;
+        }
+
+        if (!i2c_shm_replay_msg(s, &s->replay_msg)) {
+            return;
+        }
+
+        s->replay_loaded = false;
+        if (i2c_shm_ring_pop(&s->inbox->req)) {
+            event_notifier_set(&s->peer_notifier);
+        }
+    }
+}
+
+static void i2c_shm_notify(EventNotifier *n)
+{
+    I2CShm *s = container_of(n, I2CShm, notifier);
+
+    event_notifier_test_and_clear(n);
+    if (!s->connected) {
+        return;
+    }
+
+    i2c_shm_handle_resp(s);
+    i2c_shm_replay_bh(s);
+}
+
+/*
+ * Connection
+ */
+
+static void i2c_shm_disconnect(I2CShm *s)
+{
+    if (!s->connected) {
+        return;
+    }
+
+    s->connected = false;
+    s->replay_loaded = false;
+    munmap(s->peer, sizeof(*s->peer));
+    s->peer = NULL;
+    event_notifier_cleanup(&s->peer_notifier);
+
+    if (s->rx_waiting) {
+        i2c_shm_complete(s, -1, 0xff);
+    }
+    s->tx_active = false;
+
+    if (s->replay_state != I2C_SHM_REPLAY_IDLE) {
+        if (s->replay_state == I2C_SHM_REPLAY_BUSY) {
+            i2c_async_cancel(s->bus);
+        }
+        if (s->bus->bh == s->bh) {
+            i2c_bus_release(s->bus);
+            i2c_end_transfer(s->bus);
+        }
+        s->replay_state = I2C_SHM_REPLAY_IDLE;
+    }
+}
+
+static void i2c_shm_send_hello(I2CShm *s)
+{
+    I2CShmHello hello = {
+        .magic = I2C_SHM_MAGIC,
+        .version = I2C_SHM_VERSION,
+    };
+    int fds[2] = { s->inbox_fd, event_notifier_get_wfd(&s->notifier) };
+
+    /* Nothing from a previous peer is left in the inbox */
+    memset(&s->inbox->req, 0, sizeof(s->inbox->req));
+    memset(&s->inbox->resp, 0, sizeof(s->inbox->resp));
+    s->hello_len = 0;
+
+    qemu_chr_fe_set_msgfds(&s->chr, fds, ARRAY_SIZE(fds));
+    qemu_chr_fe_write_all(&s->chr, (uint8_t *)&hello, sizeof(hello));
+}
+
+static void i2c_shm_connect(I2CShm *s, int *fds, int nfds)
+{
+    struct stat st;
+    void *peer;
+
+    if (s->hello.magic != I2C_SHM_MAGIC ||
+        s->hello.version != I2C_SHM_VERSION || nfds != 2) {
+        error_report("%s: invalid hello from peer", TYPE_I2C_SHM);
+        goto err;
+    }
+
+    if (fstat(fds[0], &st) || st.st_size < sizeof(I2CShmInbox)) {
+        error_report("%s: invalid peer inbox", TYPE_I2C_SHM);
+        goto err;
+    }
+
+    peer = mmap(NULL, sizeof(I2CShmInbox), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fds[0], 0);
+    if (peer == MAP_FAILED) {
+        error_report("%s: failed to map peer inbox: %s", TYPE_I2C_SHM,
+                     strerror(errno));
+        goto err;
+    }
+    close(fds[0]);
+
+    i2c_shm_disconnect(s);
+    s->peer = peer;
+    event_notifier_init_fd(&s->peer_notifier, fds[1]);
+    s->connected = true;
+    return;
+
+err:
+    while (nfds-- > 0) {
+        close(fds[nfds]);
+    }
+}
+
+static int i2c_shm_chr_can_receive(void *opaque)
+{
+    I2CShm *s = opaque;
+
+    return sizeof(s->hello) - s->hello_len;
+}
+
+static void i2c_shm_chr_receive(void *opaque, const uint8_t *buf, int size)
+{
+    I2CShm *s = opaque;
+    int fds[2];
+    int nfds;
+
+    memcpy((uint8_t *)&s->hello + s->hello_len, buf, size);
+    s->hello_len += size;
+    if (s->hello_len < sizeof(s->hello)) {
+        return;
+    }
+    s->hello_len = 0;
+
+    nfds = qemu_chr_fe_get_msgfds(&s->chr, fds, ARRAY_SIZE(fds));
+    i2c_shm_connect(s, fds, MAX(nfds, 0));
+}
+
+static void i2c_shm_chr_event(void *opaque, QEMUChrEvent event)
+{
+    I2CShm *s = opaque;
+
+    switch (event) {
+    case CHR_EVENT_OPENED:
+        i2c_shm_send_hello(s);
+        break;
+    case CHR_EVENT_CLOSED:
+        i2c_shm_disconnect(s);
+        break;
+    default:
+        break;
+    }
+}
+
+static void i2c_shm_realize(DeviceState *dev, Error **errp)
+{
+    I2CShm *s = I2C_SHM(dev);
+
+    if (!qemu_chr_fe_backend_connected(&s->chr)) {
+        error_setg(errp, "%s: 'chardev' property is required", TYPE_I2C_SHM);
+        return;
+    }
+
+    s->inbox = qemu_memfd_alloc("i2c-shm", sizeof(I2CShmInbox),
+                                F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL,
+                                &s->inbox_fd, errp);
+    if (!s->inbox) {
+        return;
+    }
+    s->inbox->magic = I2C_SHM_MAGIC;
+    s->inbox->version = I2C_SHM_VERSION;
+
+    if (event_notifier_init(&s->notifier, 0) < 0) {
+        error_setg(errp, "%s: failed to create event notifier", TYPE_I2C_SHM);
+        qemu_memfd_free(s->inbox, sizeof(I2CShmInbox), s->inbox_fd);
+        s->inbox = NULL;
+        return;
+    }
+    event_notifier_set_handler(&s->notifier, i2c_shm_notify);
+
+    s->bus = I2C_BUS(qdev_get_parent_bus(dev));
+    s->bh = qemu_bh_new(i2c_shm_replay_bh, s);
+    timer_init_ms(&s->timeout, QEMU_CLOCK_REALTIME, i2c_shm_timeout, s);
+
+    qemu_chr_fe_set_handlers(&s->chr, i2c_shm_chr_can_receive,
+                             i2c_shm_chr_receive, i2c_shm_chr_event,
+                             NULL, s, NULL, true);
+}
+
+static void i2c_shm_unrealize(DeviceState *dev)
+{
+    I2CShm *s = I2C_SHM(dev);
+
+    qemu_chr_fe_deinit(&s->chr, false);
+    i2c_shm_disconnect(s);
+    timer_del(&s->timeout);
+    qemu_bh_delete(s->bh);
+    event_notifier_set_handler(&s->notifier, NULL);
+    event_notifier_cleanup(&s->notifier);
+    qemu_memfd_free(s->inbox, sizeof(I2CShmInbox), s->inbox_fd);
+}
+
+static bool i2c_shm_get_connected(Object *obj, Error **errp)
+{
+    return I2C_SHM(obj)->connected;
+}
+
+static Property i2c_shm_props[] = {
+    DEFINE_PROP_CHR("chardev", I2CShm, chr),
+    DEFINE_PROP_UINT32("timeout", I2CShm, timeout_ms, 100),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+static void i2c_shm_class_init(ObjectClass *oc, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(oc);
+    I2CSlaveClass *sc = I2C_SLAVE_CLASS(oc);
+
+    dc->realize = i2c_shm_realize;
+    dc->unrealize = i2c_shm_unrealize;
+    dc->desc = "I2C bus bridge over shared memory";
+    device_class_set_props(dc, i2c_shm_props);
+    object_class_property_add_bool(oc, "connected", i2c_shm_get_connected,
+                                   NULL);
+
+    sc->event = i2c_shm_event;
+    sc->event_async = i2c_shm_event_async;
+    sc->send = i2c_shm_send_byte;
+    sc->recv = i2c_shm_recv;
+    sc->recv_async = i2c_shm_recv_async;
+}
+
+static const TypeInfo i2c_shm_info = {
+    .name = TYPE_I2C_SHM,
+    .parent = TYPE_I2C_SLAVE,
+    .instance_size = sizeof(I2CShm),
+    .class_init = i2c_shm_class_init,
+};
+
+static void i2c_shm_register_types(void)
+{
+    type_register_static(&i2c_shm_info);
+}
+
+type_init(i2c_shm_register_types);
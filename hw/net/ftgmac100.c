@@ -16,6 +16,7 @@
 #include "hw/net/ftgmac100.h"
 #include "sysemu/dma.h"
 #include "qapi/error.h"
+#include "qemu/iov.h"
 #include "qemu/log.h"
 #include "qemu/module.h"
 #include "net/checksum.h"
@@ -71,6 +72,16 @@
 #define FTGMAC100_INT_PHYSTS_CHG  (1 << 9)
 #define FTGMAC100_INT_NO_HPTXBUF  (1 << 10)
 
+/*
+ * Interrupt timer control register
+ */
+#define FTGMAC100_ITC_RXINT_CNT(x)          ((x) & 0xf)
+#define FTGMAC100_ITC_RXINT_THR(x)          (((x) >> 4) & 0x7)
+#define FTGMAC100_ITC_RXINT_TIME_SEL        (1 << 7)
+#define FTGMAC100_ITC_TXINT_CNT(x)          (((x) >> 8) & 0xf)
+#define FTGMAC100_ITC_TXINT_THR(x)          (((x) >> 12) & 0x7)
+#define FTGMAC100_ITC_TXINT_TIME_SEL        (1 << 15)
+
 /*
  * Automatic polling timer control register
  */
@@ -209,6 +220,15 @@ typedef struct {
 } FTGMAC100Desc;
 
 #define FTGMAC100_DESC_ALIGNMENT 16
+#define FTGMAC100_DESC_MAX_SIZE  (0xf * 8)
+
+/*
+ * Number of transmit descriptors fetched and written back with a
+ * single DMA access, and max number of segments of a frame sent
+ * without copy.
+ */
+#define FTGMAC100_TX_BURST       16
+#define FTGMAC100_TX_MAX_IOV     32
 
 /*
  * Specific RTL8211E MII Registers
@@ -252,7 +272,83 @@ static int ftgmac100_max_frame_size(FTGMAC100State *s, uint16_t proto)
 
 static void ftgmac100_update_irq(FTGMAC100State *s)
 {
-    qemu_set_irq(s->irq, s->isr & s->ier);
+    qemu_set_irq(s->irq, s->isr & s->ier & ~s->isr_deferred);
+}
+
+/*
+ * Time unit of the polling and interrupt timers, depending on the
+ * link speed. See the polling times in ftgmac100_rxpoll().
+ */
+static int64_t ftgmac100_timer_unit_ns(FTGMAC100State *s, bool time_sel)
+{
+    static const int div[] = { 20, 200, 1000 };
+    uint32_t speed = (s->maccr & FTGMAC100_MACCR_FAST_MODE) ? 1 : 0;
+    int64_t unit = 1024 * SCALE_MS;
+
+    if (s->maccr & FTGMAC100_MACCR_GIGA_MODE) {
+        speed = 2;
+    }
+
+    if (time_sel) {
+        unit <<= 4;
+    }
+
+    return unit / div[speed];
+}
+
+static void ftgmac100_itc_release(FTGMAC100State *s)
+{
+    s->isr_deferred = 0;
+    s->rx_pending = 0;
+    s->tx_pending = 0;
+    timer_del(&s->itc_timer);
+}
+
+static void ftgmac100_itc_expire(void *opaque)
+{
+    FTGMAC100State *s = FTGMAC100(opaque);
+
+    ftgmac100_itc_release(s);
+    ftgmac100_update_irq(s);
+}
+
+/*
+ * Flag a transmitted or received packet. When interrupt mitigation is
+ * configured in the ITC register, the interrupt is only raised when
+ * the threshold of packets is reached or when the interrupt timer
+ * expires, so that a single interrupt covers a burst of packets.
+ */
+static void ftgmac100_pkt_done(FTGMAC100State *s, bool tx)
+{
+    uint32_t irq = tx ? FTGMAC100_INT_XPKT_ETH : FTGMAC100_INT_RPKT_BUF;
+    uint32_t cnt = tx ? FTGMAC100_ITC_TXINT_CNT(s->itc) :
+                        FTGMAC100_ITC_RXINT_CNT(s->itc);
+    uint32_t thr = tx ? FTGMAC100_ITC_TXINT_THR(s->itc) :
+                        FTGMAC100_ITC_RXINT_THR(s->itc);
+    bool time_sel = s->itc & (tx ? FTGMAC100_ITC_TXINT_TIME_SEL :
+                                   FTGMAC100_ITC_RXINT_TIME_SEL);
+    uint32_t *pending = tx ? &s->tx_pending : &s->rx_pending;
+
+    s->isr |= irq;
+
+    /* Without an interrupt timer, the interrupt is raised right away */
+    if (!cnt) {
+        s->isr_deferred &= ~irq;
+        *pending = 0;
+        return;
+    }
+
+    if (thr && ++(*pending) >= thr) {
+        s->isr_deferred &= ~irq;
+        *pending = 0;
+        return;
+    }
+
+    s->isr_deferred |= irq;
+    if (!timer_pending(&s->itc_timer)) {
+        timer_mod(&s->itc_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+                  cnt * ftgmac100_timer_unit_ns(s, time_sel));
+    }
 }
 
 /*
@@ -514,108 +610,294 @@ out:
     return frame_size;
 }
 
-static void ftgmac100_do_tx(FTGMAC100State *s, uint32_t tx_ring,
-                            uint32_t tx_descriptor)
+/*
+ * Prefetch a burst of descriptors from a ring. The burst stops after
+ * the end-of-ring descriptor. Returns the number of descriptors read.
+ */
+static int ftgmac100_read_bd_burst(FTGMAC100Desc *bd, uint8_t *raw, int max,
+                                   dma_addr_t addr, uint32_t stride,
+                                   uint32_t edo)
 {
-    int frame_size = 0;
-    uint8_t *ptr = s->frame;
-    uint32_t addr = tx_descriptor;
-    uint32_t flags = 0;
+    int i;
+
+    if (dma_memory_read(&address_space_memory, addr, raw, max * stride,
+                        MEMTXATTRS_UNSPECIFIED)) {
+        /* The burst could go beyond the end of RAM. Try a single one */
+        max = 1;
+        if (dma_memory_read(&address_space_memory, addr, raw, sizeof(*bd),
+                            MEMTXATTRS_UNSPECIFIED)) {
+            qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to read descriptor @ 0x%"
+                          HWADDR_PRIx "\n", __func__, addr);
+            return 0;
+        }
+    }
 
-    while (1) {
-        FTGMAC100Desc bd;
-        int len;
+    for (i = 0; i < max; i++) {
+        uint8_t *p = raw + i * stride;
 
-        if (ftgmac100_read_bd(&bd, addr) ||
-            ((bd.des0 & FTGMAC100_TXDES0_TXDMA_OWN) == 0)) {
-            /* Run out of descriptors to transmit.  */
-            s->isr |= FTGMAC100_INT_NO_NPTXBUF;
-            break;
-        }
+        bd[i].des0 = ldl_le_p(p);
+        bd[i].des1 = ldl_le_p(p + 4);
+        bd[i].des2 = ldl_le_p(p + 8);
+        bd[i].des3 = ldl_le_p(p + 12);
 
-        /* record transmit flags as they are valid only on the first
-         * segment */
-        if (bd.des0 & FTGMAC100_TXDES0_FTS) {
-            flags = bd.des1;
+        if (bd[i].des0 & edo) {
+            return i + 1;
         }
+    }
+    return max;
+}
 
-        len = FTGMAC100_TXDES0_TXBUF_SIZE(bd.des0);
-        if (!len) {
-            /*
-             * 0 is an invalid size, however the HW does not raise any
-             * interrupt. Flag an error because the guest is buggy.
-             */
-            qemu_log_mask(LOG_GUEST_ERROR, "%s: invalid segment size\n",
-                          __func__);
-        }
+/*
+ * Frames are sent directly from guest memory when possible. They are
+ * only assembled in the frame buffer when the controller needs to
+ * modify them, or when their segments can not be mapped.
+ */
+typedef struct {
+    uint32_t flags;
+    int frame_size;
+    bool copy;
+    int niov;
+    struct iovec iov[FTGMAC100_TX_MAX_IOV];
+} FTGMAC100TxFrame;
+
+static void ftgmac100_tx_unmap(FTGMAC100TxFrame *tx)
+{
+    int i;
 
-        if (frame_size + len > sizeof(s->frame)) {
-            qemu_log_mask(LOG_GUEST_ERROR, "%s: frame too big : %d bytes\n",
-                          __func__, len);
-            s->isr |= FTGMAC100_INT_XPKT_LOST;
-            len =  sizeof(s->frame) - frame_size;
-        }
+    for (i = 0; i < tx->niov; i++) {
+        dma_memory_unmap(&address_space_memory, tx->iov[i].iov_base,
+                         tx->iov[i].iov_len, DMA_DIRECTION_TO_DEVICE,
+                         tx->iov[i].iov_len);
+    }
+    tx->niov = 0;
+}
+
+static void ftgmac100_tx_flatten(FTGMAC100State *s, FTGMAC100TxFrame *tx)
+{
+    iov_to_buf(tx->iov, tx->niov, 0, s->frame, tx->frame_size);
+    ftgmac100_tx_unmap(tx);
+    tx->copy = true;
+}
+
+static bool ftgmac100_tx_map(FTGMAC100TxFrame *tx, dma_addr_t addr, int len)
+{
+    dma_addr_t plen = len;
+    void *p;
+
+    if (tx->niov == FTGMAC100_TX_MAX_IOV) {
+        return false;
+    }
+
+    p = dma_memory_map(&address_space_memory, addr, &plen,
+                       DMA_DIRECTION_TO_DEVICE, MEMTXATTRS_UNSPECIFIED);
+    if (!p) {
+        return false;
+    }
+    if (plen < len) {
+        dma_memory_unmap(&address_space_memory, p, plen,
+                         DMA_DIRECTION_TO_DEVICE, 0);
+        return false;
+    }
+
+    tx->iov[tx->niov].iov_base = p;
+    tx->iov[tx->niov].iov_len = len;
+    tx->niov++;
+    return true;
+}
+
+static void ftgmac100_tx_send(FTGMAC100State *s, FTGMAC100TxFrame *tx)
+{
+    int frame_size = tx->frame_size;
+    int csum = 0;
+
+    if (!tx->copy) {
+        qemu_sendv_packet(qemu_get_queue(s->nic), tx->iov, tx->niov);
+        ftgmac100_tx_unmap(tx);
+        return;
+    }
+
+    /* Check for VLAN */
+    if (tx->flags & FTGMAC100_TXDES1_INS_VLANTAG &&
+        be16_to_cpu(PKT_GET_ETH_HDR(s->frame)->h_proto) != ETH_P_VLAN) {
+        frame_size = ftgmac100_insert_vlan(s, frame_size,
+                                    FTGMAC100_TXDES1_VLANTAG_CI(tx->flags));
+    }
+
+    if (tx->flags & FTGMAC100_TXDES1_IP_CHKSUM) {
+        csum |= CSUM_IP;
+    }
+    if (tx->flags & FTGMAC100_TXDES1_TCP_CHKSUM) {
+        csum |= CSUM_TCP;
+    }
+    if (tx->flags & FTGMAC100_TXDES1_UDP_CHKSUM) {
+        csum |= CSUM_UDP;
+    }
+    if (csum) {
+        net_checksum_calculate(s->frame, frame_size, csum);
+    }
 
-        if (dma_memory_read(&address_space_memory, bd.des3,
-                            ptr, len, MEMTXATTRS_UNSPECIFIED)) {
-            qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to read packet @ 0x%x\n",
-                          __func__, bd.des3);
-            s->isr |= FTGMAC100_INT_AHB_ERR;
+    qemu_send_packet(qemu_get_queue(s->nic), s->frame, frame_size);
+}
+
+/*
+ * Add the buffer of a transmit descriptor to the current frame and
+ * send the frame if it is the last segment. Returns false on a DMA
+ * error.
+ */
+static bool ftgmac100_tx_segment(FTGMAC100State *s, FTGMAC100TxFrame *tx,
+                                 FTGMAC100Desc *bd)
+{
+    int len;
+
+    /* record transmit flags as they are valid only on the first
+     * segment */
+    if (bd->des0 & FTGMAC100_TXDES0_FTS) {
+        tx->flags = bd->des1;
+        tx->copy = tx->flags & (FTGMAC100_TXDES1_INS_VLANTAG |
+                                FTGMAC100_TXDES1_IP_CHKSUM |
+                                FTGMAC100_TXDES1_TCP_CHKSUM |
+                                FTGMAC100_TXDES1_UDP_CHKSUM);
+    }
+
+    len = FTGMAC100_TXDES0_TXBUF_SIZE(bd->des0);
+    if (!len) {
+        /*
+         * 0 is an invalid size, however the HW does not raise any
+         * interrupt. Flag an error because the guest is buggy.
+         */
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: invalid segment size\n",
+                      __func__);
+    }
+
+    if (tx->frame_size + len > sizeof(s->frame)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: frame too big : %d bytes\n",
+                      __func__, len);
+        s->isr |= FTGMAC100_INT_XPKT_LOST;
+        len =  sizeof(s->frame) - tx->frame_size;
+    }
+
+    if (len && !tx->copy && !ftgmac100_tx_map(tx, bd->des3, len)) {
+        ftgmac100_tx_flatten(s, tx);
+    }
+
+    if (tx->copy &&
+        dma_memory_read(&address_space_memory, bd->des3,
+                        s->frame + tx->frame_size, len,
+                        MEMTXATTRS_UNSPECIFIED)) {
+        qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to read packet @ 0x%x\n",
+                      __func__, bd->des3);
+        s->isr |= FTGMAC100_INT_AHB_ERR;
+        return false;
+    }
+
+    tx->frame_size += len;
+    if (bd->des0 & FTGMAC100_TXDES0_LTS) {
+        /* Last buffer in frame.  */
+        ftgmac100_tx_send(s, tx);
+        tx->frame_size = 0;
+        tx->copy = false;
+        ftgmac100_pkt_done(s, true);
+    }
+
+    if (tx->flags & FTGMAC100_TXDES1_TX2FIC) {
+        s->isr |= FTGMAC100_INT_XPKT_FIFO;
+    }
+    return true;
+}
+
+static void ftgmac100_do_tx(FTGMAC100State *s, uint32_t tx_ring,
+                            uint32_t tx_descriptor)
+{
+    uint32_t stride = FTGMAC100_DBLAC_TXDES_SIZE(s->dblac);
+    uint8_t raw[FTGMAC100_TX_BURST * FTGMAC100_DESC_MAX_SIZE];
+    FTGMAC100Desc bd[FTGMAC100_TX_BURST];
+    FTGMAC100TxFrame tx = { 0 };
+    uint32_t addr = tx_descriptor;
+    bool done = false;
+
+    while (!done) {
+        int n, i;
+
+        n = ftgmac100_read_bd_burst(bd, raw, FTGMAC100_TX_BURST, addr,
+                                    stride, s->txdes0_edotr);
+        if (!n) {
+            s->isr |= FTGMAC100_INT_NO_NPTXBUF;
             break;
         }
 
-        ptr += len;
-        frame_size += len;
-        if (bd.des0 & FTGMAC100_TXDES0_LTS) {
-            int csum = 0;
-
-            /* Check for VLAN */
-            if (flags & FTGMAC100_TXDES1_INS_VLANTAG &&
-                be16_to_cpu(PKT_GET_ETH_HDR(s->frame)->h_proto) != ETH_P_VLAN) {
-                frame_size = ftgmac100_insert_vlan(s, frame_size,
-                                            FTGMAC100_TXDES1_VLANTAG_CI(flags));
+        for (i = 0; i < n; i++) {
+            if (!(bd[i].des0 & FTGMAC100_TXDES0_TXDMA_OWN)) {
+                /* Run out of descriptors to transmit.  */
+                s->isr |= FTGMAC100_INT_NO_NPTXBUF;
+                done = true;
+                break;
             }
 
-            if (flags & FTGMAC100_TXDES1_IP_CHKSUM) {
-                csum |= CSUM_IP;
-            }
-            if (flags & FTGMAC100_TXDES1_TCP_CHKSUM) {
-                csum |= CSUM_TCP;
-            }
-            if (flags & FTGMAC100_TXDES1_UDP_CHKSUM) {
-                csum |= CSUM_UDP;
-            }
-            if (csum) {
-                net_checksum_calculate(s->frame, frame_size, csum);
+            if (!ftgmac100_tx_segment(s, &tx, &bd[i])) {
+                done = true;
+                break;
             }
 
-            /* Last buffer in frame.  */
-            qemu_send_packet(qemu_get_queue(s->nic), s->frame, frame_size);
-            ptr = s->frame;
-            frame_size = 0;
-            s->isr |= FTGMAC100_INT_XPKT_ETH;
+            bd[i].des0 &= ~FTGMAC100_TXDES0_TXDMA_OWN;
+            stl_le_p(raw + i * stride, bd[i].des0);
         }
 
-        if (flags & FTGMAC100_TXDES1_TX2FIC) {
-            s->isr |= FTGMAC100_INT_XPKT_FIFO;
+        if (!i) {
+            break;
+        }
+
+        /* Write back the modified descriptors.  */
+        if (dma_memory_write(&address_space_memory, addr, raw, i * stride,
+                             MEMTXATTRS_UNSPECIFIED)) {
+            qemu_log_mask(LOG_GUEST_ERROR, "%s: failed to write descriptor @ 0x%"
+                          HWADDR_PRIx "\n", __func__, (hwaddr) addr);
         }
-        bd.des0 &= ~FTGMAC100_TXDES0_TXDMA_OWN;
 
-        /* Write back the modified descriptor.  */
-        ftgmac100_write_bd(&bd, addr);
         /* Advance to the next descriptor.  */
-        if (bd.des0 & s->txdes0_edotr) {
+        if (bd[i - 1].des0 & s->txdes0_edotr) {
             addr = tx_ring;
         } else {
-            addr += FTGMAC100_DBLAC_TXDES_SIZE(s->dblac);
+            addr += i * stride;
         }
     }
 
+    /* Drop the segments of an incomplete frame */
+    ftgmac100_tx_unmap(&tx);
+
     s->tx_descriptor = addr;
 
     ftgmac100_update_irq(s);
 }
 
+/*
+ * Automatic transmit polling
+ */
+static void ftgmac100_txpoll_update(FTGMAC100State *s)
+{
+    uint32_t cnt = FTGMAC100_APTC_TXPOLL_CNT(s->aptcr);
+
+    if (!cnt) {
+        timer_del(&s->txpoll_timer);
+        return;
+    }
+
+    timer_mod(&s->txpoll_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+              cnt * ftgmac100_timer_unit_ns(s, s->aptcr &
+                                            FTGMAC100_APTC_TXPOLL_TIME_SEL));
+}
+
+static void ftgmac100_txpoll(void *opaque)
+{
+    FTGMAC100State *s = FTGMAC100(opaque);
+
+    if ((s->maccr & (FTGMAC100_MACCR_TXDMA_EN | FTGMAC100_MACCR_TXMAC_EN))
+        == (FTGMAC100_MACCR_TXDMA_EN | FTGMAC100_MACCR_TXMAC_EN)) {
+        ftgmac100_do_tx(s, s->tx_ring, s->tx_descriptor);
+    }
+
+    ftgmac100_txpoll_update(s);
+}
+
 static bool ftgmac100_can_receive(NetClientState *nc)
 {
     FTGMAC100State *s = FTGMAC100(qemu_get_nic_opaque(nc));
@@ -633,9 +915,9 @@ static bool ftgmac100_can_receive(NetClientState *nc)
 }
 
 /*
- * This is purely informative. The HW can poll the RW (and RX) ring
- * buffers for available descriptors but we don't need to trigger a
- * timer for that in qemu.
+ * This is purely informative. The HW can poll the RX ring buffer for
+ * available descriptors but we don't need to trigger a timer for that
+ * in qemu. Transmit polling is modelled with ftgmac100_txpoll().
  */
 static uint32_t ftgmac100_rxpoll(FTGMAC100State *s)
 {
@@ -693,6 +975,9 @@ static void ftgmac100_do_reset(FTGMAC100State *s, bool sw_reset)
     s->phydata = 0;
     s->fcr = 0x400;
 
+    ftgmac100_itc_release(s);
+    timer_del(&s->txpoll_timer);
+
     /* and the PHY */
     phy_reset(s);
 }
@@ -786,8 +1071,9 @@ static void ftgmac100_write(void *opaque, hwaddr addr,
     case FTGMAC100_MATH1: /* Multicast Address Hash Table 1 */
         s->math[1] = value;
         break;
-    case FTGMAC100_ITC: /* TODO: Interrupt Timer Control */
+    case FTGMAC100_ITC: /* Interrupt Timer Control */
         s->itc = value;
+        ftgmac100_itc_release(s);
         break;
     case FTGMAC100_RXR_BADR: /* Ring buffer address */
         if (!QEMU_IS_ALIGNED(value, FTGMAC100_DESC_ALIGNMENT)) {
@@ -838,9 +1124,7 @@ static void ftgmac100_write(void *opaque, hwaddr addr,
             ftgmac100_rxpoll(s);
         }
 
-        if (FTGMAC100_APTC_TXPOLL_CNT(s->aptcr)) {
-            qemu_log_mask(LOG_UNIMP, "%s: no transmit polling\n", __func__);
-        }
+        ftgmac100_txpoll_update(s);
         break;
 
     case FTGMAC100_MACCR: /* MAC Device control */
@@ -1059,7 +1343,7 @@ static ssize_t ftgmac100_receive(NetClientState *nc, const uint8_t *buf,
         if (size == 0) {
             /* Last buffer in frame.  */
             bd.des0 |= flags | FTGMAC100_RXDES0_LRS;
-            s->isr |= FTGMAC100_INT_RPKT_BUF;
+            ftgmac100_pkt_done(s, false);
         }
         ftgmac100_write_bd(&bd, addr);
         if (bd.des0 & s->rxdes0_edorr) {
@@ -1117,15 +1401,73 @@ static void ftgmac100_realize(DeviceState *dev, Error **errp)
     sysbus_init_irq(sbd, &s->irq);
     qemu_macaddr_default_if_unset(&s->conf.macaddr);
 
+    timer_init_ns(&s->itc_timer, QEMU_CLOCK_VIRTUAL, ftgmac100_itc_expire, s);
+    timer_init_ns(&s->txpoll_timer, QEMU_CLOCK_VIRTUAL, ftgmac100_txpoll, s);
+
     s->nic = qemu_new_nic(&net_ftgmac100_info, &s->conf,
                           object_get_typename(OBJECT(dev)), dev->id, s);
     qemu_format_nic_info_str(qemu_get_queue(s->nic), s->conf.macaddr.a);
 }
 
+static bool ftgmac100_itc_needed(void *opaque)
+{
+    FTGMAC100State *s = FTGMAC100(opaque);
+
+    return s->isr_deferred != 0;
+}
+
+static const VMStateDescription vmstate_ftgmac100_itc = {
+    .name = TYPE_FTGMAC100 "/itc",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = ftgmac100_itc_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT32(isr_deferred, FTGMAC100State),
+        VMSTATE_UINT32(rx_pending, FTGMAC100State),
+        VMSTATE_UINT32(tx_pending, FTGMAC100State),
+        VMSTATE_TIMER(itc_timer, FTGMAC100State),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+/*
+ * MAC address programmed by the guest in MADR/LADR. It replaces the one
+ * of the destination command line, the receive filter must keep matching
+ * the address the guest stack uses. Streams for older machine types do
+ * not have it.
+ */
+static bool ftgmac100_mac_needed(void *opaque)
+{
+    FTGMAC100State *s = FTGMAC100(opaque);
+
+    return s->migrate_mac;
+}
+
+static const VMStateDescription vmstate_ftgmac100_mac = {
+    .name = TYPE_FTGMAC100 "/mac",
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .needed = ftgmac100_mac_needed,
+    .fields = (VMStateField[]) {
+        VMSTATE_UINT8_ARRAY(conf.macaddr.a, FTGMAC100State, 6),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static int ftgmac100_post_load(void *opaque, int version_id)
+{
+    FTGMAC100State *s = FTGMAC100(opaque);
+
+    qemu_format_nic_info_str(qemu_get_queue(s->nic), s->conf.macaddr.a);
+    ftgmac100_txpoll_update(s);
+    return 0;
+}
+
 static const VMStateDescription vmstate_ftgmac100 = {
     .name = TYPE_FTGMAC100,
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = ftgmac100_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32(irq_state, FTGMAC100State),
         VMSTATE_UINT32(isr, FTGMAC100State),
@@ -1155,11 +1497,17 @@ static const VMStateDescription vmstate_ftgmac100 = {
         VMSTATE_UINT32(txdes0_edotr, FTGMAC100State),
         VMSTATE_UINT32(rxdes0_edorr, FTGMAC100State),
         VMSTATE_END_OF_LIST()
+    },
+    .subsections = (const VMStateDescription * []) {
+        &vmstate_ftgmac100_itc,
+        &vmstate_ftgmac100_mac,
+        NULL
     }
 };
 
 static Property ftgmac100_properties[] = {
     DEFINE_PROP_BOOL("aspeed", FTGMAC100State, aspeed, false),
+    DEFINE_PROP_BOOL("x-migrate-mac", FTGMAC100State, migrate_mac, true),
     DEFINE_NIC_PROPERTIES(FTGMAC100State, conf),
     DEFINE_PROP_END_OF_LIST(),
 };
@@ -128,6 +128,54 @@ int at24c_eeprom_send(I2CSlave *s, uint8_t data)
     return 0;
 }
 
+static
+void at24c_eeprom_recv_buf(I2CSlave *s, uint8_t *buf, size_t len)
+{
+    EEPROMState *ee = AT24C_EE(s);
+
+    if (ee->haveaddr == 1) {
+        memset(buf, 0xff, len);
+        return;
+    }
+
+    while (len) {
+        size_t n = MIN(len, ee->rsize - ee->cur);
+
+        memcpy(buf, ee->mem + ee->cur, n);
+        ee->cur = (ee->cur + n) % ee->rsize;
+        buf += n;
+        len -= n;
+    }
+    DPRINTK("Recv buffer, pointer now %04x\n", ee->cur);
+}
+
+static
+size_t at24c_eeprom_send_buf(I2CSlave *s, const uint8_t *buf, size_t len)
+{
+    EEPROMState *ee = AT24C_EE(s);
+    size_t sent = 0;
+
+    /* The address bytes */
+    while (ee->haveaddr < 2 && sent < len) {
+        at24c_eeprom_send(s, buf[sent++]);
+    }
+
+    while (sent < len) {
+        size_t n = MIN(len - sent, ee->rsize - ee->cur);
+
+        if (ee->writable) {
+            memcpy(ee->mem + ee->cur, buf + sent, n);
+            ee->changed = true;
+        } else {
+            DPRINTK("Send error, read-only\n");
+        }
+        ee->cur = (ee->cur + n) % ee->rsize;
+        sent += n;
+    }
+
+    return len;
+}
+
 static void at24c_eeprom_realize(DeviceState *dev, Error **errp)
 {
     EEPROMState *ee = AT24C_EE(dev);
@@ -209,6 +257,8 @@ void at24c_eeprom_class_init(ObjectClass *klass, void *data)
     k->event = &at24c_eeprom_event;
     k->recv = &at24c_eeprom_recv;
     k->send = &at24c_eeprom_send;
+    k->recv_buf = &at24c_eeprom_recv_buf;
+    k->send_buf = &at24c_eeprom_send_buf;
 
     device_class_set_props(dc, at24c_eeprom_props);
     dc->reset = at24c_eeprom_reset;
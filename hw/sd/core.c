@@ -186,6 +186,35 @@ bool sdbus_data_ready(SDBus *sdbus)
     return false;
 }
 
+bool sdbus_transfer_blocks(SDBus *sdbus, QEMUIOVector *qiov, bool write,
+                           void (*cb)(void *opaque, int ret), void *opaque)
+{
+    SDState *card = get_card(sdbus);
+
+    if (card) {
+        SDCardClass *sc = SD_CARD_GET_CLASS(card);
+
+        if (sc->transfer_blocks) {
+            return sc->transfer_blocks(card, qiov, write, cb, opaque);
+        }
+    }
+
+    return false;
+}
+
+void sdbus_drain_blocks(SDBus *sdbus)
+{
+    SDState *card = get_card(sdbus);
+
+    if (card) {
+        SDCardClass *sc = SD_CARD_GET_CLASS(card);
+
+        if (sc->drain_blocks) {
+            sc->drain_blocks(card);
+        }
+    }
+}
+
 bool sdbus_get_inserted(SDBus *sdbus)
 {
     SDState *card = get_card(sdbus);
@@ -46,7 +46,9 @@
 #include "qemu/error-report.h"
 #include "qemu/timer.h"
 #include "qemu/log.h"
+#include "qemu/main-loop.h"
 #include "qemu/module.h"
+#include "sysemu/iothread.h"
 #include "sdmmc-internal.h"
 #include "trace.h"
 
@@ -108,6 +110,7 @@ struct SDState {
     uint8_t spec_version;
     BlockBackend *blk;
     bool spi;
+    IOThread *iothread;
 
     /* Runtime changeables */
 
@@ -141,9 +144,19 @@ struct SDState {
     bool enable;
     uint8_t dat_lines;
     bool cmd_line;
+
+    /* Asynchronous block transfer, see sd_transfer_blocks() */
+    QEMUBH *transfer_bh;
+    void (*transfer_cb)(void *opaque, int ret);
+    void *transfer_opaque;
+    uint64_t transfer_size;
+    uint32_t transfer_len;
+    int transfer_ret;
+    bool transfer_done;
 };
 
 static void sd_realize(DeviceState *dev, Error **errp);
+static void sd_drain_blocks(SDState *sd);
 
 static const char *sd_state_name(enum SDCardStates state)
 {
@@ -558,6 +571,7 @@ static void sd_reset(DeviceState *dev)
     uint64_t sect;
 
     trace_sdcard_reset();
+    sd_drain_blocks(sd);
     if (sd->blk) {
         blk_get_geometry(sd->blk, &sect);
     } else {
@@ -668,11 +682,22 @@ static int sd_vmstate_pre_load(void *opaque)
     return 0;
 }
 
+static int sd_vmstate_pre_save(void *opaque)
+{
+    SDState *sd = opaque;
+
+    /* The asynchronous block transfer is not migrated, complete it */
+    sd_drain_blocks(sd);
+
+    return 0;
+}
+
 static const VMStateDescription sd_vmstate = {
     .name = "sd-card",
     .version_id = 2,
     .minimum_version_id = 2,
     .pre_load = sd_vmstate_pre_load,
+    .pre_save = sd_vmstate_pre_save,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32(mode, SDState),
         VMSTATE_INT32(state, SDState),
@@ -751,16 +776,34 @@ void sd_set_cb(SDState *sd, qemu_irq readonly, qemu_irq insert)
 
 static void sd_blk_read(SDState *sd, uint64_t addr, uint32_t len)
 {
+    AioContext *ctx;
+    int ret = -ENOMEDIUM;
+
     trace_sdcard_read_block(addr, len);
-    if (!sd->blk || blk_pread(sd->blk, addr, sd->data, len) < 0) {
+    if (sd->blk) {
+        ctx = blk_get_aio_context(sd->blk);
+        aio_context_acquire(ctx);
+        ret = blk_pread(sd->blk, addr, sd->data, len);
+        aio_context_release(ctx);
+    }
+    if (ret < 0) {
         fprintf(stderr, "sd_blk_read: read error on host side\n");
     }
 }
 
 static void sd_blk_write(SDState *sd, uint64_t addr, uint32_t len)
 {
+    AioContext *ctx;
+    int ret = -ENOMEDIUM;
+
     trace_sdcard_write_block(addr, len);
-    if (!sd->blk || blk_pwrite(sd->blk, addr, sd->data, len, 0) < 0) {
+    if (sd->blk) {
+        ctx = blk_get_aio_context(sd->blk);
+        aio_context_acquire(ctx);
+        ret = blk_pwrite(sd->blk, addr, sd->data, len, 0);
+        aio_context_release(ctx);
+    }
+    if (ret < 0) {
         fprintf(stderr, "sd_blk_write: write error on host side\n");
     }
 }
@@ -2096,6 +2139,154 @@ uint8_t sd_read_byte(SDState *sd)
     return ret;
 }
 
+/*
+ * Asynchronous block transfers
+ *
+ * The controller hands over the host buffers of several blocks of a
+ * CMD17/18/24/25 data phase at once, and the card transfers them with the
+ * block layer directly, instead of byte per byte through sd->data. The
+ * request runs in the AioContext of the drive, which is an IOThread when
+ * the "iothread" property is set, and completes in the main loop, where
+ * the card state is updated as the data lines would have.
+ */
+
+static void sd_transfer_blocks_finish(SDState *sd)
+{
+    uint32_t blocks = sd->transfer_size / sd->transfer_len;
+    bool write = sd->state == sd_programming_state;
+
+    trace_sdcard_transfer_blocks_complete(sd->data_start, sd->transfer_size,
+                                          sd->transfer_ret);
+    if (write) {
+        sd->state = sd_receivingdata_state;
+    }
+    if (sd->transfer_ret < 0) {
+        return;
+    }
+
+    sd->data_start += sd->transfer_size;
+    if (write) {
+        sd->blk_written += blocks;
+        sd->csd[14] |= 0x40;
+    }
+    if (sd->current_cmd == 17 || sd->current_cmd == 24) {
+        sd->state = sd_transfer_state;
+    } else if (sd->multi_blk_cnt != 0) {
+        sd->multi_blk_cnt -= blocks;
+        if (sd->multi_blk_cnt == 0) {
+            sd->state = sd_transfer_state;
+        }
+    }
+}
+
+static void sd_transfer_blocks_bh(void *opaque)
+{
+    SDState *sd = opaque;
+    void (*cb)(void *opaque, int ret) = sd->transfer_cb;
+
+    sd->transfer_cb = NULL;
+    sd_transfer_blocks_finish(sd);
+    cb(sd->transfer_opaque, sd->transfer_ret);
+}
+
+/* Called in the AioContext of the drive */
+static void sd_transfer_blocks_cb(void *opaque, int ret)
+{
+    SDState *sd = opaque;
+
+    sd->transfer_ret = ret;
+    sd->transfer_done = true;
+    qemu_bh_schedule(sd->transfer_bh);
+}
+
+static bool sd_transfer_blocks(SDState *sd, QEMUIOVector *qiov, bool write,
+                               void (*cb)(void *opaque, int ret),
+                               void *opaque)
+{
+    AioContext *ctx;
+    uint64_t addr;
+    uint32_t len;
+
+    if (!sd->blk || !blk_is_inserted(sd->blk) || !sd->enable ||
+        sd->transfer_cb || sd->data_offset != 0 ||
+        sd->card_status & (ADDRESS_ERROR | WP_VIOLATION)) {
+        return false;
+    }
+
+    if (write) {
+        if (sd->state != sd_receivingdata_state ||
+            (sd->current_cmd != 24 && sd->current_cmd != 25)) {
+            return false;
+        }
+        len = sd->blk_len;
+    } else {
+        if (sd->state != sd_sendingdata_state ||
+            (sd->current_cmd != 17 && sd->current_cmd != 18)) {
+            return false;
+        }
+        len = (sd->ocr & (1 << 30)) ? 512 : sd->blk_len;
+    }
+
+    if (!qiov->size || qiov->size % len != 0 ||
+        ((sd->current_cmd == 17 || sd->current_cmd == 24) &&
+         qiov->size != len) ||
+        (sd->multi_blk_cnt != 0 && qiov->size / len > sd->multi_blk_cnt)) {
+        return false;
+    }
+
+    /* Leave the errors to the data lines, which report them block by block */
+    if (sd->data_start + qiov->size > sd->size) {
+        return false;
+    }
+    if (write && sd->size <= SDSC_MAX_CAPACITY) {
+        for (addr = sd->data_start; addr < sd->data_start + qiov->size;
+             addr += len) {
+            if (sd_wp_addr(sd, addr)) {
+                return false;
+            }
+        }
+    }
+
+    trace_sdcard_transfer_blocks(write ? "write" : "read", sd->data_start,
+                                 qiov->size);
+    sd->transfer_cb = cb;
+    sd->transfer_opaque = opaque;
+    sd->transfer_size = qiov->size;
+    sd->transfer_len = len;
+    sd->transfer_done = false;
+
+    ctx = blk_get_aio_context(sd->blk);
+    aio_context_acquire(ctx);
+    if (write) {
+        sd->state = sd_programming_state;
+        blk_aio_pwritev(sd->blk, sd->data_start, qiov, 0,
+                        sd_transfer_blocks_cb, sd);
+    } else {
+        blk_aio_preadv(sd->blk, sd->data_start, qiov, 0,
+                       sd_transfer_blocks_cb, sd);
+    }
+    aio_context_release(ctx);
+    return true;
+}
+
+static void sd_drain_blocks(SDState *sd)
+{
+    AioContext *ctx;
+
+    if (!sd->transfer_cb) {
+        return;
+    }
+
+    ctx = blk_get_aio_context(sd->blk);
+    aio_context_acquire(ctx);
+    blk_drain(sd->blk);
+    aio_context_release(ctx);
+
+    assert(sd->transfer_done);
+    qemu_bh_cancel(sd->transfer_bh);
+    sd_transfer_blocks_bh(sd);
+}
+
 static bool sd_receive_ready(SDState *sd)
 {
     return sd->state == sd_receivingdata_state;
@@ -2124,6 +2315,9 @@ static void sd_instance_finalize(Object *obj)
     SDState *sd = SD_CARD(obj);
 
     timer_free(sd->ocr_power_timer);
+    if (sd->transfer_bh) {
+        qemu_bh_delete(sd->transfer_bh);
+    }
 }
 
 static void sd_realize(DeviceState *dev, Error **errp)
@@ -2178,7 +2372,22 @@ static void sd_realize(DeviceState *dev, Error **errp)
             return;
         }
         blk_set_dev_ops(sd->blk, &sd_block_ops, sd);
+
+        if (sd->iothread) {
+            AioContext *ctx = blk_get_aio_context(sd->blk);
+
+            aio_context_acquire(ctx);
+            ret = blk_set_aio_context(sd->blk,
+                                      iothread_get_aio_context(sd->iothread),
+                                      errp);
+            aio_context_release(ctx);
+            if (ret < 0) {
+                return;
+            }
+        }
     }
+
+    sd->transfer_bh = qemu_bh_new(sd_transfer_blocks_bh, sd);
 }
 
 static Property sd_properties[] = {
@@ -2190,6 +2399,8 @@ static Property sd_properties[] = {
      * board to ensure that ssi transfers only occur when the chip select
      * is asserted.  */
     DEFINE_PROP_BOOL("spi", SDState, spi, false),
+    DEFINE_PROP_LINK("iothread", SDState, iothread, TYPE_IOTHREAD,
+                     IOThread *),
     DEFINE_PROP_END_OF_LIST()
 };
 
@@ -2216,6 +2427,8 @@ static void sd_class_init(ObjectClass *klass, void *data)
     sc->enable = sd_enable;
     sc->get_inserted = sd_get_inserted;
     sc->get_readonly = sd_get_readonly;
+    sc->transfer_blocks = sd_transfer_blocks;
+    sc->drain_blocks = sd_drain_blocks;
 }
 
 static const TypeInfo sd_info = {
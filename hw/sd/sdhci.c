@@ -289,6 +289,9 @@ static void sdhci_reset(SDHCIState *s)
 
     timer_del(s->insert_timer);
     timer_del(s->transfer_timer);
+    if (s->adma_async) {
+        sdbus_drain_blocks(&s->sdbus);
+    }
 
     /* Set all registers to 0. Capabilities/Version registers are not cleared
      * and assumed to always preserve their value, given to them during
@@ -735,6 +738,138 @@ static void get_adma_description(SDHCIState *s, ADMADescr *dscr)
     }
 }
 
+/*
+ * Asynchronous ADMA2 transfer
+ *
+ * When the descriptor table covers the rest of the data phase of a block
+ * read or write, map all its buffers and let the card transfer the blocks
+ * with the block layer, instead of copying them through the FIFO. The vCPU
+ * does not wait for the host I/O: the transfer completes from the main
+ * loop, with the usual interrupts.
+ */
+#define SDHC_ADMA_ASYNC_MAX_DESCS       128
+
+static void sdhci_adma_unmap(SDHCIState *s, bool accessed)
+{
+    int i;
+
+    for (i = 0; i < s->adma_qiov.niov; i++) {
+        dma_memory_unmap(s->dma_as, s->adma_qiov.iov[i].iov_base,
+                         s->adma_qiov.iov[i].iov_len, s->adma_dir,
+                         accessed ? s->adma_qiov.iov[i].iov_len : 0);
+    }
+    qemu_iovec_reset(&s->adma_qiov);
+}
+
+static void sdhci_adma_complete(void *opaque, int ret)
+{
+    SDHCIState *s = opaque;
+
+    trace_sdhci_adma_async_complete(s->adma_qiov.size, ret);
+    sdhci_adma_unmap(s, true);
+    s->adma_async = false;
+
+    if (ret < 0) {
+        s->admaerr &= ~SDHC_ADMAERR_STATE_MASK;
+        s->admaerr |= SDHC_ADMAERR_STATE_ST_TFR;
+        if (s->errintstsen & SDHC_EISEN_ADMAERR) {
+            trace_sdhci_error("Set ADMA error flag");
+            s->errintsts |= SDHC_EIS_ADMAERR;
+            s->norintsts |= SDHC_NIS_ERR;
+        }
+        sdhci_update_irq(s);
+        return;
+    }
+
+    /* The transfer always covers the whole block count */
+    if (s->trnmod & SDHC_TRNS_BLK_CNT_EN) {
+        s->blkcnt = 0;
+    }
+    trace_sdhci_adma_transfer_completed();
+    sdhci_end_transfer(s);
+}
+
+static bool sdhci_adma_async(SDHCIState *s)
+{
+    const uint16_t block_size = s->blksize & BLOCK_SIZE_MASK;
+    const MemTxAttrs attrs = { .memory = true };
+    const uint64_t admasysaddr = s->admasysaddr;
+    bool read = s->trnmod & SDHC_TRNS_READ;
+    ADMADescr dscr = {};
+    dma_addr_t length, len;
+    uint64_t needed = 0;
+    void *mem;
+    int i;
+
+    if ((SDHC_DMA_TYPE(s->hostctl1) != SDHC_CTRL_ADMA2_32 &&
+         SDHC_DMA_TYPE(s->hostctl1) != SDHC_CTRL_ADMA2_64) ||
+        !block_size || s->data_count) {
+        return false;
+    }
+    if (s->trnmod & SDHC_TRNS_BLK_CNT_EN) {
+        needed = (uint64_t)s->blkcnt * block_size;
+    }
+
+    s->adma_dir = read ? DMA_DIRECTION_FROM_DEVICE : DMA_DIRECTION_TO_DEVICE;
+    for (i = 0; i < SDHC_ADMA_ASYNC_MAX_DESCS; ++i) {
+        get_adma_description(s, &dscr);
+
+        /* Leave the errors and the intermediate interrupts to the FIFO path */
+        if (!(dscr.attr & SDHC_ADMA_ATTR_VALID) ||
+            (dscr.attr & SDHC_ADMA_ATTR_INT)) {
+            break;
+        }
+
+        switch (dscr.attr & SDHC_ADMA_ATTR_ACT_MASK) {
+        case SDHC_ADMA_ATTR_ACT_TRAN:
+            length = dscr.length ? dscr.length : 64 * KiB;
+            if (needed && s->adma_qiov.size + length > needed) {
+                goto fallback;
+            }
+            len = length;
+            mem = dma_memory_map(s->dma_as, dscr.addr, &len, s->adma_dir,
+                                 attrs);
+            if (!mem) {
+                goto fallback;
+            }
+            qemu_iovec_add(&s->adma_qiov, mem, len);
+            if (len < length) {
+                goto fallback;
+            }
+            s->admasysaddr += dscr.incr;
+            break;
+        case SDHC_ADMA_ATTR_ACT_LINK:
+            s->admasysaddr = dscr.addr;
+            break;
+        default:
+            s->admasysaddr += dscr.incr;
+            break;
+        }
+
+        if ((needed && s->adma_qiov.size == needed) ||
+            (dscr.attr & SDHC_ADMA_ATTR_END)) {
+            if (!s->adma_qiov.size || s->adma_qiov.size % block_size ||
+                (needed && s->adma_qiov.size != needed)) {
+                break;
+            }
+            if (!sdbus_transfer_blocks(&s->sdbus, &s->adma_qiov, !read,
+                                       sdhci_adma_complete, s)) {
+                break;
+            }
+            trace_sdhci_adma_async(s->adma_qiov.niov, s->adma_qiov.size);
+            s->adma_async = true;
+            s->prnsts |= SDHC_DATA_INHIBIT | SDHC_DAT_LINE_ACTIVE |
+                (read ? SDHC_DOING_READ : SDHC_DOING_WRITE);
+            return true;
+        }
+    }
+
+fallback:
+    sdhci_adma_unmap(s, false);
+    s->admasysaddr = admasysaddr;
+    return false;
+}
+
 /* Advanced DMA data transfer */
 
 static void sdhci_do_adma(SDHCIState *s)
@@ -752,6 +887,10 @@ static void sdhci_do_adma(SDHCIState *s)
         return;
     }
 
+    if (sdhci_adma_async(s)) {
+        return;
+    }
+
     for (i = 0; i < SDHC_ADMA_DESCS_PER_DELAY; ++i) {
         s->admaerr &= ~SDHC_ADMAERR_LENGTH_MISMATCH;
 
@@ -1123,6 +1262,9 @@ static inline void sdhci_reset_write(SDHCIState *s, uint8_t value)
         s->norintsts &= ~SDHC_NIS_CMDCMP;
         break;
     case SDHC_RESET_DATA:
+        if (s->adma_async) {
+            sdbus_drain_blocks(&s->sdbus);
+        }
         s->data_count = 0;
         s->prnsts &= ~(SDHC_SPACE_AVAILABLE | SDHC_DATA_AVAILABLE |
                 SDHC_DOING_READ | SDHC_DOING_WRITE |
@@ -1369,12 +1511,14 @@ void sdhci_initfn(SDHCIState *s)
     s->transfer_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, sdhci_data_transfer, s);
 
     s->io_ops = &sdhci_mmio_ops;
+    qemu_iovec_init(&s->adma_qiov, 1);
 }
 
 void sdhci_uninitfn(SDHCIState *s)
 {
     timer_free(s->insert_timer);
     timer_free(s->transfer_timer);
+    qemu_iovec_destroy(&s->adma_qiov);
 
     g_free(s->fifo_buffer);
     s->fifo_buffer = NULL;
@@ -1424,10 +1568,23 @@ static const VMStateDescription sdhci_pending_insert_vmstate = {
     },
 };
 
+static int sdhci_pre_save(void *opaque)
+{
+    SDHCIState *s = opaque;
+
+    /* The state of an asynchronous transfer is not migrated, complete it */
+    if (s->adma_async) {
+        sdbus_drain_blocks(&s->sdbus);
+    }
+
+    return 0;
+}
+
 const VMStateDescription sdhci_vmstate = {
     .name = "sdhci",
     .version_id = 1,
     .minimum_version_id = 1,
+    .pre_save = sdhci_pre_save,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32(sdmasysad, SDHCIState),
         VMSTATE_UINT16(blksize, SDHCIState),
@@ -0,0 +1,445 @@
+/*
+ * Bulk sensor value feed
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * A feed holds a table of sensor values updated from outside of QEMU,
+ * either in place through a mapped telemetry table file or as a stream of
+ * updates on a character device:
+ *
+ *   -object sensor-feed,id=feed0,path=/dev/shm/telemetry
+ *   -object sensor-feed,id=feed0,chardev=chr0,entries=1024
+ *
+ * Sensors subscribe to a range of entries with their "feed", "feed-index"
+ * and "feed-props" properties, and sample the table when the guest reads
+ * them. Every update of the table is a tick: the sensors only convert the
+ * values again after a tick, and the monitor is not involved.
+ *
+ * A streamed update is a little-endian header { uint32 first, uint32 count }
+ * followed by count int64 values, assigned to entries first onwards.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/bitmap.h"
+#include "qemu/bswap.h"
+#include "qemu/module.h"
+#include "qapi/error.h"
+#include "qapi/visitor.h"
+#include "qom/object_interfaces.h"
+#include "chardev/char-fe.h"
+#include "hw/sensor/sensor-feed.h"
+#include "trace.h"
+
+#define SENSOR_FEED_DEFAULT_ENTRIES 256
+#define SENSOR_FEED_MAX_ENTRIES     (1 << 20)
+
+/* Times a torn read of a mapped table is retried before giving up */
+#define SENSOR_FEED_READ_RETRIES    16
+
+struct SensorFeed {
+    Object parent;
+
+    char *path;
+    char *chr_name;
+    uint32_t entries;
+
+    /* Mapped telemetry table */
+    SensorFeedTable *table;
+    size_t table_size;
+    /* Entries in the table, as validated at open; the writer owns count */
+    uint32_t count;
+
+    /* Streamed updates */
+    CharBackend chr;
+    int64_t *values;
+    uint32_t seq;
+    uint8_t buf[8];
+    int buf_len;
+    bool in_values;
+    uint32_t first;
+    uint32_t remaining;
+};
+
+static uint32_t sensor_feed_count(SensorFeed *s)
+{
+    return s->table ? s->count : s->entries;
+}
+
+static uint32_t sensor_feed_seq(SensorFeed *s)
+{
+    return s->table ? qatomic_load_acquire(&s->table->seq) : s->seq;
+}
+
+/*
+ * Copies @n values from @index onwards. Returns false if they are out of
+ * range, or if the writer kept updating the table while they were copied.
+ */
+static bool sensor_feed_read(SensorFeed *s, uint32_t index, uint32_t n,
+                             int64_t *values, uint32_t *seq)
+{
+    int i;
+
+    if (index >= sensor_feed_count(s) || n > sensor_feed_count(s) - index) {
+        return false;
+    }
+
+    if (!s->table) {
+        memcpy(values, &s->values[index], n * sizeof(*values));
+        *seq = s->seq;
+        return true;
+    }
+
+    for (i = 0; i < SENSOR_FEED_READ_RETRIES; i++) {
+        uint32_t start = qatomic_load_acquire(&s->table->seq);
+
+        if (start & 1) {
+            continue;
+        }
+        memcpy(values, &s->table->values[index], n * sizeof(*values));
+        smp_rmb();
+        if (qatomic_read(&s->table->seq) == start) {
+            *seq = start;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int sensor_feed_chr_can_receive(void *opaque)
+{
+    return sizeof(((SensorFeed *)opaque)->buf);
+}
+
+static void sensor_feed_chr_receive(void *opaque, const uint8_t *buf, int size)
+{
+    SensorFeed *s = opaque;
+
+    while (size > 0) {
+        int n = MIN(size, sizeof(s->buf) - s->buf_len);
+
+        memcpy(s->buf + s->buf_len, buf, n);
+        s->buf_len += n;
+        buf += n;
+        size -= n;
+        if (s->buf_len < sizeof(s->buf)) {
+            break;
+        }
+        s->buf_len = 0;
+
+        if (!s->in_values) {
+            s->first = ldl_le_p(s->buf);
+            s->remaining = ldl_le_p(s->buf + 4);
+            s->in_values = s->remaining != 0;
+        } else {
+            /* Entries out of the table are dropped */
+            if (s->first < s->entries) {
+                s->values[s->first] = ldq_le_p(s->buf);
+            }
+            s->first++;
+            s->in_values = --s->remaining != 0;
+        }
+
+        if (!s->in_values) {
+            s->seq++;
+        }
+    }
+}
+
+static void sensor_feed_open_table(SensorFeed *s, Error **errp)
+{
+    struct stat st;
+    void *table;
+    int fd;
+
+    fd = qemu_open(s->path, O_RDONLY, errp);
+    if (fd < 0) {
+        return;
+    }
+
+    if (fstat(fd, &st) || st.st_size < sizeof(SensorFeedTable)) {
+        error_setg(errp, "%s: telemetry table is too small", s->path);
+        goto out;
+    }
+
+    table = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (table == MAP_FAILED) {
+        error_setg_errno(errp, errno, "%s: failed to map telemetry table",
+                         s->path);
+        goto out;
+    }
+
+    s->table = table;
+    s->table_size = st.st_size;
+    s->count = qatomic_read(&s->table->count);
+    if (s->table->magic != SENSOR_FEED_MAGIC ||
+        s->table->version != SENSOR_FEED_VERSION ||
+        s->count > (s->table_size - sizeof(SensorFeedTable)) /
+                   sizeof(int64_t)) {
+        error_setg(errp, "%s: invalid telemetry table", s->path);
+        munmap(s->table, s->table_size);
+        s->table = NULL;
+    }
+
+out:
+    close(fd);
+}
+
+static void sensor_feed_complete(UserCreatable *uc, Error **errp)
+{
+    SensorFeed *s = SENSOR_FEED(uc);
+    Chardev *chr;
+
+    if (!s->path == !s->chr_name) {
+        error_setg(errp, "exactly one of 'path' and 'chardev' is required");
+        return;
+    }
+
+    if (s->path) {
+        sensor_feed_open_table(s, errp);
+        return;
+    }
+
+    if (!s->entries || s->entries > SENSOR_FEED_MAX_ENTRIES) {
+        error_setg(errp, "'entries' must be between 1 and %d",
+                   SENSOR_FEED_MAX_ENTRIES);
+        return;
+    }
+
+    chr = qemu_chr_find(s->chr_name);
+    if (!chr) {
+        error_setg(errp, "Device '%s' not found", s->chr_name);
+        return;
+    }
+    if (!qemu_chr_fe_init(&s->chr, chr, errp)) {
+        return;
+    }
+
+    s->values = g_new0(int64_t, s->entries);
+    qemu_chr_fe_set_handlers(&s->chr, sensor_feed_chr_can_receive,
+                             sensor_feed_chr_receive, NULL, NULL, s, NULL,
+                             true);
+}
+
+static char *sensor_feed_get_path(Object *obj, Error **errp)
+{
+    return g_strdup(SENSOR_FEED(obj)->path);
+}
+
+static void sensor_feed_set_path(Object *obj, const char *value, Error **errp)
+{
+    SensorFeed *s = SENSOR_FEED(obj);
+
+    g_free(s->path);
+    s->path = g_strdup(value);
+}
+
+static char *sensor_feed_get_chardev(Object *obj, Error **errp)
+{
+    return g_strdup(SENSOR_FEED(obj)->chr_name);
+}
+
+static void sensor_feed_set_chardev(Object *obj, const char *value,
+                                    Error **errp)
+{
+    SensorFeed *s = SENSOR_FEED(obj);
+
+    g_free(s->chr_name);
+    s->chr_name = g_strdup(value);
+}
+
+static void sensor_feed_init(Object *obj)
+{
+    SensorFeed *s = SENSOR_FEED(obj);
+
+    s->entries = SENSOR_FEED_DEFAULT_ENTRIES;
+    object_property_add_uint32_ptr(obj, "entries", &s->entries,
+                                   OBJ_PROP_FLAG_READWRITE);
+}
+
+static void sensor_feed_finalize(Object *obj)
+{
+    SensorFeed *s = SENSOR_FEED(obj);
+
+    qemu_chr_fe_deinit(&s->chr, false);
+    if (s->table) {
+        munmap(s->table, s->table_size);
+    }
+    g_free(s->values);
+    g_free(s->path);
+    g_free(s->chr_name);
+}
+
+static void sensor_feed_class_init(ObjectClass *oc, void *data)
+{
+    UserCreatableClass *ucc = USER_CREATABLE_CLASS(oc);
+
+    ucc->complete = sensor_feed_complete;
+
+    object_class_property_add_str(oc, "path", sensor_feed_get_path,
+                                  sensor_feed_set_path);
+    object_class_property_add_str(oc, "chardev", sensor_feed_get_chardev,
+                                  sensor_feed_set_chardev);
+}
+
+static const TypeInfo sensor_feed_info = {
+    .name = TYPE_SENSOR_FEED,
+    .parent = TYPE_OBJECT,
+    .instance_size = sizeof(SensorFeed),
+    .instance_init = sensor_feed_init,
+    .instance_finalize = sensor_feed_finalize,
+    .class_init = sensor_feed_class_init,
+    .interfaces = (InterfaceInfo[]) {
+        { TYPE_USER_CREATABLE },
+        { }
+    },
+};
+
+static void sensor_feed_register_types(void)
+{
+    type_register_static(&sensor_feed_info);
+}
+
+type_init(sensor_feed_register_types)
+
+/*
+ * Subscription of a device
+ */
+
+static void sensor_feed_client_get_index(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    SensorFeedClient *c = opaque;
+
+    visit_type_uint32(v, name, &c->index, errp);
+}
+
+static void sensor_feed_client_set_index(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    SensorFeedClient *c = opaque;
+
+    if (visit_type_uint32(v, name, &c->index, errp)) {
+        c->synced_feed = NULL;
+    }
+}
+
+static void sensor_feed_client_get_props(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    SensorFeedClient *c = opaque;
+    char *value = g_strdup(c->props ?: "");
+
+    visit_type_str(v, name, &value, errp);
+    g_free(value);
+}
+
+static void sensor_feed_client_set_props(Object *obj, Visitor *v,
+                                         const char *name, void *opaque,
+                                         Error **errp)
+{
+    SensorFeedClient *c = opaque;
+    char *value;
+    char **names;
+    int i;
+
+    if (!visit_type_str(v, name, &value, errp)) {
+        return;
+    }
+
+    names = g_strsplit(value, ",", -1);
+    for (i = 0; names[i]; i++) {
+        if (!object_property_find(obj, names[i])) {
+            error_setg(errp, "'%s' has no property '%s'",
+                       object_get_typename(obj), names[i]);
+            g_strfreev(names);
+            g_free(value);
+            return;
+        }
+    }
+
+    g_free(c->props);
+    g_strfreev(c->prop_names);
+    g_free(c->values);
+    g_free(c->rejected);
+    c->props = value;
+    c->prop_names = names;
+    c->nprops = i;
+    c->values = g_new0(int64_t, c->nprops);
+    c->rejected = bitmap_new(c->nprops);
+    c->synced_feed = NULL;
+}
+
+void sensor_feed_client_init(Object *obj, SensorFeedClient *c)
+{
+    object_property_add_link(obj, "feed", TYPE_SENSOR_FEED,
+                             (Object **)&c->feed,
+                             object_property_allow_set_link,
+                             OBJ_PROP_LINK_STRONG);
+    object_property_add(obj, "feed-index", "uint32",
+                        sensor_feed_client_get_index,
+                        sensor_feed_client_set_index, NULL, c);
+    object_property_add(obj, "feed-props", "str",
+                        sensor_feed_client_get_props,
+                        sensor_feed_client_set_props, NULL, c);
+}
+
+void sensor_feed_client_finalize(SensorFeedClient *c)
+{
+    g_free(c->props);
+    g_strfreev(c->prop_names);
+    g_free(c->values);
+    g_free(c->rejected);
+}
+
+void sensor_feed_client_sample(Object *obj, SensorFeedClient *c)
+{
+    g_autofree int64_t *values = NULL;
+    bool synced = c->synced_feed == c->feed;
+    uint32_t seq;
+    int i;
+
+    if (!c->feed || !c->nprops) {
+        return;
+    }
+
+    if (synced && sensor_feed_seq(c->feed) == c->seq) {
+        return;
+    }
+
+    values = g_new(int64_t, c->nprops);
+    if (!sensor_feed_read(c->feed, c->index, c->nprops, values, &seq)) {
+        trace_sensor_feed_sample_failed(object_get_typename(obj), c->index,
+                                        c->nprops);
+        return;
+    }
+
+    for (i = 0; i < c->nprops; i++) {
+        Error *err = NULL;
+
+        if (synced && values[i] == c->values[i] &&
+            !test_bit(i, c->rejected)) {
+            continue;
+        }
+        /* A value the sensor rejects is retried at the next tick */
+        if (object_property_set_int(obj, c->prop_names[i], values[i],
+                                    &err)) {
+            clear_bit(i, c->rejected);
+        } else {
+            trace_sensor_feed_set_failed(object_get_typename(obj),
+                                         c->prop_names[i], values[i]);
+            error_free(err);
+            set_bit(i, c->rejected);
+        }
+    }
+
+    memcpy(c->values, values, c->nprops * sizeof(*values));
+    c->synced_feed = c->feed;
+    c->seq = seq;
+}
@@ -204,6 +204,7 @@ static int tmp105_event(I2CSlave *i2c, enum i2c_event event)
     TMP105State *s = TMP105(i2c);
 
     if (event == I2C_START_RECV) {
+        sensor_feed_client_sample(OBJECT(s), &s->feed);
         tmp105_read(s);
     }
 
@@ -295,9 +296,19 @@ static void tmp105_realize(DeviceState *dev, Error **errp)
 
 static void tmp105_initfn(Object *obj)
 {
+    TMP105State *s = TMP105(obj);
+
     object_property_add(obj, "temperature", "int",
                         tmp105_get_temperature,
                         tmp105_set_temperature, NULL, NULL);
+    sensor_feed_client_init(obj, &s->feed);
+}
+
+static void tmp105_finalize(Object *obj)
+{
+    TMP105State *s = TMP105(obj);
+
+    sensor_feed_client_finalize(&s->feed);
 }
 
 static void tmp105_class_init(ObjectClass *klass, void *data)
@@ -317,6 +328,7 @@ static const TypeInfo tmp105_info = {
     .parent        = TYPE_I2C_SLAVE,
     .instance_size = sizeof(TMP105State),
     .instance_init = tmp105_initfn,
+    .instance_finalize = tmp105_finalize,
     .class_init    = tmp105_class_init,
 };
 
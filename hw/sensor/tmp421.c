@@ -26,6 +26,7 @@
 
 #include "qemu/osdep.h"
 #include "hw/i2c/i2c.h"
+#include "hw/sensor/sensor-feed.h"
 #include "migration/vmstate.h"
 #include "qapi/error.h"
 #include "qapi/visitor.h"
@@ -64,6 +65,7 @@ struct TMP421State {
     uint8_t buf[2];
     uint8_t pointer;
 
+    SensorFeedClient feed;
 };
 
 struct TMP421Class {
@@ -279,6 +281,7 @@ static int tmp421_event(I2CSlave *i2c, enum i2c_event event)
     TMP421State *s = TMP421(i2c);
 
     if (event == I2C_START_RECV) {
+        sensor_feed_client_sample(OBJECT(s), &s->feed);
         tmp421_read(s);
     }
 
@@ -337,6 +340,20 @@ static void tmp421_realize(DeviceState *dev, Error **errp)
     tmp421_reset(&s->i2c);
 }
 
+static void tmp421_init(Object *obj)
+{
+    TMP421State *s = TMP421(obj);
+
+    sensor_feed_client_init(obj, &s->feed);
+}
+
+static void tmp421_finalize(Object *obj)
+{
+    TMP421State *s = TMP421(obj);
+
+    sensor_feed_client_finalize(&s->feed);
+}
+
 static void tmp421_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
@@ -368,6 +385,8 @@ static const TypeInfo tmp421_info = {
     .name          = TYPE_TMP421,
     .parent        = TYPE_I2C_SLAVE,
     .instance_size = sizeof(TMP421State),
+    .instance_init = tmp421_init,
+    .instance_finalize = tmp421_finalize,
     .class_size    = sizeof(TMP421Class),
     .abstract      = true,
 };
@@ -35,6 +35,7 @@
 #include "hw/irq.h"
 #include "hw/qdev-properties.h"
 #include "hw/ssi/aspeed_smc.h"
+#include "hw/block/flash.h"
 
 /* CE Type Setting Register */
 #define R_CONF            (0x00 / 4)
@@ -187,6 +188,7 @@
 
 /* Flash opcodes. */
 #define SPI_OP_READ       0x03    /* Read data bytes (low frequency) */
+#define SPI_OP_WREN       0x06    /* Write enable */
 
 #define SNOOP_OFF         0xFF
 #define SNOOP_START       0x0
@@ -244,6 +246,13 @@ static bool aspeed_smc_flash_overlap(const AspeedSMCState *s,
     return false;
 }
 
+static void aspeed_smc_flash_direct_disable(AspeedSMCFlash *fl)
+{
+    if (fl->direct_init) {
+        memory_region_set_enabled(&fl->direct, false);
+    }
+}
+
 static void aspeed_smc_flash_set_segment_region(AspeedSMCState *s, int cs,
                                                 uint64_t regval)
 {
@@ -254,6 +263,7 @@ static void aspeed_smc_flash_set_segment_region(AspeedSMCState *s, int cs,
     asc->reg_to_segment(s, regval, &seg);
 
     memory_region_transaction_begin();
+    aspeed_smc_flash_direct_disable(fl);
     memory_region_set_size(&fl->mmio, seg.size);
     memory_region_set_address(&fl->mmio, seg.addr - asc->flash_window_base);
     memory_region_set_enabled(&fl->mmio, !!seg.size);
@@ -478,6 +488,116 @@ static void aspeed_smc_flash_setup(AspeedSMCFlash *fl, uint32_t addr)
     }
 }
 
+/*
+ * TODO (clg@kaod.org): stolen from xilinx_spips.c. Should move to a
+ * common include header.
+ */
+typedef enum {
+    READ = 0x3,         READ_4 = 0x13,
+    FAST_READ = 0xb,    FAST_READ_4 = 0x0c,
+    DOR = 0x3b,         DOR_4 = 0x3c,
+    QOR = 0x6b,         QOR_4 = 0x6c,
+    DIOR = 0xbb,        DIOR_4 = 0xbc,
+    QIOR = 0xeb,        QIOR_4 = 0xec,
+
+    PP = 0x2,           PP_4 = 0x12,
+    DPP = 0xa2,
+    QPP = 0x32,         QPP_4 = 0x34,
+} FlashCMD;
+
+/*
+ * Commands for which the flash streams out its contents as they are
+ * stored, whatever the number of data lines.
+ */
+static bool aspeed_smc_is_direct_read_cmd(uint8_t cmd)
+{
+    switch (cmd) {
+    case READ:
+    case READ_4:
+    case FAST_READ:
+    case FAST_READ_4:
+    case DOR:
+    case DOR_4:
+    case QOR:
+    case QOR_4:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void aspeed_smc_flash_direct_enable(AspeedSMCFlash *fl,
+                                           uint8_t *storage, uint32_t size)
+{
+    if (!fl->direct_init) {
+        g_autofree char *name = g_strdup_printf(TYPE_ASPEED_SMC_FLASH
+                                                ".%d.direct", fl->cs);
+
+        memory_region_init_ram_ptr(&fl->direct, OBJECT(fl), name, size,
+                                   storage);
+        memory_region_set_readonly(&fl->direct, true);
+        memory_region_set_enabled(&fl->direct, false);
+        memory_region_add_subregion_overlap(&fl->mmio, 0, &fl->direct, 1);
+        fl->direct_init = true;
+    }
+
+    /* Drop TBs translated from contents which were since reprogrammed */
+    if (fl->direct_modified) {
+        memory_region_flush_rom_device(&fl->direct, 0, size);
+        fl->direct_modified = false;
+    }
+
+    trace_aspeed_smc_flash_direct(fl->cs, size);
+    memory_region_set_enabled(&fl->direct, true);
+}
+
+/*
+ * Called once the command and address have been sent. If the selected
+ * flash is streaming out its contents from the requested address, the
+ * access is served from the flash storage. When the whole segment maps
+ * the flash linearly, the storage is also mapped directly in the segment,
+ * so that subsequent reads no longer go through the MMIO handlers. The
+ * mapping is dropped as soon as the controller configuration changes.
+ */
+static bool aspeed_smc_flash_direct_read(AspeedSMCFlash *fl, hwaddr addr,
+                                         unsigned size, uint64_t *data)
+{
+    AspeedSMCState *s = fl->controller;
+    uint8_t *storage = NULL;
+    uint32_t flash_size, flash_addr;
+    BusChild *kid;
+    int i;
+
+    if (!aspeed_smc_is_direct_read_cmd(aspeed_smc_flash_cmd(fl))) {
+        return false;
+    }
+
+    QTAILQ_FOREACH(kid, &BUS(s->spi)->children, sibling) {
+        storage = m25p80_get_read_window(kid->child, &flash_size,
+                                         &flash_addr);
+        if (storage) {
+            break;
+        }
+    }
+
+    if (!storage || flash_addr != addr) {
+        return false;
+    }
+
+    for (i = 0; i < size; i++) {
+        *data |= (uint64_t)storage[(flash_addr + i) & (flash_size - 1)]
+            << (8 * i);
+    }
+
+    /* 3-byte addresses only map the first 16MB of the flash linearly */
+    if (!s->regs[R_CE_CMD_CTRL] &&
+        (aspeed_smc_flash_addr_width(fl) == 4 || flash_size <= 16 * MiB)) {
+        aspeed_smc_flash_direct_enable(fl, storage, flash_size);
+    }
+
+    return true;
+}
+
 static uint64_t aspeed_smc_flash_read(void *opaque, hwaddr addr, unsigned size)
 {
     AspeedSMCFlash *fl = opaque;
@@ -496,8 +616,10 @@ static uint64_t aspeed_smc_flash_read(void *opaque, hwaddr addr, unsigned size)
         aspeed_smc_flash_select(fl);
         aspeed_smc_flash_setup(fl, addr);
 
-        for (i = 0; i < size; i++) {
-            ret |= ssi_transfer(s->spi, 0x0) << (8 * i);
+        if (!aspeed_smc_flash_direct_read(fl, addr, size, &ret)) {
+            for (i = 0; i < size; i++) {
+                ret |= ssi_transfer(s->spi, 0x0) << (8 * i);
+            }
         }
 
         aspeed_smc_flash_unselect(fl);
@@ -511,23 +633,6 @@ static uint64_t aspeed_smc_flash_read(void *opaque, hwaddr addr, unsigned size)
     return ret;
 }
 
-/*
- * TODO (clg@kaod.org): stolen from xilinx_spips.c. Should move to a
- * common include header.
- */
-typedef enum {
-    READ = 0x3,         READ_4 = 0x13,
-    FAST_READ = 0xb,    FAST_READ_4 = 0x0c,
-    DOR = 0x3b,         DOR_4 = 0x3c,
-    QOR = 0x6b,         QOR_4 = 0x6c,
-    DIOR = 0xbb,        DIOR_4 = 0xbc,
-    QIOR = 0xeb,        QIOR_4 = 0xec,
-
-    PP = 0x2,           PP_4 = 0x12,
-    DPP = 0xa2,
-    QPP = 0x32,         QPP_4 = 0x34,
-} FlashCMD;
-
 static int aspeed_smc_num_dummies(uint8_t command)
 {
     switch (command) { /* check for dummies */
@@ -626,6 +731,11 @@ static void aspeed_smc_flash_write(void *opaque, hwaddr addr, uint64_t data,
 
     switch (aspeed_smc_flash_mode(fl)) {
     case CTRL_USERMODE:
+        /* Any program or erase command must be preceded by a WREN */
+        if (s->snoop_index == SNOOP_START && (data & 0xff) == SPI_OP_WREN) {
+            fl->direct_modified = true;
+        }
+
         if (aspeed_smc_do_snoop(fl, data, size)) {
             break;
         }
@@ -635,6 +745,7 @@ static void aspeed_smc_flash_write(void *opaque, hwaddr addr, uint64_t data,
         }
         break;
     case CTRL_WRITEMODE:
+        fl->direct_modified = true;
         aspeed_smc_flash_select(fl);
         aspeed_smc_flash_setup(fl, addr);
 
@@ -677,6 +788,8 @@ static void aspeed_smc_flash_update_ctrl(AspeedSMCFlash *fl, uint32_t value)
 
     s->snoop_index = unselect ? SNOOP_OFF : SNOOP_START;
 
+    aspeed_smc_flash_direct_disable(fl);
+
     aspeed_smc_flash_do_select(fl, unselect);
 }
 
@@ -706,6 +819,10 @@ static void aspeed_smc_reset(DeviceState *d)
 
     s->snoop_index = SNOOP_OFF;
     s->snoop_dummies = 0;
+
+    if (aspeed_smc_has_dma(asc)) {
+        timer_del(&s->dma_timer);
+    }
 }
 
 static uint64_t aspeed_smc_read(void *opaque, hwaddr addr, unsigned int size)
@@ -826,107 +943,183 @@ static bool aspeed_smc_inject_read_failure(AspeedSMCState *s)
     }
 }
 
+/*
+ * DMA transfers are done in chunks from a timer, so that the vCPU is
+ * not stalled while large regions of the flash are being copied. The
+ * delay between two chunks models the time spent on the SPI bus.
+ */
+#define ASPEED_SMC_DMA_CHUNK_SIZE       (64 * KiB)
+#define ASPEED_SMC_DMA_CHUNK_DELAY_NS   (10 * SCALE_US)
+
+static uint32_t aspeed_smc_dma_sum(const uint8_t *buf, uint32_t len)
+{
+    uint32_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i < len; i += 4) {
+        sum += ldl_le_p(buf + i);
+    }
+    return sum;
+}
+
 /*
  * Accumulate the result of the reads to provide a checksum that will
  * be used to validate the read timing settings.
  */
-static void aspeed_smc_dma_checksum(AspeedSMCState *s)
+static bool aspeed_smc_dma_checksum(AspeedSMCState *s, uint32_t len)
 {
     MemTxResult result;
-    uint32_t data;
+    uint32_t sum;
 
-    if (s->regs[R_DMA_CTRL] & DMA_CTRL_WRITE) {
-        aspeed_smc_error("invalid direction for DMA checksum");
-        return;
+    result = address_space_read(&s->flash_as, s->regs[R_DMA_FLASH_ADDR],
+                                MEMTXATTRS_UNSPECIFIED, s->dma_buf, len);
+    if (result != MEMTX_OK) {
+        aspeed_smc_error("Flash read failed @%08x",
+                         s->regs[R_DMA_FLASH_ADDR]);
+        return false;
     }
 
-    if (s->regs[R_DMA_CTRL] & DMA_CTRL_CALIB) {
-        aspeed_smc_dma_calibration(s);
+    sum = aspeed_smc_dma_sum(s->dma_buf, len);
+    trace_aspeed_smc_dma_checksum(s->regs[R_DMA_FLASH_ADDR], sum);
+    s->regs[R_DMA_CHECKSUM] += sum;
+    return true;
+}
+
+/*
+ * The DRAM side of the transfer is accessed directly when it can be
+ * mapped. Otherwise, the data goes through the DMA bounce buffer.
+ */
+static bool aspeed_smc_dma_rw(AspeedSMCState *s, uint32_t *len)
+{
+    bool is_write = s->regs[R_DMA_CTRL] & DMA_CTRL_WRITE;
+    hwaddr dram_addr = s->regs[R_DMA_DRAM_ADDR];
+    hwaddr flash_addr = s->regs[R_DMA_FLASH_ADDR];
+    hwaddr plen = *len;
+    MemTxResult result;
+    uint8_t *map;
+    uint8_t *buf;
+    bool ret = false;
+
+    map = address_space_map(&s->dram_as, dram_addr, &plen, !is_write,
+                            MEMTXATTRS_UNSPECIFIED);
+    if (map) {
+        /* Keep the DMA length 4 bytes aligned */
+        plen &= ~(hwaddr)3;
+        if (!plen) {
+            address_space_unmap(&s->dram_as, map, 0, !is_write, 0);
+            map = NULL;
+        } else {
+            *len = plen;
+        }
     }
+    buf = map ? map : s->dma_buf;
+
+    if (is_write) {
+        if (!map) {
+            result = address_space_read(&s->dram_as, dram_addr,
+                                        MEMTXATTRS_UNSPECIFIED, buf, *len);
+            if (result != MEMTX_OK) {
+                aspeed_smc_error("DRAM read failed @%08x",
+                                 s->regs[R_DMA_DRAM_ADDR]);
+                goto out;
+            }
+        }
 
-    while (s->regs[R_DMA_LEN]) {
-        data = address_space_ldl_le(&s->flash_as, s->regs[R_DMA_FLASH_ADDR],
-                                    MEMTXATTRS_UNSPECIFIED, &result);
+        result = address_space_write(&s->flash_as, flash_addr,
+                                     MEMTXATTRS_UNSPECIFIED, buf, *len);
+        if (result != MEMTX_OK) {
+            aspeed_smc_error("Flash write failed @%08x",
+                             s->regs[R_DMA_FLASH_ADDR]);
+            goto out;
+        }
+    } else {
+        result = address_space_read(&s->flash_as, flash_addr,
+                                    MEMTXATTRS_UNSPECIFIED, buf, *len);
         if (result != MEMTX_OK) {
             aspeed_smc_error("Flash read failed @%08x",
                              s->regs[R_DMA_FLASH_ADDR]);
-            return;
+            goto out;
         }
-        trace_aspeed_smc_dma_checksum(s->regs[R_DMA_FLASH_ADDR], data);
 
-        /*
-         * When the DMA is on-going, the DMA registers are updated
-         * with the current working addresses and length.
-         */
-        s->regs[R_DMA_CHECKSUM] += data;
-        s->regs[R_DMA_FLASH_ADDR] += 4;
-        s->regs[R_DMA_LEN] -= 4;
+        if (!map) {
+            result = address_space_write(&s->dram_as, dram_addr,
+                                         MEMTXATTRS_UNSPECIFIED, buf, *len);
+            if (result != MEMTX_OK) {
+                aspeed_smc_error("DRAM write failed @%08x",
+                                 s->regs[R_DMA_DRAM_ADDR]);
+                goto out;
+            }
+        }
     }
 
-    if (s->inject_failure && aspeed_smc_inject_read_failure(s)) {
-        s->regs[R_DMA_CHECKSUM] = 0xbadc0de;
+    s->regs[R_DMA_CHECKSUM] += aspeed_smc_dma_sum(buf, *len);
+    ret = true;
+
+out:
+    if (map) {
+        address_space_unmap(&s->dram_as, map, plen, !is_write,
+                            ret && !is_write ? *len : 0);
     }
+    return ret;
+}
 
+static void aspeed_smc_dma_done(AspeedSMCState *s)
+{
+    s->regs[R_INTR_CTRL] |= INTR_CTRL_DMA_STATUS;
+    if (s->regs[R_INTR_CTRL] & INTR_CTRL_DMA_EN) {
+        qemu_irq_raise(s->irq);
+    }
 }
 
-static void aspeed_smc_dma_rw(AspeedSMCState *s)
+static void aspeed_smc_dma_schedule(AspeedSMCState *s)
 {
-    MemTxResult result;
-    uint32_t data;
-
-    trace_aspeed_smc_dma_rw(s->regs[R_DMA_CTRL] & DMA_CTRL_WRITE ?
-                            "write" : "read",
-                            s->regs[R_DMA_FLASH_ADDR],
-                            s->regs[R_DMA_DRAM_ADDR],
-                            s->regs[R_DMA_LEN]);
-    while (s->regs[R_DMA_LEN]) {
-        if (s->regs[R_DMA_CTRL] & DMA_CTRL_WRITE) {
-            data = address_space_ldl_le(&s->dram_as, s->regs[R_DMA_DRAM_ADDR],
-                                        MEMTXATTRS_UNSPECIFIED, &result);
-            if (result != MEMTX_OK) {
-                aspeed_smc_error("DRAM read failed @%08x",
-                                 s->regs[R_DMA_DRAM_ADDR]);
-                return;
-            }
+    timer_mod(&s->dma_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) +
+              ASPEED_SMC_DMA_CHUNK_DELAY_NS);
+}
 
-            address_space_stl_le(&s->flash_as, s->regs[R_DMA_FLASH_ADDR],
-                                 data, MEMTXATTRS_UNSPECIFIED, &result);
-            if (result != MEMTX_OK) {
-                aspeed_smc_error("Flash write failed @%08x",
-                                 s->regs[R_DMA_FLASH_ADDR]);
-                return;
-            }
-        } else {
-            data = address_space_ldl_le(&s->flash_as, s->regs[R_DMA_FLASH_ADDR],
-                                        MEMTXATTRS_UNSPECIFIED, &result);
-            if (result != MEMTX_OK) {
-                aspeed_smc_error("Flash read failed @%08x",
-                                 s->regs[R_DMA_FLASH_ADDR]);
-                return;
-            }
+static void aspeed_smc_dma_step(void *opaque)
+{
+    AspeedSMCState *s = ASPEED_SMC(opaque);
+    uint32_t len = MIN(s->regs[R_DMA_LEN], ASPEED_SMC_DMA_CHUNK_SIZE);
+    bool ok;
 
-            address_space_stl_le(&s->dram_as, s->regs[R_DMA_DRAM_ADDR],
-                                 data, MEMTXATTRS_UNSPECIFIED, &result);
-            if (result != MEMTX_OK) {
-                aspeed_smc_error("DRAM write failed @%08x",
-                                 s->regs[R_DMA_DRAM_ADDR]);
-                return;
-            }
+    if (len) {
+        if (s->regs[R_DMA_CTRL] & DMA_CTRL_CKSUM) {
+            ok = aspeed_smc_dma_checksum(s, len);
+        } else {
+            ok = aspeed_smc_dma_rw(s, &len);
         }
 
         /*
          * When the DMA is on-going, the DMA registers are updated
          * with the current working addresses and length.
          */
-        s->regs[R_DMA_FLASH_ADDR] += 4;
-        s->regs[R_DMA_DRAM_ADDR] += 4;
-        s->regs[R_DMA_LEN] -= 4;
-        s->regs[R_DMA_CHECKSUM] += data;
+        if (ok) {
+            s->regs[R_DMA_FLASH_ADDR] += len;
+            if (!(s->regs[R_DMA_CTRL] & DMA_CTRL_CKSUM)) {
+                s->regs[R_DMA_DRAM_ADDR] += len;
+            }
+            s->regs[R_DMA_LEN] -= len;
+        }
+
+        if (ok && s->regs[R_DMA_LEN]) {
+            aspeed_smc_dma_schedule(s);
+            return;
+        }
+    }
+
+    if (s->regs[R_DMA_CTRL] & DMA_CTRL_CKSUM &&
+        s->inject_failure && aspeed_smc_inject_read_failure(s)) {
+        s->regs[R_DMA_CHECKSUM] = 0xbadc0de;
     }
+
+    aspeed_smc_dma_done(s);
 }
 
 static void aspeed_smc_dma_stop(AspeedSMCState *s)
 {
+    timer_del(&s->dma_timer);
+
     /*
      * When the DMA is disabled, INTR_CTRL_DMA_STATUS=0 means the
      * engine is idle
@@ -951,14 +1144,6 @@ static bool aspeed_smc_dma_in_progress(AspeedSMCState *s)
         !(s->regs[R_INTR_CTRL] & INTR_CTRL_DMA_STATUS);
 }
 
-static void aspeed_smc_dma_done(AspeedSMCState *s)
-{
-    s->regs[R_INTR_CTRL] |= INTR_CTRL_DMA_STATUS;
-    if (s->regs[R_INTR_CTRL] & INTR_CTRL_DMA_EN) {
-        qemu_irq_raise(s->irq);
-    }
-}
-
 static void aspeed_smc_dma_ctrl(AspeedSMCState *s, uint32_t dma_ctrl)
 {
     if (!(dma_ctrl & DMA_CTRL_ENABLE)) {
@@ -974,14 +1159,27 @@ static void aspeed_smc_dma_ctrl(AspeedSMCState *s, uint32_t dma_ctrl)
     }
 
     s->regs[R_DMA_CTRL] = dma_ctrl;
+    s->regs[R_INTR_CTRL] &= ~INTR_CTRL_DMA_STATUS;
 
     if (s->regs[R_DMA_CTRL] & DMA_CTRL_CKSUM) {
-        aspeed_smc_dma_checksum(s);
+        if (s->regs[R_DMA_CTRL] & DMA_CTRL_WRITE) {
+            aspeed_smc_error("invalid direction for DMA checksum");
+            aspeed_smc_dma_done(s);
+            return;
+        }
+
+        if (s->regs[R_DMA_CTRL] & DMA_CTRL_CALIB) {
+            aspeed_smc_dma_calibration(s);
+        }
     } else {
-        aspeed_smc_dma_rw(s);
+        trace_aspeed_smc_dma_rw(s->regs[R_DMA_CTRL] & DMA_CTRL_WRITE ?
+                                "write" : "read",
+                                s->regs[R_DMA_FLASH_ADDR],
+                                s->regs[R_DMA_DRAM_ADDR],
+                                s->regs[R_DMA_LEN]);
     }
 
-    aspeed_smc_dma_done(s);
+    aspeed_smc_dma_schedule(s);
 }
 
 static inline bool aspeed_smc_dma_granted(AspeedSMCState *s)
@@ -1026,6 +1224,16 @@ static void aspeed_2600_smc_dma_ctrl(AspeedSMCState *s, uint32_t dma_ctrl)
     s->regs[R_DMA_CTRL] &= ~(DMA_CTRL_REQUEST | DMA_CTRL_GRANT);
 }
 
+static void aspeed_smc_flash_direct_disable_all(AspeedSMCState *s)
+{
+    AspeedSMCClass *asc = ASPEED_SMC_GET_CLASS(s);
+    int i;
+
+    for (i = 0; i < asc->cs_num_max; i++) {
+        aspeed_smc_flash_direct_disable(&s->flashes[i]);
+    }
+}
+
 static void aspeed_smc_write(void *opaque, hwaddr addr, uint64_t data,
                              unsigned int size)
 {
@@ -1039,9 +1247,11 @@ static void aspeed_smc_write(void *opaque, hwaddr addr, uint64_t data,
 
     if (addr == s->r_conf ||
         (addr >= s->r_timings &&
-         addr < s->r_timings + asc->nregs_timings) ||
-        addr == s->r_ce_ctrl) {
+         addr < s->r_timings + asc->nregs_timings)) {
         s->regs[addr] = value;
+    } else if (addr == s->r_ce_ctrl) {
+        s->regs[addr] = value;
+        aspeed_smc_flash_direct_disable_all(s);
     } else if (addr >= s->r_ctrl0 && addr < s->r_ctrl0 + asc->cs_num_max) {
         int cs = addr - s->r_ctrl0;
         aspeed_smc_flash_update_ctrl(&s->flashes[cs], value);
@@ -1054,6 +1264,7 @@ static void aspeed_smc_write(void *opaque, hwaddr addr, uint64_t data,
         }
     } else if (addr == R_CE_CMD_CTRL) {
         s->regs[addr] = value & 0xff;
+        aspeed_smc_flash_direct_disable_all(s);
     } else if (addr == R_DUMMY_DATA) {
         s->regs[addr] = value & 0xff;
     } else if (aspeed_smc_has_wdt_control(asc) && addr == R_FMC_WDT2_CTRL) {
@@ -1110,6 +1321,9 @@ static void aspeed_smc_dma_setup(AspeedSMCState *s, Error **errp)
                        TYPE_ASPEED_SMC ".dma-flash");
     address_space_init(&s->dram_as, s->dram_mr,
                        TYPE_ASPEED_SMC ".dma-dram");
+
+    s->dma_buf = g_malloc(ASPEED_SMC_DMA_CHUNK_SIZE);
+    timer_init_ns(&s->dma_timer, QEMU_CLOCK_VIRTUAL, aspeed_smc_dma_step, s);
 }
 
 static void aspeed_smc_realize(DeviceState *dev, Error **errp)
@@ -1192,10 +1406,23 @@ static void aspeed_smc_realize(DeviceState *dev, Error **errp)
     }
 }
 
+static int aspeed_smc_post_load(void *opaque, int version_id)
+{
+    AspeedSMCState *s = ASPEED_SMC(opaque);
+
+    /* Resume an on-going DMA transfer */
+    if (aspeed_smc_has_dma(ASPEED_SMC_GET_CLASS(s)) &&
+        aspeed_smc_dma_in_progress(s)) {
+        timer_mod(&s->dma_timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    }
+    return 0;
+}
+
 static const VMStateDescription vmstate_aspeed_smc = {
     .name = "aspeed.smc",
     .version_id = 2,
     .minimum_version_id = 2,
+    .post_load = aspeed_smc_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32_ARRAY(regs, AspeedSMCState, ASPEED_SMC_R_MAX),
         VMSTATE_UINT8(snoop_index, AspeedSMCState),
@@ -16,6 +16,8 @@
 #include "hw/timer/aspeed_timer.h"
 #include "migration/vmstate.h"
 #include "qemu/bitops.h"
+#include "qemu/lockable.h"
+#include "qemu/main-loop.h"
 #include "qemu/timer.h"
 #include "qemu/log.h"
 #include "qemu/module.h"
@@ -187,6 +189,8 @@ static void aspeed_timer_expire(void *opaque)
     bool interrupt = false;
     uint32_t ticks;
 
+    QEMU_LOCK_GUARD(&timer_to_ctrl(t)->lock);
+
     if (!timer_enabled(t)) {
         return;
     }
@@ -245,6 +249,8 @@ static uint64_t aspeed_timer_read(void *opaque, hwaddr offset, unsigned size)
     const int reg = (offset & 0xf) / 4;
     uint64_t value;
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     switch (offset) {
     case 0x30: /* Control Register */
         value = s->ctrl;
@@ -435,6 +441,10 @@ static void aspeed_timer_write(void *opaque, hwaddr offset, uint64_t value,
     const int reg = (offset & 0xf) / 4;
     AspeedTimerCtrlState *s = opaque;
 
+    /* Writes may raise the timer interrupts, which needs the BQL */
+    QEMU_IOTHREAD_LOCK_GUARD();
+    QEMU_LOCK_GUARD(&s->lock);
+
     switch (offset) {
     /* Control Registers */
     case 0x30:
@@ -611,8 +621,10 @@ static void aspeed_timer_realize(DeviceState *dev, Error **errp)
         aspeed_init_one_timer(s, i);
         sysbus_init_irq(sbd, &s->timers[i].irq);
     }
+    qemu_mutex_init(&s->lock);
     memory_region_init_io(&s->iomem, OBJECT(s), &aspeed_timer_ops, s,
                           TYPE_ASPEED_TIMER, 0x1000);
+    memory_region_clear_global_locking(&s->iomem);
     sysbus_init_mmio(sbd, &s->iomem);
 }
 
@@ -621,6 +633,8 @@ static void aspeed_timer_reset(DeviceState *dev)
     int i;
     AspeedTimerCtrlState *s = ASPEED_TIMER(dev);
 
+    QEMU_LOCK_GUARD(&s->lock);
+
     for (i = 0; i < ASPEED_TIMER_NR_TIMERS; i++) {
         AspeedTimer *t = &s->timers[i];
         /* Explicitly call helpers to avoid any conditional behaviour through
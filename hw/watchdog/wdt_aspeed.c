@@ -10,6 +10,7 @@
 #include "qemu/osdep.h"
 
 #include "qapi/error.h"
+#include "qemu/lockable.h"
 #include "qemu/log.h"
 #include "qemu/module.h"
 #include "qemu/timer.h"
@@ -245,9 +246,15 @@ static void aspeed_wdt_timer_expired(void *dev)
 {
     AspeedWDTState *s = ASPEED_WDT(dev);
     uint32_t reset_ctrl_reg = ASPEED_WDT_GET_CLASS(s)->reset_ctrl_reg;
+    uint32_t reset_ctrl;
+
+    /* The guest writes the SCU without the BQL */
+    WITH_QEMU_LOCK_GUARD(&s->scu->lock) {
+        reset_ctrl = s->scu->regs[reset_ctrl_reg];
+    }
 
     /* Do not reset on SDRAM controller reset */
-    if (s->scu->regs[reset_ctrl_reg] & SCU_RESET_SDRAM) {
+    if (reset_ctrl & SCU_RESET_SDRAM) {
         timer_del(s->timer);
         s->regs[WDT_CTRL] = 0;
         return;
@@ -23,6 +23,13 @@
 
 #include "qapi/qapi-types-crypto.h"
 
+typedef struct QCryptoHash QCryptoHash;
+struct QCryptoHash {
+    QCryptoHashAlgorithm alg;
+    void *opaque;
+    void *driver;
+};
+
 /* See also "QCryptoHashAlgorithm" defined in qapi/crypto.json */
 
 /**
@@ -189,4 +196,84 @@ int qcrypto_hash_base64(QCryptoHashAlgorithm alg,
                         char **base64,
                         Error **errp);
 
+/**
+ * qcrypto_hash_new:
+ * @alg: the hash algorithm
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Creates a new hashing context for the @alg algorithm, to
+ * compute a hash incrementally with qcrypto_hash_updatev()
+ * and qcrypto_hash_finalize_bytes(). The context must be
+ * released with qcrypto_hash_free() when no longer required.
+ *
+ * Returns: the new hashing context, or NULL on error
+ */
+QCryptoHash *qcrypto_hash_new(QCryptoHashAlgorithm alg, Error **errp);
+
+/**
+ * qcrypto_hash_updatev:
+ * @hash: the hashing context
+ * @iov: the array of memory regions to hash
+ * @niov: the length of @iov
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Adds the data present in the memory regions of @iov
+ * to the hash computed by @hash.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int qcrypto_hash_updatev(QCryptoHash *hash,
+                         const struct iovec *iov,
+                         size_t niov,
+                         Error **errp);
+
+/**
+ * qcrypto_hash_update:
+ * @hash: the hashing context
+ * @buf: the memory region to hash
+ * @len: the length of @buf
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Adds the data present in the memory region @buf of
+ * length @len to the hash computed by @hash.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int qcrypto_hash_update(QCryptoHash *hash,
+                        const char *buf,
+                        size_t len,
+                        Error **errp);
+
+/**
+ * qcrypto_hash_finalize_bytes:
+ * @hash: the hashing context
+ * @result: pointer to hold output hash
+ * @resultlen: pointer to hold length of @result
+ * @errp: pointer to a NULL-initialized error object
+ *
+ * Computes the hash of all the data added to @hash. The
+ * @result pointer will be filled with raw bytes representing
+ * the computed hash, which will have length @resultlen. The
+ * memory pointer in @result must be released with a call to
+ * g_free() when no longer required. No more data can be added
+ * to @hash afterwards.
+ *
+ * Returns: 0 on success, -1 on error
+ */
+int qcrypto_hash_finalize_bytes(QCryptoHash *hash,
+                                uint8_t **result,
+                                size_t *resultlen,
+                                Error **errp);
+
+/**
+ * qcrypto_hash_free:
+ * @hash: the hashing context
+ *
+ * Releases the hashing context @hash. It is safe to pass
+ * NULL.
+ */
+void qcrypto_hash_free(QCryptoHash *hash);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(QCryptoHash, qcrypto_hash_free)
+
 #endif /* QCRYPTO_HASH_H */
@@ -76,8 +76,15 @@ typedef uint64_t target_ulong;
 
 #if !defined(CONFIG_USER_ONLY) && defined(CONFIG_TCG)
 
-/* use a fully associative victim tlb of 8 entries */
-#define CPU_VTLB_SIZE 8
+/*
+ * The victim tlb is set associative, with CPU_VTLB_WAYS entries per set.
+ * The number of sets is resized together with the main tlb, depending on
+ * the time spent refilling it (see tlb_mmu_resize_locked).
+ */
+#define CPU_VTLB_WAYS 4
+#define CPU_VTLB_MIN_BITS 1
+#define CPU_VTLB_DEFAULT_BITS 2
+#define CPU_VTLB_MAX_BITS 6
 
 #if HOST_LONG_BITS == 32 && TARGET_LONG_BITS == 32
 #define CPU_TLB_ENTRY_BITS 4
@@ -168,13 +175,25 @@ typedef struct CPUTLBDesc {
     /* maximum number of entries observed in the window */
     size_t window_max_entries;
     size_t n_used_entries;
-    /* The next index to use in the tlb victim table.  */
+    /* host time (in ns) spent refilling the tlb in the window */
+    int64_t window_fill_ns;
+    /* The next way to use in the tlb victim table.  */
     size_t vindex;
-    /* The tlb victim table, in two parts.  */
-    CPUTLBEntry vtable[CPU_VTLB_SIZE];
-    CPUIOTLBEntry viotlb[CPU_VTLB_SIZE];
+    /* log2 of the number of sets in the tlb victim table */
+    unsigned vbits;
+    /* The tlb victim table, in two parts, of CPU_VTLB_WAYS << vbits entries */
+    CPUTLBEntry *vtable;
+    CPUIOTLBEntry *viotlb;
     /* The iotlb.  */
     CPUIOTLBEntry *iotlb;
+    /*
+     * Statistics, read and written atomically as those in CPUTLBCommon.
+     * A fill is a miss in both the main and the victim tlb.
+     */
+    size_t victim_hit_count;
+    size_t fill_count;
+    size_t flush_count;
+    uint64_t fill_ns;
 } CPUTLBDesc;
 
 /*
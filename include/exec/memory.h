@@ -69,7 +69,10 @@ static inline void fuzz_dma_read_cb(size_t addr,
 /* Dirty tracking enabled because measuring dirty rate */
 #define GLOBAL_DIRTY_DIRTY_RATE (1U << 1)
 
-#define GLOBAL_DIRTY_MASK  (0x3)
+/* Dirty tracking enabled because an in-memory checkpoint exists */
+#define GLOBAL_DIRTY_CHECKPOINT (1U << 2)
+
+#define GLOBAL_DIRTY_MASK  (0x7)
 
 extern unsigned int global_dirty_tracking;
 
@@ -730,6 +733,7 @@ struct MemoryRegion {
     bool nonvolatile;
     bool rom_device;
     bool flush_coalesced_mmio;
+    bool global_locking;
     uint8_t dirty_log_mask;
     bool is_iommu;
     RAMBlock *ram_block;
@@ -2023,7 +2027,9 @@ void memory_region_reset_dirty(MemoryRegion *mr, hwaddr addr,
  *
  * The MemoryRegionOps->write() callback of a ROM device must use this function
  * to mark byte ranges that have been modified internally, such as by directly
- * accessing the memory returned by memory_region_get_ram_ptr().
+ * accessing the memory returned by memory_region_get_ram_ptr(). The same
+ * applies to read-only RAM regions whose backing memory is modified by
+ * their owner.
  *
  * This function marks the range dirty and invalidates TBs so that TCG can
  * detect self-modifying code.
@@ -2133,6 +2139,33 @@ void memory_region_set_flush_coalesced(MemoryRegion *mr);
  */
 void memory_region_clear_flush_coalesced(MemoryRegion *mr);
 
+/**
+ * memory_region_clear_global_locking: Declares that access processing does
+ *                                     not depend on the QEMU global lock.
+ *
+ * By clearing this property, accesses to the memory region will be processed
+ * outside of QEMU's global lock (unless the lock is held on when issuing the
+ * access request). In this case, the device model implementing the access
+ * handlers is responsible for synchronization of concurrency.  Handlers
+ * that need the global lock, e.g. to raise an interrupt, take it with
+ * QEMU_IOTHREAD_LOCK_GUARD() before any lock of their own.
+ *
+ * @mr: the memory region to be updated.
+ */
+void memory_region_clear_global_locking(MemoryRegion *mr);
+
+/**
+ * memory_region_set_global_locking: Declares the access processing requires
+ *                                   QEMU's global lock.
+ *
+ * When this is invoked, accesses to the memory region will be processed while
+ * holding the global lock of QEMU. This is the default behavior of memory
+ * regions.
+ *
+ * @mr: the memory region to be updated.
+ */
+void memory_region_set_global_locking(MemoryRegion *mr);
+
 /**
  * memory_region_add_eventfd: Request an eventfd to be triggered when a word
  *                            is written to a location.
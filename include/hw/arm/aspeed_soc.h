@@ -50,6 +50,7 @@ struct AspeedSoCState {
     ARMCPU cpu[ASPEED_CPUS_NUM];
     A15MPPrivState     a7mpcore;
     ARMv7MState        armv7m;
+    MemoryRegion *memory;
     MemoryRegion *dram_mr;
     MemoryRegion sram;
     AspeedVICState vic;
@@ -76,6 +77,7 @@ struct AspeedSoCState {
     AspeedLPCState lpc;
     AspeedPECIState peci;
     uint32_t uart_default;
+    uint32_t serial_base;
     Clock *sysclk;
 };
 
@@ -169,4 +171,13 @@ enum {
 qemu_irq aspeed_soc_get_irq(AspeedSoCState *s, int dev);
 void aspeed_soc_uart_init(AspeedSoCState *s);
 
+/*
+ * Map the devices of the SoC in the "memory" link of @s, which defaults
+ * to the system memory. Boards running several SoCs give each of them its
+ * own address space container.
+ */
+void aspeed_mmio_map(AspeedSoCState *s, SysBusDevice *dev, int n, hwaddr addr);
+void aspeed_mmio_map_unimplemented(AspeedSoCState *s, const char *name,
+                                   hwaddr addr, uint64_t size);
+
 #endif /* ASPEED_SOC_H */
@@ -65,6 +65,10 @@ uint32_t nand_getbuswidth(DeviceState *dev);
 /* onenand.c */
 void *onenand_raw_otp(DeviceState *onenand_device);
 
+/* m25p80.c */
+uint8_t *m25p80_get_read_window(DeviceState *dev, uint32_t *size,
+                                uint32_t *addr);
+
 /* ecc.c */
 typedef struct {
     uint8_t cp;		/* Column parity */
@@ -78,6 +78,12 @@ struct SerialState {
 
     QEMUTimer *modem_status_poll;
     MemoryRegion io;
+
+    /* Coalesced chardev accesses, see serial_tx_queue() */
+    bool coalesce;
+    uint8_t *tx_buf;
+    uint32_t tx_len;
+    QEMUTimer *tx_flush_timer;
 };
 typedef struct SerialState SerialState;
 
@@ -88,6 +94,7 @@ struct SerialMM {
 
     uint8_t regshift;
     uint8_t endianness;
+    bool lockless;      /* dispatched without the BQL */
 };
 
 extern const VMStateDescription vmstate_serial;
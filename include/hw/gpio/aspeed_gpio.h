@@ -11,6 +11,7 @@
 #define ASPEED_GPIO_H
 
 #include "hw/sysbus.h"
+#include "qemu/thread.h"
 #include "qom/object.h"
 
 #define TYPE_ASPEED_GPIO "aspeed.gpio"
@@ -69,10 +70,23 @@ struct AspeedGPIOState {
 
     /*< public >*/
     MemoryRegion iomem;
+
+    /*
+     * Protects the registers, which the guest reads without the BQL. It is
+     * held while the output lines are updated, and the devices connected to
+     * them may set the input pins in return.
+     */
+    QemuRecMutex lock;
+
     int pending;
     qemu_irq irq;
     qemu_irq gpios[ASPEED_GPIO_MAX_NR_SETS][ASPEED_GPIOS_PER_SET];
 
+    /* GPIO_CHANGE events for output pins */
+    bool change_events;
+    QEMUBH *change_bh;
+    uint32_t changed[ASPEED_GPIO_MAX_NR_SETS];
+
 /* Parallel GPIO Registers */
     uint32_t debounce_regs[ASPEED_GPIO_NR_DEBOUNCE_REGS];
     struct GPIOSets {
@@ -23,6 +23,7 @@
 
 #include "hw/i2c/i2c.h"
 #include "hw/sysbus.h"
+#include "hw/register-ram.h"
 #include "qom/object.h"
 
 #define TYPE_ASPEED_I2C "aspeed.i2c"
@@ -33,7 +34,6 @@
 OBJECT_DECLARE_TYPE(AspeedI2CState, AspeedI2CClass, ASPEED_I2C)
 
 #define ASPEED_I2C_NR_BUSSES 16
-#define ASPEED_I2C_MAX_POOL_SIZE 0x800
 
 struct AspeedI2CState;
 
@@ -44,10 +44,14 @@ struct AspeedI2CBus {
 
     struct AspeedI2CState *controller;
     struct AspeedI2CSlave *slave;
+    /* Slave function of this bus, as seen from a peer bus */
+    struct AspeedI2CSlave *peer_slave;
 
     MemoryRegion mr;
 
     I2CBus *bus;
+    /* Bus of the master currently addressing the slave function */
+    I2CBus *slave_bus;
     uint8_t id;
     qemu_irq irq;
 
@@ -66,6 +70,11 @@ struct AspeedI2CBus {
 
     uint8_t tx_state_machine;
 
+    /* Master command stalled until the I2C target completes this step */
+    I2CAsyncOp async_op;
+    /* Up to 256 bytes of the pool buffer, or the byte of the byte mode */
+    uint16_t pool_pos;
+
     uint32_t slave_cmd;
     uint32_t slave_dma_addr;
     uint32_t slave_dma_len;
@@ -84,8 +93,7 @@ struct AspeedI2CState {
     uint32_t intr_status;
     uint32_t ctrl_global;
     uint32_t new_divider;
-    MemoryRegion pool_iomem;
-    uint8_t pool[ASPEED_I2C_MAX_POOL_SIZE];
+    RegisterRAM pool;
 
     AspeedI2CBus busses[ASPEED_I2C_NR_BUSSES];
     MemoryRegion *dram_mr;
@@ -117,4 +125,12 @@ struct AspeedI2CClass {
 
 I2CBus *aspeed_i2c_get_bus(AspeedI2CState *s, int busnr);
 
+/**
+ * aspeed_i2c_bus_connect: also attach the slave function of @bus to @peer,
+ * the bus of another controller. Masters on @peer then reach the slave of
+ * @bus with direct calls, as if both controllers shared the physical bus.
+ * Used by boards running several Aspeed SoCs in one machine.
+ */
+void aspeed_i2c_bus_connect(AspeedI2CBus *bus, I2CBus *peer);
+
 #endif /* ASPEED_I2C_H */
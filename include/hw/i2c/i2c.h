@@ -4,10 +4,13 @@
 #include "hw/qdev-core.h"
 #include "qom/object.h"
 
-/* The QEMU I2C implementation only supports simple transfers that complete
-   immediately.  It does not support slave devices that need to be able to
-   defer their response (eg. CPU slave interfaces where the data is supplied
-   by the device driver in response to an interrupt).  */
+/*
+ * Most I2C transfers complete immediately. Slave devices that need to defer
+ * their response (eg. CPU slave interfaces where the data is supplied by the
+ * device driver in response to an interrupt, or bridges to another process)
+ * implement the asynchronous handlers of I2CSlaveClass, and masters that can
+ * wait for them drive the bus with the i2c_async_*() helpers.
+ */
 
 enum i2c_event {
     I2C_START_RECV,
@@ -28,7 +31,7 @@ struct I2CSlaveClass {
     /* Master to slave. Returns non-zero for a NAK, 0 for success. */
     int (*send)(I2CSlave *s, uint8_t data);
 
-    /* Master to slave. */
+    /* Master to slave. Completed with i2c_ack() or i2c_async_complete(). */
     void (*send_async)(I2CSlave *s, uint8_t data);
 
     /*
@@ -37,6 +40,25 @@ struct I2CSlaveClass {
      */
     uint8_t (*recv)(I2CSlave *s);
 
+    /*
+     * Slave to master, deferred. The device supplies the byte later with
+     * i2c_async_complete().
+     */
+    void (*recv_async)(I2CSlave *s);
+
+    /*
+     * Master to slave, several bytes at once. Returns the number of bytes
+     * ACKed: when less than @len, the byte that follows was NAKed and ends
+     * the transfer. Optional, i2c_send_buf() falls back to @send.
+     */
+    size_t (*send_buf)(I2CSlave *s, const uint8_t *buf, size_t len);
+
+    /*
+     * Slave to master, several bytes at once. Optional, i2c_recv_buf()
+     * falls back to @recv.
+     */
+    void (*recv_buf)(I2CSlave *s, uint8_t *buf, size_t len);
+
     /*
      * Notify the slave of a bus state change.  For start event,
      * returns non-zero to NAK an operation.  For other events the
@@ -44,6 +66,18 @@ struct I2CSlaveClass {
      */
     int (*event)(I2CSlave *s, enum i2c_event event);
 
+    /*
+     * Deferred variant of event. The device completes it later with
+     * i2c_ack(), or with a non-zero i2c_async_complete() status to NAK a
+     * start event.
+     *
+     * The asynchronous handlers are only used by masters issuing
+     * i2c_async_*() transfers, and only when the device is the sole target
+     * of the transfer. Devices should keep the synchronous handlers for
+     * the other cases.
+     */
+    void (*event_async)(I2CSlave *s, enum i2c_event event);
+
     /*
      * Check if this device matches the address provided.  Returns bool of
      * true if it matches (or broadcast), and updates the device list, false
@@ -53,6 +87,17 @@ struct I2CSlaveClass {
      */
     bool (*match_and_add)(I2CSlave *candidate, uint8_t address, bool broadcast,
                           I2CNodeList *current_devs);
+
+    /*
+     * Add the devices matched by @match_and_add to @routes, the routing
+     * table of the bus indexed by address. Entries already set come from
+     * devices scanned first and must be kept. Returns false if the device
+     * cannot be routed, and its bus must be scanned on every start.
+     *
+     * Devices overriding @match_and_add must implement it too, to route
+     * the bus with a table.
+     */
+    bool (*route)(I2CSlave *candidate, I2CSlave **routes);
 };
 
 struct I2CSlave {
@@ -82,6 +127,39 @@ struct I2CPendingMaster {
 typedef QLIST_HEAD(I2CNodeList, I2CNode) I2CNodeList;
 typedef QSIMPLEQ_HEAD(I2CPendingMasters, I2CPendingMaster) I2CPendingMasters;
 
+/* Size of the routing table of a bus, one entry per 7-bit address */
+#define I2C_ROUTES 128
+
+/* Returned by the i2c_async_*() helpers when the target defers its answer */
+#define I2C_ASYNC_PENDING 1
+
+/*
+ * Completion callback of a deferred i2c_async_*() operation. @ret is 0 when
+ * the target acked and non-zero for a NAK; @data is the received byte of an
+ * i2c_async_recv().
+ */
+typedef void (*I2CAsyncCompletionFunc)(void *opaque, int ret, uint8_t data);
+
+typedef enum I2CAsyncOp {
+    I2C_ASYNC_NONE,
+    I2C_ASYNC_START,
+    I2C_ASYNC_SEND,
+    I2C_ASYNC_RECV,
+    I2C_ASYNC_NACK,
+    I2C_ASYNC_END,
+} I2CAsyncOp;
+
+typedef struct I2CAsyncState {
+    I2CAsyncOp op;
+    I2CAsyncCompletionFunc cb;
+    void *opaque;
+    bool in_handler;    /* target handler has not returned yet */
+    bool done;          /* completed from within the target handler */
+    bool scanned;       /* start of a new transfer */
+    int ret;
+    uint8_t data;
+} I2CAsyncState;
+
 struct I2CBus {
     BusState qbus;
     I2CNodeList current_devs;
@@ -91,6 +169,20 @@ struct I2CBus {
 
     /* Set from slave currently mastering the bus. */
     QEMUBH *bh;
+
+    /* Operation of the current master waiting for the target */
+    I2CAsyncState async;
+
+    /*
+     * Device answering each address, on the bus or behind its muxes, so
+     * that a start needs no scan. Rebuilt after i2c_bus_invalidate_routes().
+     */
+    I2CSlave *routes[I2C_ROUTES];
+    bool routes_valid;
+    /* A device cannot be routed, the bus is scanned on every start */
+    bool routes_scan;
+    /* current_devs entry of a routed transfer, to not allocate one */
+    I2CNode route_node;
 };
 
 I2CBus *i2c_init_bus(DeviceState *parent, const char *name);
@@ -138,9 +230,126 @@ void i2c_bus_release(I2CBus *bus);
 int i2c_send(I2CBus *bus, uint8_t data);
 int i2c_send_async(I2CBus *bus, uint8_t data);
 uint8_t i2c_recv(I2CBus *bus);
+
+/**
+ * i2c_send_buf: send @len bytes, stopping at the first NAK.
+ *
+ * @bus: #I2CBus to be used
+ * @buf: the bytes to send
+ * @len: number of bytes to send
+ *
+ * The bytes are handed at once to a sole target implementing the buffer
+ * interface, and sent one by one with i2c_send() otherwise.
+ *
+ * Returns: the number of bytes ACKed. When less than @len, the byte that
+ * follows was sent and NAKed.
+ */
+size_t i2c_send_buf(I2CBus *bus, const uint8_t *buf, size_t len);
+
+/**
+ * i2c_recv_buf: receive @len bytes, see i2c_send_buf().
+ *
+ * @bus: #I2CBus to be used
+ * @buf: where to store the bytes
+ * @len: number of bytes to receive
+ */
+void i2c_recv_buf(I2CBus *bus, uint8_t *buf, size_t len);
+
+/**
+ * i2c_bus_target_may_defer: whether the target of the current transfer
+ * may defer its answers to the i2c_async_*() helpers. Masters supporting
+ * deferred answers should then transfer their buffers byte by byte.
+ *
+ * @bus: #I2CBus to be used
+ */
+bool i2c_bus_target_may_defer(I2CBus *bus);
+
+/**
+ * i2c_async_start: start or restart a transfer, letting the target defer
+ * its answer.
+ *
+ * @bus: #I2CBus to be used
+ * @address: address of the slave
+ * @is_recv: indicates the transfer direction
+ * @cb: called when the target completes a deferred operation
+ * @opaque: passed to @cb
+ *
+ * The i2c_async_*() helpers behave like their synchronous counterparts
+ * when the target has no asynchronous handler. Otherwise they may return
+ * %I2C_ASYNC_PENDING, and @cb is called with the result once the target
+ * has answered. The master must not issue another operation on @bus in
+ * the meantime.
+ *
+ * Returns: 0 on success, -1 on NAK, or %I2C_ASYNC_PENDING
+ */
+int i2c_async_start(I2CBus *bus, uint8_t address, bool is_recv,
+                    I2CAsyncCompletionFunc cb, void *opaque);
+
+/**
+ * i2c_async_send: send a byte, see i2c_async_start().
+ *
+ * Returns: 0 on success, -1 on NAK, or %I2C_ASYNC_PENDING
+ */
+int i2c_async_send(I2CBus *bus, uint8_t data,
+                   I2CAsyncCompletionFunc cb, void *opaque);
+
+/**
+ * i2c_async_recv: receive a byte, see i2c_async_start().
+ *
+ * @data: holds the byte when the operation completes immediately
+ *
+ * Returns: 0 on success, or %I2C_ASYNC_PENDING
+ */
+int i2c_async_recv(I2CBus *bus, uint8_t *data,
+                   I2CAsyncCompletionFunc cb, void *opaque);
+
+/**
+ * i2c_async_nack: NACK the last received byte, see i2c_async_start().
+ *
+ * Returns: 0, or %I2C_ASYNC_PENDING
+ */
+int i2c_async_nack(I2CBus *bus, I2CAsyncCompletionFunc cb, void *opaque);
+
+/**
+ * i2c_async_end: end the transfer, see i2c_async_start(). The bus is
+ * only released once the operation has completed.
+ *
+ * Returns: 0, or %I2C_ASYNC_PENDING
+ */
+int i2c_async_end(I2CBus *bus, I2CAsyncCompletionFunc cb, void *opaque);
+
+/**
+ * i2c_async_cancel: drop the pending operation of the master. A later
+ * completion from the target is ignored.
+ */
+void i2c_async_cancel(I2CBus *bus);
+
+/**
+ * i2c_async_complete: called by a target to complete a deferred operation.
+ *
+ * @bus: #I2CBus the target sits on
+ * @ret: 0 to ACK, non-zero to NAK
+ * @data: the byte to return for a deferred recv
+ */
+void i2c_async_complete(I2CBus *bus, int ret, uint8_t data);
 bool i2c_scan_bus(I2CBus *bus, uint8_t address, bool broadcast,
                   I2CNodeList *current_devs);
 
+/**
+ * i2c_bus_merge_routes: add the routing table of @bus to @routes, for the
+ * route handler of a mux. The entries already set in @routes are kept.
+ *
+ * Returns: false if @bus cannot be routed and must be scanned instead.
+ */
+bool i2c_bus_merge_routes(I2CBus *bus, I2CSlave **routes);
+
+/**
+ * i2c_bus_invalidate_routes: drop the routing tables of @bus and of the
+ * buses upstream of it, when a device changes the addresses it answers,
+ * e.g. a mux enabling or disabling channels.
+ */
+void i2c_bus_invalidate_routes(I2CBus *bus);
+
 /**
  * Create an I2C slave device on the heap.
  * @name: a device type name
@@ -11,6 +11,7 @@
 
 #include "qemu/bitops.h"
 #include "hw/i2c/smbus_slave.h"
+#include "hw/sensor/sensor-feed.h"
 
 enum pmbus_registers {
     PMBUS_PAGE                      = 0x00, /* R/W byte */
@@ -429,6 +430,9 @@ struct PMBusDevice {
     uint8_t *in_buf;
     int32_t out_buf_len;
     uint8_t out_buf[SMBUS_DATA_MAX_LEN];
+
+    /* Sensor values sampled from a feed before each read */
+    SensorFeedClient feed;
 };
 
 /**
@@ -62,6 +62,12 @@ struct SMBusDeviceClass {
      * return 0xff in that case.
      */
     uint8_t (*receive_byte)(SMBusDevice *dev);
+
+    /*
+     * Reads @len bytes at once, for the controllers transferring whole
+     * buffers. This may be NULL, receive_byte is then called for each byte.
+     */
+    void (*receive_buf)(SMBusDevice *dev, uint8_t *buf, size_t len);
 };
 
 #define SMBUS_DATA_MAX_LEN 34  /* command + len + 32 bytes of data.  */
@@ -14,6 +14,7 @@
 #define ASPEED_VIC_H
 
 #include "hw/sysbus.h"
+#include "qemu/thread.h"
 #include "qom/object.h"
 
 #define TYPE_ASPEED_VIC "aspeed.vic"
@@ -30,6 +31,12 @@ struct AspeedVICState {
     qemu_irq irq;
     qemu_irq fiq;
 
+    /*
+     * Protects the registers, which the guest reads without the BQL. Taken
+     * after the locks of the devices raising the interrupts.
+     */
+    QemuMutex lock;
+
     uint64_t level;
     uint64_t raw;
     uint64_t select;
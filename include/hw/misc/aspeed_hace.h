@@ -10,6 +10,7 @@
 #define ASPEED_HACE_H
 
 #include "hw/sysbus.h"
+#include "crypto/hash.h"
 
 #define TYPE_ASPEED_HACE "aspeed.hace"
 #define TYPE_ASPEED_AST2400_HACE TYPE_ASPEED_HACE "-ast2400"
@@ -20,7 +21,7 @@
 OBJECT_DECLARE_TYPE(AspeedHACEState, AspeedHACEClass, ASPEED_HACE)
 
 #define ASPEED_HACE_NR_REGS (0x64 >> 2)
-#define ASPEED_HACE_MAX_SG  256 /* max number of entries */
+#define ASPEED_HACE_MAX_SG  256 /* max number of entries per request */
 
 struct AspeedHACEState {
     SysBusDevice parent;
@@ -28,10 +29,12 @@ struct AspeedHACEState {
     MemoryRegion iomem;
     qemu_irq irq;
 
-    struct iovec iov_cache[ASPEED_HACE_MAX_SG];
     uint32_t regs[ASPEED_HACE_NR_REGS];
     uint32_t total_req_len;
-    uint32_t iov_count;
+
+    /* Hash context of the on-going accumulative operation */
+    QCryptoHash *hash_ctx;
+    Error *migration_blocker;
 
     MemoryRegion *dram_mr;
     AddressSpace dram_as;
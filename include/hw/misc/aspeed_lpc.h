@@ -11,6 +11,7 @@
 #define ASPEED_LPC_H
 
 #include "hw/sysbus.h"
+#include "hw/register-ram.h"
 
 #include <stdint.h>
 
@@ -18,6 +19,7 @@
 #define ASPEED_LPC(obj) OBJECT_CHECK(AspeedLPCState, (obj), TYPE_ASPEED_LPC)
 
 #define ASPEED_LPC_NR_REGS      (0x260 >> 2)
+#define ASPEED_LPC_SIZE         0x1000
 
 enum aspeed_lpc_subdevice {
     aspeed_lpc_kcs_1 = 0,
@@ -34,13 +36,12 @@ typedef struct AspeedLPCState {
     SysBusDevice parent;
 
     /*< public >*/
-    MemoryRegion iomem;
+    RegisterRAM regs;
     qemu_irq irq;
 
     qemu_irq subdevice_irqs[ASPEED_LPC_NR_SUBDEVS];
     uint32_t subdevice_irqs_pending;
 
-    uint32_t regs[ASPEED_LPC_NR_REGS];
     uint32_t hicr7;
 } AspeedLPCState;
 
@@ -10,19 +10,19 @@
 #define ASPEED_SBC_H
 
 #include "hw/sysbus.h"
+#include "hw/register-ram.h"
 
 #define TYPE_ASPEED_SBC "aspeed.sbc"
 #define TYPE_ASPEED_AST2600_SBC TYPE_ASPEED_SBC "-ast2600"
 OBJECT_DECLARE_TYPE(AspeedSBCState, AspeedSBCClass, ASPEED_SBC)
 
 #define ASPEED_SBC_NR_REGS (0x93c >> 2)
+#define ASPEED_SBC_SIZE    0x1000
 
 struct AspeedSBCState {
     SysBusDevice parent;
 
-    MemoryRegion iomem;
-
-    uint32_t regs[ASPEED_SBC_NR_REGS];
+    RegisterRAM regs;
 };
 
 struct AspeedSBCClass {
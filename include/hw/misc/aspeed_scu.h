@@ -12,6 +12,7 @@
 #define ASPEED_SCU_H
 
 #include "hw/sysbus.h"
+#include "qemu/thread.h"
 #include "qom/object.h"
 
 #define TYPE_ASPEED_SCU "aspeed.scu"
@@ -31,6 +32,9 @@ struct AspeedSCUState {
     /*< public >*/
     MemoryRegion iomem;
 
+    /* Protects the registers, which the guest accesses without the BQL */
+    QemuMutex lock;
+
     uint32_t regs[ASPEED_AST2600_SCU_NR_REGS];
     uint32_t silicon_rev;
     uint32_t hw_strap1;
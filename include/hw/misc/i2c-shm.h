@@ -0,0 +1,67 @@
+/*
+ * I2C bus bridge between two local QEMU processes over shared memory:
+ * layout of the shared inboxes
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * This code is licensed under the GPL version 2 or later.  See the
+ * COPYING file in the top-level directory.
+ */
+
+#ifndef HW_MISC_I2C_SHM_H
+#define HW_MISC_I2C_SHM_H
+
+#include "qemu/bitops.h"
+
+#define I2C_SHM_MAGIC           0x53433249 /* "I2CS" */
+#define I2C_SHM_VERSION         1
+
+#define I2C_SHM_RING_SLOTS      64
+#define I2C_SHM_MAX_DATA        256
+
+#define I2C_SHM_MSG_WRITE       0x01 /* addr, data[len] */
+#define I2C_SHM_MSG_START       0x02 /* addr, answered */
+#define I2C_SHM_MSG_READ        0x03 /* answered with one byte */
+#define I2C_SHM_MSG_NACK        0x04
+#define I2C_SHM_MSG_STOP        0x05
+#define I2C_SHM_MSG_RESP        0x80 /* status, data[len] */
+
+/* WRITE flags */
+#define I2C_SHM_F_CONT          BIT(0) /* continues the previous segment */
+#define I2C_SHM_F_STOP          BIT(1) /* the transfer stops after it */
+
+typedef struct I2CShmMsg {
+    uint8_t type;
+    uint8_t addr;       /* 7-bit address << 1 | R/W */
+    uint8_t status;
+    uint8_t flags;
+    uint16_t seq;
+    uint16_t len;
+    uint8_t data[I2C_SHM_MAX_DATA];
+} I2CShmMsg;
+
+/*
+ * Single producer, single consumer ring. Both sides run on the same host,
+ * so the indexes are kept in host byte order.
+ */
+typedef struct I2CShmRing {
+    uint32_t head QEMU_ALIGNED(64);     /* written by the producer */
+    uint32_t blocked;                   /* producer waits for room */
+    uint32_t tail QEMU_ALIGNED(64);     /* written by the consumer */
+    I2CShmMsg slots[I2C_SHM_RING_SLOTS] QEMU_ALIGNED(64);
+} I2CShmRing;
+
+typedef struct I2CShmInbox {
+    uint32_t magic;
+    uint32_t version;
+    I2CShmRing req;
+    I2CShmRing resp;
+} I2CShmInbox;
+
+/* Sent over the chardev, along with the inbox and notifier fds */
+typedef struct I2CShmHello {
+    uint32_t magic;
+    uint32_t version;
+} I2CShmHello;
+
+#endif
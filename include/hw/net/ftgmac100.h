@@ -16,6 +16,7 @@ OBJECT_DECLARE_SIMPLE_TYPE(FTGMAC100State, FTGMAC100)
 
 #include "hw/sysbus.h"
 #include "net/net.h"
+#include "qemu/timer.h"
 
 /*
  * Max frame size for the receiving buffer
@@ -55,6 +56,12 @@ struct FTGMAC100State {
     uint32_t phydata;
     uint32_t fcr;
 
+    /* Interrupt mitigation and transmit polling */
+    uint32_t isr_deferred;
+    uint32_t rx_pending;
+    uint32_t tx_pending;
+    QEMUTimer itc_timer;
+    QEMUTimer txpoll_timer;
 
     uint32_t phy_status;
     uint32_t phy_control;
@@ -63,6 +70,7 @@ struct FTGMAC100State {
     uint32_t phy_int_mask;
 
     bool aspeed;
+    bool migrate_mac;
     uint32_t txdes0_edotr;
     uint32_t rxdes0_edorr;
 };
@@ -0,0 +1,130 @@
+/*
+ * RAM-backed register files
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef HW_REGISTER_RAM_H
+#define HW_REGISTER_RAM_H
+
+#include "exec/memory.h"
+#include "qemu/bswap.h"
+
+/**
+ * RegisterRAMOps: the side effects of a #RegisterRAM
+ *
+ * @read: called for guest reads while direct reads are disabled with
+ * register_ram_set_direct_read(). May be NULL if they never are.
+ * @write: called for guest writes to the offsets watched with
+ * register_ram_watch(), instead of storing the value. May be NULL if
+ * no offset is watched.
+ *
+ * Both are called with the same arguments as the #MemoryRegionOps ones.
+ */
+typedef struct RegisterRAMOps {
+    uint64_t (*read)(void *opaque, hwaddr addr, unsigned size);
+    void (*write)(void *opaque, hwaddr addr, uint64_t data, unsigned size);
+} RegisterRAMOps;
+
+/**
+ * RegisterRAM: a device register bank kept in guest RAM
+ *
+ * The registers are stored little-endian in a RAM block, which the guest
+ * reads directly, like ROM devices, so that polling loops run at RAM speed
+ * and do not take the BQL. Guest writes are trapped and stored, except at
+ * the watched offsets where they are handed to the device. A bank without
+ * any write side effect (@ops is NULL) is plain RAM, for writes as well.
+ *
+ * The device accesses the registers with the register_ram_get() and
+ * register_ram_set() helpers, which also track the changes for migration.
+ * The RAM block is migrated as such, so the registers must not be in the
+ * device vmstate.
+ */
+typedef struct RegisterRAM {
+    MemoryRegion mr;
+
+    /*< private >*/
+    const RegisterRAMOps *ops;
+    void *opaque;
+    uint8_t *ptr;
+    uint64_t size;
+    unsigned long *watch;
+} RegisterRAM;
+
+/**
+ * register_ram_init: initialize a register bank of @size bytes
+ *
+ * @r: the bank to initialize
+ * @owner: the device owning the bank
+ * @ops: the side effects of the bank, or NULL for plain storage
+ * @opaque: passed to the @ops callbacks
+ * @name: name of the memory region, unique within @owner
+ * @size: size of the bank in bytes
+ * @errp: pointer to Error*, to store an error if it happens
+ */
+bool register_ram_init(RegisterRAM *r, Object *owner,
+                       const RegisterRAMOps *ops, void *opaque,
+                       const char *name, uint64_t size, Error **errp);
+
+/**
+ * register_ram_watch: send the guest writes to [@addr, @addr + @size)
+ * to the write callback of the bank
+ */
+void register_ram_watch(RegisterRAM *r, hwaddr addr, uint64_t size);
+
+/**
+ * register_ram_set_direct_read: enable or disable direct guest reads
+ *
+ * While a register with read side effects needs them, the device disables
+ * direct reads so that all guest reads go to the read callback of the bank.
+ * Disabling waits for the vCPUs to drop their direct mappings of the bank,
+ * except when called from a vCPU thread: then the other vCPUs may still
+ * read directly until their next translation block. The device should only
+ * make the side effects visible to the guest once direct reads are disabled.
+ * Must be called with the BQL held.
+ */
+void register_ram_set_direct_read(RegisterRAM *r, bool enable);
+
+/**
+ * register_ram_set_dirty: mark [@addr, @addr + @size) as changed by the
+ * device, when it wrote there through register_ram_ptr()
+ */
+void register_ram_set_dirty(RegisterRAM *r, hwaddr addr, uint64_t size);
+
+/**
+ * register_ram_reset: clear all the registers of the bank
+ */
+void register_ram_reset(RegisterRAM *r);
+
+static inline void *register_ram_ptr(RegisterRAM *r, hwaddr addr)
+{
+    return r->ptr + addr;
+}
+
+static inline uint64_t register_ram_read(RegisterRAM *r, hwaddr addr,
+                                         unsigned size)
+{
+    return ldn_le_p(r->ptr + addr, size);
+}
+
+static inline void register_ram_write(RegisterRAM *r, hwaddr addr,
+                                      uint64_t value, unsigned size)
+{
+    stn_le_p(r->ptr + addr, size, value);
+    register_ram_set_dirty(r, addr, size);
+}
+
+static inline uint32_t register_ram_get(RegisterRAM *r, hwaddr addr)
+{
+    return ldl_le_p(r->ptr + addr);
+}
+
+static inline void register_ram_set(RegisterRAM *r, hwaddr addr,
+                                    uint32_t value)
+{
+    register_ram_write(r, addr, value, 4);
+}
+
+#endif /* HW_REGISTER_RAM_H */
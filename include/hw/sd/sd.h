@@ -31,6 +31,7 @@
 #define HW_SD_H
 
 #include "hw/qdev-core.h"
+#include "qemu/iov.h"
 #include "qom/object.h"
 
 #define OUT_OF_RANGE            (1 << 31)
@@ -124,6 +125,28 @@ struct SDCardClass {
     void (*enable)(SDState *sd, bool enable);
     bool (*get_inserted)(SDState *sd);
     bool (*get_readonly)(SDState *sd);
+    /**
+     * Transfer whole data blocks of a block read or write command.
+     * @sd: card
+     * @qiov: host buffers of the blocks, valid until @cb is called
+     * @write: true for a write command, false for a read command
+     * @cb: called from the main loop once the blocks are transferred
+     * @opaque: argument of @cb
+     *
+     * Optional. The blocks go between the drive and @qiov asynchronously,
+     * without the data lines. The card may refuse a transfer it cannot do
+     * that way, then the controller must use the data lines instead.
+     *
+     * Return: true if the transfer was started
+     */
+    bool (*transfer_blocks)(SDState *sd, QEMUIOVector *qiov, bool write,
+                            void (*cb)(void *opaque, int ret), void *opaque);
+    /**
+     * Wait for the transfer started with @transfer_blocks, if any, and
+     * call its completion callback.
+     * @sd: card
+     */
+    void (*drain_blocks)(SDState *sd);
 };
 
 #define TYPE_SD_BUS "sd-bus"
@@ -192,6 +215,30 @@ bool sdbus_receive_ready(SDBus *sd);
 bool sdbus_data_ready(SDBus *sd);
 bool sdbus_get_inserted(SDBus *sd);
 bool sdbus_get_readonly(SDBus *sd);
+/**
+ * sdbus_transfer_blocks: Transfer data blocks with the card asynchronously
+ * @sdbus: bus
+ * @qiov: host buffers of the blocks, valid until @cb is called
+ * @write: true for a write command, false for a read command
+ * @cb: called from the main loop once the blocks are transferred
+ * @opaque: argument of @cb
+ *
+ * Transfer whole blocks of the current read or write command between the
+ * drive of the card and @qiov, without going through the data lines.
+ *
+ * Return: true if the transfer was started, false if the card cannot do it
+ * and the data must go through sdbus_read_data() or sdbus_write_data().
+ */
+bool sdbus_transfer_blocks(SDBus *sdbus, QEMUIOVector *qiov, bool write,
+                           void (*cb)(void *opaque, int ret), void *opaque);
+/**
+ * sdbus_drain_blocks: Complete the asynchronous transfer in progress
+ * @sdbus: bus
+ *
+ * Wait for the transfer started with sdbus_transfer_blocks(), if any, and
+ * call its completion callback before returning.
+ */
+void sdbus_drain_blocks(SDBus *sdbus);
 /**
  * sdbus_reparent_card: Reparent an SD card from one controller to another
  * @from: controller bus to remove card from
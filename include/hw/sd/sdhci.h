@@ -87,6 +87,10 @@ struct SDHCIState {
     uint16_t data_count;   /* current element in FIFO buffer */
     uint8_t  stopped_state;/* Current SDHC state */
     bool     pending_insert_state;
+    /* Guest buffers of the asynchronous ADMA transfer in progress */
+    QEMUIOVector adma_qiov;
+    DMADirection adma_dir;
+    bool     adma_async;
     /* Buffer Data Port Register - virtual access point to R and W buffers */
     /* Software Reset Register - always reads as 0 */
     /* Force Event Auto CMD12 Error Interrupt Reg - write only */
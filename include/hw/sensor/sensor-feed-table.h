@@ -0,0 +1,29 @@
+/*
+ * Bulk sensor value feed, telemetry table layout
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef HW_SENSOR_FEED_TABLE_H
+#define HW_SENSOR_FEED_TABLE_H
+
+/*
+ * Layout of a telemetry table file. All fields are in host byte order.
+ *
+ * The writer makes @seq odd while it updates @values and even again once
+ * it is done, so that a reader never samples a half-written tick.
+ */
+#define SENSOR_FEED_MAGIC   0x44454653 /* "SFED" */
+#define SENSOR_FEED_VERSION 1
+
+typedef struct SensorFeedTable {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t seq;
+    int64_t values[];
+} SensorFeedTable;
+
+#endif
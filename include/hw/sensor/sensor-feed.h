@@ -0,0 +1,61 @@
+/*
+ * Bulk sensor value feed
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef HW_SENSOR_FEED_H
+#define HW_SENSOR_FEED_H
+
+#include "qom/object.h"
+#include "hw/sensor/sensor-feed-table.h"
+
+#define TYPE_SENSOR_FEED "sensor-feed"
+OBJECT_DECLARE_SIMPLE_TYPE(SensorFeed, SENSOR_FEED)
+
+/**
+ * SensorFeedClient:
+ * @feed: feed the values are sampled from, or NULL
+ * @index: first entry of the feed used by the device
+ * @nprops: number of properties fed, from @index onwards
+ *
+ * Embedded in a sensor device to subscribe it to a feed. Entry
+ * @index + i of the feed is assigned to the i-th property of the
+ * comma-separated "feed-props" list, in the units of that property.
+ */
+typedef struct SensorFeedClient {
+    SensorFeed *feed;
+    uint32_t index;
+    uint32_t nprops;
+
+    /*< private >*/
+    char *props;
+    char **prop_names;
+    int64_t *values;
+    unsigned long *rejected;    /* values the device did not accept */
+    SensorFeed *synced_feed;
+    uint32_t seq;
+} SensorFeedClient;
+
+/**
+ * sensor_feed_client_init: add the "feed", "feed-index" and "feed-props"
+ * properties of @c to @obj. They can be set at any time, including after
+ * the device is realized.
+ */
+void sensor_feed_client_init(Object *obj, SensorFeedClient *c);
+
+/**
+ * sensor_feed_client_finalize: free the resources of @c.
+ */
+void sensor_feed_client_finalize(SensorFeedClient *c);
+
+/**
+ * sensor_feed_client_sample: update the fed properties of @obj with the
+ * latest values of the feed. Called by the device before a guest read; it
+ * returns quickly if the feed did not tick since the last call.
+ */
+void sensor_feed_client_sample(Object *obj, SensorFeedClient *c);
+
+#endif
@@ -16,6 +16,7 @@
 
 #include "hw/i2c/i2c.h"
 #include "hw/sensor/tmp105_regs.h"
+#include "hw/sensor/sensor-feed.h"
 #include "qom/object.h"
 
 #define TYPE_TMP105 "tmp105"
@@ -50,6 +51,8 @@ struct TMP105State {
      * looking for T_high, true when looking for T_low.
      */
     bool detect_falling;
+
+    SensorFeedClient feed;
 };
 
 #endif
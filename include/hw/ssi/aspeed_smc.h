@@ -27,6 +27,7 @@
 
 #include "hw/ssi/ssi.h"
 #include "hw/sysbus.h"
+#include "qemu/timer.h"
 #include "qom/object.h"
 
 struct AspeedSMCState;
@@ -40,6 +41,11 @@ struct AspeedSMCFlash {
     uint8_t cs;
 
     MemoryRegion mmio;
+
+    /* Flash storage mapped in the segment while in read mode */
+    MemoryRegion direct;
+    bool direct_init;
+    bool direct_modified;
 };
 
 #define TYPE_ASPEED_SMC "aspeed.smc"
@@ -74,6 +80,8 @@ struct AspeedSMCState {
     AddressSpace flash_as;
     MemoryRegion *dram_mr;
     AddressSpace dram_as;
+    uint8_t *dma_buf;
+    QEMUTimer dma_timer;
 
     AspeedSMCFlash flashes[ASPEED_SMC_CS_MAX];
 
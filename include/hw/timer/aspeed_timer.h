@@ -23,6 +23,7 @@
 #define ASPEED_TIMER_H
 
 #include "qemu/timer.h"
+#include "qemu/thread.h"
 #include "hw/misc/aspeed_scu.h"
 #include "qom/object.h"
 
@@ -58,6 +59,12 @@ struct AspeedTimerCtrlState {
     /*< public >*/
     MemoryRegion iomem;
 
+    /*
+     * Protects the registers and the timers, so that the guest can read
+     * them without the BQL. Taken after the BQL, and before the SCU lock.
+     */
+    QemuMutex lock;
+
     uint32_t ctrl;
     uint32_t ctrl2;
     uint32_t ctrl3;
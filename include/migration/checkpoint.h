@@ -0,0 +1,47 @@
+/*
+ * In-memory VM checkpoints
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef MIGRATION_CHECKPOINT_H
+#define MIGRATION_CHECKPOINT_H
+
+/**
+ * CheckpointOps: device state that is neither in a vmstate nor in
+ * migratable RAM, e.g. the storage of a flash device.
+ *
+ * @create: copy the state, when a checkpoint is taken
+ * @restore: roll the state back to the copy, after the device state was
+ *           loaded from the checkpoint
+ * @delete: free the copy
+ *
+ * The callbacks are called with the BQL held and the VM stopped. @restore
+ * and @delete must cope with a device registered after the checkpoint was
+ * taken.
+ */
+typedef struct CheckpointOps {
+    void (*create)(void *opaque);
+    void (*restore)(void *opaque);
+    void (*delete)(void *opaque);
+} CheckpointOps;
+
+/**
+ * checkpoint_register: add a device to the checkpoints
+ *
+ * @ops: the callbacks
+ * @opaque: passed to the callbacks
+ */
+void checkpoint_register(const CheckpointOps *ops, void *opaque);
+
+/**
+ * checkpoint_unregister: remove a device from the checkpoints, deleting
+ * its part of the current checkpoint
+ *
+ * @opaque: as passed to checkpoint_register()
+ */
+void checkpoint_unregister(void *opaque);
+
+#endif
@@ -214,6 +214,17 @@ void qemu_plugin_add_dyn_cb_arr(GArray *arr);
 
 void qemu_plugin_disable_mem_helpers(CPUState *cpu);
 
+/*
+ * Translation accounting for qemu_plugin_translation_stats(): pass the
+ * value returned by qemu_plugin_tb_gen_start() to qemu_plugin_tb_gen_done()
+ * once the block is translated.
+ */
+int64_t qemu_plugin_tb_gen_start(void);
+void qemu_plugin_tb_gen_done(int64_t start);
+
+/* Returns true if any plugin is installed, i.e. new code is instrumented */
+bool qemu_plugin_installed(void);
+
 /**
  * qemu_plugin_user_exit(): clean-up callbacks before calling exit callbacks
  *
@@ -285,6 +296,19 @@ void qemu_plugin_add_dyn_cb_arr(GArray *arr)
 static inline void qemu_plugin_disable_mem_helpers(CPUState *cpu)
 { }
 
+static inline int64_t qemu_plugin_tb_gen_start(void)
+{
+    return 0;
+}
+
+static inline void qemu_plugin_tb_gen_done(int64_t start)
+{ }
+
+static inline bool qemu_plugin_installed(void)
+{
+    return false;
+}
+
 static inline void qemu_plugin_user_exit(void)
 { }
 #endif /* !CONFIG_PLUGIN */
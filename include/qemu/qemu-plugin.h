@@ -601,6 +601,17 @@ bool qemu_plugin_bool_parse(const char *name, const char *val, bool *ret);
  */
 const char *qemu_plugin_path_to_binary(void);
 
+/**
+ * qemu_plugin_translation_stats() - returns the translation counters
+ * @count: number of blocks translated
+ * @time_ns: host time spent translating them, in nanoseconds
+ *
+ * The counters cover all vCPUs. They start counting on the first call,
+ * which plugins should make when installed. Blocks reused from the
+ * persistent code cache are not counted.
+ */
+void qemu_plugin_translation_stats(uint64_t *count, uint64_t *time_ns);
+
 /**
  * qemu_plugin_start_code() - returns start of text segment
  *
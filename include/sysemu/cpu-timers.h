@@ -83,6 +83,13 @@ int64_t cpu_get_clock(void);
 
 void qemu_timer_notify_cb(void *opaque, QEMUClockType type);
 
+/*
+ * When all vCPUs are idle, advance QEMU_CLOCK_VIRTUAL to the next timer
+ * deadline instead of waiting for it. Not for use with icount, which has
+ * its own sleep=off mode.
+ */
+void cpu_timers_enable_idle_warp(void);
+
 /* get the VIRTUAL clock and VM elapsed ticks via the cpus accel interface */
 int64_t cpus_get_virtual_clock(void);
 int64_t cpus_get_elapsed_ticks(void);
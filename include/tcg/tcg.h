@@ -552,6 +552,7 @@ struct TCGContext {
 
     TCGRegSet reserved_regs;
     uint32_t tb_cflags; /* cflags of the current TB */
+    bool host_ptr_const; /* the current TB uses a host pointer constant */
     intptr_t current_frame_offset;
     intptr_t frame_start;
     intptr_t frame_end;
@@ -806,6 +807,9 @@ void tcg_pool_reset(TCGContext *s);
 TranslationBlock *tcg_tb_alloc(TCGContext *s);
 
 void tcg_region_reset_all(void);
+void tcg_region_set_hint(void *addr);
+void *tcg_region_start(void);
+bool tcg_region_reserve(const void *end);
 
 size_t tcg_code_size(void);
 size_t tcg_code_capacity(void);
@@ -1053,14 +1057,30 @@ static inline TCGv_i64 tcg_constant_i64(int64_t val)
 TCGv_vec tcg_constant_vec(TCGType type, unsigned vece, int64_t val);
 TCGv_vec tcg_constant_vec_matching(TCGv_vec match, unsigned vece, int64_t val);
 
+/*
+ * Pointer constants are usually host addresses, which make the generated
+ * code valid only in this process; note their use for tb-persist.
+ */
+static inline intptr_t tcg_host_ptr(intptr_t x)
+{
+    tcg_ctx->host_ptr_const = true;
+    return x;
+}
+
 #if UINTPTR_MAX == UINT32_MAX
-# define tcg_const_ptr(x)        ((TCGv_ptr)tcg_const_i32((intptr_t)(x)))
-# define tcg_const_local_ptr(x)  ((TCGv_ptr)tcg_const_local_i32((intptr_t)(x)))
-# define tcg_constant_ptr(x)     ((TCGv_ptr)tcg_constant_i32((intptr_t)(x)))
+# define tcg_const_ptr(x)        \
+    ((TCGv_ptr)tcg_const_i32(tcg_host_ptr((intptr_t)(x))))
+# define tcg_const_local_ptr(x)  \
+    ((TCGv_ptr)tcg_const_local_i32(tcg_host_ptr((intptr_t)(x))))
+# define tcg_constant_ptr(x)     \
+    ((TCGv_ptr)tcg_constant_i32(tcg_host_ptr((intptr_t)(x))))
 #else
-# define tcg_const_ptr(x)        ((TCGv_ptr)tcg_const_i64((intptr_t)(x)))
-# define tcg_const_local_ptr(x)  ((TCGv_ptr)tcg_const_local_i64((intptr_t)(x)))
-# define tcg_constant_ptr(x)     ((TCGv_ptr)tcg_constant_i64((intptr_t)(x)))
+# define tcg_const_ptr(x)        \
+    ((TCGv_ptr)tcg_const_i64(tcg_host_ptr((intptr_t)(x))))
+# define tcg_const_local_ptr(x)  \
+    ((TCGv_ptr)tcg_const_local_i64(tcg_host_ptr((intptr_t)(x))))
+# define tcg_constant_ptr(x)     \
+    ((TCGv_ptr)tcg_constant_i64(tcg_host_ptr((intptr_t)(x))))
 #endif
 
 TCGLabel *gen_new_label(void);
@@ -0,0 +1,343 @@
+/*
+ * In-memory VM checkpoints
+ *
+ * A checkpoint holds the device state and a copy of the migratable guest
+ * RAM. The RAM is dirty logged from then on, so that rolling back only
+ * copies the pages written since the checkpoint was taken.
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qapi/qapi-commands-migration.h"
+#include "exec/exec-all.h"
+#include "exec/memory.h"
+#include "exec/ramblock.h"
+#include "exec/target_page.h"
+#include "hw/core/cpu.h"
+#include "io/channel-buffer.h"
+#include "migration/blocker.h"
+#include "migration/checkpoint.h"
+#include "migration/misc.h"
+#include "qemu/main-loop.h"
+#include "qemu/rcu.h"
+#include "qemu/timer.h"
+#include "sysemu/runstate.h"
+#include "migration.h"
+#include "qemu-file-channel.h"
+#include "qemu-file.h"
+#include "ram.h"
+#include "savevm.h"
+#include "trace.h"
+
+typedef struct CheckpointHandler {
+    const CheckpointOps *ops;
+    void *opaque;
+    QTAILQ_ENTRY(CheckpointHandler) next;
+} CheckpointHandler;
+
+typedef struct CheckpointRAM {
+    char *idstr;
+    ram_addr_t length;
+    uint8_t *data;
+} CheckpointRAM;
+
+static struct {
+    bool active;
+    /* Device state, as saved by qemu_save_device_state() */
+    uint8_t *devices;
+    size_t devices_size;
+    GArray *ram;
+    Error *blocker;
+    QTAILQ_HEAD(, CheckpointHandler) handlers;
+} checkpoint = {
+    .handlers = QTAILQ_HEAD_INITIALIZER(checkpoint.handlers),
+};
+
+void checkpoint_register(const CheckpointOps *ops, void *opaque)
+{
+    CheckpointHandler *h = g_new0(CheckpointHandler, 1);
+
+    h->ops = ops;
+    h->opaque = opaque;
+    QTAILQ_INSERT_TAIL(&checkpoint.handlers, h, next);
+}
+
+void checkpoint_unregister(void *opaque)
+{
+    CheckpointHandler *h, *next_h;
+
+    QTAILQ_FOREACH_SAFE(h, &checkpoint.handlers, next, next_h) {
+        if (h->opaque == opaque) {
+            if (checkpoint.active) {
+                h->ops->delete(h->opaque);
+            }
+            QTAILQ_REMOVE(&checkpoint.handlers, h, next);
+            g_free(h);
+        }
+    }
+}
+
+static void checkpoint_ram_clear(gpointer data)
+{
+    CheckpointRAM *ram = data;
+
+    g_free(ram->idstr);
+    g_free(ram->data);
+}
+
+static void checkpoint_delete(void)
+{
+    CheckpointHandler *h;
+
+    if (!checkpoint.active) {
+        return;
+    }
+
+    QTAILQ_FOREACH(h, &checkpoint.handlers, next) {
+        h->ops->delete(h->opaque);
+    }
+    g_clear_pointer(&checkpoint.ram, g_array_unref);
+    g_clear_pointer(&checkpoint.devices, g_free);
+    checkpoint.devices_size = 0;
+
+    memory_global_dirty_log_stop(GLOBAL_DIRTY_CHECKPOINT);
+    migrate_del_blocker(checkpoint.blocker);
+    error_free(checkpoint.blocker);
+    checkpoint.blocker = NULL;
+    checkpoint.active = false;
+}
+
+/* Copy the RAM, and start logging the pages written from now on */
+static bool checkpoint_save_ram(Error **errp)
+{
+    CheckpointRAM ram;
+    RAMBlock *block;
+
+    checkpoint.ram = g_array_new(false, false, sizeof(CheckpointRAM));
+    g_array_set_clear_func(checkpoint.ram, checkpoint_ram_clear);
+
+    memory_global_dirty_log_start(GLOBAL_DIRTY_CHECKPOINT);
+
+    RCU_READ_LOCK_GUARD();
+    RAMBLOCK_FOREACH_MIGRATABLE(block) {
+        ram.length = block->used_length;
+        ram.data = g_try_malloc(ram.length);
+        if (!ram.data) {
+            error_setg(errp, "Not enough memory to copy RAM block '%s'",
+                       block->idstr);
+            return false;
+        }
+        g_free(memory_region_snapshot_and_clear_dirty(block->mr, 0,
+                                                      ram.length,
+                                                      DIRTY_MEMORY_MIGRATION));
+        memcpy(ram.data, block->host, ram.length);
+        ram.idstr = g_strdup(block->idstr);
+        g_array_append_val(checkpoint.ram, ram);
+    }
+    return true;
+}
+
+static bool checkpoint_save_devices(Error **errp)
+{
+    QIOChannelBuffer *bioc;
+    QEMUFile *f;
+    int ret;
+
+    bioc = qio_channel_buffer_new(4096);
+    qio_channel_set_name(QIO_CHANNEL(bioc), "checkpoint-buffer");
+    f = qemu_fopen_channel_output(QIO_CHANNEL(bioc));
+
+    ret = qemu_save_device_state(f);
+    qemu_fflush(f);
+    if (ret == 0) {
+        checkpoint.devices = g_memdup2(bioc->data, bioc->usage);
+        checkpoint.devices_size = bioc->usage;
+    }
+    qemu_fclose(f);
+    object_unref(OBJECT(bioc));
+
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to save the device state");
+        return false;
+    }
+    return true;
+}
+
+void qmp_checkpoint_create(Error **errp)
+{
+    bool was_running = runstate_is_running();
+    CheckpointHandler *h;
+    int ret;
+
+    checkpoint_delete();
+    if (migration_is_blocked(errp)) {
+        return;
+    }
+    error_setg(&checkpoint.blocker, "A checkpoint exists; "
+               "remove it with 'checkpoint-delete'");
+    if (migrate_add_blocker(checkpoint.blocker, errp) < 0) {
+        error_free(checkpoint.blocker);
+        checkpoint.blocker = NULL;
+        return;
+    }
+    checkpoint.active = true;
+
+    ret = vm_stop(RUN_STATE_SAVE_VM);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to flush the block devices");
+        checkpoint_delete();
+        return;
+    }
+
+    if (!checkpoint_save_ram(errp) || !checkpoint_save_devices(errp)) {
+        checkpoint_delete();
+        goto out;
+    }
+    QTAILQ_FOREACH(h, &checkpoint.handlers, next) {
+        h->ops->create(h->opaque);
+    }
+    trace_checkpoint_create(checkpoint.ram->len, checkpoint.devices_size);
+
+out:
+    if (was_running) {
+        vm_start();
+    }
+}
+
+static bool checkpoint_load_devices(Error **errp)
+{
+    QIOChannelBuffer *bioc;
+    QEMUFile *f;
+    int ret = -EINVAL;
+
+    /* Closing the file frees the buffer, give it a copy */
+    bioc = qio_channel_buffer_new(checkpoint.devices_size);
+    qio_channel_set_name(QIO_CHANNEL(bioc), "checkpoint-buffer");
+    memcpy(bioc->data, checkpoint.devices, checkpoint.devices_size);
+    bioc->usage = checkpoint.devices_size;
+    f = qemu_fopen_channel_input(QIO_CHANNEL(bioc));
+    object_unref(OBJECT(bioc));
+
+    if (qemu_get_be32(f) == QEMU_VM_FILE_MAGIC &&
+        qemu_get_be32(f) == QEMU_VM_FILE_VERSION) {
+        ret = qemu_load_device_state(f);
+    }
+    qemu_fclose(f);
+    migration_incoming_state_destroy();
+
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to load the device state");
+        return false;
+    }
+    return true;
+}
+
+/* Copy back the pages written since the checkpoint, returns their count */
+static uint64_t checkpoint_load_ram(CheckpointRAM *ram)
+{
+    size_t page_size = qemu_target_page_size();
+    DirtyBitmapSnapshot *snap;
+    RAMBlock *block;
+    ram_addr_t start, end;
+    uint64_t pages = 0;
+
+    block = qemu_ram_block_by_name(ram->idstr);
+    if (!block || block->used_length != ram->length) {
+        return 0;
+    }
+
+    snap = memory_region_snapshot_and_clear_dirty(block->mr, 0, ram->length,
+                                                  DIRTY_MEMORY_MIGRATION);
+    for (start = 0; start < ram->length; start = end) {
+        end = start + page_size;
+        if (!memory_region_snapshot_get_dirty(block->mr, snap, start,
+                                              page_size)) {
+            continue;
+        }
+        while (end < ram->length &&
+               memory_region_snapshot_get_dirty(block->mr, snap, end,
+                                                page_size)) {
+            end += page_size;
+        }
+        memcpy(block->host + start, ram->data + start, end - start);
+        pages += (end - start) / page_size;
+    }
+    g_free(snap);
+
+    return pages;
+}
+
+CheckpointRestoreInfo *qmp_checkpoint_restore(Error **errp)
+{
+    bool was_running = runstate_is_running();
+    int64_t start_time = qemu_clock_get_us(QEMU_CLOCK_REALTIME);
+    CheckpointRestoreInfo *info;
+    CheckpointHandler *h;
+    uint64_t pages = 0;
+    guint i;
+    int ret;
+
+    if (!checkpoint.active) {
+        error_setg(errp, "There is no checkpoint to restore");
+        return NULL;
+    }
+
+    ret = vm_stop(RUN_STATE_RESTORE_VM);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to flush the block devices");
+        return NULL;
+    }
+
+    /*
+     * Devices that don't migrate some of their state rely on the reset
+     * value. The RAM written by the reset, e.g. the ROM blobs, is dirty
+     * logged and rolled back below.
+     *
+     * As with loadvm, the RAM comes before the device state: post_load
+     * hooks may read RAM, e.g. register files backed by a RAM region.
+     */
+    qemu_system_reset(SHUTDOWN_CAUSE_NONE);
+    WITH_RCU_READ_LOCK_GUARD() {
+        for (i = 0; i < checkpoint.ram->len; i++) {
+            pages += checkpoint_load_ram(&g_array_index(checkpoint.ram,
+                                                        CheckpointRAM, i));
+        }
+    }
+    if (!checkpoint_load_devices(errp)) {
+        return NULL;
+    }
+
+    QTAILQ_FOREACH(h, &checkpoint.handlers, next) {
+        h->ops->restore(h->opaque);
+    }
+
+    /* The RAM was written behind the back of the translated code */
+    if (first_cpu) {
+        tb_flush(first_cpu);
+    }
+
+    trace_checkpoint_restore(pages,
+                             qemu_clock_get_us(QEMU_CLOCK_REALTIME) -
+                             start_time);
+
+    if (was_running) {
+        vm_start();
+    }
+
+    info = g_new0(CheckpointRestoreInfo, 1);
+    info->pages = pages;
+    return info;
+}
+
+void qmp_checkpoint_delete(Error **errp)
+{
+    if (!checkpoint.active) {
+        error_setg(errp, "There is no checkpoint to delete");
+        return;
+    }
+    checkpoint_delete();
+}
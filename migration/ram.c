@@ -161,10 +161,23 @@ out:
     return ret;
 }
 
+/* Set while a template is saved or loaded, see qmp_x_template_save() */
+static bool ram_template;
+
+void ram_set_template(bool enable)
+{
+    ram_template = enable;
+}
+
+static bool ram_ignore_shared(void)
+{
+    return migrate_ignore_shared() || ram_template;
+}
+
 bool ramblock_is_ignored(RAMBlock *block)
 {
     return !qemu_ram_is_migratable(block) ||
-           (migrate_ignore_shared() && qemu_ram_is_shared(block));
+           (ram_ignore_shared() && qemu_ram_is_shared(block));
 }
 
 #undef RAMBLOCK_FOREACH
@@ -2935,7 +2948,7 @@ static int ram_save_setup(QEMUFile *f, void *opaque)
                                           qemu_host_page_size) {
                 qemu_put_be64(f, block->page_size);
             }
-            if (migrate_ignore_shared()) {
+            if (ram_ignore_shared()) {
                 qemu_put_be64(f, block->mr->addr);
             }
         }
@@ -4023,7 +4036,7 @@ static int ram_load_precopy(QEMUFile *f)
                             ret = -EINVAL;
                         }
                     }
-                    if (migrate_ignore_shared()) {
+                    if (ram_ignore_shared()) {
                         hwaddr addr = qemu_get_be64(f);
                         if (ramblock_is_ignored(block) &&
                             block->mr->addr != addr) {
@@ -38,6 +38,7 @@ extern XBZRLECacheStats xbzrle_counters;
 extern CompressionStats compression_counters;
 
 bool ramblock_is_ignored(RAMBlock *block);
+void ram_set_template(bool enable);
 /* Should be holding either ram_list.mutex, or the RCU lock. */
 #define RAMBLOCK_FOREACH_NOT_IGNORED(block)            \
     INTERNAL_RAMBLOCK_FOREACH(block)                   \
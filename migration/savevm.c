@@ -3009,6 +3009,116 @@ void qmp_xen_load_devices_state(const char *filename, Error **errp)
     migration_incoming_state_destroy();
 }
 
+void qmp_x_template_save(const char *filename, Error **errp)
+{
+    QEMUFile *f;
+    QIOChannelFile *ioc;
+    RAMBlock *block;
+    bool has_shared = false;
+    int ret;
+
+    WITH_RCU_READ_LOCK_GUARD() {
+        RAMBLOCK_FOREACH_MIGRATABLE(block) {
+            has_shared |= qemu_ram_is_shared(block);
+        }
+    }
+    if (!has_shared) {
+        error_setg(errp, "Templates need the guest RAM in a memory backend "
+                   "with share=on");
+        return;
+    }
+    if (migration_is_blocked(errp)) {
+        return;
+    }
+
+    /* The template stays stopped: clones map its RAM */
+    ret = vm_stop(RUN_STATE_SAVE_VM);
+    if (ret < 0) {
+        error_setg_errno(errp, -ret, "Failed to flush the block devices");
+        return;
+    }
+    global_state_store_running();
+
+    ioc = qio_channel_file_new_path(filename, O_WRONLY | O_CREAT | O_TRUNC,
+                                    0660, errp);
+    if (!ioc) {
+        return;
+    }
+    qio_channel_set_name(QIO_CHANNEL(ioc), "migration-template-save");
+    f = qemu_fopen_channel_output(QIO_CHANNEL(ioc));
+    object_unref(OBJECT(ioc));
+
+    ram_set_template(true);
+    ret = qemu_savevm_state(f, errp);
+    ram_set_template(false);
+    if (qemu_fclose(f) < 0 && ret == 0) {
+        error_setg(errp, QERR_IO_ERROR);
+        ret = -EIO;
+    }
+    if (ret < 0) {
+        return;
+    }
+
+    /* Release the image locks, clones use the images as backing files */
+    ret = bdrv_inactivate_all();
+    if (ret) {
+        error_setg(errp, "%s: bdrv_inactivate_all() failed (%d)",
+                   __func__, ret);
+    }
+}
+
+void qmp_x_template_load(const char *filename, Error **errp)
+{
+    MigrationIncomingState *mis = migration_incoming_get_current();
+    Error *local_err = NULL;
+    QEMUFile *f;
+    QIOChannelFile *ioc;
+    int ret;
+
+    /*
+     * -incoming keeps rom_reset() from writing the ROM blobs over the
+     * template RAM when the clone is created.
+     */
+    if (!runstate_check(RUN_STATE_INMIGRATE) ||
+        mis->state != MIGRATION_STATUS_NONE) {
+        error_setg(errp, "Templates are loaded in a VM started with "
+                   "'-incoming defer'");
+        return;
+    }
+
+    ioc = qio_channel_file_new_path(filename, O_RDONLY | O_BINARY, 0, errp);
+    if (!ioc) {
+        return;
+    }
+    qio_channel_set_name(QIO_CHANNEL(ioc), "migration-template-load");
+    f = qemu_fopen_channel_input(QIO_CHANNEL(ioc));
+    object_unref(OBJECT(ioc));
+
+    mis->from_src_file = f;
+    ram_set_template(true);
+    ret = qemu_loadvm_state(f);
+    ram_set_template(false);
+    migration_incoming_state_destroy();
+    if (ret < 0) {
+        error_setg(errp, "Error %d while loading the template", ret);
+        return;
+    }
+
+    bdrv_activate_all(&local_err);
+    if (local_err) {
+        error_propagate(errp, local_err);
+        runstate_set(RUN_STATE_PAUSED);
+        return;
+    }
+
+    qemu_announce_self(&mis->announce_timer, migrate_announce_params());
+    if (autostart) {
+        vm_start();
+    } else {
+        runstate_set(RUN_STATE_PAUSED);
+    }
+}
+
 bool load_snapshot(const char *name, const char *vmstate,
                    bool has_devices, strList *devices, Error **errp)
 {
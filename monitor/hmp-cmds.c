@@ -933,6 +933,58 @@ void hmp_sync_profile(Monitor *mon, const QDict *qdict)
     }
 }
 
+void hmp_mtree_profile(Monitor *mon, const QDict *qdict)
+{
+    bool enable = qdict_get_bool(qdict, "enable");
+    bool has_bucket_size = qdict_haskey(qdict, "bucket_size");
+    int64_t bucket_size = qdict_get_try_int(qdict, "bucket_size", 0);
+    Error *err = NULL;
+
+    if (bucket_size < 0 || bucket_size > UINT32_MAX) {
+        error_setg(&err, QERR_INVALID_PARAMETER_VALUE, "bucket_size",
+                   "a power of 2");
+    } else {
+        qmp_x_mtree_profile(enable, has_bucket_size, bucket_size, &err);
+    }
+    hmp_handle_error(mon, err);
+}
+
+void hmp_info_mtree_profile(Monitor *mon, const QDict *qdict)
+{
+    int64_t max = qdict_get_try_int(qdict, "max", 10);
+    MtreeProfileRegionList *list, *region;
+    MtreeProfileBucketList *bucket;
+    Error *err = NULL;
+
+    list = qmp_x_query_mtree_profile(&err);
+    if (hmp_handle_error(mon, err)) {
+        return;
+    }
+
+    for (region = list; region && max-- > 0; region = region->next) {
+        MtreeProfileRegion *r = region->value;
+
+        monitor_printf(mon, "%s", r->name);
+        if (r->has_owner) {
+            monitor_printf(mon, " (%s)", r->owner);
+        }
+        monitor_printf(mon, ": %" PRIu64 " reads (%" PRIu64 " bytes), "
+                       "%" PRIu64 " writes (%" PRIu64 " bytes), "
+                       "%" PRIu64 " ns\n",
+                       r->reads, r->read_bytes, r->writes, r->write_bytes,
+                       r->time_ns);
+        for (bucket = r->buckets; bucket; bucket = bucket->next) {
+            MtreeProfileBucket *b = bucket->value;
+
+            monitor_printf(mon, "  0x%08" PRIx64 ": %" PRIu64 " reads, "
+                           "%" PRIu64 " writes, %" PRIu64 " ns\n",
+                           b->offset, b->reads, b->writes, b->time_ns);
+        }
+    }
+
+    qapi_free_MtreeProfileRegionList(list);
+}
+
 void hmp_system_reset(Monitor *mon, const QDict *qdict)
 {
     qmp_system_reset(NULL);
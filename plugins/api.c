@@ -393,6 +393,11 @@ void qemu_plugin_outs(const char *string)
     qemu_log_mask(CPU_LOG_PLUGIN, "%s", string);
 }
 
+void qemu_plugin_translation_stats(uint64_t *count, uint64_t *time_ns)
+{
+    plugin_translation_stats(count, time_ns);
+}
+
 bool qemu_plugin_bool_parse(const char *name, const char *value, bool *ret)
 {
     return name && value && qapi_bool_parse(name, value, ret, NULL);
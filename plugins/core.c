@@ -20,6 +20,8 @@
 #include "qemu/rcu_queue.h"
 #include "qemu/xxhash.h"
 #include "qemu/rcu.h"
+#include "qemu/stats64.h"
+#include "qemu/timer.h"
 #include "hw/core/cpu.h"
 #include "exec/cpu-common.h"
 
@@ -475,6 +477,40 @@ void qemu_plugin_vcpu_mem_cb(CPUState *cpu, uint64_t vaddr,
     }
 }
 
+/*
+ * Translation accounting starts when a plugin first reads the counters, so
+ * that translating doesn't read the clock otherwise.
+ */
+static bool trans_stats_enabled;
+static Stat64 trans_count;
+static Stat64 trans_ns;
+
+int64_t qemu_plugin_tb_gen_start(void)
+{
+    return qatomic_read(&trans_stats_enabled) ? get_clock() : 0;
+}
+
+void qemu_plugin_tb_gen_done(int64_t start)
+{
+    if (start) {
+        stat64_add(&trans_count, 1);
+        stat64_add(&trans_ns, get_clock() - start);
+    }
+}
+
+void plugin_translation_stats(uint64_t *count, uint64_t *time_ns)
+{
+    qatomic_set(&trans_stats_enabled, true);
+    *count = stat64_get(&trans_count);
+    *time_ns = stat64_get(&trans_ns);
+}
+
+bool qemu_plugin_installed(void)
+{
+    QEMU_LOCK_GUARD(&plugin.lock);
+    return !QTAILQ_EMPTY(&plugin.ctxs);
+}
+
 void qemu_plugin_atexit_cb(void)
 {
     plugin_cb__udata(QEMU_PLUGIN_EV_ATEXIT);
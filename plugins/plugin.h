@@ -97,4 +97,6 @@ void plugin_register_vcpu_mem_cb(GArray **arr,
 
 void exec_inline_op(struct qemu_plugin_dyn_cb *cb);
 
+void plugin_translation_stats(uint64_t *count, uint64_t *time_ns);
+
 #endif /* PLUGIN_H */
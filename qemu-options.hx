@@ -151,6 +151,9 @@ DEF("accel", HAS_ARG, QEMU_OPTION_accel,
     "                kvm-shadow-mem=size of KVM shadow MMU in bytes\n"
     "                split-wx=on|off (enable TCG split w^x mapping)\n"
     "                tb-size=n (TCG translation block cache size)\n"
+    "                hot-threshold=n (retranslate TCG blocks looked up n times)\n"
+    "                tb-cache=file (reuse TCG translations across runs)\n"
+    "                sleep=on|off (wait for timers in real time when TCG vCPUs are idle)\n"
     "                dirty-ring-size=n (KVM dirty ring GFN count, default 0)\n"
     "                thread=single|multi (enable multi-threaded TCG)\n", QEMU_ARCH_ALL)
 SRST
@@ -185,6 +188,32 @@ SRST
     ``tb-size=n``
         Controls the size (in MiB) of the TCG translation block cache.
 
+    ``hot-threshold=n``
+        Retranslates a TCG translation block once it has been looked up
+        ``n`` times, i.e. entered other than through a direct jump from
+        another block. Hot blocks may be optimized further by the target,
+        e.g. the Arm target follows unconditional forward branches within
+        a page to form longer blocks. The default of 0 disables this.
+
+    ``tb-cache=file``
+        Saves the TCG translations to ``file`` at exit, and reuses them
+        on the next run if the guest code they were generated from is
+        unchanged. This shortens repeated boots of the same firmware. The
+        file is only valid for the same QEMU binary loaded at the same
+        address, so it is ignored unless address space randomization is
+        disabled (e.g. with ``setarch -R``) or QEMU is not built as a
+        position independent executable. Not compatible with ``split-wx``,
+        and not used while TCG plugins are loaded.
+
+    ``sleep=on|off``
+        When ``off``, and all vCPUs are idle, the virtual clock jumps to
+        the next timer deadline instead of waiting for it in real time.
+        Guests that mostly sleep or poll timers then run much faster than
+        real time. Like ``-icount sleep=off``, the jumps are visible to
+        the outside world, e.g. network peers. Not available with
+        ``-icount``, which has its own ``sleep`` option. The default is
+        ``on``.
+
     ``thread=single|multi``
         Controls number of TCG threads. When the TCG is multi-threaded
         there will be one thread per vCPU therefore taking advantage of
@@ -264,6 +264,57 @@ void qemu_timer_notify_cb(void *opaque, QEMUClockType type)
     }
 }
 
+/*
+ * Without icount, QEMU_CLOCK_VIRTUAL follows the host clock, and idle
+ * vCPUs wait for the next virtual timer in real time. With idle warp,
+ * the main loop polls for I/O without blocking while all vCPUs are idle,
+ * and then jumps the clock straight to the next deadline. Like icount
+ * with sleep=off, the jumps are visible to the outside world.
+ */
+static void cpu_timers_idle_warp(Notifier *notifier, void *opaque)
+{
+    MainLoopPoll *mlpoll = opaque;
+    int64_t deadline;
+
+    if (!runstate_is_running() || !all_cpu_threads_idle()) {
+        return;
+    }
+
+    deadline = qemu_clock_deadline_ns_all(QEMU_CLOCK_VIRTUAL,
+                                          ~QEMU_TIMER_ATTR_EXTERNAL);
+    if (deadline < 0) {
+        /* Nothing will wake the vCPUs but I/O; wait for it */
+        return;
+    }
+
+    switch (mlpoll->state) {
+    case MAIN_LOOP_POLL_FILL:
+        mlpoll->timeout = 0;
+        break;
+    case MAIN_LOOP_POLL_OK:
+        /* Still idle once pending I/O has been dispatched */
+        if (deadline > 0) {
+            seqlock_write_lock(&timers_state.vm_clock_seqlock,
+                               &timers_state.vm_clock_lock);
+            timers_state.cpu_clock_offset += deadline;
+            seqlock_write_unlock(&timers_state.vm_clock_seqlock,
+                                 &timers_state.vm_clock_lock);
+            qemu_clock_notify(QEMU_CLOCK_VIRTUAL);
+        }
+        break;
+    }
+}
+
+static Notifier idle_warp_notifier = {
+    .notify = cpu_timers_idle_warp,
+};
+
+void cpu_timers_enable_idle_warp(void)
+{
+    assert(!icount_enabled());
+    main_loop_poll_add_notifier(&idle_warp_notifier);
+}
+
 TimersState timers_state;
 
 /* initialize timers state and the cpu throttle for convenience */
@@ -20,6 +20,8 @@
 #include "qapi/visitor.h"
 #include "qemu/bitops.h"
 #include "qemu/error-report.h"
+#include "qemu/lockable.h"
+#include "qemu/timer.h"
 #include "qemu/main-loop.h"
 #include "qemu/qemu-print.h"
 #include "qom/object.h"
@@ -33,6 +35,7 @@
 #include "qemu/accel.h"
 #include "hw/boards.h"
 #include "migration/vmstate.h"
+#include "qapi/qapi-commands-machine.h"
 
 //#define DEBUG_UNASSIGNED
 
@@ -1246,6 +1249,7 @@ static void memory_region_initfn(Object *obj)
     mr->ops = &unassigned_mem_ops;
     mr->enabled = true;
     mr->romd_mode = true;
+    mr->global_locking = true;
     mr->destructor = memory_region_destructor_none;
     QTAILQ_INIT(&mr->subregions);
     QTAILQ_INIT(&mr->coalesced);
@@ -1412,6 +1416,218 @@ bool memory_region_access_valid(MemoryRegion *mr,
     return true;
 }
 
+/*
+ * MMIO access profiler.  While enabled, every dispatched access is counted
+ * per region and per offset bucket, with the host time spent in the device
+ * callbacks.  When disabled, the only cost is the test of mtree_profile_on.
+ */
+
+/* Offset buckets recorded per region, further offsets only count in total */
+#define MTREE_PROFILE_MAX_BUCKETS 256
+
+typedef struct MtreeProfileCounters {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t time_ns;
+} MtreeProfileCounters;
+
+typedef struct MtreeProfileEntry {
+    char *name;
+    char *owner;
+    MtreeProfileCounters total;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    /* hwaddr bucket offset -> MtreeProfileBucketEntry */
+    GHashTable *buckets;
+} MtreeProfileEntry;
+
+typedef struct MtreeProfileBucketEntry {
+    hwaddr offset;
+    MtreeProfileCounters c;
+} MtreeProfileBucketEntry;
+
+static bool mtree_profile_on;
+static unsigned mtree_profile_bucket_bits;
+/* MemoryRegion -> MtreeProfileEntry, protected by mtree_profile_lock */
+static GHashTable *mtree_profile;
+static QemuMutex mtree_profile_lock;
+
+static void mtree_profile_entry_free(gpointer data)
+{
+    MtreeProfileEntry *e = data;
+
+    g_free(e->name);
+    g_free(e->owner);
+    g_hash_table_destroy(e->buckets);
+    g_free(e);
+}
+
+static void mtree_profile_count(MtreeProfileCounters *c, bool is_write,
+                                int64_t ns)
+{
+    if (is_write) {
+        c->writes++;
+    } else {
+        c->reads++;
+    }
+    c->time_ns += ns;
+}
+
+static void mtree_profile_record(MemoryRegion *mr, hwaddr addr,
+                                 unsigned size, bool is_write, int64_t ns)
+{
+    hwaddr offset = addr & ~((1ULL << mtree_profile_bucket_bits) - 1);
+    MtreeProfileBucketEntry *b;
+    MtreeProfileEntry *e;
+
+    QEMU_LOCK_GUARD(&mtree_profile_lock);
+
+    /* The profiler may have been disabled since the access started */
+    if (!mtree_profile_on) {
+        return;
+    }
+
+    e = g_hash_table_lookup(mtree_profile, mr);
+    if (!e) {
+        Object *owner = memory_region_owner(mr);
+
+        e = g_new0(MtreeProfileEntry, 1);
+        e->name = g_strdup(memory_region_name(mr));
+        e->owner = owner ? object_get_canonical_path(owner) : NULL;
+        e->buckets = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                           NULL, g_free);
+        g_hash_table_insert(mtree_profile, mr, e);
+    }
+
+    mtree_profile_count(&e->total, is_write, ns);
+    if (is_write) {
+        e->write_bytes += size;
+    } else {
+        e->read_bytes += size;
+    }
+
+    b = g_hash_table_lookup(e->buckets, &offset);
+    if (!b) {
+        if (g_hash_table_size(e->buckets) >= MTREE_PROFILE_MAX_BUCKETS) {
+            return;
+        }
+        b = g_new0(MtreeProfileBucketEntry, 1);
+        b->offset = offset;
+        g_hash_table_insert(e->buckets, &b->offset, b);
+    }
+    mtree_profile_count(&b->c, is_write, ns);
+}
+
+/* Called when a region is finalized, its address may be reused */
+static void mtree_profile_forget(MemoryRegion *mr)
+{
+    if (!qatomic_read(&mtree_profile)) {
+        return;
+    }
+
+    WITH_QEMU_LOCK_GUARD(&mtree_profile_lock) {
+        g_hash_table_remove(mtree_profile, mr);
+    }
+}
+
+void qmp_x_mtree_profile(bool enable, bool has_bucket_size,
+                         uint32_t bucket_size, Error **errp)
+{
+    if (!has_bucket_size) {
+        bucket_size = 4;
+    }
+    if (!is_power_of_2(bucket_size)) {
+        error_setg(errp, "bucket-size must be a power of 2");
+        return;
+    }
+
+    if (!mtree_profile) {
+        qemu_mutex_init(&mtree_profile_lock);
+        qatomic_set(&mtree_profile,
+                    g_hash_table_new_full(NULL, NULL, NULL,
+                                          mtree_profile_entry_free));
+    }
+
+    WITH_QEMU_LOCK_GUARD(&mtree_profile_lock) {
+        if (enable && !mtree_profile_on) {
+            g_hash_table_remove_all(mtree_profile);
+            mtree_profile_bucket_bits = ctz32(bucket_size);
+        }
+        qatomic_set(&mtree_profile_on, enable);
+    }
+}
+
+static MtreeProfileBucket *mtree_profile_bucket(MtreeProfileBucketEntry *b)
+{
+    MtreeProfileBucket *info = g_new0(MtreeProfileBucket, 1);
+
+    info->offset = b->offset;
+    info->reads = b->c.reads;
+    info->writes = b->c.writes;
+    info->time_ns = b->c.time_ns;
+    return info;
+}
+
+static gint mtree_profile_bucket_cmp(gconstpointer a, gconstpointer b)
+{
+    const MtreeProfileBucketEntry *ba = a, *bb = b;
+
+    return ba->offset < bb->offset ? -1 : ba->offset > bb->offset;
+}
+
+static gint mtree_profile_region_cmp(gconstpointer a, gconstpointer b)
+{
+    const MtreeProfileRegion *ra = *(MtreeProfileRegion * const *)a;
+    const MtreeProfileRegion *rb = *(MtreeProfileRegion * const *)b;
+
+    return ra->time_ns > rb->time_ns ? -1 : ra->time_ns < rb->time_ns;
+}
+
+MtreeProfileRegionList *qmp_x_query_mtree_profile(Error **errp)
+{
+    g_autoptr(GPtrArray) regions = g_ptr_array_new();
+    MtreeProfileRegionList *list = NULL;
+    GHashTableIter iter;
+    MtreeProfileEntry *e;
+    guint i;
+
+    if (!mtree_profile) {
+        return NULL;
+    }
+
+    WITH_QEMU_LOCK_GUARD(&mtree_profile_lock) {
+        g_hash_table_iter_init(&iter, mtree_profile);
+        while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&e)) {
+            MtreeProfileRegion *info = g_new0(MtreeProfileRegion, 1);
+            g_autoptr(GList) buckets = g_hash_table_get_values(e->buckets);
+            MtreeProfileBucketList **tail = &info->buckets;
+            GList *l;
+
+            info->name = g_strdup(e->name);
+            info->has_owner = !!e->owner;
+            info->owner = g_strdup(e->owner);
+            info->reads = e->total.reads;
+            info->writes = e->total.writes;
+            info->read_bytes = e->read_bytes;
+            info->write_bytes = e->write_bytes;
+            info->time_ns = e->total.time_ns;
+
+            buckets = g_list_sort(buckets, mtree_profile_bucket_cmp);
+            for (l = buckets; l; l = l->next) {
+                QAPI_LIST_APPEND(tail, mtree_profile_bucket(l->data));
+            }
+            g_ptr_array_add(regions, info);
+        }
+    }
+
+    /* Most expensive regions first */
+    g_ptr_array_sort(regions, mtree_profile_region_cmp);
+    for (i = regions->len; i > 0; i--) {
+        QAPI_LIST_PREPEND(list, g_ptr_array_index(regions, i - 1));
+    }
+    return list;
+}
+
 static MemTxResult memory_region_dispatch_read1(MemoryRegion *mr,
                                                 hwaddr addr,
                                                 uint64_t *pval,
@@ -1454,7 +1670,15 @@ MemTxResult memory_region_dispatch_read(MemoryRegion *mr,
         return MEMTX_DECODE_ERROR;
     }
 
-    r = memory_region_dispatch_read1(mr, addr, pval, size, attrs);
+    /* A subpage forwards to the regions it covers, which are counted */
+    if (unlikely(qatomic_read(&mtree_profile_on)) && !mr->subpage) {
+        int64_t start = get_clock();
+
+        r = memory_region_dispatch_read1(mr, addr, pval, size, attrs);
+        mtree_profile_record(mr, addr, size, false, get_clock() - start);
+    } else {
+        r = memory_region_dispatch_read1(mr, addr, pval, size, attrs);
+    }
     adjust_endianness(mr, pval, op);
     return r;
 }
@@ -1485,6 +1709,28 @@ static bool memory_region_dispatch_write_eventfds(MemoryRegion *mr,
     return false;
 }
 
+static MemTxResult memory_region_dispatch_write1(MemoryRegion *mr,
+                                                 hwaddr addr,
+                                                 uint64_t data,
+                                                 unsigned size,
+                                                 MemTxAttrs attrs)
+{
+    if (mr->ops->write) {
+        return access_with_adjusted_size(addr, &data, size,
+                                         mr->ops->impl.min_access_size,
+                                         mr->ops->impl.max_access_size,
+                                         memory_region_write_accessor, mr,
+                                         attrs);
+    } else {
+        return
+            access_with_adjusted_size(addr, &data, size,
+                                      mr->ops->impl.min_access_size,
+                                      mr->ops->impl.max_access_size,
+                                      memory_region_write_with_attrs_accessor,
+                                      mr, attrs);
+    }
+}
+
 MemTxResult memory_region_dispatch_write(MemoryRegion *mr,
                                          hwaddr addr,
                                          uint64_t data,
@@ -1492,6 +1738,7 @@ MemTxResult memory_region_dispatch_write(MemoryRegion *mr,
                                          MemTxAttrs attrs)
 {
     unsigned size = memop_size(op);
+    MemTxResult r;
 
     if (mr->alias) {
         return memory_region_dispatch_write(mr->alias,
@@ -1510,20 +1757,15 @@ MemTxResult memory_region_dispatch_write(MemoryRegion *mr,
         return MEMTX_OK;
     }
 
-    if (mr->ops->write) {
-        return access_with_adjusted_size(addr, &data, size,
-                                         mr->ops->impl.min_access_size,
-                                         mr->ops->impl.max_access_size,
-                                         memory_region_write_accessor, mr,
-                                         attrs);
+    if (unlikely(qatomic_read(&mtree_profile_on)) && !mr->subpage) {
+        int64_t start = get_clock();
+
+        r = memory_region_dispatch_write1(mr, addr, data, size, attrs);
+        mtree_profile_record(mr, addr, size, true, get_clock() - start);
     } else {
-        return
-            access_with_adjusted_size(addr, &data, size,
-                                      mr->ops->impl.min_access_size,
-                                      mr->ops->impl.max_access_size,
-                                      memory_region_write_with_attrs_accessor,
-                                      mr, attrs);
+        r = memory_region_dispatch_write1(mr, addr, data, size, attrs);
     }
+    return r;
 }
 
 void memory_region_init_io(MemoryRegion *mr,
@@ -1764,6 +2006,7 @@ static void memory_region_finalize(Object *obj)
     memory_region_transaction_commit();
 
     mr->destructor(mr);
+    mtree_profile_forget(mr);
     memory_region_clear_coalescing(mr);
     g_free((char *)mr->name);
     g_free(mr->ioeventfds);
@@ -2442,6 +2685,16 @@ void memory_region_clear_flush_coalesced(MemoryRegion *mr)
     }
 }
 
+void memory_region_clear_global_locking(MemoryRegion *mr)
+{
+    mr->global_locking = false;
+}
+
+void memory_region_set_global_locking(MemoryRegion *mr)
+{
+    mr->global_locking = true;
+}
+
 static bool userspace_eventfd_warning;
 
 void memory_region_add_eventfd(MemoryRegion *mr,
@@ -2546,6 +2546,11 @@ static subpage_t *subpage_init(FlatView *fv, hwaddr base)
     memory_region_init_io(&mmio->iomem, NULL, &subpage_ops, mmio,
                           NULL, TARGET_PAGE_SIZE);
     mmio->iomem.subpage = true;
+    /*
+     * The accesses are forwarded to the regions sharing the page, which
+     * take the BQL themselves unless they opted out of it.
+     */
+    memory_region_clear_global_locking(&mmio->iomem);
 #if defined(DEBUG_SUBPAGE)
     printf("%s: %p base " TARGET_FMT_plx " len %08x\n", __func__,
            mmio, base, TARGET_PAGE_SIZE);
@@ -2710,11 +2715,11 @@ void memory_region_flush_rom_device(MemoryRegion *mr, hwaddr addr, hwaddr size)
 {
     /*
      * In principle this function would work on other memory region types too,
-     * but the ROM device use case is the only one where this operation is
-     * necessary.  Other memory regions should use the
-     * address_space_read/write() APIs.
+     * but ROM devices and ROM regions whose contents are changed by their
+     * owner are the only use cases where this operation is necessary.  Other
+     * memory regions should use the address_space_read/write() APIs.
      */
-    assert(memory_region_is_romd(mr));
+    assert(memory_region_is_romd(mr) || memory_region_is_rom(mr));
 
     invalidate_and_set_dirty(mr, addr, size);
 }
@@ -2748,14 +2753,22 @@ static int memory_access_size(MemoryRegion *mr, unsigned l, hwaddr addr)
 
 static bool prepare_mmio_access(MemoryRegion *mr)
 {
+    bool unlocked = !qemu_mutex_iothread_locked();
     bool release_lock = false;
 
-    if (!qemu_mutex_iothread_locked()) {
+    if (unlocked && mr->global_locking) {
         qemu_mutex_lock_iothread();
+        unlocked = false;
         release_lock = true;
     }
     if (mr->flush_coalesced_mmio) {
+        if (unlocked) {
+            qemu_mutex_lock_iothread();
+        }
         qemu_flush_coalesced_mmio_buffer();
+        if (unlocked) {
+            qemu_mutex_unlock_iothread();
+        }
     }
 
     return release_lock;
@@ -8303,9 +8303,41 @@ static bool trans_CLRM(DisasContext *s, arg_CLRM *a)
  * Branch, branch with link
  */
 
+/*
+ * In a hot TB (CF_HOT), continue translating at the target of an
+ * unconditional forward branch within the page rather than ending the TB.
+ * The optimizer then sees the code on both sides of the branch, e.g. a
+ * flag computation that is dead after it. Only following forward
+ * branches keeps [pc_first, pc_next) covering all translated insns, which
+ * the TB size must do for invalidation.
+ */
+static bool arm_follow_branch(DisasContext *s, uint32_t dest)
+{
+    if (!(tb_cflags(s->base.tb) & CF_HOT) ||
+        s->base.is_jmp != DISAS_NEXT || s->base.singlestep_enabled ||
+        s->ss_active || s->condjmp || s->condexec_mask || s->eci ||
+        dest < s->base.pc_next ||
+        ((dest ^ s->base.pc_first) & TARGET_PAGE_MASK)) {
+        return false;
+    }
+    if (!s->thumb) {
+        /* Keep the page bound set up by arm_tr_init_disas_context */
+        int bound = (s->page_start + TARGET_PAGE_SIZE - dest) / 4;
+
+        s->base.max_insns = MIN(s->base.max_insns,
+                                s->base.num_insns + bound);
+    }
+    s->base.pc_next = dest;
+    return true;
+}
+
 static bool trans_B(DisasContext *s, arg_i *a)
 {
-    gen_jmp(s, read_pc(s) + a->imm);
+    uint32_t dest = read_pc(s) + a->imm;
+
+    if (!arm_follow_branch(s, dest)) {
+        gen_jmp(s, dest);
+    }
     return true;
 }
 
@@ -8326,8 +8358,12 @@ static bool trans_B_cond_thumb(DisasContext *s, arg_ci *a)
 
 static bool trans_BL(DisasContext *s, arg_i *a)
 {
+    uint32_t dest = read_pc(s) + a->imm;
+
     tcg_gen_movi_i32(cpu_R[14], s->base.pc_next | s->thumb);
-    gen_jmp(s, read_pc(s) + a->imm);
+    if (!arm_follow_branch(s, dest)) {
+        gen_jmp(s, dest);
+    }
     return true;
 }
 
@@ -60,10 +60,14 @@ struct tcg_region_state {
     /* fields protected by the lock */
     size_t current; /* current region index */
     size_t agg_size_full; /* aggregate size of full regions */
+    void *reserved; /* end of the code reserved by tcg_region_reserve() */
 };
 
 static struct tcg_region_state region;
 
+/* Preferred address of code_gen_buffer, see tcg_region_set_hint() */
+static void *region_hint;
+
 /*
  * This is an array of struct tcg_region_tree's, with padding.
  * We use void * to simplify the computation of region_trees[i]; each
@@ -316,6 +320,10 @@ static void tcg_region_bounds(size_t curr_region, void **pstart, void **pend)
     if (curr_region == region.n - 1) {
         end = region.start_aligned + region.total_size;
     }
+    /* The region holding the end of the reserved code keeps the rest */
+    if (region.reserved > start && region.reserved < end) {
+        start = region.reserved;
+    }
 
     *pstart = start;
     *pend = end;
@@ -379,6 +387,56 @@ void tcg_region_initial_alloc(TCGContext *s)
     qemu_mutex_unlock(&region.lock);
 }
 
+/*
+ * Take the code below @end out of the allocation pool, because it was not
+ * generated by this process (see accel/tcg/tb-persist.c). The region that
+ * holds @end keeps the space after it, so that this works with a single
+ * region as well; the contexts move to that region and the ones that
+ * follow. Call from a safe-work context, before any code is generated.
+ * Returns false if too little space would be left.
+ */
+bool tcg_region_reserve(const void *end)
+{
+    unsigned int n_ctxs = qatomic_read(&tcg_cur_ctxs);
+    void *start, *stop;
+    size_t n, i;
+
+    if (!in_code_gen_buffer(end) || end <= region.after_prologue) {
+        return false;
+    }
+    n = (end - 1 - region.start_aligned) / region.stride;
+    tcg_region_bounds(n, &start, &stop);
+    if (end + TCG_HIGHWATER >= stop) {
+        /* Too little left in that region, start with the next one */
+        n++;
+    }
+    if (n_ctxs == 0 || n + n_ctxs > region.n) {
+        return false;
+    }
+
+    qemu_mutex_lock(&region.lock);
+    region.current = n;
+    region.agg_size_full = 0;
+    for (i = 0; i < n; i++) {
+        tcg_region_bounds(i, &start, &stop);
+        region.agg_size_full += stop - start - TCG_HIGHWATER;
+    }
+    if (n < region.n) {
+        tcg_region_bounds(n, &start, &stop);
+        if (end > start) {
+            region.agg_size_full += end - start;
+        }
+    }
+    region.reserved = (void *)end;
+
+    for (i = 0; i < n_ctxs; i++) {
+        TCGContext *s = qatomic_read(&tcg_ctxs[i]);
+        tcg_region_initial_alloc__locked(s);
+    }
+    qemu_mutex_unlock(&region.lock);
+    return true;
+}
+
 /* Call from a safe-work context */
 void tcg_region_reset_all(void)
 {
@@ -388,6 +446,7 @@ void tcg_region_reset_all(void)
     qemu_mutex_lock(&region.lock);
     region.current = 0;
     region.agg_size_full = 0;
+    region.reserved = NULL;
 
     for (i = 0; i < n_ctxs; i++) {
         TCGContext *s = qatomic_read(&tcg_ctxs[i]);
@@ -532,7 +591,7 @@ static int alloc_code_gen_buffer_anon(size_t size, int prot,
 {
     void *buf;
 
-    buf = mmap(NULL, size, prot, flags, -1, 0);
+    buf = mmap(region_hint, size, prot, flags, -1, 0);
     if (buf == MAP_FAILED) {
         error_setg_errno(errp, errno,
                          "allocate %zu bytes for jit buffer", size);
@@ -699,6 +758,22 @@ static int alloc_code_gen_buffer(size_t size, int splitwx, Error **errp)
 }
 #endif /* USE_STATIC_CODE_GEN_BUFFER, WIN32, POSIX */
 
+/*
+ * Ask tcg_region_init() to map code_gen_buffer at @addr. This is only
+ * a hint; it is honoured if that part of the address space is free and
+ * the buffer is allocated with mmap.
+ */
+void tcg_region_set_hint(void *addr)
+{
+    region_hint = addr;
+}
+
+/* Returns the start of code_gen_buffer. */
+void *tcg_region_start(void)
+{
+    return region.start_aligned;
+}
+
 /*
  * Initializes region partitioning.
  *
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * Check the translation counters of qemu_plugin_translation_stats(): they
+ * never go back, and the blocks translated while the plugin is installed
+ * are counted, with the host time spent on them.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+#include <inttypes.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <glib.h>
+
+#include <qemu-plugin.h>
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_version = QEMU_PLUGIN_VERSION;
+
+static GMutex lock;
+static uint64_t start_count, start_ns;
+static uint64_t last_count, last_ns;
+static uint64_t tb_trans;
+
+/* The block being translated is counted once it is done */
+static void vcpu_tb_trans(qemu_plugin_id_t id, struct qemu_plugin_tb *tb)
+{
+    uint64_t count, ns;
+
+    g_mutex_lock(&lock);
+    qemu_plugin_translation_stats(&count, &ns);
+    assert(count >= last_count);
+    assert(ns >= last_ns);
+    last_count = count;
+    last_ns = ns;
+    tb_trans++;
+    g_mutex_unlock(&lock);
+}
+
+static void plugin_exit(qemu_plugin_id_t id, void *p)
+{
+    g_autoptr(GString) report = g_string_new("");
+    uint64_t count, ns;
+
+    qemu_plugin_translation_stats(&count, &ns);
+    g_string_printf(report, "translated: %" PRIu64 ", time: %" PRIu64
+                    " ns, callbacks: %" PRIu64 "\n",
+                    count - start_count, ns - start_ns, tb_trans);
+    qemu_plugin_outs(report->str);
+
+    assert(tb_trans);
+    assert(count > last_count);
+    assert(ns > start_ns);
+}
+
+QEMU_PLUGIN_EXPORT int qemu_plugin_install(qemu_plugin_id_t id,
+                                           const qemu_info_t *info,
+                                           int argc, char **argv)
+{
+    /* The first call starts the counters */
+    qemu_plugin_translation_stats(&start_count, &start_ns);
+    last_count = start_count;
+    last_ns = start_ns;
+
+    qemu_plugin_register_vcpu_tb_trans_cb(id, vcpu_tb_trans);
+    qemu_plugin_register_atexit_cb(id, plugin_exit, NULL);
+    return 0;
+}
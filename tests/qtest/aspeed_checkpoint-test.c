@@ -0,0 +1,172 @@
+/*
+ * QTest testcase for in-memory checkpoints, on an Aspeed machine.
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+
+#define DRAM_ADDR   0x80000000
+#define SRAM_ADDR   0x10000000
+#define UART5_BASE  0x1E784000
+#define UART_SCR    (7 << 2)
+
+#define FMC_BASE    0x1E620000
+#define FMC_CONF    0x00
+#define   CONF_ENABLE_W0        (1 << 16)
+#define FMC_CTRL0   0x10
+#define   CTRL_CE_STOP_ACTIVE   (1 << 2)
+#define   CTRL_USERMODE         0x3
+#define FLASH_BASE  0x20000000
+
+/* Flash commands */
+#define PP              0x02
+#define READ            0x03
+#define WREN            0x06
+#define EN_4BYTE_ADDR   0xb7
+
+static uint64_t checkpoint_restore(QTestState *s)
+{
+    QDict *rsp, *ret;
+    uint64_t pages;
+
+    rsp = qtest_qmp(s, "{ 'execute': 'checkpoint-restore' }");
+    g_assert(qdict_haskey(rsp, "return"));
+    ret = qdict_get_qdict(rsp, "return");
+    pages = qdict_get_int(ret, "pages");
+    qobject_unref(rsp);
+
+    return pages;
+}
+
+/* Runs @cmd at @addr on the flash of CS0, in user mode */
+static void flash_cmd(QTestState *s, uint8_t cmd, uint32_t addr)
+{
+    uint32_t ctrl = qtest_readl(s, FMC_BASE + FMC_CTRL0);
+
+    qtest_writel(s, FMC_BASE + FMC_CONF,
+                 qtest_readl(s, FMC_BASE + FMC_CONF) | CONF_ENABLE_W0);
+    ctrl |= CTRL_USERMODE | CTRL_CE_STOP_ACTIVE;
+    qtest_writel(s, FMC_BASE + FMC_CTRL0, ctrl);
+    ctrl &= ~CTRL_CE_STOP_ACTIVE;
+    qtest_writel(s, FMC_BASE + FMC_CTRL0, ctrl);
+
+    qtest_writeb(s, FLASH_BASE, EN_4BYTE_ADDR);
+    if (cmd == PP) {
+        qtest_writeb(s, FLASH_BASE, WREN);
+    }
+    qtest_writeb(s, FLASH_BASE, cmd);
+    qtest_writel(s, FLASH_BASE, bswap32(addr));
+}
+
+static void flash_cmd_end(QTestState *s)
+{
+    qtest_writel(s, FMC_BASE + FMC_CTRL0,
+                 qtest_readl(s, FMC_BASE + FMC_CTRL0) | CTRL_USERMODE |
+                 CTRL_CE_STOP_ACTIVE);
+}
+
+static void flash_writel(QTestState *s, uint32_t addr, uint32_t value)
+{
+    flash_cmd(s, PP, addr);
+    qtest_writel(s, FLASH_BASE, value);
+    flash_cmd_end(s);
+}
+
+static uint32_t flash_readl(QTestState *s, uint32_t addr)
+{
+    uint32_t value;
+
+    flash_cmd(s, READ, addr);
+    value = qtest_readl(s, FLASH_BASE);
+    flash_cmd_end(s);
+
+    return value;
+}
+
+static void test_restore(void)
+{
+    QTestState *s = qtest_init("-machine ast2600-evb");
+    uint64_t pages;
+
+    qtest_writel(s, DRAM_ADDR, 0x12345678);
+    qtest_writel(s, SRAM_ADDR, 0xcafe0001);
+    qtest_writel(s, UART5_BASE + UART_SCR, 0x5a);
+    qtest_qmp_assert_success(s, "{ 'execute': 'checkpoint-create' }");
+
+    qtest_writel(s, DRAM_ADDR, 0x87654321);
+    qtest_writel(s, DRAM_ADDR + 0x100000, 0xdeadbeef);
+    qtest_writel(s, SRAM_ADDR, 0xcafe0002);
+    qtest_writel(s, UART5_BASE + UART_SCR, 0xa5);
+
+    /* Only the written pages are copied back */
+    pages = checkpoint_restore(s);
+    g_assert_cmpuint(pages, >=, 3);
+    g_assert_cmpuint(pages, <, 64);
+    g_assert_cmphex(qtest_readl(s, DRAM_ADDR), ==, 0x12345678);
+    g_assert_cmphex(qtest_readl(s, DRAM_ADDR + 0x100000), ==, 0);
+    g_assert_cmphex(qtest_readl(s, SRAM_ADDR), ==, 0xcafe0001);
+    g_assert_cmphex(qtest_readl(s, UART5_BASE + UART_SCR), ==, 0x5a);
+
+    /* The checkpoint is kept */
+    qtest_writel(s, DRAM_ADDR, 0x87654321);
+    checkpoint_restore(s);
+    g_assert_cmphex(qtest_readl(s, DRAM_ADDR), ==, 0x12345678);
+
+    qtest_quit(s);
+}
+
+/* The flash storage is not RAM, the m25p80 model rolls it back itself */
+static void test_restore_flash(void)
+{
+    QTestState *s = qtest_init("-machine ast2600-evb");
+
+    flash_writel(s, 0x0, 0x12345678);
+    qtest_qmp_assert_success(s, "{ 'execute': 'checkpoint-create' }");
+
+    flash_writel(s, 0x0, 0x02040608);
+    flash_writel(s, 0x10000, 0xcafe0001);
+    g_assert_cmphex(flash_readl(s, 0x0), ==, 0x02040608);
+    g_assert_cmphex(flash_readl(s, 0x10000), ==, 0xcafe0001);
+
+    checkpoint_restore(s);
+    g_assert_cmphex(flash_readl(s, 0x0), ==, 0x12345678);
+    g_assert_cmphex(flash_readl(s, 0x10000), ==, 0xffffffff);
+
+    qtest_quit(s);
+}
+
+static void test_delete(void)
+{
+    QTestState *s = qtest_init("-machine ast2600-evb");
+    QDict *rsp;
+
+    qtest_qmp_assert_success(s, "{ 'execute': 'checkpoint-create' }");
+    rsp = qtest_qmp(s, "{ 'execute': 'migrate', "
+                    "  'arguments': { 'uri': 'exec:cat > /dev/null' } }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+
+    qtest_qmp_assert_success(s, "{ 'execute': 'checkpoint-delete' }");
+    rsp = qtest_qmp(s, "{ 'execute': 'checkpoint-restore' }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+
+    qtest_quit(s);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/checkpoint/restore", test_restore);
+    qtest_add_func("/ast2600/checkpoint/restore_flash", test_restore_flash);
+    qtest_add_func("/ast2600/checkpoint/delete", test_delete);
+
+    return g_test_run();
+}
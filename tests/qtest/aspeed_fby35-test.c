@@ -0,0 +1,186 @@
+/*
+ * QTest testcase for the fby35 sled, IPMB from the BMC to a BIC
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+
+/* BMC bus 0 is wired to bus 6 of the BIC of slot 0 */
+#define BMC_I2C_BUS0_BASE       0x1E78A080
+#define BIC_I2C_BUS6_BASE       0x7E7B0380
+#define BIC_ADDR                0x20
+
+/* The BMC has 2 CPUs, the BIC of slot 0 comes next */
+#define BIC0_CPU                2
+
+#define I2CD_FUN_CTRL_REG       0x00
+#define   I2CD_SLAVE_EN                    (0x1 << 1)
+#define   I2CD_MASTER_EN                   (0x1)
+#define I2CD_INTR_STS_REG       0x10
+#define   I2CD_INTR_NORMAL_STOP            (0x1 << 4)
+#define   I2CD_INTR_TX_NAK                 (0x1 << 1)
+#define   I2CD_INTR_TX_ACK                 (0x1 << 0)
+#define I2CD_CMD_REG            0x14
+#define   I2CD_M_STOP_CMD                  (0x1 << 5)
+#define   I2CD_M_TX_CMD                    (0x1 << 1)
+#define   I2CD_M_START_CMD                 (0x1)
+#define I2CD_BYTE_BUF_REG       0x20
+#define   I2CD_BYTE_BUF_RX_SHIFT           8
+
+/* Where the BIC firmware logs the byte buffer on each RX_DONE */
+#define BIC_LOG_ADDR            0x8000
+
+/*
+ * BIC firmware, Thumb. Enables the slave function of bus 6 at BIC_ADDR,
+ * then acknowledges each received byte, logging the byte buffer.
+ */
+static const uint16_t bic_fw[] = {
+    0x0000, 0x0001,     /* initial SP 0x10000 */
+    0x0009, 0x0000,     /* reset vector 0x8 */
+    0x4807,             /* ldr r0, =BIC_I2C_BUS6_BASE */
+    0x4c08,             /* ldr r4, =BIC_LOG_ADDR */
+    0x2120,             /* movs r1, #BIC_ADDR */
+    0x6181,             /* str r1, [r0, #I2CD_DEV_ADDR_REG] */
+    0x2102,             /* movs r1, #I2CD_SLAVE_EN */
+    0x6001,             /* str r1, [r0, #I2CD_FUN_CTRL_REG] */
+    0x2384,             /* movs r3, #(ADDR_RX_MATCH | RX_DONE) */
+    0x6901,             /* 1: ldr r1, [r0, #I2CD_INTR_STS_REG] */
+    0x4219,             /* tst r1, r3 */
+    0xd0fc,             /* beq 1b */
+    0x6a02,             /* ldr r2, [r0, #I2CD_BYTE_BUF_REG] */
+    0x6022,             /* str r2, [r4] */
+    0x3404,             /* adds r4, #4 */
+    0x6103,             /* str r3, [r0, #I2CD_INTR_STS_REG] */
+    0xe7f7,             /* b 1b */
+    0xbf00,             /* nop */
+    0x0380, 0x7e7b,     /* BIC_I2C_BUS6_BASE */
+    0x8000, 0x0000,     /* BIC_LOG_ADDR */
+};
+
+/* Reads @addr in the address space of the BIC */
+static uint32_t bic_readl(QTestState *s, uint32_t addr)
+{
+    g_autofree char *cmd = g_strdup_printf("x /1wx 0x%x", addr);
+    QDict *rsp;
+    const char *out;
+    uint32_t val;
+
+    rsp = qtest_qmp(s, "{ 'execute': 'human-monitor-command', "
+                    "'arguments': { 'command-line': %s, 'cpu-index': %d } }",
+                    cmd, BIC0_CPU);
+    out = strchr(qdict_get_str(rsp, "return"), ':');
+    g_assert(out);
+    val = strtoul(out + 1, NULL, 16);
+    qobject_unref(rsp);
+
+    return val;
+}
+
+static void bic_wait_bits(QTestState *s, uint32_t addr, uint32_t bits)
+{
+    int i;
+
+    for (i = 0; i < 1000; i++) {
+        if ((bic_readl(s, addr) & bits) == bits) {
+            return;
+        }
+        g_usleep(1000);
+    }
+    g_assert_cmphex(bic_readl(s, addr) & bits, ==, bits);
+}
+
+static uint32_t bic_wait_log(QTestState *s, int n)
+{
+    uint32_t val = 0;
+    int i;
+
+    for (i = 0; i < 1000 && !val; i++) {
+        val = bic_readl(s, BIC_LOG_ADDR + n * 4);
+        if (!val) {
+            g_usleep(1000);
+        }
+    }
+    g_assert_cmphex(val, !=, 0);
+
+    return val;
+}
+
+static void bmc_write(QTestState *s, uint32_t reg, uint32_t val)
+{
+    qtest_writel(s, BMC_I2C_BUS0_BASE + reg, val);
+}
+
+/* Runs @cmd on the BMC master, and waits for the BIC to acknowledge it */
+static void bmc_cmd_ack(QTestState *s, uint32_t cmd)
+{
+    uint32_t sts = 0;
+    int i;
+
+    bmc_write(s, I2CD_CMD_REG, cmd);
+    for (i = 0; i < 1000; i++) {
+        sts = qtest_readl(s, BMC_I2C_BUS0_BASE + I2CD_INTR_STS_REG);
+        if (sts & (I2CD_INTR_TX_ACK | I2CD_INTR_TX_NAK)) {
+            break;
+        }
+        g_usleep(1000);
+    }
+    g_assert_cmphex(sts & (I2CD_INTR_TX_ACK | I2CD_INTR_TX_NAK), ==,
+                    I2CD_INTR_TX_ACK);
+    bmc_write(s, I2CD_INTR_STS_REG, sts);
+}
+
+static void test_ipmb_write(void)
+{
+    g_autofree char *path = NULL;
+    QTestState *s;
+    GError *err = NULL;
+    uint16_t fw[ARRAY_SIZE(bic_fw)];
+    int fd, i;
+
+    for (i = 0; i < ARRAY_SIZE(bic_fw); i++) {
+        fw[i] = cpu_to_le16(bic_fw[i]);
+    }
+    fd = g_file_open_tmp("qtest-fby35-bic-XXXXXX", &path, &err);
+    g_assert_no_error(err);
+    close(fd);
+    g_assert(g_file_set_contents(path, (char *)fw, sizeof(fw), NULL));
+
+    s = qtest_initf("-machine fby35,slots=1,bic-kernel=%s -accel tcg", path);
+
+    /* The BIC enables its slave function and logs the address match */
+    bmc_write(s, I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    bic_wait_bits(s, BIC_I2C_BUS6_BASE + I2CD_FUN_CTRL_REG, I2CD_SLAVE_EN);
+    bmc_write(s, I2CD_BYTE_BUF_REG, BIC_ADDR << 1);
+    bmc_cmd_ack(s, I2CD_M_START_CMD | I2CD_M_TX_CMD);
+    g_assert_cmphex(bic_wait_log(s, 0), ==,
+                    (BIC_ADDR << 1) << I2CD_BYTE_BUF_RX_SHIFT);
+
+    /* The data byte is only acknowledged once the BIC firmware read it */
+    bmc_write(s, I2CD_BYTE_BUF_REG, 0x5a);
+    bmc_cmd_ack(s, I2CD_M_TX_CMD);
+    g_assert_cmphex(bic_wait_log(s, 1), ==, 0x5a << I2CD_BYTE_BUF_RX_SHIFT);
+
+    bmc_write(s, I2CD_CMD_REG, I2CD_M_STOP_CMD);
+    bic_wait_bits(s, BIC_I2C_BUS6_BASE + I2CD_INTR_STS_REG,
+                  I2CD_INTR_NORMAL_STOP);
+
+    qtest_quit(s);
+    unlink(path);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (qtest_has_accel("tcg")) {
+        qtest_add_func("/fby35/i2c/ipmb_write", test_ipmb_write);
+    }
+
+    return g_test_run();
+}
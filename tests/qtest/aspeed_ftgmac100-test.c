@@ -0,0 +1,189 @@
+/*
+ * QTest testcase for the transmission of the FTGMAC100 of the Aspeed SoCs
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define ETH1_BASE       0x1E660000
+#define ETH1_IRQ        2
+
+#define FTGMAC100_ISR           0x00
+#define FTGMAC100_IER           0x04
+#define   FTGMAC100_INT_XPKT_ETH  (1 << 4)
+#define FTGMAC100_NPTXPD        0x18
+#define FTGMAC100_NPTXR_BADR    0x20
+#define FTGMAC100_ITC           0x30
+#define   FTGMAC100_ITC_TXINT_CNT(x)    ((x) << 8)
+#define   FTGMAC100_ITC_TXINT_THR(x)    ((x) << 12)
+#define FTGMAC100_MACCR         0x50
+#define   FTGMAC100_MACCR_TXDMA_EN      (1 << 0)
+#define   FTGMAC100_MACCR_TXMAC_EN      (1 << 2)
+#define   FTGMAC100_MACCR_GIGA_MODE     (1 << 9)
+
+#define FTGMAC100_TXDES0_LTS            (1 << 28)
+#define FTGMAC100_TXDES0_FTS            (1 << 29)
+#define FTGMAC100_TXDES0_EDOTR_ASPEED   (1 << 30)
+#define FTGMAC100_TXDES0_TXDMA_OWN      (1U << 31)
+
+/* Default DBLAC, 16 byte descriptors */
+#define DESC_SIZE       16
+#define RING_SIZE       4
+#define RING_ADDR       0x80000000
+#define FRAME_ADDR      0x80001000
+#define FRAME_SIZE      64
+
+/* Time unit of the interrupt timer at 1Gbps */
+#define ITC_UNIT_NS     1024000
+
+/* One interrupt every 3 frames, or 1 unit after the first one */
+#define ITC_CNT         1
+#define ITC_THR         3
+
+static int test_sock;
+
+static uint32_t mac_read(QTestState *s, uint32_t reg)
+{
+    return qtest_readl(s, ETH1_BASE + reg);
+}
+
+static void mac_write(QTestState *s, uint32_t reg, uint32_t val)
+{
+    qtest_writel(s, ETH1_BASE + reg, val);
+}
+
+static uint32_t desc_addr(int slot)
+{
+    return RING_ADDR + slot * DESC_SIZE;
+}
+
+/* Gives the descriptor of @slot to the controller, with frame @n */
+static void queue_frame(QTestState *s, int slot, uint8_t n)
+{
+    uint32_t buf = FRAME_ADDR + slot * FRAME_SIZE;
+    uint32_t des0 = FTGMAC100_TXDES0_TXDMA_OWN | FTGMAC100_TXDES0_FTS |
+        FTGMAC100_TXDES0_LTS | FRAME_SIZE;
+
+    if (slot == RING_SIZE - 1) {
+        des0 |= FTGMAC100_TXDES0_EDOTR_ASPEED;
+    }
+
+    qtest_memset(s, buf, n, FRAME_SIZE);
+    qtest_writel(s, desc_addr(slot) + 4, 0);
+    qtest_writel(s, desc_addr(slot) + 8, 0);
+    qtest_writel(s, desc_addr(slot) + 12, buf);
+    qtest_writel(s, desc_addr(slot), des0);
+}
+
+static bool desc_owned(QTestState *s, int slot)
+{
+    return qtest_readl(s, desc_addr(slot)) & FTGMAC100_TXDES0_TXDMA_OWN;
+}
+
+/* Checks that frame @n is the next one sent on the socket */
+static void recv_frame(uint8_t n)
+{
+    uint8_t buf[FRAME_SIZE];
+    uint32_t len;
+    int i;
+
+    g_assert_cmpint(recv(test_sock, &len, sizeof(len), MSG_WAITALL), ==,
+                    sizeof(len));
+    g_assert_cmpuint(ntohl(len), ==, FRAME_SIZE);
+    g_assert_cmpint(recv(test_sock, buf, sizeof(buf), MSG_WAITALL), ==,
+                    sizeof(buf));
+    for (i = 0; i < FRAME_SIZE; i++) {
+        g_assert_cmphex(buf[i], ==, n);
+    }
+}
+
+static void recv_none(void)
+{
+    uint32_t len;
+
+    g_assert_cmpint(recv(test_sock, &len, sizeof(len), MSG_DONTWAIT), ==, -1);
+    g_assert(errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+static void test_tx_coalesce(void)
+{
+    QTestState *s;
+    int sv[2];
+
+    g_assert_cmpint(socketpair(PF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+    test_sock = sv[0];
+    s = qtest_initf("-S -machine ast2600-evb "
+                    "-nic socket,fd=%d,model=ftgmac100", sv[1]);
+    close(sv[1]);
+    qtest_irq_intercept_in(s, "/machine/soc/a7mpcore");
+
+    mac_write(s, FTGMAC100_NPTXR_BADR, RING_ADDR);
+    mac_write(s, FTGMAC100_IER, FTGMAC100_INT_XPKT_ETH);
+    mac_write(s, FTGMAC100_ITC, FTGMAC100_ITC_TXINT_CNT(ITC_CNT) |
+              FTGMAC100_ITC_TXINT_THR(ITC_THR));
+    mac_write(s, FTGMAC100_MACCR, FTGMAC100_MACCR_TXDMA_EN |
+              FTGMAC100_MACCR_TXMAC_EN | FTGMAC100_MACCR_GIGA_MODE);
+
+    /* Below the threshold, the interrupt waits for the timer */
+    queue_frame(s, 0, 0);
+    queue_frame(s, 1, 1);
+    mac_write(s, FTGMAC100_NPTXPD, 1);
+    g_assert(!desc_owned(s, 0));
+    g_assert(!desc_owned(s, 1));
+    recv_frame(0);
+    recv_frame(1);
+    recv_none();
+    g_assert(mac_read(s, FTGMAC100_ISR) & FTGMAC100_INT_XPKT_ETH);
+    g_assert(!qtest_get_irq(s, ETH1_IRQ));
+
+    qtest_clock_step(s, ITC_CNT * ITC_UNIT_NS - 1);
+    g_assert(!qtest_get_irq(s, ETH1_IRQ));
+    qtest_clock_step(s, 1);
+    g_assert(qtest_get_irq(s, ETH1_IRQ));
+
+    mac_write(s, FTGMAC100_ISR, FTGMAC100_INT_XPKT_ETH);
+    g_assert(!qtest_get_irq(s, ETH1_IRQ));
+
+    /* Reaching the threshold raises it at once, across the end of ring */
+    queue_frame(s, 2, 2);
+    queue_frame(s, 3, 3);
+    queue_frame(s, 0, 4);
+    mac_write(s, FTGMAC100_NPTXPD, 1);
+    g_assert(!desc_owned(s, 2));
+    g_assert(!desc_owned(s, 3));
+    g_assert(!desc_owned(s, 0));
+    recv_frame(2);
+    recv_frame(3);
+    recv_frame(4);
+    recv_none();
+    g_assert(qtest_get_irq(s, ETH1_IRQ));
+
+    mac_write(s, FTGMAC100_ISR, FTGMAC100_INT_XPKT_ETH);
+    g_assert(!qtest_get_irq(s, ETH1_IRQ));
+
+    /* The controller resumes after the last descriptor it sent */
+    queue_frame(s, 1, 5);
+    mac_write(s, FTGMAC100_NPTXPD, 1);
+    g_assert(!desc_owned(s, 1));
+    recv_frame(5);
+    recv_none();
+    g_assert(!qtest_get_irq(s, ETH1_IRQ));
+    qtest_clock_step(s, ITC_CNT * ITC_UNIT_NS);
+    g_assert(qtest_get_irq(s, ETH1_IRQ));
+
+    qtest_quit(s);
+    close(test_sock);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/ftgmac100/tx_coalesce", test_tx_coalesce);
+
+    return g_test_run();
+}
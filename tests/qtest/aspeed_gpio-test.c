@@ -26,6 +26,8 @@
 #include "qemu/bitops.h"
 #include "qemu/timer.h"
 #include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
+#include "qapi/qmp/qnum.h"
 #include "libqtest-single.h"
 
 static void test_set_colocated_pins(const void *data)
@@ -46,6 +48,70 @@ static void test_set_colocated_pins(const void *data)
     g_assert(!qtest_qom_get_bool(s, "/machine/soc/gpio", "gpioV7"));
 }
 
+#define AST2600_GPIO_BASE 0x1E780000
+
+#define GPIO_ABCD_DATA_VALUE 0x000
+#define GPIO_ABCD_DIRECTION  0x004
+
+static void test_set_sets(const void *data)
+{
+    QTestState *s = (QTestState *)data;
+    QDict *resp;
+    QList *sets;
+
+    resp = qtest_qmp(s, "{ 'execute': 'qom-set', 'arguments': "
+                     "{ 'path': '/machine/soc/gpio', 'property': 'sets', "
+                     "'value': [ 0x00000101, 0x00000000, 0x00000000, "
+                     "0x00000000, 0x00000000, 0x00100000 ] } }");
+    g_assert(qdict_haskey(resp, "return"));
+    qobject_unref(resp);
+
+    g_assert(qtest_qom_get_bool(s, "/machine/soc/gpio", "gpioA0"));
+    g_assert(!qtest_qom_get_bool(s, "/machine/soc/gpio", "gpioA1"));
+    g_assert(qtest_qom_get_bool(s, "/machine/soc/gpio", "gpioB0"));
+    g_assert(qtest_qom_get_bool(s, "/machine/soc/gpio", "gpioW4"));
+
+    qtest_qom_set_bool(s, "/machine/soc/gpio", "gpioA1", true);
+    resp = qtest_qmp(s, "{ 'execute': 'qom-get', 'arguments': "
+                     "{ 'path': '/machine/soc/gpio', 'property': 'sets' } }");
+    g_assert(qdict_haskey(resp, "return"));
+    sets = qdict_get_qlist(resp, "return");
+    g_assert_cmpint(qlist_size(sets), ==, 7);
+    g_assert_cmphex(qnum_get_uint(qobject_to(QNum, qlist_peek(sets))), ==,
+                    0x00000103);
+    qobject_unref(resp);
+
+    /* Too many sets */
+    resp = qtest_qmp(s, "{ 'execute': 'qom-set', 'arguments': "
+                     "{ 'path': '/machine/soc/gpio', 'property': 'sets', "
+                     "'value': [ 0, 0, 0, 0, 0, 0, 0, 0 ] } }");
+    g_assert(qdict_haskey(resp, "error"));
+    qobject_unref(resp);
+}
+
+static void test_change_events(const void *data)
+{
+    QTestState *s = (QTestState *)data;
+    QDict *resp, *event;
+
+    qtest_qom_set_bool(s, "/machine/soc/gpio", "change-events", true);
+
+    /* gpioA2 and gpioA3 as outputs, driven high together */
+    qtest_writel(s, AST2600_GPIO_BASE + GPIO_ABCD_DIRECTION, 0x0000000c);
+    qtest_writel(s, AST2600_GPIO_BASE + GPIO_ABCD_DATA_VALUE, 0x0000000c);
+
+    event = qtest_qmp_eventwait_ref(s, "GPIO_CHANGE");
+    resp = qdict_get_qdict(event, "data");
+    g_assert_cmpstr(qdict_get_str(resp, "qom-path"), ==, "/machine/soc/gpio");
+    g_assert_cmpuint(qdict_get_int(resp, "set"), ==, 0);
+    g_assert_cmphex(qdict_get_int(resp, "changed"), ==, 0x0000000c);
+    g_assert_cmphex(qdict_get_int(resp, "value") & 0x0000000c, ==,
+                    0x0000000c);
+    qobject_unref(event);
+
+    qtest_qom_set_bool(s, "/machine/soc/gpio", "change-events", false);
+}
+
 int main(int argc, char **argv)
 {
     QTestState *s;
@@ -56,6 +122,8 @@ int main(int argc, char **argv)
     s = qtest_init("-machine ast2600-evb");
     qtest_add_data_func("/ast2600/gpio/set_colocated_pins", s,
                         test_set_colocated_pins);
+    qtest_add_data_func("/ast2600/gpio/set_sets", s, test_set_sets);
+    qtest_add_data_func("/ast2600/gpio/change_events", s, test_change_events);
     r = g_test_run();
     qtest_quit(s);
 
@@ -9,6 +9,7 @@
 
 #include "libqtest.h"
 #include "qemu/bitops.h"
+#include "qapi/qmp/qdict.h"
 
 #define HACE_CMD                 0x10
 #define  HACE_SHA_BE_EN          BIT(3)
@@ -148,6 +149,27 @@ static const uint8_t test_result_accum_sha256[] = {
     0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
     0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad};
 
+/*
+ * The same accumulative operation split in two requests: a first block
+ * of 64 'a' characters, then a second block holding only the padding.
+ *
+ *  printf 'a%.0s' {1..64} | sha256sum
+ */
+static const uint8_t test_vector_accum_pad_256[] = {
+    0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00};
+
+static const uint8_t test_result_accum_split_sha256[] = {
+    0xff, 0xe0, 0x54, 0xfe, 0x7a, 0xe0, 0xcb, 0x6d, 0xc6, 0x5c, 0x3a, 0xf9,
+    0xb6, 0x1d, 0x52, 0x09, 0xf4, 0x39, 0x85, 0x1d, 0xb4, 0x3d, 0x0b, 0xa5,
+    0x99, 0x73, 0x37, 0xdf, 0x15, 0x46, 0x68, 0xeb};
+
 static void write_regs(QTestState *s, uint32_t base, uint32_t src,
                        uint32_t length, uint32_t out, uint32_t method)
 {
@@ -400,6 +422,69 @@ static void test_sha256_accum(const char *machine, const uint32_t base,
     qtest_quit(s);
 }
 
+static void test_sha256_accum_split(const char *machine, const uint32_t base,
+                                    const uint32_t src_addr)
+{
+    QTestState *s = qtest_init(machine);
+
+    const uint32_t buffer_addr = src_addr + 0x1000000;
+    const uint32_t pad_addr = src_addr + 0x2000000;
+    const uint32_t digest_addr = src_addr + 0x4000000;
+    uint8_t data[64];
+    uint8_t digest[32] = {0};
+    QDict *rsp;
+    struct AspeedSgList array[] = {
+        {  cpu_to_le32(sizeof(data) | SG_LIST_LEN_LAST),
+           cpu_to_le32(buffer_addr) },
+    };
+    struct AspeedSgList pad_array[] = {
+        {  cpu_to_le32(sizeof(test_vector_accum_pad_256) | SG_LIST_LEN_LAST),
+           cpu_to_le32(pad_addr) },
+    };
+
+    /* Check engine is idle, no busy or irq bits set */
+    g_assert_cmphex(qtest_readl(s, base + HACE_STS), ==, 0);
+
+    /* Write test vector into memory */
+    memset(data, 'a', sizeof(data));
+    qtest_memwrite(s, buffer_addr, data, sizeof(data));
+    qtest_memwrite(s, pad_addr, test_vector_accum_pad_256,
+                   sizeof(test_vector_accum_pad_256));
+
+    /* First request, without padding */
+    qtest_memwrite(s, src_addr, array, sizeof(array));
+    write_regs(s, base, src_addr, sizeof(data),
+               digest_addr, HACE_ALGO_SHA256 | HACE_SG_EN | HACE_ACCUM_EN);
+
+    g_assert_cmphex(qtest_readl(s, base + HACE_STS), ==, 0x00000200);
+    qtest_writel(s, base + HACE_STS, 0x00000200);
+    g_assert_cmphex(qtest_readl(s, base + HACE_STS), ==, 0);
+
+    /* The hash context can't be migrated until the operation completes */
+    rsp = qtest_qmp(s, "{ 'execute': 'migrate', "
+                    "  'arguments': { 'uri': 'exec:cat > /dev/null' } }");
+    g_assert(qdict_haskey(rsp, "error"));
+    qobject_unref(rsp);
+
+    /* Second request, holding the padding */
+    qtest_memwrite(s, src_addr, pad_array, sizeof(pad_array));
+    write_regs(s, base, src_addr, sizeof(test_vector_accum_pad_256),
+               digest_addr, HACE_ALGO_SHA256 | HACE_SG_EN | HACE_ACCUM_EN);
+
+    g_assert_cmphex(qtest_readl(s, base + HACE_STS), ==, 0x00000200);
+    qtest_writel(s, base + HACE_STS, 0x00000200);
+    g_assert_cmphex(qtest_readl(s, base + HACE_STS), ==, 0);
+
+    /* Read computed digest from memory */
+    qtest_memread(s, digest_addr, digest, sizeof(digest));
+
+    /* Check result of computation */
+    g_assert_cmpmem(digest, sizeof(digest),
+                    test_result_accum_split_sha256, sizeof(digest));
+
+    qtest_quit(s);
+}
+
 static void test_sha512_accum(const char *machine, const uint32_t base,
                         const uint32_t src_addr)
 {
@@ -534,6 +619,11 @@ static void test_sha256_accum_ast2600(void)
     test_sha256_accum("-machine ast2600-evb", 0x1e6d0000, 0x80000000);
 }
 
+static void test_sha256_accum_split_ast2600(void)
+{
+    test_sha256_accum_split("-machine ast2600-evb", 0x1e6d0000, 0x80000000);
+}
+
 static void test_sha512_accum_ast2600(void)
 {
     test_sha512_accum("-machine ast2600-evb", 0x1e6d0000, 0x80000000);
@@ -600,6 +690,8 @@ int main(int argc, char **argv)
 
     qtest_add_func("ast2600/hace/sha512_accum", test_sha512_accum_ast2600);
     qtest_add_func("ast2600/hace/sha256_accum", test_sha256_accum_ast2600);
+    qtest_add_func("ast2600/hace/sha256_accum_split",
+                   test_sha256_accum_split_ast2600);
 
     qtest_add_func("ast2500/hace/addresses", test_addresses_ast2500);
     qtest_add_func("ast2500/hace/sha512", test_sha512_ast2500);
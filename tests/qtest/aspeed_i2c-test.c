@@ -25,6 +25,7 @@
 #include "qemu/osdep.h"
 #include "qemu/bitops.h"
 #include "libqtest-single.h"
+#include "qapi/qmp/qdict.h"
 
 #define ASPEED_I2C_BASE 0x1E78A000
 #define ASPEED_I2C_BUS0_BASE (ASPEED_I2C_BASE + 0x80)
@@ -38,6 +39,8 @@
 #define   I2CD_INTR_SLAVE_ADDR_RX_MATCH    (0x1 << 7)  /* use RX_DONE */
 #define   I2CD_INTR_NORMAL_STOP            (0x1 << 4)
 #define   I2CD_INTR_RX_DONE                (0x1 << 2)
+#define   I2CD_INTR_TX_NAK                 (0x1 << 1)
+#define   I2CD_INTR_TX_ACK                 (0x1 << 0)
 #define I2CD_CMD_REG            0x14       /* I2CD Command/Status */
 #define   I2CD_RX_DMA_ENABLE               (0x1 << 9)
 #define   I2CD_TX_DMA_ENABLE               (0x1 << 8)
@@ -49,18 +52,53 @@
 #define   I2CD_S_TX_CMD                    (0x1 << 2)
 #define   I2CD_M_TX_CMD                    (0x1 << 1)
 #define   I2CD_M_START_CMD                 (0x1)
+#define   I2CD_M_CMDS                      (I2CD_M_START_CMD |        \
+                                            I2CD_M_TX_CMD |           \
+                                            I2CD_M_RX_CMD |           \
+                                            I2CD_M_S_RX_CMD_LAST |    \
+                                            I2CD_M_STOP_CMD)
 #define I2CD_DEV_ADDR_REG       0x18       /* Slave Device Address */
+#define I2CD_POOL_CTRL_REG      0x1c       /* Pool Buffer Control */
+#define   I2CD_POOL_RX_COUNT(x)            (((x) >> 24) & 0xff)
+#define   I2CD_POOL_RX_SIZE(x)             (((x) - 1) << 16)
+#define   I2CD_POOL_TX_COUNT(x)            (((x) - 1) << 8)
 #define I2CD_BYTE_BUF_REG       0x20       /* Transmit/Receive Byte Buffer */
 #define   I2CD_BYTE_BUF_TX_SHIFT           0
 #define   I2CD_BYTE_BUF_TX_MASK            0xff
 #define   I2CD_BYTE_BUF_RX_SHIFT           8
 #define   I2CD_BYTE_BUF_RX_MASK            0xff
+#define I2CD_DMA_ADDR           0x24       /* DMA Buffer Address */
+#define I2CD_DMA_LEN            0x28       /* DMA Transfer Length < 4KB */
+
+#define EEPROM_ADDR 0x50
+#define MUX_ADDR 0x70
+#define MUX_EEPROM_ADDR 0x51
+#define PMBUS_ADDR 0x44
+#define PMBUS_MFR_MODEL 0x9A
+#define PMBUS_MODEL "ADM1272-A1"
+#define DMA_BUF 0x80100000
+#define POOL_MAX 256
+#define ASPEED_I2C_BUS0_POOL (ASPEED_I2C_BASE + 0xC00)
+
+/* Target answering each step of a transfer after DEFER_DELAY ns */
+#define DEFER_ADDR 0x40
+#define DEFER_DELAY 1000
 
 #define DATA_LEN 1
 #define ACK_LEN 2
 #define START_LEN 3
 #define STOP_LEN 4
 
+#define FRAME_HDR_LEN 6
+#define FRAME_VERSION 2
+#define FRAME_WRITE 0x01
+#define FRAME_READ 0x02
+#define FRAME_RESP 0x80
+#define FRAME_STATUS_ACK 0x00
+#define FRAME_STATUS_NACK 0x01
+#define FRAME_READ_CONT 0x01
+#define FRAME_ADDR 0x33
+
 static void aspeed_i2c_master_mode_tx(const uint8_t *buf, int len)
 {
     int i;
@@ -112,6 +150,7 @@ static uint8_t aspeed_i2c_slave_mode_rx_byte(void)
 }
 
 static int udp_socket;
+static int udp_socket_frame;
 
 static void test_write_in_old_byte_mode(void)
 {
@@ -192,6 +231,637 @@ static void test_slave_mode_rx_byte_buf(void)
     g_assert(sts & I2CD_INTR_NORMAL_STOP);
 }
 
+static void test_write_framed(void)
+{
+    uint8_t pkt[] = {0x66, 0xde, 0xad, 0xbe, 0xef};
+    uint8_t buf[32];
+    ssize_t n;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+
+    aspeed_i2c_master_mode_tx(pkt, sizeof(pkt));
+
+    /* The whole transaction arrives as one frame, without any ACK exchange */
+    n = recv(udp_socket_frame, buf, sizeof(buf), 0);
+    g_assert_cmphex(n, ==, FRAME_HDR_LEN + sizeof(pkt) - 1);
+    g_assert_cmphex(buf[0], ==, FRAME_VERSION);
+    g_assert_cmphex(buf[1], ==, FRAME_WRITE);
+    g_assert_cmphex(buf[2], ==, pkt[0]);
+    g_assert_cmphex(buf[4], ==, sizeof(pkt) - 1);
+    g_assert_cmphex(buf[5], ==, 0);
+    g_assert(!memcmp(&buf[FRAME_HDR_LEN], &pkt[1], sizeof(pkt) - 1));
+}
+
+static void test_slave_mode_rx_framed(void)
+{
+    uint8_t pkt[] = {0x20, 0xde, 0xad, 0xbe, 0xef};
+    uint8_t buf[32] = {};
+    struct sockaddr_in dst;
+    uint32_t sts;
+    ssize_t n;
+    int i;
+
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = inet_addr("127.0.0.1");
+    dst.sin_port = htons(6001);
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, 0xFFFFFFFF);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+
+    aspeed_i2c_slave_mode_enable(0x10);
+
+    buf[0] = FRAME_VERSION;
+    buf[1] = FRAME_WRITE;
+    buf[2] = pkt[0];
+    buf[4] = sizeof(pkt) - 1;
+    memcpy(&buf[FRAME_HDR_LEN], &pkt[1], sizeof(pkt) - 1);
+    sendto(udp_socket_frame, buf, FRAME_HDR_LEN + sizeof(pkt) - 1, 0,
+           (const struct sockaddr *)&dst, sizeof(dst));
+
+    for (i = 0; i < sizeof(pkt); i++) {
+        g_assert_cmphex(aspeed_i2c_slave_mode_rx_byte(), ==, pkt[i]);
+    }
+
+    for (i = 0; i < 10000; i++) {
+        sts = readl(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG);
+        writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, sts);
+        if (sts & I2CD_INTR_NORMAL_STOP) {
+            break;
+        }
+    }
+    g_assert(sts & I2CD_INTR_NORMAL_STOP);
+
+    /* One response acks the transaction as a unit */
+    n = recv(udp_socket_frame, buf, sizeof(buf), 0);
+    g_assert_cmphex(n, ==, FRAME_HDR_LEN);
+    g_assert_cmphex(buf[0], ==, FRAME_VERSION);
+    g_assert_cmphex(buf[1], ==, FRAME_RESP);
+    g_assert_cmphex(buf[2], ==, pkt[0]);
+    g_assert_cmphex(buf[3], ==, FRAME_STATUS_ACK);
+    g_assert_cmphex(buf[4], ==, sizeof(pkt) - 1);
+}
+
+/* Checks that the guest sent a READ frame, as the peer */
+static void frame_expect_read(uint16_t len, uint8_t flags)
+{
+    uint8_t buf[32];
+    ssize_t n;
+
+    n = recv(udp_socket_frame, buf, sizeof(buf), 0);
+    g_assert_cmphex(n, ==, FRAME_HDR_LEN);
+    g_assert_cmphex(buf[0], ==, FRAME_VERSION);
+    g_assert_cmphex(buf[1], ==, FRAME_READ);
+    g_assert_cmphex(buf[2], ==, FRAME_ADDR << 1 | 1);
+    g_assert_cmphex(buf[3], ==, flags);
+    g_assert_cmphex(buf[4], ==, len);
+    g_assert_cmphex(buf[5], ==, 0);
+}
+
+static void frame_send_resp(uint8_t status, const uint8_t *data, uint8_t len)
+{
+    uint8_t buf[32] = {};
+    struct sockaddr_in dst;
+
+    dst.sin_family = AF_INET;
+    dst.sin_addr.s_addr = inet_addr("127.0.0.1");
+    dst.sin_port = htons(6001);
+
+    buf[0] = FRAME_VERSION;
+    buf[1] = FRAME_RESP;
+    buf[2] = FRAME_ADDR << 1 | 1;
+    buf[3] = status;
+    buf[4] = len;
+    if (len) {
+        memcpy(&buf[FRAME_HDR_LEN], data, len);
+    }
+    sendto(udp_socket_frame, buf, FRAME_HDR_LEN + len, 0,
+           (const struct sockaddr *)&dst, sizeof(dst));
+}
+
+static uint32_t aspeed_i2c_wait_intr(uint32_t mask)
+{
+    uint32_t sts = 0;
+    int i;
+
+    for (i = 0; i < 10000 && !(sts & mask); i++) {
+        sts = readl(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG);
+    }
+    g_assert(sts & mask);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, sts);
+    return sts;
+}
+
+static void test_read_framed(void)
+{
+    const uint8_t data[] = {0xa5, 0x5a};
+    uint32_t sts;
+    int i;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, 0xFFFFFFFF);
+
+    /* The peer NACKs the address */
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, FRAME_ADDR << 1 | 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_M_RX_CMD | I2CD_M_S_RX_CMD_LAST |
+           I2CD_M_STOP_CMD);
+    frame_expect_read(0, FRAME_READ_CONT);
+    frame_send_resp(FRAME_STATUS_NACK, NULL, 0);
+    aspeed_i2c_wait_intr(I2CD_INTR_TX_NAK);
+
+    /* Two bytes, each one fetched from the peer when the guest reads it */
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, FRAME_ADDR << 1 | 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_M_RX_CMD);
+    frame_expect_read(0, FRAME_READ_CONT);
+    frame_send_resp(FRAME_STATUS_ACK, NULL, 0);
+    for (i = 0; i < sizeof(data); i++) {
+        if (i) {
+            writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+                   I2CD_M_RX_CMD | I2CD_M_S_RX_CMD_LAST | I2CD_M_STOP_CMD);
+        }
+        frame_expect_read(1, FRAME_READ_CONT);
+        frame_send_resp(FRAME_STATUS_ACK, &data[i], 1);
+        sts = aspeed_i2c_wait_intr(I2CD_INTR_RX_DONE);
+        g_assert_cmphex((readl(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG) >>
+                         I2CD_BYTE_BUF_RX_SHIFT) & I2CD_BYTE_BUF_RX_MASK,
+                        ==, data[i]);
+    }
+
+    /* The NACK of the last byte ends the read on the peer */
+    frame_expect_read(0, 0);
+    frame_send_resp(FRAME_STATUS_ACK, NULL, 0);
+    if (!(sts & I2CD_INTR_NORMAL_STOP)) {
+        aspeed_i2c_wait_intr(I2CD_INTR_NORMAL_STOP);
+    }
+}
+
+static uint32_t aspeed_i2c_master_mode_dma(uint32_t cmd, uint32_t addr,
+                                           int len)
+{
+    uint32_t sts;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_DMA_ADDR, addr);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_DMA_LEN, len);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG, cmd);
+
+    sts = readl(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, sts);
+    return sts;
+}
+
+static void test_dma_eeprom(void)
+{
+    uint8_t tx[] = {EEPROM_ADDR << 1, 0x00, 0x10, 0xde, 0xad, 0xbe, 0xef};
+    uint8_t rx[4] = {};
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+
+    /* Write the data bytes at offset 0x10, in one DMA transfer */
+    memwrite(DMA_BUF, tx, sizeof(tx));
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                               I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                               DMA_BUF, sizeof(tx));
+
+    /* Move back to offset 0x10 and read them, with a repeated start */
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                               I2CD_TX_DMA_ENABLE, DMA_BUF, 3);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, (EEPROM_ADDR << 1) | 1);
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_RX_CMD |
+                               I2CD_RX_DMA_ENABLE | I2CD_M_S_RX_CMD_LAST |
+                               I2CD_M_STOP_CMD, DMA_BUF + 0x100, sizeof(rx));
+
+    memread(DMA_BUF + 0x100, rx, sizeof(rx));
+    g_assert(!memcmp(rx, &tx[3], sizeof(rx)));
+}
+
+static void test_mux_routes(void)
+{
+    uint8_t select[] = {MUX_ADDR << 1, BIT(3)};
+    uint8_t deselect[] = {MUX_ADDR << 1, 0};
+    uint8_t tx[] = {MUX_EEPROM_ADDR << 1, 0x00, 0x20, 0x5a};
+    uint8_t rx = 0;
+    uint32_t sts;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+
+    /* Behind a disabled channel, the EEPROM does not answer */
+    memwrite(DMA_BUF, tx, sizeof(tx));
+    sts = aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                     I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                                     DMA_BUF, sizeof(tx));
+    g_assert(sts & I2CD_INTR_TX_NAK);
+
+    memwrite(DMA_BUF, select, sizeof(select));
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                               I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                               DMA_BUF, sizeof(select));
+
+    memwrite(DMA_BUF, tx, sizeof(tx));
+    sts = aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                     I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                                     DMA_BUF, sizeof(tx));
+    g_assert(!(sts & I2CD_INTR_TX_NAK));
+
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                               I2CD_TX_DMA_ENABLE, DMA_BUF, 3);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG,
+           (MUX_EEPROM_ADDR << 1) | 1);
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_RX_CMD |
+                               I2CD_RX_DMA_ENABLE | I2CD_M_S_RX_CMD_LAST |
+                               I2CD_M_STOP_CMD, DMA_BUF + 0x100, 1);
+    memread(DMA_BUF + 0x100, &rx, 1);
+    g_assert_cmphex(rx, ==, tx[3]);
+
+    /* And it is gone again once the channel is disabled */
+    memwrite(DMA_BUF, deselect, sizeof(deselect));
+    aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                               I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                               DMA_BUF, sizeof(deselect));
+
+    memwrite(DMA_BUF, tx, sizeof(tx));
+    sts = aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                     I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                                     DMA_BUF, sizeof(tx));
+    g_assert(sts & I2CD_INTR_TX_NAK);
+}
+
+/*
+ * Issues @cmd to the deferring target and runs the virtual clock until the
+ * command is done. Returns the number of deferred answers it waited for.
+ */
+static int aspeed_i2c_defer_cmd(uint32_t cmd)
+{
+    int n;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG, cmd);
+    for (n = 0; n < 512; n++) {
+        if (!(readl(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG) & I2CD_M_CMDS)) {
+            break;
+        }
+        clock_step(DEFER_DELAY);
+    }
+    g_assert_cmphex(readl(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG) & I2CD_M_CMDS,
+                    ==, 0);
+    return n;
+}
+
+static int aspeed_i2c_master_mode_dma_defer(uint32_t cmd, uint32_t addr,
+                                            int len)
+{
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_DMA_ADDR, addr);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_DMA_LEN, len);
+    return aspeed_i2c_defer_cmd(cmd);
+}
+
+static uint32_t aspeed_i2c_intr_clear(void)
+{
+    uint32_t sts = readl(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG);
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, sts);
+    return sts;
+}
+
+static uint32_t defer_count(void)
+{
+    QDict *rsp;
+    uint32_t count;
+
+    rsp = qmp("{ 'execute': 'qom-get', 'arguments': "
+              "{ 'path': '/machine/peripheral/defer0', "
+              "  'property': 'deferred' } }");
+    count = qdict_get_int(rsp, "return");
+    qobject_unref(rsp);
+
+    return count;
+}
+
+static void defer_init(void)
+{
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, 0xFFFFFFFF);
+}
+
+static void test_defer_byte(void)
+{
+    const uint8_t tx[] = {0x10, 0xde, 0xad};
+    uint32_t count = defer_count();
+    uint32_t byte_buf;
+    int i;
+
+    defer_init();
+
+    /* Each step is answered by the target after a delay */
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, DEFER_ADDR << 1);
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD), ==, 1);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_TX_ACK);
+    for (i = 0; i < sizeof(tx); i++) {
+        writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, tx[i]);
+        g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_TX_CMD), ==, 1);
+        g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_TX_ACK);
+    }
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_STOP_CMD), ==, 1);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_NORMAL_STOP);
+
+    /* Read the data back, after a repeated start */
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, DEFER_ADDR << 1);
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD), ==, 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, tx[0]);
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_TX_CMD), ==, 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, DEFER_ADDR << 1 | 1);
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD), ==, 1);
+    aspeed_i2c_intr_clear();
+
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_RX_CMD), ==, 1);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_RX_DONE);
+    byte_buf = readl(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG);
+    g_assert_cmphex((byte_buf >> I2CD_BYTE_BUF_RX_SHIFT) &
+                    I2CD_BYTE_BUF_RX_MASK, ==, tx[1]);
+
+    /* The last byte, the NACK and the STOP are each deferred */
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_RX_CMD |
+                                         I2CD_M_S_RX_CMD_LAST |
+                                         I2CD_M_STOP_CMD), ==, 3);
+    g_assert_cmphex(aspeed_i2c_intr_clear() &
+                    (I2CD_INTR_RX_DONE | I2CD_INTR_NORMAL_STOP), ==,
+                    I2CD_INTR_RX_DONE | I2CD_INTR_NORMAL_STOP);
+    byte_buf = readl(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG);
+    g_assert_cmphex((byte_buf >> I2CD_BYTE_BUF_RX_SHIFT) &
+                    I2CD_BYTE_BUF_RX_MASK, ==, tx[2]);
+
+    g_assert_cmpuint(defer_count() - count, ==,
+                     (2 + sizeof(tx)) + 3 + (1 + 3));
+}
+
+static void test_defer_pool(void)
+{
+    const uint8_t tx[] = {DEFER_ADDR << 1, 0x20, 0x11, 0x22, 0x33};
+    const uint8_t start_rx = DEFER_ADDR << 1 | 1;
+    uint32_t count = defer_count();
+    uint8_t rx[3];
+
+    defer_init();
+
+    /* START, and the bytes of the pool sent one at a time, then STOP */
+    memwrite(ASPEED_I2C_BUS0_POOL, tx, sizeof(tx));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(sizeof(tx)));
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                         I2CD_TX_BUFF_ENABLE |
+                                         I2CD_M_STOP_CMD), ==,
+                    1 + sizeof(tx) - 1 + 1);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_NORMAL_STOP);
+
+    /* Move back to the offset */
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG, I2CD_POOL_TX_COUNT(2));
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                         I2CD_TX_BUFF_ENABLE), ==, 2);
+    aspeed_i2c_intr_clear();
+
+    /* Repeated START, the bytes received one at a time, NACK and STOP */
+    memwrite(ASPEED_I2C_BUS0_POOL, &start_rx, 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(1) | I2CD_POOL_RX_SIZE(sizeof(rx)));
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD |
+                                         I2CD_TX_BUFF_ENABLE |
+                                         I2CD_M_RX_CMD | I2CD_RX_BUFF_ENABLE |
+                                         I2CD_M_S_RX_CMD_LAST |
+                                         I2CD_M_STOP_CMD), ==,
+                    1 + sizeof(rx) + 2);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_RX_DONE);
+    g_assert_cmpuint(I2CD_POOL_RX_COUNT(readl(ASPEED_I2C_BUS0_BASE +
+                                              I2CD_POOL_CTRL_REG)),
+                     ==, sizeof(rx));
+    memread(ASPEED_I2C_BUS0_POOL, rx, sizeof(rx));
+    g_assert(!memcmp(rx, &tx[2], sizeof(rx)));
+
+    g_assert_cmpuint(defer_count() - count, ==,
+                     (1 + sizeof(tx) - 1 + 1) + 2 + (1 + sizeof(rx) + 2));
+}
+
+/* A full pool buffer, of 256 bytes, is sent and received at once */
+static void test_pool_eeprom_full(void)
+{
+    uint8_t tx[POOL_MAX] = {EEPROM_ADDR << 1, 0x01, 0x00};
+    const uint8_t start_rx = EEPROM_ADDR << 1 | 1;
+    uint8_t rx[POOL_MAX];
+    uint32_t sts;
+    int i;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, 0xFFFFFFFF);
+
+    for (i = 3; i < sizeof(tx); i++) {
+        tx[i] = i;
+    }
+    memwrite(ASPEED_I2C_BUS0_POOL, tx, sizeof(tx));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(sizeof(tx)));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_M_TX_CMD | I2CD_TX_BUFF_ENABLE |
+           I2CD_M_STOP_CMD);
+    g_assert_cmphex(readl(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG) & I2CD_M_CMDS,
+                    ==, 0);
+    sts = aspeed_i2c_intr_clear();
+    g_assert(!(sts & I2CD_INTR_TX_NAK));
+    g_assert(sts & I2CD_INTR_NORMAL_STOP);
+
+    /* Move back to offset 0x100 and read 256 bytes from there */
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG, I2CD_POOL_TX_COUNT(3));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_M_TX_CMD | I2CD_TX_BUFF_ENABLE);
+    aspeed_i2c_intr_clear();
+
+    memwrite(ASPEED_I2C_BUS0_POOL, &start_rx, 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(1) | I2CD_POOL_RX_SIZE(sizeof(rx)));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_TX_BUFF_ENABLE | I2CD_M_RX_CMD |
+           I2CD_RX_BUFF_ENABLE | I2CD_M_S_RX_CMD_LAST | I2CD_M_STOP_CMD);
+    g_assert_cmphex(readl(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG) & I2CD_M_CMDS,
+                    ==, 0);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_RX_DONE);
+
+    memread(ASPEED_I2C_BUS0_POOL, rx, sizeof(rx));
+    g_assert(!memcmp(rx, &tx[3], sizeof(tx) - 3));
+}
+
+/* A PMBus block read, MFR_MODEL, is the length byte and the string */
+static void pmbus_block_read_byte(uint8_t *rx, int len)
+{
+    int i;
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, PMBUS_ADDR << 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG, I2CD_M_START_CMD);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, PMBUS_MFR_MODEL);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG, I2CD_M_TX_CMD);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, PMBUS_ADDR << 1 | 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG, I2CD_M_START_CMD);
+    g_assert(!(aspeed_i2c_intr_clear() & I2CD_INTR_TX_NAK));
+
+    for (i = 0; i < len; i++) {
+        writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+               i == len - 1 ?
+               I2CD_M_RX_CMD | I2CD_M_S_RX_CMD_LAST | I2CD_M_STOP_CMD :
+               I2CD_M_RX_CMD);
+        g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_RX_DONE);
+        rx[i] = (readl(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG) >>
+                 I2CD_BYTE_BUF_RX_SHIFT) & I2CD_BYTE_BUF_RX_MASK;
+    }
+}
+
+static void pmbus_block_read_pool(uint8_t *rx, int len)
+{
+    const uint8_t tx[] = {PMBUS_ADDR << 1, PMBUS_MFR_MODEL};
+    const uint8_t start_rx = PMBUS_ADDR << 1 | 1;
+
+    memwrite(ASPEED_I2C_BUS0_POOL, tx, sizeof(tx));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(sizeof(tx)));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_M_TX_CMD | I2CD_TX_BUFF_ENABLE);
+    g_assert(!(aspeed_i2c_intr_clear() & I2CD_INTR_TX_NAK));
+
+    memwrite(ASPEED_I2C_BUS0_POOL, &start_rx, 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(1) | I2CD_POOL_RX_SIZE(len));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_CMD_REG,
+           I2CD_M_START_CMD | I2CD_TX_BUFF_ENABLE | I2CD_M_RX_CMD |
+           I2CD_RX_BUFF_ENABLE | I2CD_M_S_RX_CMD_LAST | I2CD_M_STOP_CMD);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_RX_DONE);
+    g_assert_cmpuint(I2CD_POOL_RX_COUNT(readl(ASPEED_I2C_BUS0_BASE +
+                                              I2CD_POOL_CTRL_REG)), ==, len);
+    memread(ASPEED_I2C_BUS0_POOL, rx, len);
+}
+
+static void pmbus_block_read_dma(uint8_t *rx, int len)
+{
+    const uint8_t tx[] = {PMBUS_ADDR << 1, PMBUS_MFR_MODEL};
+
+    memwrite(DMA_BUF, tx, sizeof(tx));
+    g_assert(!(aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                          I2CD_TX_DMA_ENABLE, DMA_BUF,
+                                          sizeof(tx)) & I2CD_INTR_TX_NAK));
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, PMBUS_ADDR << 1 | 1);
+    g_assert(aspeed_i2c_master_mode_dma(I2CD_M_START_CMD | I2CD_M_RX_CMD |
+                                        I2CD_RX_DMA_ENABLE |
+                                        I2CD_M_S_RX_CMD_LAST |
+                                        I2CD_M_STOP_CMD,
+                                        DMA_BUF + 0x100, len) &
+             I2CD_INTR_NORMAL_STOP);
+    memread(DMA_BUF + 0x100, rx, len);
+}
+
+/*
+ * The pool and DMA modes receive the response of the PMBus device in one
+ * buffer transfer, it must be the same as the one received byte by byte.
+ */
+static void test_pmbus_block_read(void)
+{
+    const char model[] = PMBUS_MODEL;
+    uint8_t byte[sizeof(model)], pool[sizeof(model)], dma[sizeof(model)];
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_FUN_CTRL_REG, I2CD_MASTER_EN);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_CTRL_REG, 0xFFFFFFFF);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_INTR_STS_REG, 0xFFFFFFFF);
+
+    pmbus_block_read_byte(byte, sizeof(byte));
+    g_assert_cmpuint(byte[0], ==, strlen(model));
+    g_assert(!memcmp(&byte[1], model, strlen(model)));
+
+    pmbus_block_read_pool(pool, sizeof(pool));
+    g_assert(!memcmp(pool, byte, sizeof(byte)));
+
+    pmbus_block_read_dma(dma, sizeof(dma));
+    g_assert(!memcmp(dma, byte, sizeof(byte)));
+}
+
+/* Byte by byte, the 256 bytes of a full pool buffer are all transferred */
+static void test_defer_pool_full(void)
+{
+    uint8_t tx[POOL_MAX] = {DEFER_ADDR << 1, 0x00};
+    const uint8_t start_rx = DEFER_ADDR << 1 | 1;
+    uint32_t count = defer_count();
+    uint8_t rx[POOL_MAX];
+    int i;
+
+    defer_init();
+
+    for (i = 2; i < sizeof(tx); i++) {
+        tx[i] = ~i;
+    }
+    memwrite(ASPEED_I2C_BUS0_POOL, tx, sizeof(tx));
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(sizeof(tx)));
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                         I2CD_TX_BUFF_ENABLE |
+                                         I2CD_M_STOP_CMD), ==,
+                    1 + sizeof(tx) - 1 + 1);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_NORMAL_STOP);
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG, I2CD_POOL_TX_COUNT(2));
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                                         I2CD_TX_BUFF_ENABLE), ==, 2);
+    aspeed_i2c_intr_clear();
+
+    memwrite(ASPEED_I2C_BUS0_POOL, &start_rx, 1);
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_POOL_CTRL_REG,
+           I2CD_POOL_TX_COUNT(1) | I2CD_POOL_RX_SIZE(sizeof(rx)));
+    g_assert_cmpint(aspeed_i2c_defer_cmd(I2CD_M_START_CMD |
+                                         I2CD_TX_BUFF_ENABLE |
+                                         I2CD_M_RX_CMD | I2CD_RX_BUFF_ENABLE |
+                                         I2CD_M_S_RX_CMD_LAST |
+                                         I2CD_M_STOP_CMD), ==,
+                    1 + sizeof(rx) + 2);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_RX_DONE);
+    memread(ASPEED_I2C_BUS0_POOL, rx, sizeof(rx));
+    g_assert(!memcmp(rx, &tx[2], sizeof(tx) - 2));
+
+    g_assert_cmpuint(defer_count() - count, ==,
+                     (1 + sizeof(tx) - 1 + 1) + 2 + (1 + sizeof(rx) + 2));
+}
+
+static void test_defer_dma(void)
+{
+    const uint8_t tx[] = {DEFER_ADDR << 1, 0x30, 0xca, 0xfe};
+    uint32_t count = defer_count();
+    uint8_t rx[2] = {};
+
+    defer_init();
+
+    memwrite(DMA_BUF, tx, sizeof(tx));
+    g_assert_cmpint(aspeed_i2c_master_mode_dma_defer(
+                        I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                        I2CD_TX_DMA_ENABLE | I2CD_M_STOP_CMD,
+                        DMA_BUF, sizeof(tx)), ==, 1 + sizeof(tx) - 1 + 1);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_NORMAL_STOP);
+
+    g_assert_cmpint(aspeed_i2c_master_mode_dma_defer(
+                        I2CD_M_START_CMD | I2CD_M_TX_CMD |
+                        I2CD_TX_DMA_ENABLE, DMA_BUF, 2), ==, 2);
+    aspeed_i2c_intr_clear();
+
+    writel(ASPEED_I2C_BUS0_BASE + I2CD_BYTE_BUF_REG, DEFER_ADDR << 1 | 1);
+    g_assert_cmpint(aspeed_i2c_master_mode_dma_defer(
+                        I2CD_M_START_CMD | I2CD_M_RX_CMD |
+                        I2CD_RX_DMA_ENABLE | I2CD_M_S_RX_CMD_LAST |
+                        I2CD_M_STOP_CMD, DMA_BUF + 0x100, sizeof(rx)), ==,
+                    1 + sizeof(rx) + 2);
+    g_assert(aspeed_i2c_intr_clear() & I2CD_INTR_NORMAL_STOP);
+    memread(DMA_BUF + 0x100, rx, sizeof(rx));
+    g_assert(!memcmp(rx, &tx[2], sizeof(rx)));
+
+    g_assert_cmpuint(defer_count() - count, ==,
+                     (1 + sizeof(tx) - 1 + 1) + 2 + (1 + sizeof(rx) + 2));
+}
+
 static int udp_socket_init(const char *ip_addr, uint16_t port)
 {
     bool reuseaddr = true;
@@ -219,25 +889,55 @@ static int udp_socket_init(const char *ip_addr, uint16_t port)
 
 int main(int argc, char **argv)
 {
+    bool has_defer;
     int ret;
 
     udp_socket = udp_socket_init("127.0.0.1", 5000);
     if (udp_socket == -1) {
         return 1;
     }
+    udp_socket_frame = udp_socket_init("127.0.0.1", 5001);
+    if (udp_socket_frame == -1) {
+        return 1;
+    }
 
     g_test_init(&argc, &argv, NULL);
 
+    has_defer = qtest_has_device("i2c-defer-test");
     global_qtest = qtest_initf("-machine fby35-bmc "
                                "-netdev socket,id=socket0,udp=localhost:5000,localaddr=localhost:6000 "
-                               "-device i2c-netdev2,bus=aspeed.i2c.bus.0,address=0x32,netdev=socket0");
+                               "-device i2c-netdev2,bus=aspeed.i2c.bus.0,address=0x32,netdev=socket0 "
+                               "-netdev socket,id=socket1,udp=localhost:5001,localaddr=localhost:6001 "
+                               "-device i2c-netdev2,bus=aspeed.i2c.bus.0,address=0x33,netdev=socket1,protocol-version=2 "
+                               "-device at24c-eeprom,bus=aspeed.i2c.bus.0,address=0x50,rom-size=4096 "
+                               "-device pca9548,bus=aspeed.i2c.bus.0,address=0x70 "
+                               "-device at24c-eeprom,bus=i2c.3,address=0x51,rom-size=4096 "
+                               "-device adm1272,bus=aspeed.i2c.bus.0,address=0x44 "
+                               "%s", has_defer ?
+                               "-device i2c-defer-test,id=defer0,"
+                               "bus=aspeed.i2c.bus.0,address=0x40,delay=1000" :
+                               "");
 
     qtest_add_func("/ast2600/i2c/write_in_old_byte_mode", test_write_in_old_byte_mode);
     qtest_add_func("/ast2600/i2c/slave_mode_rx_byte_buf", test_slave_mode_rx_byte_buf);
+    qtest_add_func("/ast2600/i2c/write_framed", test_write_framed);
+    qtest_add_func("/ast2600/i2c/slave_mode_rx_framed", test_slave_mode_rx_framed);
+    qtest_add_func("/ast2600/i2c/read_framed", test_read_framed);
+    qtest_add_func("/ast2600/i2c/dma_eeprom", test_dma_eeprom);
+    qtest_add_func("/ast2600/i2c/mux_routes", test_mux_routes);
+    qtest_add_func("/ast2600/i2c/pool_eeprom_full", test_pool_eeprom_full);
+    qtest_add_func("/ast2600/i2c/pmbus_block_read", test_pmbus_block_read);
+    if (has_defer) {
+        qtest_add_func("/ast2600/i2c/defer_byte", test_defer_byte);
+        qtest_add_func("/ast2600/i2c/defer_pool", test_defer_pool);
+        qtest_add_func("/ast2600/i2c/defer_pool_full", test_defer_pool_full);
+        qtest_add_func("/ast2600/i2c/defer_dma", test_defer_dma);
+    }
 
     ret = g_test_run();
     qtest_quit(global_qtest);
     close(udp_socket);
+    close(udp_socket_frame);
 
     return ret;
 }
@@ -0,0 +1,157 @@
+/*
+ * QTest testcase for the Aspeed devices dispatched without the BQL
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define SCU_BASE        0x1E6E2000
+#define SCU_SILICON_REV 0x04
+#define AST2600_A3_SILICON_REV 0x05030303U
+
+#define READER_ADDR     0x80000000
+#define WRITER_ADDR     0x80001000
+
+/* Shared with the guest */
+#define RESULT_ADDR     0x80010000
+#define R_DONE          0x00
+#define R_ERRORS        0x04
+#define R_READS         0x08
+#define R_SILICON_REV   0x0c
+#define R_WRITES        0x10
+
+#define NR_READS        20000
+
+/*
+ * CPU0 reads the SCU silicon revision, the counter of timer 1, the data of
+ * GPIO A and the LSR of UART5, NR_READS times, and counts the values that
+ * are not possible.
+ */
+static const uint32_t reader[] = {
+    0xe3006000,     /* movw r6, #0 */
+    0xe3486001,     /* movt r6, #0x8001 */
+    0xe3027000,     /* movw r7, #0x2000 */
+    0xe3417e6e,     /* movt r7, #0x1e6e (SCU) */
+    0xe3028000,     /* movw r8, #0x2000 */
+    0xe3418e78,     /* movt r8, #0x1e78 (timer) */
+    0xe3009000,     /* movw r9, #0 */
+    0xe3419e78,     /* movt r9, #0x1e78 (GPIO) */
+    0xe304a000,     /* movw r10, #0x4000 */
+    0xe341ae78,     /* movt r10, #0x1e78 (UART5) */
+    0xe596c00c,     /* ldr r12, [r6, #R_SILICON_REV] */
+    0xe5962008,     /* ldr r2, [r6, #R_READS] */
+    0xe30033e8,     /* movw r3, #1000 */
+    0xe3a0b000,     /* mov r11, #0 */
+    0xe5970004,     /* 1: ldr r0, [r7, #SCU_SILICON_REV] */
+    0xe150000c,     /* cmp r0, r12 */
+    0x128bb001,     /* addne r11, r11, #1 */
+    0xe5980000,     /* ldr r0, [r8] (counter) */
+    0xe1500003,     /* cmp r0, r3 */
+    0x828bb001,     /* addhi r11, r11, #1 */
+    0xe5990000,     /* ldr r0, [r9] (data) */
+    0xe20000ff,     /* and r0, r0, #0xff */
+    0xe3500000,     /* cmp r0, #0 */
+    0x135000a5,     /* cmpne r0, #0xa5 */
+    0x128bb001,     /* addne r11, r11, #1 */
+    0xe59a0014,     /* ldr r0, [r10, #0x14] (LSR) */
+    0xe2000060,     /* and r0, r0, #(THRE | TEMT) */
+    0xe3500060,     /* cmp r0, #(THRE | TEMT) */
+    0x128bb001,     /* addne r11, r11, #1 */
+    0xe2522001,     /* subs r2, r2, #1 */
+    0x1affffee,     /* bne 1b */
+    0xe586b004,     /* str r11, [r6, #R_ERRORS] */
+    0xe3a00001,     /* mov r0, #1 */
+    0xe5860000,     /* str r0, [r6, #R_DONE] */
+    0xeafffffe,     /* b . */
+};
+
+/*
+ * CPU1 starts timer 1 with its interrupt, every 1ms, and then keeps
+ * reloading it, toggling the low byte of GPIO A between 0 and 0xa5,
+ * writing the SCU protection key and the scratch register of UART5.
+ */
+static const uint32_t writer[] = {
+    0xe3006000,     /* movw r6, #0 */
+    0xe3486001,     /* movt r6, #0x8001 */
+    0xe3027000,     /* movw r7, #0x2000 */
+    0xe3417e6e,     /* movt r7, #0x1e6e (SCU) */
+    0xe3028000,     /* movw r8, #0x2000 */
+    0xe3418e78,     /* movt r8, #0x1e78 (timer) */
+    0xe3009000,     /* movw r9, #0 */
+    0xe3419e78,     /* movt r9, #0x1e78 (GPIO) */
+    0xe304a000,     /* movw r10, #0x4000 */
+    0xe341ae78,     /* movt r10, #0x1e78 (UART5) */
+    0xe30033e8,     /* movw r3, #1000 */
+    0xe5883004,     /* str r3, [r8, #4] (reload) */
+    0xe3a00007,     /* mov r0, #(enable | 1MHz clock | interrupt) */
+    0xe5880030,     /* str r0, [r8, #0x30] (control) */
+    0xe3a000ff,     /* mov r0, #0xff */
+    0xe5890004,     /* str r0, [r9, #4] (direction) */
+    0xe30a48a8,     /* movw r4, #0xa8a8 */
+    0xe3414688,     /* movt r4, #0x1688 */
+    0xe3a05000,     /* mov r5, #0 */
+    0xe5883004,     /* 1: str r3, [r8, #4] (reload) */
+    0xe3a000a5,     /* mov r0, #0xa5 */
+    0xe5890000,     /* str r0, [r9] (data) */
+    0xe5874000,     /* str r4, [r7] (protection key) */
+    0xe58a501c,     /* str r5, [r10, #0x1c] (SCR) */
+    0xe3a00000,     /* mov r0, #0 */
+    0xe5890000,     /* str r0, [r9] (data) */
+    0xe2855001,     /* add r5, r5, #1 */
+    0xe5865010,     /* str r5, [r6, #R_WRITES] */
+    0xeafffff5,     /* b 1b */
+};
+
+static void write_code(QTestState *qts, uint32_t addr, const uint32_t *code,
+                       size_t len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        qtest_writel(qts, addr + i * 4, code[i]);
+    }
+}
+
+static void test_concurrent_mmio(void)
+{
+    QTestState *qts;
+    int i;
+
+    qts = qtest_initf("-S -machine ast2600-evb -accel tcg,thread=multi "
+                      "-device loader,addr=0x%x,cpu-num=0 "
+                      "-device loader,addr=0x%x,cpu-num=1",
+                      READER_ADDR, WRITER_ADDR);
+    write_code(qts, READER_ADDR, reader, ARRAY_SIZE(reader));
+    write_code(qts, WRITER_ADDR, writer, ARRAY_SIZE(writer));
+    qtest_writel(qts, RESULT_ADDR + R_READS, NR_READS);
+    qtest_writel(qts, RESULT_ADDR + R_SILICON_REV,
+                 qtest_readl(qts, SCU_BASE + SCU_SILICON_REV));
+    g_assert_cmphex(qtest_readl(qts, RESULT_ADDR + R_SILICON_REV), ==,
+                    AST2600_A3_SILICON_REV);
+    qtest_qmp_assert_success(qts, "{ 'execute': 'cont' }");
+
+    for (i = 0; i < 10000 && !qtest_readl(qts, RESULT_ADDR + R_DONE); i++) {
+        g_usleep(1000);
+    }
+    g_assert_cmpuint(qtest_readl(qts, RESULT_ADDR + R_DONE), ==, 1);
+    g_assert_cmpuint(qtest_readl(qts, RESULT_ADDR + R_ERRORS), ==, 0);
+    g_assert_cmpuint(qtest_readl(qts, RESULT_ADDR + R_WRITES), >, 0);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (qtest_has_accel("tcg")) {
+        qtest_add_func("/ast2600/lockless/concurrent_mmio",
+                       test_concurrent_mmio);
+    }
+
+    return g_test_run();
+}
@@ -0,0 +1,93 @@
+/*
+ * QTest testcase for the KCS channels of the Aspeed LPC controller
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/qmp/qdict.h"
+#include "libqtest.h"
+
+#define LPC_BASE    0x1E789000
+#define LPC_PATH    "/machine/soc/lpc"
+
+#define HICR0       0x00
+#define   HICR0_LPC1E   (1 << 5)
+#define IDR1        0x24
+#define ODR1        0x30
+#define STR1        0x3C
+#define   STR_OBF       (1 << 0)
+#define   STR_IBF       (1 << 1)
+
+static void kcs_set(QTestState *s, const char *name, uint32_t value)
+{
+    qtest_qmp_assert_success(s,
+                             "{ 'execute': 'qom-set', 'arguments': "
+                             "{ 'path': %s, 'property': %s, 'value': %u } }",
+                             LPC_PATH, name, value);
+}
+
+static uint32_t kcs_get(QTestState *s, const char *name)
+{
+    QDict *resp;
+    uint32_t value;
+
+    resp = qtest_qmp(s, "{ 'execute': 'qom-get', 'arguments': "
+                     "{ 'path': %s, 'property': %s } }", LPC_PATH, name);
+    g_assert(qdict_haskey(resp, "return"));
+    value = qdict_get_int(resp, "return");
+    qobject_unref(resp);
+
+    return value;
+}
+
+static void test_kcs_input(void)
+{
+    QTestState *s = qtest_init("-machine ast2600-evb");
+
+    qtest_writel(s, LPC_BASE + HICR0, HICR0_LPC1E);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + STR1) & STR_IBF, ==, 0);
+
+    kcs_set(s, "idr1", 0x42);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + STR1) & STR_IBF, ==, STR_IBF);
+
+    /* Reading the byte clears IBF, the following reads do not trap */
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + IDR1), ==, 0x42);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + STR1) & STR_IBF, ==, 0);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + IDR1), ==, 0x42);
+
+    /* Again, for the switch back to trapped reads */
+    kcs_set(s, "idr1", 0x43);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + IDR1), ==, 0x43);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + STR1) & STR_IBF, ==, 0);
+
+    qtest_quit(s);
+}
+
+static void test_kcs_output(void)
+{
+    QTestState *s = qtest_init("-machine ast2600-evb");
+
+    qtest_writel(s, LPC_BASE + HICR0, HICR0_LPC1E);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + HICR0), ==, HICR0_LPC1E);
+
+    qtest_writel(s, LPC_BASE + ODR1, 0x55);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + STR1) & STR_OBF, ==, STR_OBF);
+
+    g_assert_cmphex(kcs_get(s, "odr1"), ==, 0x55);
+    g_assert_cmphex(qtest_readl(s, LPC_BASE + STR1) & STR_OBF, ==, 0);
+
+    qtest_quit(s);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/lpc/kcs_input", test_kcs_input);
+    qtest_add_func("/ast2600/lpc/kcs_output", test_kcs_output);
+
+    return g_test_run();
+}
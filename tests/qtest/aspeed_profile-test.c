@@ -0,0 +1,153 @@
+/*
+ * QTest testcase for the MMIO access profiler, on the Aspeed UART
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
+
+/* The UART is 32 bytes, the rest of its page is aspeed_soc.io */
+#define UART5_BASE  0x1E784000
+#define UART_LSR    (5 << 2)
+#define UART_SCR    (7 << 2)
+
+#define CODE_ADDR   0x80000000
+#define NR_READS    10
+
+/* Reads LSR NR_READS times, writes SCR once and spins */
+static const uint32_t code[] = {
+    0xe3041000,     /* movw r1, #0x4000 */
+    0xe3411e78,     /* movt r1, #0x1e78 */
+    0xe3a0200a,     /* mov r2, #NR_READS */
+    0xe5910014,     /* 1: ldr r0, [r1, #UART_LSR] */
+    0xe2522001,     /* subs r2, r2, #1 */
+    0x1afffffc,     /* bne 1b */
+    0xe581001c,     /* str r0, [r1, #UART_SCR] */
+    0xeafffffe,     /* b . */
+};
+
+static QDict *profile_find(QList *regions, const char *name)
+{
+    QDict *found = NULL;
+    QListEntry *e;
+
+    QLIST_FOREACH_ENTRY(regions, e) {
+        QDict *r = qobject_to(QDict, qlist_entry_obj(e));
+
+        g_assert(r);
+        /* Subpages forward to the regions they cover, never counted */
+        g_assert_cmpstr(qdict_get_str(r, "name"), !=, "subpage");
+        if (!strcmp(qdict_get_str(r, "name"), name)) {
+            g_assert(!found);
+            found = r;
+        }
+    }
+
+    return found;
+}
+
+static QDict *profile_query(QTestState *qts)
+{
+    return qtest_qmp(qts, "{ 'execute': 'x-query-mtree-profile' }");
+}
+
+static void profile_enable(QTestState *qts)
+{
+    qtest_qmp_assert_success(qts, "{ 'execute': 'x-mtree-profile', "
+                             "'arguments': { 'enable': true } }");
+}
+
+static void check_bucket(QDict *region, uint64_t offset, uint64_t reads,
+                         uint64_t writes)
+{
+    QList *buckets = qdict_get_qlist(region, "buckets");
+    QListEntry *e;
+
+    QLIST_FOREACH_ENTRY(buckets, e) {
+        QDict *b = qobject_to(QDict, qlist_entry_obj(e));
+
+        if (qdict_get_int(b, "offset") == offset) {
+            g_assert_cmpuint(qdict_get_int(b, "reads"), ==, reads);
+            g_assert_cmpuint(qdict_get_int(b, "writes"), ==, writes);
+            return;
+        }
+    }
+    g_assert_not_reached();
+}
+
+static void check_uart(QDict *uart)
+{
+    g_assert(uart);
+    g_assert_cmpuint(qdict_get_int(uart, "reads"), ==, NR_READS);
+    g_assert_cmpuint(qdict_get_int(uart, "writes"), ==, 1);
+    g_assert_cmpuint(qdict_get_int(uart, "read-bytes"), ==, NR_READS * 4);
+    g_assert_cmpuint(qdict_get_int(uart, "write-bytes"), ==, 4);
+    check_bucket(uart, UART_LSR, NR_READS, 0);
+    check_bucket(uart, UART_SCR, 0, 1);
+}
+
+static void test_qtest_access(void)
+{
+    QTestState *qts = qtest_init("-S -machine ast2600-evb");
+    QDict *rsp;
+    int i;
+
+    profile_enable(qts);
+    for (i = 0; i < NR_READS; i++) {
+        qtest_readl(qts, UART5_BASE + UART_LSR);
+    }
+    qtest_writel(qts, UART5_BASE + UART_SCR, 0x5a);
+
+    rsp = profile_query(qts);
+    check_uart(profile_find(qdict_get_qlist(rsp, "return"), "serial"));
+    qobject_unref(rsp);
+
+    qtest_quit(qts);
+}
+
+/* The vCPU goes through the subpage of the UART, unlike qtest */
+static void test_guest_access(void)
+{
+    QTestState *qts;
+    QDict *rsp = NULL, *uart = NULL;
+    int i;
+
+    qts = qtest_initf("-S -machine ast2600-evb -accel tcg "
+                      "-device loader,addr=0x%x,cpu-num=0", CODE_ADDR);
+    for (i = 0; i < ARRAY_SIZE(code); i++) {
+        qtest_writel(qts, CODE_ADDR + i * 4, code[i]);
+    }
+    profile_enable(qts);
+    qtest_qmp_assert_success(qts, "{ 'execute': 'cont' }");
+
+    for (i = 0; i < 1000; i++) {
+        qobject_unref(rsp);
+        rsp = profile_query(qts);
+        uart = profile_find(qdict_get_qlist(rsp, "return"), "serial");
+        if (uart && qdict_get_int(uart, "writes")) {
+            break;
+        }
+        g_usleep(1000);
+    }
+    check_uart(uart);
+    qobject_unref(rsp);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/profile/qtest_access", test_qtest_access);
+    if (qtest_has_accel("tcg")) {
+        qtest_add_func("/ast2600/profile/guest_access", test_guest_access);
+    }
+
+    return g_test_run();
+}
@@ -0,0 +1,248 @@
+/*
+ * QTest testcase for the ADMA2 transfers of the Aspeed SD host controller
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "libqos/sdhci-cmd.h"
+
+#define SDHCI_BASE          0x1E740100
+#define SDHC_HOSTCTL        0x28
+#define   SDHC_CTRL_ADMA2_32    0x10
+#define SDHC_NORINTSTS      0x30
+#define   SDHC_NIS_TRSCMP       0x0002
+#define SDHC_ERRINTSTS      0x32
+#define SDHC_NORINTSTSEN    0x34
+#define SDHC_ERRINTSTSEN    0x36
+#define SDHC_ADMASYSADDR    0x58
+#define SDHC_TRNS_DMA       0x0001
+#define SDHC_TRNS_ACMD12    0x0004
+#define SDHC_DATA_INHIBIT   0x00000002  /* SDHC_PRNSTS */
+
+#define ADMA_ATTR_VALID     (1 << 0)
+#define ADMA_ATTR_END       (1 << 1)
+#define ADMA_ATTR_TRAN      (1 << 5)
+#define ADMA_ATTR_LINK      (3 << 4)
+
+#define BLK_SIZE            512
+#define IMAGE_SIZE          (64 * 1024 * 1024)
+
+/* Each request of the null drive of the asynchronous tests lasts 1s */
+#define NULL_DRIVE          "-drive if=sd,index=0,driver=null-co,size=64M," \
+                            "read-zeroes=on,latency-ns=1000000000"
+
+/* Two descriptor tables linked together, and scattered buffers */
+#define DESC_TABLE0         0x80000000
+#define DESC_TABLE1         0x80001000
+#define BUF0                0x80010000
+#define BUF1                0x80030000
+
+static char *sd_path;
+
+static QTestState *setup_sd_card_args(const char *args)
+{
+    QTestState *s = qtest_initf("-machine ast2600-evb %s", args);
+
+    qtest_writeb(s, SDHCI_BASE + SDHC_SWRST, SDHC_RESET_ALL);
+    qtest_writew(s, SDHCI_BASE + SDHC_CLKCON,
+                 SDHC_CLOCK_SDCLK_EN | SDHC_CLOCK_INT_STABLE |
+                 SDHC_CLOCK_INT_EN);
+    sdhci_cmd_regs(s, SDHCI_BASE, 0, 0, 0, 0, SDHC_APP_CMD);
+    sdhci_cmd_regs(s, SDHCI_BASE, 0, 0, 0x41200000, 0, (41 << 8));
+    sdhci_cmd_regs(s, SDHCI_BASE, 0, 0, 0, 0, SDHC_ALL_SEND_CID);
+    sdhci_cmd_regs(s, SDHCI_BASE, 0, 0, 0, 0, SDHC_SEND_RELATIVE_ADDR);
+    sdhci_cmd_regs(s, SDHCI_BASE, 0, 0, 0x45670000, 0,
+                   SDHC_SELECT_DESELECT_CARD);
+
+    qtest_writew(s, SDHCI_BASE + SDHC_NORINTSTSEN, 0xffff);
+    qtest_writew(s, SDHCI_BASE + SDHC_ERRINTSTSEN, 0xffff);
+    qtest_writeb(s, SDHCI_BASE + SDHC_HOSTCTL, SDHC_CTRL_ADMA2_32);
+
+    return s;
+}
+
+static QTestState *setup_sd_card(void)
+{
+    g_autofree char *args =
+        g_strdup_printf("-drive file=%s,if=sd,index=0,format=raw", sd_path);
+
+    return setup_sd_card_args(args);
+}
+
+static void adma_desc(QTestState *s, uint64_t addr, uint32_t buf,
+                      uint16_t len, uint8_t attr)
+{
+    qtest_writeq(s, addr,
+                 ((uint64_t)buf << 32) | ((uint64_t)len << 16) | attr);
+}
+
+static void adma_start(QTestState *s, uint16_t cmd, uint16_t dir)
+{
+    adma_desc(s, DESC_TABLE0, BUF0, BLK_SIZE,
+              ADMA_ATTR_TRAN | ADMA_ATTR_VALID);
+    adma_desc(s, DESC_TABLE0 + 8, DESC_TABLE1, 0,
+              ADMA_ATTR_LINK | ADMA_ATTR_VALID);
+    adma_desc(s, DESC_TABLE1, BUF1, BLK_SIZE,
+              ADMA_ATTR_TRAN | ADMA_ATTR_END | ADMA_ATTR_VALID);
+
+    qtest_writel(s, SDHCI_BASE + SDHC_ADMASYSADDR, DESC_TABLE0);
+    qtest_writew(s, SDHCI_BASE + SDHC_NORINTSTS, 0xffff);
+    sdhci_cmd_regs(s, SDHCI_BASE, BLK_SIZE, 2, 0,
+                   SDHC_TRNS_DMA | SDHC_TRNS_MULTI | SDHC_TRNS_BLK_CNT_EN |
+                   SDHC_TRNS_ACMD12 | dir, cmd | SDHC_CMD_DATA_PRESENT);
+}
+
+/* The transfer completes in the background */
+static void adma_wait(QTestState *s, int timeout_ms)
+{
+    int i;
+
+    for (i = 0; i < timeout_ms; i++) {
+        if (qtest_readw(s, SDHCI_BASE + SDHC_NORINTSTS) & SDHC_NIS_TRSCMP) {
+            break;
+        }
+        g_usleep(1000);
+    }
+    g_assert_cmphex(qtest_readw(s, SDHCI_BASE + SDHC_NORINTSTS) &
+                    SDHC_NIS_TRSCMP, ==, SDHC_NIS_TRSCMP);
+    g_assert_cmphex(qtest_readw(s, SDHCI_BASE + SDHC_ERRINTSTS), ==, 0);
+    g_assert_cmpuint(qtest_readw(s, SDHCI_BASE + SDHC_BLKCNT), ==, 0);
+}
+
+static void adma_transfer(QTestState *s, uint16_t cmd, uint16_t dir)
+{
+    adma_start(s, cmd, dir);
+    adma_wait(s, 1000);
+}
+
+static void fill_pattern(uint8_t *buf, size_t len, uint8_t seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        buf[i] = seed + i * 7;
+    }
+}
+
+static void test_adma_read(void)
+{
+    QTestState *s = setup_sd_card();
+    uint8_t expected[2 * BLK_SIZE];
+    uint8_t data[BLK_SIZE];
+    int fd;
+
+    fill_pattern(expected, sizeof(expected), 0x11);
+    fd = open(sd_path, O_WRONLY);
+    g_assert(fd >= 0);
+    g_assert_cmpint(pwrite(fd, expected, sizeof(expected), 0), ==,
+                    sizeof(expected));
+    close(fd);
+
+    adma_transfer(s, SDHC_READ_MULTIPLE_BLOCK, SDHC_TRNS_READ);
+
+    qtest_memread(s, BUF0, data, BLK_SIZE);
+    g_assert(!memcmp(data, expected, BLK_SIZE));
+    qtest_memread(s, BUF1, data, BLK_SIZE);
+    g_assert(!memcmp(data, expected + BLK_SIZE, BLK_SIZE));
+
+    qtest_quit(s);
+}
+
+static void test_adma_write(void)
+{
+    QTestState *s = setup_sd_card();
+    uint8_t expected[2 * BLK_SIZE];
+    uint8_t data[2 * BLK_SIZE];
+    int fd;
+
+    fill_pattern(expected, sizeof(expected), 0x5a);
+    qtest_memwrite(s, BUF0, expected, BLK_SIZE);
+    qtest_memwrite(s, BUF1, expected + BLK_SIZE, BLK_SIZE);
+
+    adma_transfer(s, SDHC_WRITE_MULTIPLE_BLOCK, SDHC_TRNS_WRITE);
+
+    fd = open(sd_path, O_RDONLY);
+    g_assert(fd >= 0);
+    g_assert_cmpint(pread(fd, data, sizeof(data), 0), ==, sizeof(data));
+    close(fd);
+    g_assert(!memcmp(data, expected, sizeof(data)));
+
+    qtest_quit(s);
+}
+
+/*
+ * The command returns before the blocks are read, only the asynchronous
+ * ADMA2 path leaves the data phase in flight: the FIFO path would wait for
+ * the drive in the vCPU, and the transfer would be complete.
+ */
+static void adma_read_async(QTestState *s)
+{
+    uint8_t data[BLK_SIZE];
+    int i;
+
+    memset(data, 0xff, sizeof(data));
+    qtest_memwrite(s, BUF0, data, sizeof(data));
+    qtest_memwrite(s, BUF1, data, sizeof(data));
+
+    adma_start(s, SDHC_READ_MULTIPLE_BLOCK, SDHC_TRNS_READ);
+    g_assert_cmphex(qtest_readw(s, SDHCI_BASE + SDHC_NORINTSTS) &
+                    SDHC_NIS_TRSCMP, ==, 0);
+    g_assert_cmphex(qtest_readl(s, SDHCI_BASE + SDHC_PRNSTS) &
+                    SDHC_DATA_INHIBIT, ==, SDHC_DATA_INHIBIT);
+    adma_wait(s, 5000);
+
+    qtest_memread(s, BUF0, data, sizeof(data));
+    for (i = 0; i < sizeof(data); i++) {
+        g_assert_cmphex(data[i], ==, 0);
+    }
+    qtest_memread(s, BUF1, data, sizeof(data));
+    for (i = 0; i < sizeof(data); i++) {
+        g_assert_cmphex(data[i], ==, 0);
+    }
+}
+
+static void test_adma_async(void)
+{
+    QTestState *s = setup_sd_card_args(NULL_DRIVE);
+
+    adma_read_async(s);
+    qtest_quit(s);
+}
+
+/* The drive of the card runs in an IOThread */
+static void test_adma_async_iothread(void)
+{
+    QTestState *s = setup_sd_card_args("-object iothread,id=sd-io "
+                                       "-global sd-card.iothread=sd-io "
+                                       NULL_DRIVE);
+
+    adma_read_async(s);
+    qtest_quit(s);
+}
+
+int main(int argc, char **argv)
+{
+    int fd, ret;
+
+    fd = g_file_open_tmp("sdhci_XXXXXX", &sd_path, NULL);
+    g_assert(fd >= 0);
+    g_assert_cmpint(ftruncate(fd, IMAGE_SIZE), ==, 0);
+    close(fd);
+
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/sdhci/adma_read", test_adma_read);
+    qtest_add_func("/ast2600/sdhci/adma_write", test_adma_write);
+    qtest_add_func("/ast2600/sdhci/adma_async", test_adma_async);
+    qtest_add_func("/ast2600/sdhci/adma_async_iothread",
+                   test_adma_async_iothread);
+
+    ret = g_test_run();
+    unlink(sd_path);
+    g_free(sd_path);
+    return ret;
+}
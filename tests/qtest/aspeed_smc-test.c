@@ -41,10 +41,19 @@
 #define   CTRL_FREADMODE       0x1
 #define   CTRL_WRITEMODE       0x2
 #define   CTRL_USERMODE        0x3
+#define R_INTR_CTRL         0x08
+#define   INTR_CTRL_DMA_STATUS (1 << 11)
+#define R_DMA_CTRL          0x80
+#define   DMA_CTRL_ENABLE      (1 << 0)
+#define R_DMA_FLASH_ADDR    0x84
+#define R_DMA_DRAM_ADDR     0x88
+#define R_DMA_LEN           0x8C
+#define R_DMA_CHECKSUM      0x90
 #define SR_WEL BIT(1)
 
 #define ASPEED_FMC_BASE    0x1E620000
 #define ASPEED_FLASH_BASE  0x20000000
+#define ASPEED_DRAM_BASE   0x40000000
 
 /*
  * Flash commands
@@ -423,6 +432,59 @@ static void test_write_page_mem(void)
     flash_reset();
 }
 
+static void test_dma_read(void)
+{
+    uint32_t my_page_addr = 0x14000 * FLASH_PAGE_SIZE; /* beyond 16MB */
+    uint32_t dram_addr = ASPEED_DRAM_BASE + 0x100000;
+    uint32_t page[FLASH_PAGE_SIZE / 4];
+    uint32_t checksum = 0;
+    int i;
+
+    spi_ce_ctrl(1 << CRTL_EXTENDED0);
+
+    spi_conf(CONF_ENABLE_W0);
+    spi_ctrl_start_user();
+    writeb(ASPEED_FLASH_BASE, EN_4BYTE_ADDR);
+    writeb(ASPEED_FLASH_BASE, WREN);
+    writeb(ASPEED_FLASH_BASE, PP);
+    writel(ASPEED_FLASH_BASE, make_be32(my_page_addr));
+
+    /* Fill the page with its own addresses */
+    for (i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        writel(ASPEED_FLASH_BASE, make_be32(my_page_addr + i * 4));
+        checksum += make_be32(my_page_addr + i * 4);
+    }
+    spi_ctrl_stop_user();
+    spi_conf_remove(CONF_ENABLE_W0);
+
+    /* DMAs go through the AHB window of the flash */
+    spi_ctrl_setmode(CTRL_READMODE, READ);
+
+    writel(ASPEED_FMC_BASE + R_DMA_CTRL, 0);
+    writel(ASPEED_FMC_BASE + R_DMA_FLASH_ADDR,
+           ASPEED_FLASH_BASE + my_page_addr);
+    writel(ASPEED_FMC_BASE + R_DMA_DRAM_ADDR, dram_addr);
+    writel(ASPEED_FMC_BASE + R_DMA_LEN, FLASH_PAGE_SIZE);
+    writel(ASPEED_FMC_BASE + R_DMA_CTRL, DMA_CTRL_ENABLE);
+
+    /* The transfer completes asynchronously */
+    while (!(readl(ASPEED_FMC_BASE + R_INTR_CTRL) & INTR_CTRL_DMA_STATUS)) {
+        clock_step(1000);
+    }
+
+    g_assert_cmphex(readl(ASPEED_FMC_BASE + R_DMA_LEN), ==, 0);
+    g_assert_cmphex(readl(ASPEED_FMC_BASE + R_DMA_CHECKSUM), ==, checksum);
+
+    memread(dram_addr, page, sizeof(page));
+    for (i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        g_assert_cmphex(make_be32(page[i]), ==, my_page_addr + i * 4);
+    }
+
+    writel(ASPEED_FMC_BASE + R_DMA_CTRL, 0);
+
+    flash_reset();
+}
+
 static void test_read_status_reg(void)
 {
     uint8_t r;
@@ -608,6 +670,68 @@ static void test_write_block_protect_bottom_bit(void)
     flash_reset();
 }
 
+static void file_read_page(const char *path, uint32_t addr, uint32_t *page)
+{
+    int fd = open(path, O_RDONLY);
+
+    g_assert(fd >= 0);
+    g_assert_cmpint(pread(fd, page, FLASH_PAGE_SIZE, addr), ==,
+                    FLASH_PAGE_SIZE);
+    close(fd);
+}
+
+/* With mmap=on, a page program goes straight to the image file */
+static void test_write_page_mmap(void)
+{
+    char path[] = "/tmp/qtest.m25p80.mmap.XXXXXX";
+    uint32_t my_page_addr = 0x14000 * FLASH_PAGE_SIZE; /* beyond 16MB */
+    uint32_t page[FLASH_PAGE_SIZE / 4];
+    QTestState *saved = global_qtest;
+    int fd;
+    int i;
+
+    /* An erased page in an otherwise empty image */
+    fd = mkstemp(path);
+    g_assert(fd >= 0);
+    g_assert_cmpint(ftruncate(fd, FLASH_SIZE), ==, 0);
+    memset(page, 0xff, sizeof(page));
+    g_assert_cmpint(pwrite(fd, page, sizeof(page), my_page_addr), ==,
+                    sizeof(page));
+    close(fd);
+
+    global_qtest = qtest_initf("-m 256 -machine palmetto-bmc "
+                               "-drive file=%s,format=raw,if=mtd "
+                               "-global m25p80-generic.mmap=on", path);
+
+    spi_conf(CONF_ENABLE_W0);
+    spi_ctrl_start_user();
+    writeb(ASPEED_FLASH_BASE, EN_4BYTE_ADDR);
+    writeb(ASPEED_FLASH_BASE, WREN);
+    writeb(ASPEED_FLASH_BASE, PP);
+    writel(ASPEED_FLASH_BASE, make_be32(my_page_addr));
+    for (i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        writel(ASPEED_FLASH_BASE, make_be32(my_page_addr + i * 4));
+    }
+    spi_ctrl_stop_user();
+
+    /* The file has the data as soon as the page is programmed */
+    file_read_page(path, my_page_addr, page);
+    for (i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        g_assert_cmphex(be32_to_cpu(page[i]), ==, my_page_addr + i * 4);
+    }
+
+    /* And keeps it once QEMU has synced it and exited */
+    qtest_quit(global_qtest);
+    global_qtest = saved;
+
+    file_read_page(path, my_page_addr, page);
+    for (i = 0; i < FLASH_PAGE_SIZE / 4; i++) {
+        g_assert_cmphex(be32_to_cpu(page[i]), ==, my_page_addr + i * 4);
+    }
+
+    unlink(path);
+}
+
 static char tmp_path[] = "/tmp/qtest.m25p80.XXXXXX";
 
 int main(int argc, char **argv)
@@ -633,6 +757,7 @@ int main(int argc, char **argv)
     qtest_add_func("/ast2400/smc/write_page", test_write_page);
     qtest_add_func("/ast2400/smc/read_page_mem", test_read_page_mem);
     qtest_add_func("/ast2400/smc/write_page_mem", test_write_page_mem);
+    qtest_add_func("/ast2400/smc/dma_read", test_dma_read);
     qtest_add_func("/ast2400/smc/read_status_reg", test_read_status_reg);
     qtest_add_func("/ast2400/smc/status_reg_write_protection",
                    test_status_reg_write_protection);
@@ -640,6 +765,7 @@ int main(int argc, char **argv)
                    test_write_block_protect);
     qtest_add_func("/ast2400/smc/write_block_protect_bottom_bit",
                    test_write_block_protect_bottom_bit);
+    qtest_add_func("/ast2400/smc/write_page_mmap", test_write_page_mmap);
 
     flash_reset();
     ret = g_test_run();
@@ -0,0 +1,105 @@
+/*
+ * QTest testcase for VM templates, on an Aspeed machine.
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define DRAM_ADDR 0x80000000
+#define SRAM_ADDR 0x10000000
+
+#define ETH1_BASE 0x1E660000
+#define FTGMAC100_MAC_MADR 0x08
+#define FTGMAC100_MAC_LADR 0x0c
+
+/* The MAC address of the template, which its guest programs again */
+#define TMPL_MAC "52:54:00:12:34:01"
+#define TMPL_MADR 0x5254
+#define TMPL_LADR 0x00123401
+#define CLONE_MAC "52:54:00:12:34:02"
+
+static char *start_args(const char *mem_path, bool share, bool incoming)
+{
+    return g_strdup_printf("-machine ast2600-evb,memory-backend=ram "
+                           "-object memory-backend-file,id=ram,size=1G,"
+                           "mem-path=%s,share=%s "
+                           "-net nic,model=ftgmac100,macaddr=%s %s",
+                           mem_path, share ? "on" : "off",
+                           incoming ? CLONE_MAC : TMPL_MAC,
+                           incoming ? "-incoming defer" : "");
+}
+
+static uint32_t file_readl(const char *path, off_t offset)
+{
+    uint32_t value;
+    int fd = open(path, O_RDONLY);
+
+    g_assert(fd >= 0);
+    g_assert(pread(fd, &value, sizeof(value), offset) == sizeof(value));
+    close(fd);
+
+    return le32_to_cpu(value);
+}
+
+static void test_template(void)
+{
+    g_autofree char *dir = g_dir_make_tmp("qemu-template-XXXXXX", NULL);
+    g_autofree char *mem_path = g_build_filename(dir, "ram", NULL);
+    g_autofree char *state = g_build_filename(dir, "state", NULL);
+    g_autofree char *args = NULL;
+    QTestState *tmpl, *clone;
+
+    g_assert(dir);
+
+    args = start_args(mem_path, true, false);
+    tmpl = qtest_init(args);
+    qtest_writel(tmpl, DRAM_ADDR, 0x12345678);
+    qtest_writel(tmpl, SRAM_ADDR, 0xcafe0001);
+    qtest_writel(tmpl, ETH1_BASE + FTGMAC100_MAC_MADR, TMPL_MADR);
+    qtest_writel(tmpl, ETH1_BASE + FTGMAC100_MAC_LADR, TMPL_LADR);
+    qtest_qmp_assert_success(tmpl,
+                             "{ 'execute': 'x-template-save',"
+                             "  'arguments': { 'filename': %s } }", state);
+    qtest_quit(tmpl);
+
+    /* The guest RAM is in the memory file, not in the state */
+    g_assert_cmphex(file_readl(mem_path, 0), ==, 0x12345678);
+
+    g_free(args);
+    args = start_args(mem_path, false, true);
+    clone = qtest_init(args);
+    qtest_qmp_assert_success(clone,
+                             "{ 'execute': 'x-template-load',"
+                             "  'arguments': { 'filename': %s } }", state);
+    g_assert_cmphex(qtest_readl(clone, DRAM_ADDR), ==, 0x12345678);
+    g_assert_cmphex(qtest_readl(clone, SRAM_ADDR), ==, 0xcafe0001);
+
+    /* The NIC filters on the MAC address the template guest programmed */
+    g_assert_cmphex(qtest_readl(clone, ETH1_BASE + FTGMAC100_MAC_MADR), ==,
+                    TMPL_MADR);
+    g_assert_cmphex(qtest_readl(clone, ETH1_BASE + FTGMAC100_MAC_LADR), ==,
+                    TMPL_LADR);
+
+    /* Clone writes are private */
+    qtest_writel(clone, DRAM_ADDR, 0x87654321);
+    g_assert_cmphex(qtest_readl(clone, DRAM_ADDR), ==, 0x87654321);
+    g_assert_cmphex(file_readl(mem_path, 0), ==, 0x12345678);
+    qtest_quit(clone);
+
+    unlink(mem_path);
+    unlink(state);
+    rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/template/save_load", test_template);
+
+    return g_test_run();
+}
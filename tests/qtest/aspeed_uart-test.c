@@ -0,0 +1,78 @@
+/*
+ * QTest testcase for the coalesced transmission of the Aspeed UARTs
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define UART5_BASE  0x1E784000
+#define UART_THR    (0 << 2)
+#define UART_LSR    (5 << 2)
+#define   UART_LSR_TEMT 0x40
+#define   UART_LSR_THRE 0x20
+
+static void uart_puts(QTestState *s, const char *str)
+{
+    for (; *str; str++) {
+        qtest_writel(s, UART5_BASE + UART_THR, *str);
+        /* The transmitter timings do not change with the coalescing */
+        g_assert_cmphex(qtest_readl(s, UART5_BASE + UART_LSR) &
+                        (UART_LSR_TEMT | UART_LSR_THRE), ==,
+                        UART_LSR_TEMT | UART_LSR_THRE);
+    }
+}
+
+static char *file_read(const char *path)
+{
+    char *contents = NULL;
+
+    g_assert(g_file_get_contents(path, &contents, NULL, NULL));
+    return contents;
+}
+
+static void test_tx_coalesce(void)
+{
+    g_autofree char *dir = g_dir_make_tmp("qemu-uart-XXXXXX", NULL);
+    g_autofree char *path = g_build_filename(dir, "console", NULL);
+    g_autofree char *contents = NULL;
+    QTestState *s;
+    int i;
+
+    s = qtest_initf("-machine ast2600-evb "
+                    "-chardev file,id=console,path=%s "
+                    "-serial chardev:console", path);
+
+    /* Complete lines are written right away */
+    uart_puts(s, "hello\n");
+    contents = file_read(path);
+    g_assert_cmpstr(contents, ==, "hello\n");
+
+    /* A partial line is written after a short delay */
+    uart_puts(s, "login: ");
+    for (i = 0; i < 500; i++) {
+        g_free(contents);
+        contents = file_read(path);
+        if (!strcmp(contents, "hello\nlogin: ")) {
+            break;
+        }
+        g_usleep(10 * 1000);
+    }
+    g_assert_cmpstr(contents, ==, "hello\nlogin: ");
+
+    qtest_quit(s);
+    unlink(path);
+    rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/ast2600/uart/tx_coalesce", test_tx_coalesce);
+
+    return g_test_run();
+}
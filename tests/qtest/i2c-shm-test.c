@@ -0,0 +1,290 @@
+/*
+ * QTest testcase for the i2c-shm bridge, with the test acting as the peer
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "qemu/atomic.h"
+#include "qemu/memfd.h"
+#include "qapi/error.h"
+#include "qapi/qmp/qdict.h"
+#include "hw/misc/i2c-shm.h"
+#include "libqtest.h"
+
+/* The replayed transfers go to an EEPROM on the same bus */
+#define EEPROM_ADDR     0x50
+#define SHM_ADDR        0x20
+
+typedef struct ShmPeer {
+    QTestState *qts;
+    char *dir;
+    char *path;
+    int listen_fd;
+    int fd;
+    /* Our inbox, QEMU writes the answers to its resp ring */
+    I2CShmInbox *inbox;
+    int inbox_fd;
+    int notify_fd;
+    /* QEMU's inbox, we write the transfers to replay to its req ring */
+    I2CShmInbox *peer;
+    int peer_notify_fd;
+    uint16_t seq;
+} ShmPeer;
+
+static void peer_recv_hello(ShmPeer *p)
+{
+    I2CShmHello hello;
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    char control[CMSG_SPACE(2 * sizeof(int))];
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    struct cmsghdr *cmsg;
+    int fds[2];
+
+    g_assert_cmpint(recvmsg(p->fd, &msg, 0), ==, sizeof(hello));
+    g_assert_cmphex(hello.magic, ==, I2C_SHM_MAGIC);
+    g_assert_cmpuint(hello.version, ==, I2C_SHM_VERSION);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    g_assert(cmsg && cmsg->cmsg_type == SCM_RIGHTS);
+    g_assert_cmpuint(cmsg->cmsg_len, ==, CMSG_LEN(sizeof(fds)));
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    p->peer = mmap(NULL, sizeof(I2CShmInbox), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fds[0], 0);
+    g_assert(p->peer != MAP_FAILED);
+    close(fds[0]);
+    p->peer_notify_fd = fds[1];
+}
+
+static void peer_send_hello(ShmPeer *p)
+{
+    I2CShmHello hello = {
+        .magic = I2C_SHM_MAGIC,
+        .version = I2C_SHM_VERSION,
+    };
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    char control[CMSG_SPACE(2 * sizeof(int))] = {};
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    int fds[2] = { p->inbox_fd, p->notify_fd };
+
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    g_assert_cmpint(sendmsg(p->fd, &msg, 0), ==, sizeof(hello));
+}
+
+static bool peer_connected(ShmPeer *p)
+{
+    QDict *rsp;
+    bool connected;
+
+    rsp = qtest_qmp(p->qts, "{ 'execute': 'qom-get', 'arguments': "
+                    "{ 'path': '/machine/peripheral/shm0', "
+                    "  'property': 'connected' } }");
+    connected = qdict_get_bool(rsp, "return");
+    qobject_unref(rsp);
+
+    return connected;
+}
+
+static void peer_init(ShmPeer *p)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int i;
+
+    p->dir = g_dir_make_tmp("i2c-shm-test-XXXXXX", NULL);
+    g_assert(p->dir);
+    p->path = g_build_filename(p->dir, "sock", NULL);
+
+    p->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    g_assert(p->listen_fd >= 0);
+    g_strlcpy(addr.sun_path, p->path, sizeof(addr.sun_path));
+    g_assert_cmpint(bind(p->listen_fd, (struct sockaddr *)&addr,
+                         sizeof(addr)), ==, 0);
+    g_assert_cmpint(listen(p->listen_fd, 1), ==, 0);
+
+    p->qts = qtest_initf("-machine ast2600-evb "
+                         "-chardev socket,id=i2c0,path=%s "
+                         "-device i2c-shm,id=shm0,bus=aspeed.i2c.bus.6,"
+                         "address=0x%x,chardev=i2c0 "
+                         "-device at24c-eeprom,bus=aspeed.i2c.bus.6,"
+                         "address=0x%x,rom-size=256",
+                         p->path, SHM_ADDR, EEPROM_ADDR);
+    p->fd = accept(p->listen_fd, NULL, NULL);
+    g_assert(p->fd >= 0);
+
+    p->inbox = qemu_memfd_alloc("i2c-shm-test", sizeof(I2CShmInbox), 0,
+                                &p->inbox_fd, &error_abort);
+    p->inbox->magic = I2C_SHM_MAGIC;
+    p->inbox->version = I2C_SHM_VERSION;
+    p->notify_fd = eventfd(0, EFD_NONBLOCK);
+    g_assert(p->notify_fd >= 0);
+
+    peer_recv_hello(p);
+    peer_send_hello(p);
+
+    for (i = 0; i < 1000 && !peer_connected(p); i++) {
+        g_usleep(1000);
+    }
+    g_assert(peer_connected(p));
+}
+
+static void peer_cleanup(ShmPeer *p)
+{
+    qtest_quit(p->qts);
+    munmap(p->peer, sizeof(I2CShmInbox));
+    qemu_memfd_free(p->inbox, sizeof(I2CShmInbox), p->inbox_fd);
+    close(p->peer_notify_fd);
+    close(p->notify_fd);
+    close(p->fd);
+    close(p->listen_fd);
+    unlink(p->path);
+    rmdir(p->dir);
+    g_free(p->path);
+    g_free(p->dir);
+}
+
+/* Queues @msg for QEMU to replay, and waits until it was */
+static void peer_push(ShmPeer *p, uint8_t type, uint8_t addr, uint8_t flags,
+                      const uint8_t *data, uint16_t len)
+{
+    I2CShmRing *r = &p->peer->req;
+    uint32_t head = r->head;
+    I2CShmMsg *slot = &r->slots[head % I2C_SHM_RING_SLOTS];
+    uint64_t one = 1;
+    int i;
+
+    g_assert_cmpuint(head - qatomic_load_acquire(&r->tail), <,
+                     I2C_SHM_RING_SLOTS);
+    slot->type = type;
+    slot->addr = addr;
+    slot->flags = flags;
+    slot->seq = ++p->seq;
+    slot->len = len;
+    memcpy(slot->data, data, MIN(len, I2C_SHM_MAX_DATA));
+    qatomic_store_release(&r->head, head + 1);
+    smp_mb();
+    g_assert_cmpint(write(p->peer_notify_fd, &one, sizeof(one)), ==,
+                    sizeof(one));
+
+    for (i = 0; i < 1000 && qatomic_load_acquire(&r->tail) != head + 1; i++) {
+        g_usleep(1000);
+    }
+    g_assert_cmpuint(qatomic_load_acquire(&r->tail), ==, head + 1);
+}
+
+/* Returns the answer to the last request */
+static I2CShmMsg peer_pop_resp(ShmPeer *p)
+{
+    I2CShmRing *r = &p->inbox->resp;
+    I2CShmMsg msg;
+    int i;
+
+    for (i = 0; i < 1000 && qatomic_load_acquire(&r->head) == r->tail; i++) {
+        g_usleep(1000);
+    }
+    g_assert_cmpuint(qatomic_load_acquire(&r->head), !=, r->tail);
+
+    msg = r->slots[r->tail % I2C_SHM_RING_SLOTS];
+    qatomic_store_release(&r->tail, r->tail + 1);
+    g_assert_cmphex(msg.type, ==, I2C_SHM_MSG_RESP);
+    g_assert_cmpuint(msg.seq, ==, p->seq);
+
+    return msg;
+}
+
+static uint8_t peer_read_byte(ShmPeer *p)
+{
+    I2CShmMsg msg;
+
+    peer_push(p, I2C_SHM_MSG_READ, EEPROM_ADDR << 1 | 1, 0, NULL, 0);
+    msg = peer_pop_resp(p);
+    g_assert_cmpuint(msg.len, ==, 1);
+
+    return msg.data[0];
+}
+
+static void test_replay_write_read(void)
+{
+    const uint8_t wr[] = { 0x10, 0xde, 0xad };
+    const uint8_t offset[] = { 0x10 };
+    ShmPeer p = { 0 };
+    I2CShmMsg msg;
+
+    peer_init(&p);
+
+    /* Write two bytes at offset 0x10 */
+    peer_push(&p, I2C_SHM_MSG_WRITE, EEPROM_ADDR << 1, I2C_SHM_F_STOP,
+              wr, sizeof(wr));
+
+    /* Read them back after a repeated start */
+    peer_push(&p, I2C_SHM_MSG_WRITE, EEPROM_ADDR << 1, 0,
+              offset, sizeof(offset));
+    peer_push(&p, I2C_SHM_MSG_START, EEPROM_ADDR << 1 | 1, 0, NULL, 0);
+    msg = peer_pop_resp(&p);
+    g_assert_cmpuint(msg.status, ==, 0);
+    g_assert_cmphex(peer_read_byte(&p), ==, 0xde);
+    g_assert_cmphex(peer_read_byte(&p), ==, 0xad);
+    peer_push(&p, I2C_SHM_MSG_NACK, EEPROM_ADDR << 1 | 1, 0, NULL, 0);
+    peer_push(&p, I2C_SHM_MSG_STOP, EEPROM_ADDR << 1, 0, NULL, 0);
+
+    peer_cleanup(&p);
+}
+
+static void test_replay_invalid(void)
+{
+    uint8_t wr[I2C_SHM_MAX_DATA] = { 0x20, 0x5a };
+    const uint8_t offset[] = { 0x20 };
+    ShmPeer p = { 0 };
+    I2CShmMsg msg;
+
+    peer_init(&p);
+
+    /* Dropped: too long, unknown type, read bit on a write */
+    peer_push(&p, I2C_SHM_MSG_WRITE, EEPROM_ADDR << 1, I2C_SHM_F_STOP,
+              wr, I2C_SHM_MAX_DATA + 1);
+    peer_push(&p, 0x42, EEPROM_ADDR << 1, 0, NULL, 0);
+    peer_push(&p, I2C_SHM_MSG_WRITE, EEPROM_ADDR << 1 | 1, I2C_SHM_F_STOP,
+              wr, 2);
+
+    /* None of them reached the EEPROM, and the bridge still works */
+    peer_push(&p, I2C_SHM_MSG_WRITE, EEPROM_ADDR << 1, 0,
+              offset, sizeof(offset));
+    peer_push(&p, I2C_SHM_MSG_START, EEPROM_ADDR << 1 | 1, 0, NULL, 0);
+    msg = peer_pop_resp(&p);
+    g_assert_cmpuint(msg.status, ==, 0);
+    g_assert_cmphex(peer_read_byte(&p), ==, 0);
+    peer_push(&p, I2C_SHM_MSG_NACK, EEPROM_ADDR << 1 | 1, 0, NULL, 0);
+    peer_push(&p, I2C_SHM_MSG_STOP, EEPROM_ADDR << 1, 0, NULL, 0);
+
+    peer_cleanup(&p);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/i2c-shm/replay/write_read", test_replay_write_read);
+    qtest_add_func("/i2c-shm/replay/invalid", test_replay_invalid);
+
+    return g_test_run();
+}
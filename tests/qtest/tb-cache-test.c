@@ -0,0 +1,103 @@
+/*
+ * QTest testcase for the persistent translation cache
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include <sys/personality.h>
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+
+#define CODE_ADDR   0x40000000
+
+/* A single-CPU machine, i.e. code_gen_buffer has a single region */
+static const uint32_t code[] = {
+    0xe3a00000,     /* mov r0, #0 */
+    0xe2800001,     /* 1: add r0, r0, #1 */
+    0xe3500a01,     /* cmp r0, #0x1000 */
+    0x1afffffc,     /* bne 1b */
+    0xe2811001,     /* add r1, r1, #1 */
+    0xeafffff9,     /* b 0b */
+};
+
+static void tb_cache_adopted(QTestState *qts, unsigned *adopted,
+                             unsigned *loaded)
+{
+    QDict *rsp, *ret;
+    const char *text, *line;
+
+    rsp = qtest_qmp(qts, "{ 'execute': 'x-query-jit' }");
+    ret = qdict_get_qdict(rsp, "return");
+    text = qdict_get_str(ret, "human-readable-text");
+    line = strstr(text, "TB cache adopted");
+    g_assert(line);
+    g_assert_cmpint(sscanf(line, "TB cache adopted %u/%u", adopted, loaded),
+                    ==, 2);
+    qobject_unref(rsp);
+}
+
+static QTestState *tb_cache_run(const char *path)
+{
+    QTestState *qts;
+    int i;
+
+    qts = qtest_initf("-S -machine virt -cpu cortex-a15 "
+                      "-accel tcg,tb-cache=%s "
+                      "-device loader,addr=0x%x,cpu-num=0",
+                      path, CODE_ADDR);
+    for (i = 0; i < ARRAY_SIZE(code); i++) {
+        qtest_writel(qts, CODE_ADDR + i * 4, code[i]);
+    }
+    qtest_qmp_assert_success(qts, "{ 'execute': 'cont' }");
+    g_usleep(100 * 1000);
+    qtest_qmp_assert_success(qts, "{ 'execute': 'stop' }");
+
+    return qts;
+}
+
+static void test_reload(void)
+{
+    g_autofree char *dir = g_dir_make_tmp("tb-cache-test-XXXXXX", NULL);
+    g_autofree char *path = g_build_filename(dir, "tbs", NULL);
+    unsigned adopted, loaded;
+    QTestState *qts;
+
+    /* Nothing to load yet; the blocks are saved at exit */
+    qts = tb_cache_run(path);
+    tb_cache_adopted(qts, &adopted, &loaded);
+    g_assert_cmpuint(loaded, ==, 0);
+    qtest_quit(qts);
+    g_assert(g_file_test(path, G_FILE_TEST_EXISTS));
+
+    /* The same code runs from the reloaded blocks */
+    qts = tb_cache_run(path);
+    tb_cache_adopted(qts, &adopted, &loaded);
+    g_assert_cmpuint(loaded, >, 0);
+    g_assert_cmpuint(adopted, >, 0);
+    qtest_quit(qts);
+
+    unlink(path);
+    rmdir(dir);
+}
+
+int main(int argc, char **argv)
+{
+    /*
+     * The blocks are reloaded at the address they were generated at, which
+     * needs the same layout of QEMU's address space from one run to the
+     * next. Disable randomization, QEMU inherits it.
+     */
+    if (personality(personality(0xffffffff) | ADDR_NO_RANDOMIZE) < 0) {
+        g_test_message("cannot disable address space randomization");
+        return 0;
+    }
+
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/tb-cache/reload", test_reload);
+
+    return g_test_run();
+}
@@ -0,0 +1,111 @@
+/*
+ * QTest testcase for the retranslation of hot TBs as superblocks
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+
+#define CODE_ADDR   0x40000000
+#define RESULT_ADDR 0x40010000
+
+/*
+ * The loop head is entered through bxne, a lookup, and gets promoted.
+ * Its superblock follows the B and the BL, over the insns they skip,
+ * with the flags of the SUBS used after the branch.
+ */
+static const uint32_t code[] = {
+    0xe30023e8,     /* movw r2, #1000 */
+    0xe3a00000,     /* mov r0, #0 */
+    0xe3006000,     /* movw r6, #0 */
+    0xe3446001,     /* movt r6, #0x4001 */
+    0xe28f7000,     /* add r7, pc, #0 */
+    0xe3a05000,     /* mov r5, #0 */
+    0xe2523f7d,     /* 0: subs r3, r2, #500 */
+    0xea000000,     /* b 1f */
+    0xe2800801,     /* add r0, r0, #0x10000 */
+    0xb2800001,     /* 1: addlt r0, r0, #1 */
+    0xa2800002,     /* addge r0, r0, #2 */
+    0xeb000000,     /* bl 2f */
+    0xe2800802,     /* add r0, r0, #0x20000 */
+    0xe1a0500e,     /* 2: mov r5, lr */
+    0xe2522001,     /* subs r2, r2, #1 */
+    0x112fff17,     /* bxne r7 */
+    0xe5860000,     /* str r0, [r6] */
+    0xe5865004,     /* str r5, [r6, #4] */
+    0xeafffffe,     /* b . */
+};
+
+/* 499 iterations below 500 add 1, the 501 others add 2 */
+#define RESULT      1501
+/* Return address of the BL */
+#define RESULT_LR   (CODE_ADDR + 12 * 4)
+
+static unsigned hot_tb_count(QTestState *qts)
+{
+    QDict *rsp, *ret;
+    const char *line;
+    unsigned count;
+
+    rsp = qtest_qmp(qts, "{ 'execute': 'x-query-jit' }");
+    ret = qdict_get_qdict(rsp, "return");
+    line = strstr(qdict_get_str(ret, "human-readable-text"), "hot TB count");
+    g_assert(line);
+    g_assert_cmpint(sscanf(line, "hot TB count %u", &count), ==, 1);
+    qobject_unref(rsp);
+
+    return count;
+}
+
+static void tb_hot_run(unsigned threshold)
+{
+    QTestState *qts;
+    int i;
+
+    qts = qtest_initf("-S -machine virt -cpu cortex-a15 "
+                      "-accel tcg,hot-threshold=%u "
+                      "-device loader,addr=0x%x,cpu-num=0",
+                      threshold, CODE_ADDR);
+    for (i = 0; i < ARRAY_SIZE(code); i++) {
+        qtest_writel(qts, CODE_ADDR + i * 4, code[i]);
+    }
+    qtest_qmp_assert_success(qts, "{ 'execute': 'cont' }");
+
+    for (i = 0; i < 1000 && !qtest_readl(qts, RESULT_ADDR); i++) {
+        g_usleep(1000);
+    }
+    g_assert_cmpuint(qtest_readl(qts, RESULT_ADDR), ==, RESULT);
+    g_assert_cmphex(qtest_readl(qts, RESULT_ADDR + 4), ==, RESULT_LR);
+
+    if (threshold) {
+        g_assert_cmpuint(hot_tb_count(qts), >, 0);
+    } else {
+        g_assert_cmpuint(hot_tb_count(qts), ==, 0);
+    }
+
+    qtest_quit(qts);
+}
+
+static void test_cold(void)
+{
+    tb_hot_run(0);
+}
+
+static void test_superblock(void)
+{
+    tb_hot_run(10);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/tb-hot/cold", test_cold);
+    qtest_add_func("/tb-hot/superblock", test_superblock);
+
+    return g_test_run();
+}
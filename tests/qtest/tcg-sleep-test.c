@@ -0,0 +1,138 @@
+/*
+ * QTest testcase for the idle warp of TCG, -accel tcg,sleep=off
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+
+#define CODE_ADDR   0x40000000
+#define RESULT_ADDR 0x40010000
+#define TICKS_ADDR  (RESULT_ADDR + 8)
+#define START_ADDR  (RESULT_ADDR + 16)
+#define END_ADDR    (RESULT_ADDR + 24)
+
+/* Frequency of the generic timer of the virt machine */
+#define TIMER_HZ    62500000ULL
+
+/*
+ * Arms the virtual timer, whose PPI is enabled in the GIC, to fire after
+ * the number of ticks at TICKS_ADDR, and waits for it in WFI. Stores the
+ * virtual counter before and after the wait.
+ */
+static const uint32_t code[] = {
+    0xe3001000,     /* movw r1, #0 */
+    0xe3401800,     /* movt r1, #0x0800 (GICD) */
+    0xe3002000,     /* movw r2, #0 */
+    0xe3402801,     /* movt r2, #0x0801 (GICC) */
+    0xe3a00001,     /* mov r0, #1 */
+    0xe5810000,     /* str r0, [r1] (GICD_CTLR) */
+    0xe5820000,     /* str r0, [r2] (GICC_CTLR) */
+    0xe3a00302,     /* mov r0, #(1 << 27) */
+    0xe5810100,     /* str r0, [r1, #0x100] (GICD_ISENABLER0) */
+    0xe3a000ff,     /* mov r0, #0xff */
+    0xe5820004,     /* str r0, [r2, #4] (GICC_PMR) */
+    0xe3006000,     /* movw r6, #0 */
+    0xe3446001,     /* movt r6, #0x4001 */
+    0xe5963008,     /* ldr r3, [r6, #8] */
+    0xec554f1e,     /* mrrc p15, 1, r4, r5, c14 (CNTVCT) */
+    0xe1c641f0,     /* strd r4, r5, [r6, #16] */
+    0xee0e3f13,     /* mcr p15, 0, r3, c14, c3, 0 (CNTV_TVAL) */
+    0xe3a00001,     /* mov r0, #1 */
+    0xee0e0f33,     /* mcr p15, 0, r0, c14, c3, 1 (CNTV_CTL) */
+    0xf57ff06f,     /* isb */
+    0xe320f003,     /* 1: wfi */
+    0xee1e0f33,     /* mrc p15, 0, r0, c14, c3, 1 (CNTV_CTL) */
+    0xe3100004,     /* tst r0, #4 (ISTATUS) */
+    0x0afffffb,     /* beq 1b */
+    0xec554f1e,     /* mrrc p15, 1, r4, r5, c14 (CNTVCT) */
+    0xe1c641f8,     /* strd r4, r5, [r6, #24] */
+    0xe3a00001,     /* mov r0, #1 */
+    0xe5860000,     /* str r0, [r6] */
+    0xeafffffe,     /* b . */
+};
+
+/*
+ * Runs the guest with a timer deadline of @secs seconds, and returns the
+ * wall clock time in us until it was reached, or -1 if it was not reached
+ * within @timeout_ms.
+ */
+static int64_t sleep_run(QTestState *qts, unsigned secs, int timeout_ms)
+{
+    int64_t start;
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(code); i++) {
+        qtest_writel(qts, CODE_ADDR + i * 4, code[i]);
+    }
+    qtest_writel(qts, TICKS_ADDR, secs * TIMER_HZ);
+
+    start = g_get_monotonic_time();
+    qtest_qmp_assert_success(qts, "{ 'execute': 'cont' }");
+    for (i = 0; i < timeout_ms && !qtest_readl(qts, RESULT_ADDR); i++) {
+        g_usleep(1000);
+    }
+    if (!qtest_readl(qts, RESULT_ADDR)) {
+        return -1;
+    }
+    return g_get_monotonic_time() - start;
+}
+
+/* The virtual counter went through the whole deadline */
+static void check_counter(QTestState *qts, unsigned secs)
+{
+    uint64_t start = qtest_readq(qts, START_ADDR);
+    uint64_t end = qtest_readq(qts, END_ADDR);
+
+    g_assert_cmpuint(end - start, >=, secs * TIMER_HZ);
+}
+
+static QTestState *sleep_init(const char *sleep)
+{
+    return qtest_initf("-S -machine virt -cpu cortex-a15 "
+                       "-accel tcg,sleep=%s "
+                       "-device loader,addr=0x%x,cpu-num=0",
+                       sleep, CODE_ADDR);
+}
+
+/* Idle, the guest reaches a deadline of 20s much faster than that */
+static void test_sleep_off(void)
+{
+    QTestState *qts = sleep_init("off");
+    int64_t us;
+
+    us = sleep_run(qts, 20, 10000);
+    g_assert_cmpint(us, >=, 0);
+    g_assert_cmpint(us, <, 10 * G_USEC_PER_SEC);
+    check_counter(qts, 20);
+
+    qtest_quit(qts);
+}
+
+/* By default, the deadline is waited for in real time */
+static void test_sleep_on(void)
+{
+    QTestState *qts = sleep_init("on");
+    int64_t us;
+
+    us = sleep_run(qts, 1, 10000);
+    g_assert_cmpint(us, >=, G_USEC_PER_SEC);
+    check_counter(qts, 1);
+
+    qtest_quit(qts);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (qtest_has_accel("tcg")) {
+        qtest_add_func("/tcg-sleep/off", test_sleep_off);
+        qtest_add_func("/tcg-sleep/on", test_sleep_on);
+    }
+
+    return g_test_run();
+}
@@ -0,0 +1,126 @@
+/*
+ * QTest testcase for the victim TLB of TCG, through x-query-tlb-stats
+ *
+ * Copyright (c) Meta Platforms, Inc. and affiliates. (http://www.meta.com)
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "libqtest.h"
+#include "qapi/qmp/qdict.h"
+
+#define CODE_ADDR   0x40000000
+#define RESULT_ADDR 0x40010000
+#define ITERATIONS  1000
+
+/*
+ * The pages read by the guest are 64MiB apart: they share the entry of
+ * the direct mapped TLB, and the set of the victim TLB, whatever the size
+ * of both. One entry of the main TLB and the 4 ways of the set hold 5.
+ */
+#define PAGE_ADDR   0x40001000
+#define PAGE_STRIDE 0x4000000
+#define TLB_PAGES   5
+
+/* Reads the number of pages at RESULT_ADDR + 4 in turn, ITERATIONS times */
+static const uint32_t code[] = {
+    0xe3006000,     /* movw r6, #0 */
+    0xe3446001,     /* movt r6, #0x4001 */
+    0xe5965004,     /* ldr r5, [r6, #4] */
+    0xe3011000,     /* movw r1, #0x1000 */
+    0xe3441000,     /* movt r1, #0x4000 */
+    0xe30023e8,     /* movw r2, #ITERATIONS */
+    0xe1a03001,     /* 0: mov r3, r1 */
+    0xe1a04005,     /* mov r4, r5 */
+    0xe5930000,     /* 1: ldr r0, [r3] */
+    0xe2833301,     /* add r3, r3, #PAGE_STRIDE */
+    0xe2544001,     /* subs r4, r4, #1 */
+    0x1afffffb,     /* bne 1b */
+    0xe2522001,     /* subs r2, r2, #1 */
+    0x1afffff7,     /* bne 0b */
+    0xe3a00001,     /* mov r0, #1 */
+    0xe5860000,     /* str r0, [r6] */
+    0xeafffffe,     /* b . */
+};
+
+/* Sums the victim hits and fills of all the MMU indexes of CPU#0 */
+static void tlb_stats(QTestState *qts, size_t *hits, size_t *fills)
+{
+    QDict *rsp, *ret;
+    const char *line;
+    size_t h, f;
+    unsigned victim;
+
+    rsp = qtest_qmp(qts, "{ 'execute': 'x-query-tlb-stats' }");
+    ret = qdict_get_qdict(rsp, "return");
+    line = strstr(qdict_get_str(ret, "human-readable-text"), "CPU#0\n");
+    g_assert(line);
+
+    *hits = *fills = 0;
+    /* Skip the CPU and header lines */
+    line = strchr(line, '\n') + 1;
+    line = strchr(line, '\n') + 1;
+    while (sscanf(line, " %*d %*u %u %zu %zu", &victim, &h, &f) == 3) {
+        g_assert_cmpuint(victim, >=, 8);
+        g_assert_cmpuint(victim, <=, 256);
+        *hits += h;
+        *fills += f;
+        line = strchr(line, '\n') + 1;
+    }
+    qobject_unref(rsp);
+}
+
+static void tlb_stats_run(unsigned pages, size_t *hits, size_t *fills)
+{
+    QTestState *qts;
+    int i;
+
+    qts = qtest_initf("-S -machine virt -cpu cortex-a15 -m 512M -accel tcg "
+                      "-device loader,addr=0x%x,cpu-num=0", CODE_ADDR);
+    for (i = 0; i < ARRAY_SIZE(code); i++) {
+        qtest_writel(qts, CODE_ADDR + i * 4, code[i]);
+    }
+    qtest_writel(qts, RESULT_ADDR + 4, pages);
+    qtest_qmp_assert_success(qts, "{ 'execute': 'cont' }");
+
+    for (i = 0; i < 1000 && !qtest_readl(qts, RESULT_ADDR); i++) {
+        g_usleep(1000);
+    }
+    g_assert_cmpuint(qtest_readl(qts, RESULT_ADDR), ==, 1);
+
+    tlb_stats(qts, hits, fills);
+    qtest_quit(qts);
+}
+
+/* After the first round, every page is found in the victim TLB */
+static void test_victim_hit(void)
+{
+    size_t hits, fills;
+
+    tlb_stats_run(TLB_PAGES, &hits, &fills);
+    g_assert_cmpuint(hits, >=, (ITERATIONS - 1) * TLB_PAGES);
+    g_assert_cmpuint(fills, <, ITERATIONS);
+}
+
+/* One page more, and each read evicts the page read next from the set */
+static void test_eviction(void)
+{
+    size_t hits, fills;
+
+    tlb_stats_run(TLB_PAGES + 1, &hits, &fills);
+    g_assert_cmpuint(hits, <, ITERATIONS);
+    g_assert_cmpuint(fills, >=, ITERATIONS * (TLB_PAGES + 1));
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    if (qtest_has_accel("tcg")) {
+        qtest_add_func("/tlb-stats/victim_hit", test_victim_hit);
+        qtest_add_func("/tlb-stats/eviction", test_eviction);
+    }
+
+    return g_test_run();
+}
@@ -14,6 +14,7 @@
 #include "libqos/i2c.h"
 #include "qapi/qmp/qdict.h"
 #include "hw/sensor/tmp105_regs.h"
+#include "hw/sensor/sensor-feed-table.h"
 
 #define TMP105_TEST_ID   "tmp105-test"
 #define TMP105_TEST_ADDR 0x49
@@ -105,16 +106,121 @@ static void send_and_receive(void *obj, void *data, QGuestAllocator *alloc)
     g_assert_cmphex(i2c_get16(i2cdev, TMP105_REG_T_HIGH), ==, 0x4231);
 }
 
+#define FEED_ENTRIES 4
+
+static void feed_write(int fd, uint32_t seq, int index, int64_t value)
+{
+    off_t seq_off = offsetof(SensorFeedTable, seq);
+    off_t value_off = offsetof(SensorFeedTable, values) +
+                      index * sizeof(int64_t);
+
+    g_assert_cmpint(pwrite(fd, &value, sizeof(value), value_off), ==,
+                    sizeof(value));
+    g_assert_cmpint(pwrite(fd, &seq, sizeof(seq), seq_off), ==, sizeof(seq));
+}
+
+static void feed_test_clear(void *path)
+{
+    unlink(path);
+    g_free(path);
+}
+
+static void *feed_test_init(GString *cmd_line, void *arg)
+{
+    SensorFeedTable table = {
+        .magic = SENSOR_FEED_MAGIC,
+        .version = SENSOR_FEED_VERSION,
+        .count = FEED_ENTRIES,
+    };
+    int64_t values[FEED_ENTRIES] = { 0 };
+    char *path;
+    int fd;
+
+    fd = g_file_open_tmp("sensor-feed-XXXXXX", &path, NULL);
+    g_assert(fd >= 0);
+    g_assert_cmpint(write(fd, &table, sizeof(table)), ==, sizeof(table));
+    g_assert_cmpint(write(fd, values, sizeof(values)), ==, sizeof(values));
+    close(fd);
+
+    g_string_append_printf(cmd_line, " -object sensor-feed,id=feed0,path=%s ",
+                           path);
+
+    g_test_queue_destroy(feed_test_clear, path);
+    return path;
+}
+
+static void qmp_tmp105_set(const char *property, const char *value)
+{
+    QDict *response;
+
+    response = qmp("{ 'execute': 'qom-set', 'arguments': { 'path': %s, "
+                   "'property': %s, 'value': %s } }", TMP105_TEST_ID,
+                   property, value);
+    g_assert(qdict_haskey(response, "return"));
+    qobject_unref(response);
+}
+
+static void feed(void *obj, void *data, QGuestAllocator *alloc)
+{
+    QI2CDevice *i2cdev = (QI2CDevice *)obj;
+    uint32_t count = 1024;
+    QDict *response;
+    int fd;
+
+    fd = open(data, O_RDWR);
+    g_assert(fd >= 0);
+
+    qmp_tmp105_set("feed", "/objects/feed0");
+    qmp_tmp105_set("feed-props", "temperature");
+    response = qmp("{ 'execute': 'qom-set', 'arguments': { 'path': %s, "
+                   "'property': 'feed-index', 'value': 2 } }", TMP105_TEST_ID);
+    g_assert(qdict_haskey(response, "return"));
+    qobject_unref(response);
+
+    feed_write(fd, 2, 2, 30000);
+    g_assert_cmphex(i2c_get16(i2cdev, TMP105_REG_TEMPERATURE), ==, 0x1e00);
+    g_assert_cmpuint(qmp_tmp105_get_temperature(TMP105_TEST_ID), ==, 30000);
+
+    /* The value is sampled again only after a tick */
+    qmp_tmp105_set_temperature(TMP105_TEST_ID, 20000);
+    g_assert_cmphex(i2c_get16(i2cdev, TMP105_REG_TEMPERATURE), ==, 0x1400);
+
+    feed_write(fd, 4, 2, 25000);
+    g_assert_cmphex(i2c_get16(i2cdev, TMP105_REG_TEMPERATURE), ==, 0x1900);
+
+    /* A write in progress is not sampled */
+    feed_write(fd, 5, 2, 10000);
+    g_assert_cmphex(i2c_get16(i2cdev, TMP105_REG_TEMPERATURE), ==, 0x1900);
+
+    /* Entries past the count checked at open stay out of range */
+    g_assert_cmpint(pwrite(fd, &count, sizeof(count),
+                           offsetof(SensorFeedTable, count)), ==,
+                    sizeof(count));
+    response = qmp("{ 'execute': 'qom-set', 'arguments': { 'path': %s, "
+                   "'property': 'feed-index', 'value': %d } }",
+                   TMP105_TEST_ID, FEED_ENTRIES);
+    g_assert(qdict_haskey(response, "return"));
+    qobject_unref(response);
+    feed_write(fd, 6, 2, 10000);
+    g_assert_cmphex(i2c_get16(i2cdev, TMP105_REG_TEMPERATURE), ==, 0x1900);
+
+    close(fd);
+}
+
 static void tmp105_register_nodes(void)
 {
     QOSGraphEdgeOptions opts = {
         .extra_device_opts = "id=" TMP105_TEST_ID ",address=0x49"
     };
+    QOSGraphTestOptions feed_opts = {
+        .before = feed_test_init,
+    };
     add_qi2c_address(&opts, &(QI2CAddress) { 0x49 });
 
     qos_node_create_driver("tmp105", i2c_device_create);
     qos_node_consumes("tmp105", "i2c-bus", &opts);
 
     qos_add_test("tx-rx", "tmp105", send_and_receive, NULL);
+    qos_add_test("feed", "tmp105", feed, &feed_opts);
 }
 libqos_init(tmp105_register_nodes);